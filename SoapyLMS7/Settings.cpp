@@ -1227,9 +1227,94 @@ SoapySDR::ArgInfoList SoapyLMS7::getSettingInfo(const int direction, const size_
         infos.push_back(info);
     }
 
+    {
+        SoapySDR::ArgInfo info;
+        info.key = "STREAM_METRICS";
+        info.name = "Stream Metrics";
+        info.type = SoapySDR::ArgInfo::STRING;
+        info.description = "Read only performance metrics of the stream using this channel, formatted as key=value pairs.";
+        infos.push_back(info);
+    }
+
+    {
+        SoapySDR::ArgInfo info;
+        info.key = "SIGNAL_STATS";
+        info.name = "Signal Statistics";
+        info.type = SoapySDR::ArgInfo::STRING;
+        info.description = "Read only statistics of samples returned by the last readStream() of this channel, "
+            "requires signalStats stream argument. Formatted as key=value pairs, normalized to full scale.";
+        infos.push_back(info);
+    }
+
     return infos;
 }
 
+std::string SoapyLMS7::readSetting(const int direction, const size_t channel, const std::string &key) const
+{
+    std::unique_lock<std::recursive_mutex> lock(_accessMutex);
+
+    if (key == "STREAM_METRICS")
+    {
+        auto it = _streamIDs.find(std::make_pair(direction, channel));
+        if (it == _streamIDs.end())
+            throw std::runtime_error("readSetting(STREAM_METRICS) no stream is set up for this channel");
+        StreamMetrics metrics;
+        if (_conn->GetStreamMetrics(it->second, metrics) != 0)
+            throw std::runtime_error(lime::GetLastErrorMessage());
+        std::string intervals;
+        for (int i = 0; i < StreamMetrics::HISTOGRAM_BINS; ++i)
+            intervals += (i ? " " : "") + std::to_string(metrics.transferIntervals[i]);
+        SoapySDR::Kwargs result;
+        result["fifoSize"] = std::to_string(metrics.fifoSize);
+        result["fifoHighWatermark"] = std::to_string(metrics.fifoHighWatermark);
+        result["packetsTransferred"] = std::to_string(metrics.packetsTransferred);
+        result["bytesTransferred"] = std::to_string(metrics.bytesTransferred);
+        result["transferIntervals"] = intervals;
+        result["packetTimeAvg_ns"] = std::to_string(metrics.packetTimeAvg_ns);
+        result["packetTimeMax_ns"] = std::to_string(metrics.packetTimeMax_ns);
+        if (metrics.txLeadTimeCount != 0)
+        {
+            result["txLeadTimeMin"] = std::to_string(metrics.txLeadTimeMin);
+            result["txLeadTimeAvg"] = std::to_string(metrics.txLeadTimeAvg);
+        }
+        result["overflowSamples"] = std::to_string(metrics.overflowSamples);
+        if (direction == SOAPY_SDR_RX)
+        {
+            result["overflowOldestSamples"] = std::to_string(metrics.overflowOldestSamples);
+            result["overflowNewestSamples"] = std::to_string(metrics.overflowNewestSamples);
+            result["overflowDecimatedSamples"] = std::to_string(metrics.overflowDecimatedSamples);
+            result["overflowBlocks"] = std::to_string(metrics.overflowBlocks);
+            result["overflowBlockTime_us"] = std::to_string(metrics.overflowBlockTime_us);
+        }
+        result["linkLossSamples"] = std::to_string(metrics.linkLossSamples);
+        result["lateSamples"] = std::to_string(metrics.lateSamples);
+        result["underflowSamples"] = std::to_string(metrics.underflowSamples);
+        return SoapySDR::KwargsToString(result);
+    }
+
+    if (key == "SIGNAL_STATS")
+    {
+        auto it = _streamIDs.find(std::make_pair(direction, channel));
+        if (it == _streamIDs.end())
+            throw std::runtime_error("readSetting(SIGNAL_STATS) no stream is set up for this channel");
+        SignalStats stats;
+        if (_conn->GetSignalStats(it->second, stats) != 0)
+            throw std::runtime_error(lime::GetLastErrorMessage());
+        const double fullScale = 2048.0;
+        const double count = stats.samplesCount ? stats.samplesCount : 1;
+        SoapySDR::Kwargs result;
+        result["samples"] = std::to_string(stats.samplesCount);
+        result["clipped"] = std::to_string(stats.clipCount);
+        result["peak"] = std::to_string(stats.peak / fullScale);
+        result["power"] = std::to_string(stats.sumPower / count / (fullScale*fullScale));
+        result["dcI"] = std::to_string(stats.sumI / count / fullScale);
+        result["dcQ"] = std::to_string(stats.sumQ / count / fullScale);
+        return SoapySDR::KwargsToString(result);
+    }
+
+    throw std::runtime_error("unknown setting key: "+key);
+}
+
 void SoapyLMS7::writeSetting(const int direction, const size_t channel, const std::string &key, const std::string &value)
 {
     std::unique_lock<std::recursive_mutex> lock(_accessMutex);
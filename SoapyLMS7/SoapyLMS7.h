@@ -96,6 +96,39 @@ public:
         long long &timeNs,
         const long timeoutUs = 100000);
 
+    /*******************************************************************
+     * Direct buffer access API
+     ******************************************************************/
+
+    size_t getNumDirectAccessBuffers(SoapySDR::Stream *stream);
+
+    int getDirectAccessBufferAddrs(SoapySDR::Stream *stream, const size_t handle, void **buffs);
+
+    int acquireReadBuffer(
+        SoapySDR::Stream *stream,
+        size_t &handle,
+        const void **buffs,
+        int &flags,
+        long long &timeNs,
+        const long timeoutUs = 100000);
+
+    void releaseReadBuffer(
+        SoapySDR::Stream *stream,
+        const size_t handle);
+
+    int acquireWriteBuffer(
+        SoapySDR::Stream *stream,
+        size_t &handle,
+        void **buffs,
+        const long timeoutUs = 100000);
+
+    void releaseWriteBuffer(
+        SoapySDR::Stream *stream,
+        const size_t handle,
+        const size_t numElems,
+        int &flags,
+        const long long timeNs = 0);
+
     /*******************************************************************
      * Antenna API
      ******************************************************************/
@@ -250,6 +283,8 @@ public:
 
     void writeSetting(const int direction, const size_t channel, const std::string &key, const std::string &value);
 
+    std::string readSetting(const int direction, const size_t channel, const std::string &key) const;
+
     /*******************************************************************
      * GPIO API
      ******************************************************************/
@@ -285,5 +320,6 @@ private:
     lime::LMS7002M *getRFIC(const size_t channel) const;
     std::vector<lime::LMS7002M *> _rfics;
     std::set<std::pair<int, size_t>> _channelsToCal;
+    std::map<std::pair<int, size_t>, size_t> _streamIDs; //stream of each direction and channel
     mutable std::recursive_mutex _accessMutex;
 };
@@ -10,8 +10,12 @@
 #include <SoapySDR/Formats.hpp>
 #include <SoapySDR/Time.hpp>
 #include <thread>
+#include <chrono>
 #include <algorithm> //min/max
 #include "ErrorReporting.h"
+#ifdef __linux__
+#include <poll.h>
+#endif
 
 using namespace lime;
 
@@ -32,6 +36,95 @@ struct IConnectionStream
     size_t numElems;
 };
 
+/*******************************************************************
+ * Receive metadata translation, shared by readStream and acquireReadBuffer
+ ******************************************************************/
+static int translateRxMetadata(IConnectionStream *icstream, const StreamMetadata &metadata, const double rate, int &flags, long long &timeNs)
+{
+    //the command had a time, samples before it were dropped by the receive pipeline
+    if ((icstream->flags & SOAPY_SDR_HAS_TIME) != 0 and metadata.hasTimestamp)
+    {
+        const uint64_t cmdTicks = SoapySDR::timeNsToTicks(icstream->timeNs, rate);
+
+        //our request time is now late, clear command and return error code
+        if (cmdTicks < metadata.timestamp)
+        {
+            icstream->hasCmd = false;
+            return SOAPY_SDR_TIME_ERROR;
+        }
+        icstream->flags &= ~SOAPY_SDR_HAS_TIME; //clear for next read
+    }
+
+    //the burst completed, done with the command
+    if (metadata.endOfBurst)
+        icstream->hasCmd = false;
+
+    //output metadata
+    flags = 0;
+    if (metadata.endOfBurst) flags |= SOAPY_SDR_END_BURST;
+    if (metadata.hasTimestamp) flags |= SOAPY_SDR_HAS_TIME;
+    timeNs = SoapySDR::ticksToTimeNs(metadata.timestamp, rate);
+    return 0;
+}
+
+/*******************************************************************
+ * Status of any channel of the stream, used by readStreamStatus
+ ******************************************************************/
+static int readChannelsStatus(IConnection *conn, const std::vector<size_t> &streamID, const long timeoutUs, size_t &chanMask, StreamMetadata &metadata)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeoutUs);
+#ifdef __linux__
+    //event descriptors of all channels are waited on together
+    std::vector<pollfd> fds;
+    for (const auto id : streamID)
+    {
+        pollfd pfd = {conn->GetStreamEventFd(id), POLLIN, 0};
+        if (pfd.fd < 0)
+        {
+            fds.clear();
+            break;
+        }
+        fds.push_back(pfd);
+    }
+#endif
+    size_t next = 0;
+    for (;;)
+    {
+        //take events already queued on any channel
+        for (size_t i = 0; i < streamID.size(); ++i)
+        {
+            if (conn->ReadStreamStatus(streamID[i], 0, metadata) == 0)
+            {
+                chanMask |= (1 << i);
+                return 0;
+            }
+            //status is not implemented by connection, do not wait for it
+            if (GetLastError() == EPERM)
+                return -1;
+        }
+        const long remainingUs = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (remainingUs <= 0)
+            return -1;
+        const long remainingMs = (remainingUs + 999)/1000;
+#ifdef __linux__
+        if (not fds.empty())
+        {
+            if (poll(fds.data(), fds.size(), remainingMs) < 0 and errno != EINTR)
+                return -1;
+            continue;
+        }
+#endif
+        //descriptors not supported, wait on channels in turn
+        const size_t i = next++ % streamID.size();
+        const long waitMs = streamID.size() == 1 ? remainingMs : std::min(remainingMs, 10L);
+        if (conn->ReadStreamStatus(streamID[i], waitMs, metadata) == 0)
+        {
+            chanMask |= (1 << i);
+            return 0;
+        }
+    }
+}
+
 /*******************************************************************
  * Stream information
  ******************************************************************/
@@ -41,6 +134,7 @@ std::vector<std::string> SoapyLMS7::getStreamFormats(const int direction, const
     formats.push_back(SOAPY_SDR_CF32);
     formats.push_back(SOAPY_SDR_CS12);
     formats.push_back(SOAPY_SDR_CS16);
+    formats.push_back(SOAPY_SDR_CS8);
     return formats;
 }
 
@@ -81,6 +175,85 @@ SoapySDR::ArgInfoList SoapyLMS7::getStreamArgsInfo(const int direction, const si
         argInfos.push_back(info);
     }
 
+    //underflow timeout
+    if (direction == SOAPY_SDR_TX)
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "100";
+        info.key = "underflowTimeout";
+        info.name = "Underflow Timeout";
+        info.description = "Time to wait for samples before zeros are transmitted.";
+        info.units = "ms";
+        info.type = SoapySDR::ArgInfo::INT;
+        argInfos.push_back(info);
+    }
+
+    //gap filling
+    if (direction == SOAPY_SDR_RX)
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "0";
+        info.key = "gapFillLimit";
+        info.name = "Gap Fill Limit";
+        info.description = "Maximum number of samples inserted in place of packets lost on the link.";
+        info.units = "samples";
+        info.type = SoapySDR::ArgInfo::INT;
+        argInfos.push_back(info);
+    }
+    if (direction == SOAPY_SDR_RX)
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "0";
+        info.key = "gapFillValue";
+        info.name = "Gap Fill Value";
+        info.description = "I and Q value of samples inserted in place of lost packets.";
+        info.type = SoapySDR::ArgInfo::INT;
+        argInfos.push_back(info);
+    }
+
+    //overflow handling
+    if (direction == SOAPY_SDR_RX)
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "dropOldest";
+        info.key = "overflowPolicy";
+        info.name = "Overflow Policy";
+        info.description = "Handling of received samples when FIFO is full.";
+        info.type = SoapySDR::ArgInfo::STRING;
+        info.options.push_back("dropOldest");
+        info.options.push_back("dropNewest");
+        info.options.push_back("block");
+        info.options.push_back("decimate");
+        info.optionNames.push_back("Drop oldest samples");
+        info.optionNames.push_back("Drop received samples");
+        info.optionNames.push_back("Wait for free space");
+        info.optionNames.push_back("Skip every other packet");
+        argInfos.push_back(info);
+    }
+    if (direction == SOAPY_SDR_RX)
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "10";
+        info.key = "overflowTimeout";
+        info.name = "Overflow Timeout";
+        info.description = "Maximum wait for free FIFO space with block overflow policy.";
+        info.units = "ms";
+        info.type = SoapySDR::ArgInfo::INT;
+        argInfos.push_back(info);
+    }
+
+    //signal statistics
+    if (direction == SOAPY_SDR_RX)
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "false";
+        info.key = "signalStats";
+        info.name = "Signal Statistics";
+        info.description = "Compute peak, power, DC and clipping of received samples, read with SIGNAL_STATS setting.";
+        info.type = SoapySDR::ArgInfo::BOOL;
+        argInfos.push_back(info);
+    }
+
     return argInfos;
 }
 
@@ -113,7 +286,8 @@ SoapySDR::Stream *SoapyLMS7::setupStream(
         config.channelID = channelIDs[i];
         if (format == SOAPY_SDR_CF32) config.format = StreamConfig::STREAM_COMPLEX_FLOAT32;
         else if (format == SOAPY_SDR_CS16) config.format = StreamConfig::STREAM_12_BIT_IN_16;
-        else if (format == SOAPY_SDR_CS12) config.format = StreamConfig::STREAM_12_BIT_COMPRESSED;
+        else if (format == SOAPY_SDR_CS12) config.format = StreamConfig::STREAM_12_BIT_PACKED;
+        else if (format == SOAPY_SDR_CS8) config.format = StreamConfig::STREAM_8_BIT;
         else throw std::runtime_error("SoapyLMS7::setupStream(format="+format+") unsupported format");
 
         //optional buffer length if specified
@@ -130,6 +304,39 @@ SoapySDR::Stream *SoapyLMS7::setupStream(
             else if(config.performanceLatency > 1)
                 config.performanceLatency = 1;
         }
+        //optional time to wait for transmit samples before sending zeros
+        if (args.count("underflowTimeout") != 0)
+        {
+            config.underflowTimeout_ms = std::stoul(args.at("underflowTimeout"));
+        }
+        //optional samples inserted in place of lost packets
+        if (args.count("gapFillLimit") != 0)
+        {
+            config.gapFillLimit = std::stoul(args.at("gapFillLimit"));
+        }
+        if (args.count("gapFillValue") != 0)
+        {
+            config.gapFillValue = std::stoi(args.at("gapFillValue"));
+        }
+        //optional handling of full receive FIFO
+        if (args.count("overflowPolicy") != 0)
+        {
+            const std::string &policy = args.at("overflowPolicy");
+            if (policy == "dropOldest") config.overflowPolicy = StreamConfig::OVERFLOW_DROP_OLDEST;
+            else if (policy == "dropNewest") config.overflowPolicy = StreamConfig::OVERFLOW_DROP_NEWEST;
+            else if (policy == "block") config.overflowPolicy = StreamConfig::OVERFLOW_BLOCK;
+            else if (policy == "decimate") config.overflowPolicy = StreamConfig::OVERFLOW_DECIMATE;
+            else throw std::runtime_error("SoapyLMS7::setupStream(overflowPolicy="+policy+") unsupported policy");
+        }
+        if (args.count("overflowTimeout") != 0)
+        {
+            config.overflowTimeout_ms = std::stoul(args.at("overflowTimeout"));
+        }
+        //optional signal statistics of received samples
+        if (args.count("signalStats") != 0)
+        {
+            config.signalStats = args.at("signalStats") == "true";
+        }
 
         //create the stream
         size_t streamID(~0);
@@ -137,6 +344,7 @@ SoapySDR::Stream *SoapyLMS7::setupStream(
         if (status != 0)
             throw std::runtime_error("SoapyLMS7::setupStream() failed: " + std::string(GetLastErrorMessage()));
         stream->streamID.push_back(streamID);
+        _streamIDs[std::make_pair(direction, channelIDs[i])] = streamID;
         stream->elemMTU = _conn->GetStreamSize(streamID);
     }
 
@@ -157,6 +365,13 @@ void SoapyLMS7::closeStream(SoapySDR::Stream *stream)
 
     for(auto i : streamID)
         _conn->CloseStream(i);
+    for(auto it = _streamIDs.begin(); it != _streamIDs.end();)
+    {
+        if (std::find(streamID.begin(), streamID.end(), it->second) != streamID.end())
+            it = _streamIDs.erase(it);
+        else
+            ++it;
+    }
 }
 
 size_t SoapyLMS7::getStreamMTU(SoapySDR::Stream *stream) const
@@ -197,6 +412,20 @@ int SoapyLMS7::activateStream(
     icstream->numElems = numElems;
     icstream->hasCmd = true;
 
+    //timed and burst requests are handled by the receive pipeline
+    if (icstream->direction == SOAPY_SDR_RX)
+    {
+        StreamMetadata metadata;
+        metadata.timestamp = SoapySDR::timeNsToTicks(timeNs, _conn->GetHardwareTimestampRate());
+        metadata.hasTimestamp = (flags & SOAPY_SDR_HAS_TIME) != 0;
+        for(auto i : streamID)
+        {
+            int status = _conn->ScheduleRxStream(i, numElems, metadata);
+            if(status != 0)
+                return SOAPY_SDR_STREAM_ERROR;
+        }
+    }
+
     for(auto i : streamID)
     {
         int status = _conn->ControlStream(i, true);
@@ -261,7 +490,6 @@ int SoapyLMS7::readStream(
         numElems = std::min(numElems, icstream->elemMTU);
     }
 
-    ReadStreamAgain:
     StreamMetadata metadata;
     int status = 0;
     int bufIndex = 0;
@@ -272,59 +500,9 @@ int SoapyLMS7::readStream(
         if(status < 0) return SOAPY_SDR_STREAM_ERROR;
     }
 
-    //the command had a time, so we need to compare it to received time
-    if ((icstream->flags & SOAPY_SDR_HAS_TIME) != 0 and metadata.hasTimestamp)
-    {
-        const uint64_t cmdTicks = SoapySDR::timeNsToTicks(icstream->timeNs, _conn->GetHardwareTimestampRate());
-
-        //our request time is now late, clear command and return error code
-        if (cmdTicks < metadata.timestamp)
-        {
-            icstream->hasCmd = false;
-            return SOAPY_SDR_TIME_ERROR;
-        }
-
-        //our request time is not in this received buffer, try again
-        if (cmdTicks >= (metadata.timestamp + status))
-        {
-            if (std::chrono::high_resolution_clock::now() > exitTime) return SOAPY_SDR_TIMEOUT;
-            goto ReadStreamAgain;
-        }
-
-        //otherwise our request is in this buffer, advance memory
-        const size_t numOff = (cmdTicks - metadata.timestamp);
-        metadata.timestamp += numOff;
-        status -= numOff;
-        const size_t elemSize = icstream->elemSize;
-        for (size_t i = 0; i < streamID.size(); i++)
-        {
-            const size_t memStart = size_t(buffs[i])+(numOff*elemSize);
-            std::memmove(buffs[i], (const void *)memStart, status*elemSize);
-        }
-        icstream->flags &= ~SOAPY_SDR_HAS_TIME; //clear for next read
-    }
-
-    //handle finite burst request commands
-    if (icstream->numElems != 0)
-    {
-        //Clip to within the request size when over,
-        //and reduce the number of elements requested.
-        status = std::min<size_t>(status, icstream->numElems);
-        icstream->numElems -= status;
-
-        //the burst completed, done with the command
-        if (icstream->numElems == 0)
-        {
-            icstream->hasCmd = false;
-            metadata.endOfBurst = true;
-        }
-    }
-
-    //output metadata
-    flags = 0;
-    if (metadata.endOfBurst) flags |= SOAPY_SDR_END_BURST;
-    if (metadata.hasTimestamp) flags |= SOAPY_SDR_HAS_TIME;
-    timeNs = SoapySDR::ticksToTimeNs(metadata.timestamp, _conn->GetHardwareTimestampRate());
+    const int ret = translateRxMetadata(icstream, metadata, _conn->GetHardwareTimestampRate(), flags, timeNs);
+    if (ret != 0)
+        return ret;
 
     //return num read or error code
     return (status >= 0) ? status : SOAPY_SDR_STREAM_ERROR;
@@ -360,6 +538,113 @@ int SoapyLMS7::writeStream(
     return (ret > 0)? ret : SOAPY_SDR_STREAM_ERROR;
 }
 
+/*******************************************************************
+ * Direct buffer access API
+ ******************************************************************/
+size_t SoapyLMS7::getNumDirectAccessBuffers(SoapySDR::Stream *stream)
+{
+    auto icstream = (IConnectionStream *)stream;
+    //library buffers hold samples as CS16, other formats need conversion
+    if (icstream->elemSize != SoapySDR::formatToSize(SOAPY_SDR_CS16))
+        return 0;
+    //channel FIFOs are independent, their buffers are not aligned
+    if (icstream->streamID.size() != 1)
+        return 0;
+    return _conn->GetNumDirectAccessBuffers(icstream->streamID.front());
+}
+
+int SoapyLMS7::getDirectAccessBufferAddrs(SoapySDR::Stream *stream, const size_t handle, void **buffs)
+{
+    auto icstream = (IConnectionStream *)stream;
+    if (getNumDirectAccessBuffers(stream) == 0)
+        return SOAPY_SDR_NOT_SUPPORTED;
+    if (_conn->GetDirectAccessBufferAddr(icstream->streamID.front(), handle, &buffs[0]) != 0)
+        return SOAPY_SDR_STREAM_ERROR;
+    return 0;
+}
+
+int SoapyLMS7::acquireReadBuffer(
+    SoapySDR::Stream *stream,
+    size_t &handle,
+    const void **buffs,
+    int &flags,
+    long long &timeNs,
+    const long timeoutUs)
+{
+    auto icstream = (IConnectionStream *)stream;
+    const auto &streamID = icstream->streamID;
+
+    if (getNumDirectAccessBuffers(stream) == 0)
+        return SOAPY_SDR_NOT_SUPPORTED;
+
+    //wait for a command from activate stream up to the timeout specified
+    if (not icstream->hasCmd)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(timeoutUs));
+        return SOAPY_SDR_TIMEOUT;
+    }
+
+    StreamMetadata metadata;
+    const int status = _conn->AcquireReadBuffer(streamID.front(), handle, &buffs[0], timeoutUs/1000, metadata);
+    if (status <= 0)
+        return (status == 0) ? SOAPY_SDR_TIMEOUT : SOAPY_SDR_STREAM_ERROR;
+
+    const int ret = translateRxMetadata(icstream, metadata, _conn->GetHardwareTimestampRate(), flags, timeNs);
+    if (ret != 0)
+    {
+        releaseReadBuffer(stream, handle);
+        return ret;
+    }
+    return status;
+}
+
+void SoapyLMS7::releaseReadBuffer(
+    SoapySDR::Stream *stream,
+    const size_t handle)
+{
+    auto icstream = (IConnectionStream *)stream;
+    const auto &streamID = icstream->streamID;
+
+    _conn->ReleaseReadBuffer(streamID.front(), handle);
+}
+
+int SoapyLMS7::acquireWriteBuffer(
+    SoapySDR::Stream *stream,
+    size_t &handle,
+    void **buffs,
+    const long timeoutUs)
+{
+    auto icstream = (IConnectionStream *)stream;
+    const auto &streamID = icstream->streamID;
+
+    if (getNumDirectAccessBuffers(stream) == 0)
+        return SOAPY_SDR_NOT_SUPPORTED;
+
+    const int status = _conn->AcquireWriteBuffer(streamID.front(), handle, &buffs[0], timeoutUs/1000);
+    if (status <= 0)
+        return (status == 0) ? SOAPY_SDR_TIMEOUT : SOAPY_SDR_STREAM_ERROR;
+    return status;
+}
+
+void SoapyLMS7::releaseWriteBuffer(
+    SoapySDR::Stream *stream,
+    const size_t handle,
+    const size_t numElems,
+    int &flags,
+    const long long timeNs)
+{
+    auto icstream = (IConnectionStream *)stream;
+    const auto &streamID = icstream->streamID;
+
+    //input metadata
+    StreamMetadata metadata;
+    metadata.timestamp = SoapySDR::timeNsToTicks(timeNs, _conn->GetHardwareTimestampRate());
+    metadata.hasTimestamp = (flags & SOAPY_SDR_HAS_TIME) != 0;
+    metadata.endOfBurst = (flags & SOAPY_SDR_END_BURST) != 0;
+
+    _conn->ReleaseWriteBuffer(streamID.front(), handle, numElems, metadata);
+}
+
 int SoapyLMS7::readStreamStatus(
     SoapySDR::Stream *stream,
     size_t &chanMask,
@@ -372,31 +657,14 @@ int SoapyLMS7::readStreamStatus(
 
     StreamMetadata metadata;
     flags = 0;
-    auto start = std::chrono::high_resolution_clock::now();
-    while (1)
+    chanMask = 0;
+
+    const int ret = readChannelsStatus(_conn, streamID, timeoutUs, chanMask, metadata);
+    if (ret != 0)
     {
-        for(auto i : streamID)
-        {
-            int ret = _conn->ReadStreamStatus(i, timeoutUs/1000, metadata);
-            if (ret != 0)
-            {
-                //handle the default not implemented case and return not supported
-                if (GetLastError() == EPERM) return SOAPY_SDR_NOT_SUPPORTED;
-                return SOAPY_SDR_TIMEOUT;
-            }
-        }
-        //stop when event is detected
-        if (metadata.endOfBurst || metadata.lateTimestamp || metadata.packetDropped)
-            break;
-        //check timeout
-        std::chrono::duration<double> seconds = std::chrono::high_resolution_clock::now()-start;
-        if (seconds.count()> (double)timeoutUs/1e6)
-            return SOAPY_SDR_TIMEOUT;
-        //sleep to avoid high CPU load
-        if (timeoutUs >= 2000)
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
-        else
-            std::this_thread::sleep_for(std::chrono::microseconds(1+timeoutUs/2));
+        //handle the default not implemented case and return not supported
+        if (GetLastError() == EPERM) return SOAPY_SDR_NOT_SUPPORTED;
+        return SOAPY_SDR_TIMEOUT;
     }
 
     timeNs = SoapySDR::ticksToTimeNs(metadata.timestamp, _conn->GetHardwareTimestampRate());
@@ -405,6 +673,7 @@ int SoapyLMS7::readStreamStatus(
     if (metadata.hasTimestamp) flags |= SOAPY_SDR_HAS_TIME;
 
     if (metadata.lateTimestamp) return SOAPY_SDR_TIME_ERROR;
+    if (metadata.underflow) return SOAPY_SDR_UNDERFLOW;
     if (metadata.packetDropped) return SOAPY_SDR_OVERFLOW;
 
     return 0;
@@ -9,6 +9,7 @@
 #include "VersionInfo.h"
 #include <assert.h>
 #include "FPGA_common.h"
+#include "SweepEngine.h"
 
 using namespace std;
 
@@ -1121,6 +1122,25 @@ API_EXPORT int CALL_CONV LMS_SetGFIR(lms_device_t * device, bool dir_tx, size_t
     return lms->SetGFIR(dir_tx,chan,filt,enabled);
 }
 
+static lime::StreamConfig::StreamDataFormat StreamDataFormat(const lms_stream_t *stream)
+{
+    switch(stream->dataFmt)
+    {
+        case lms_stream_t::LMS_FMT_F32:
+            return lime::StreamConfig::STREAM_COMPLEX_FLOAT32;
+        case lms_stream_t::LMS_FMT_I16:
+            return lime::StreamConfig::STREAM_12_BIT_IN_16;
+        case lms_stream_t::LMS_FMT_I12:
+            return lime::StreamConfig::STREAM_12_BIT_COMPRESSED;
+        case lms_stream_t::LMS_FMT_I12_PACKED:
+            return lime::StreamConfig::STREAM_12_BIT_PACKED;
+        case lms_stream_t::LMS_FMT_I8:
+            return lime::StreamConfig::STREAM_8_BIT;
+        default:
+            return lime::StreamConfig::STREAM_COMPLEX_FLOAT32;
+    }
+}
+
 API_EXPORT int CALL_CONV LMS_SetupStream(lms_device_t *device, lms_stream_t *stream)
 {
     if(device == nullptr)
@@ -1134,21 +1154,22 @@ API_EXPORT int CALL_CONV LMS_SetupStream(lms_device_t *device, lms_stream_t *str
     config.bufferLength = stream->fifoSize;
     config.channelID = stream->channel;
     config.performanceLatency = stream->throughputVsLatency;
-    switch(stream->dataFmt)
-    {
-        case lms_stream_t::LMS_FMT_F32:
-            config.format = lime::StreamConfig::STREAM_COMPLEX_FLOAT32;
-            break;
-        case lms_stream_t::LMS_FMT_I16:
-            config.format = lime::StreamConfig::STREAM_12_BIT_IN_16;
-            break;
-        case lms_stream_t::LMS_FMT_I12:
-            config.format = lime::StreamConfig::STREAM_12_BIT_COMPRESSED;
-            break;
+    config.format = StreamDataFormat(stream);
+    config.isTx = stream->isTx;
+    config.signalStats = stream->signalStats;
+    config.gapFillLimit = stream->gapFillLimit;
+    switch(stream->overflowPolicy)
+    {
+        case lms_stream_t::LMS_OVERFLOW_DROP_NEWEST:
+            config.overflowPolicy = lime::StreamConfig::OVERFLOW_DROP_NEWEST; break;
+        case lms_stream_t::LMS_OVERFLOW_BLOCK:
+            config.overflowPolicy = lime::StreamConfig::OVERFLOW_BLOCK; break;
+        case lms_stream_t::LMS_OVERFLOW_DECIMATE:
+            config.overflowPolicy = lime::StreamConfig::OVERFLOW_DECIMATE; break;
         default:
-            config.format = lime::StreamConfig::STREAM_COMPLEX_FLOAT32;
+            config.overflowPolicy = lime::StreamConfig::OVERFLOW_DROP_OLDEST; break;
     }
-    config.isTx = stream->isTx;
+    config.overflowTimeout_ms = stream->overflowTimeout_ms;
     return lms->GetConnection(stream->channel)->SetupStream(stream->handle, config);
 }
 
@@ -1185,13 +1206,17 @@ API_EXPORT int CALL_CONV LMS_RecvStream(lms_stream_t *stream, void *samples, siz
     if (meta)
     {
         metadata.flags |= meta->waitForTimestamp * lime::IStreamChannel::Metadata::SYNC_TIMESTAMP;
+        metadata.flags |= meta->flushPartialPacket * lime::IStreamChannel::Metadata::END_BURST;
         metadata.timestamp = meta->timestamp;
     }
     else metadata.timestamp = 0;
 
     int status = channel->Read(samples, sample_count, &metadata, timeout_ms);
     if (meta)
+    {
         meta->timestamp = metadata.timestamp;
+        meta->discontinuity = (metadata.flags & lime::IStreamChannel::Metadata::DISCONTINUITY) != 0;
+    }
     return status;
 }
 
@@ -1205,6 +1230,7 @@ API_EXPORT int CALL_CONV LMS_SendStream(lms_stream_t *stream, const void *sample
     if (meta)
     {
         metadata.flags |= meta->waitForTimestamp * lime::IStreamChannel::Metadata::SYNC_TIMESTAMP;
+        metadata.flags |= meta->flushPartialPacket * lime::IStreamChannel::Metadata::END_BURST;
         metadata.timestamp = meta->timestamp;
     }
     else metadata.timestamp = 0;
@@ -1212,6 +1238,60 @@ API_EXPORT int CALL_CONV LMS_SendStream(lms_stream_t *stream, const void *sample
     return channel->Write(samples, sample_count, &metadata, timeout_ms);
 }
 
+API_EXPORT int CALL_CONV LMS_SendStreamCyclic(lms_stream_t *stream, const void *samples, size_t sample_count)
+{
+    if (stream==nullptr || stream->handle==0)
+        return -1;
+    lime::IStreamChannel* channel = (lime::IStreamChannel*)stream->handle;
+    return channel->SetCyclicBuffer(samples, sample_count);
+}
+
+API_EXPORT int CALL_CONV LMS_TimestampToHostTime(lms_device_t *device, uint64_t timestamp, int64_t *host_ns)
+{
+    if (device == nullptr)
+    {
+        lime::ReportError(EINVAL, "Device cannot be NULL.");
+        return -1;
+    }
+
+    LMS7_Device* lms = (LMS7_Device*)device;
+    auto conn = lms->GetConnection();
+    if (conn == nullptr)
+    {
+        lime::ReportError(EINVAL, "Device not connected");
+        return -1;
+    }
+    int64_t hostTime = 0;
+    if (conn->TimestampToHostTime(timestamp, hostTime) != 0)
+        return -1;
+    if (host_ns)
+        *host_ns = hostTime;
+    return LMS_SUCCESS;
+}
+
+API_EXPORT int CALL_CONV LMS_HostTimeToTimestamp(lms_device_t *device, int64_t host_ns, uint64_t *timestamp)
+{
+    if (device == nullptr)
+    {
+        lime::ReportError(EINVAL, "Device cannot be NULL.");
+        return -1;
+    }
+
+    LMS7_Device* lms = (LMS7_Device*)device;
+    auto conn = lms->GetConnection();
+    if (conn == nullptr)
+    {
+        lime::ReportError(EINVAL, "Device not connected");
+        return -1;
+    }
+    uint64_t ts = 0;
+    if (conn->HostTimeToTimestamp(host_ns, ts) != 0)
+        return -1;
+    if (timestamp)
+        *timestamp = ts;
+    return LMS_SUCCESS;
+}
+
 API_EXPORT int CALL_CONV LMS_UploadWFM(lms_device_t *device,
                                          const void **samples, uint8_t chCount,
                                          size_t sample_count, int format)
@@ -1259,18 +1339,290 @@ API_EXPORT int CALL_CONV LMS_GetStreamStatus(lms_stream_t *stream, lms_stream_st
         return -1;
     lime::IStreamChannel::Info info = channel->GetInfo();
 
-    status->active = false;
-    status->droppedPackets = 0;
+    status->active = info.active;
+    status->droppedPackets = info.droppedPackets;
     status->fifoFilledCount = info.fifoItemsCount;
     status->fifoSize = info.fifoSize;
     status->linkRate = info.linkRate;
-    status->overrun = 0;
-    status->underrun = 0;
+    status->overrun = info.overrun;
+    status->underrun = info.underrun;
     status->sampleRate = 0;
     status->timestamp = 0;
     return 0;
 }
 
+API_EXPORT int CALL_CONV LMS_GetStreamMetrics(lms_stream_t *stream, lms_stream_metrics_t* metrics)
+{
+    assert(stream != nullptr);
+    lime::IStreamChannel* channel = (lime::IStreamChannel*)stream->handle;
+    if(channel == nullptr)
+        return -1;
+    lime::StreamMetrics m;
+    if (channel->GetMetrics(m) != 0)
+        return -1;
+
+    metrics->fifoSize = m.fifoSize;
+    metrics->fifoHighWatermark = m.fifoHighWatermark;
+    metrics->packetsTransferred = m.packetsTransferred;
+    metrics->bytesTransferred = m.bytesTransferred;
+    for (int i = 0; i < LMS_METRICS_HISTOGRAM_BINS; ++i)
+        metrics->transferIntervals[i] = m.transferIntervals[i];
+    metrics->packetTimeAvg_ns = m.packetTimeAvg_ns;
+    metrics->packetTimeMax_ns = m.packetTimeMax_ns;
+    metrics->txLeadTimeMin = m.txLeadTimeMin;
+    metrics->txLeadTimeAvg = m.txLeadTimeAvg;
+    metrics->txLeadTimeCount = m.txLeadTimeCount;
+    metrics->overflowSamples = m.overflowSamples;
+    metrics->overflowOldestSamples = m.overflowOldestSamples;
+    metrics->overflowNewestSamples = m.overflowNewestSamples;
+    metrics->overflowDecimatedSamples = m.overflowDecimatedSamples;
+    metrics->overflowBlocks = m.overflowBlocks;
+    metrics->overflowBlockTime_us = m.overflowBlockTime_us;
+    metrics->linkLossSamples = m.linkLossSamples;
+    metrics->lateSamples = m.lateSamples;
+    metrics->underflowSamples = m.underflowSamples;
+    return 0;
+}
+
+API_EXPORT int CALL_CONV LMS_GetSignalStats(lms_stream_t *stream, lms_signal_stats_t* stats)
+{
+    assert(stream != nullptr);
+    lime::IStreamChannel* channel = (lime::IStreamChannel*)stream->handle;
+    if(channel == nullptr)
+        return -1;
+    lime::SignalStats s;
+    if (channel->GetSignalStats(s) != 0)
+        return -1;
+
+    const float_type fullScale = 2048.0;
+    const float_type count = s.samplesCount ? s.samplesCount : 1;
+    stats->samplesCount = s.samplesCount;
+    stats->clipCount = s.clipCount;
+    stats->peak = s.peak / fullScale;
+    stats->meanPower = s.sumPower / count / (fullScale*fullScale);
+    stats->dcI = s.sumI / count / fullScale;
+    stats->dcQ = s.sumQ / count / fullScale;
+    return 0;
+}
+
+API_EXPORT int CALL_CONV LMS_ArmCapture(lms_stream_t *stream, const lms_capture_t *capture)
+{
+    assert(stream != nullptr);
+    lime::IStreamChannel* channel = (lime::IStreamChannel*)stream->handle;
+    if (channel == nullptr || capture == nullptr)
+        return -1;
+    lime::CaptureConfig config;
+    switch (capture->trigger)
+    {
+    case lms_capture_t::LMS_TRIGGER_LEVEL: config.trigger = lime::CaptureConfig::TRIGGER_LEVEL; break;
+    case lms_capture_t::LMS_TRIGGER_TIMESTAMP: config.trigger = lime::CaptureConfig::TRIGGER_TIMESTAMP; break;
+    default: config.trigger = lime::CaptureConfig::TRIGGER_SOFTWARE; break;
+    }
+    config.preTriggerSamples = capture->preTriggerSamples;
+    config.postTriggerSamples = capture->postTriggerSamples;
+    config.level = std::min(std::max(capture->level, 0.0), 1.0) * 2047 + 0.5;
+    config.timestamp = capture->timestamp;
+    return channel->ArmCapture(config);
+}
+
+API_EXPORT int CALL_CONV LMS_TriggerCapture(lms_stream_t *stream)
+{
+    assert(stream != nullptr);
+    lime::IStreamChannel* channel = (lime::IStreamChannel*)stream->handle;
+    if (channel == nullptr)
+        return -1;
+    return channel->TriggerCapture();
+}
+
+API_EXPORT int CALL_CONV LMS_RecvCapture(lms_stream_t *stream, void *samples, size_t sample_count, lms_stream_meta_t *meta, uint64_t *triggerTimestamp, unsigned timeout_ms)
+{
+    if (stream==nullptr || stream->handle==0)
+        return -1;
+    lime::IStreamChannel* channel = (lime::IStreamChannel*)stream->handle;
+    lime::IStreamChannel::Metadata metadata;
+    metadata.flags = 0;
+    metadata.timestamp = 0;
+    uint64_t trigger = 0;
+    int status = channel->ReadCapture(samples, sample_count, &metadata, &trigger, timeout_ms);
+    if (meta)
+    {
+        meta->timestamp = metadata.timestamp;
+        meta->discontinuity = (metadata.flags & lime::IStreamChannel::Metadata::DISCONTINUITY) != 0;
+    }
+    if (triggerTimestamp)
+        *triggerTimestamp = trigger;
+    return status;
+}
+
+API_EXPORT int CALL_CONV LMS_DisarmCapture(lms_stream_t *stream)
+{
+    assert(stream != nullptr);
+    lime::IStreamChannel* channel = (lime::IStreamChannel*)stream->handle;
+    if (channel == nullptr)
+        return -1;
+    return channel->DisarmCapture();
+}
+
+API_EXPORT int CALL_CONV LMS_StartSpectrumMonitor(lms_stream_t *stream, const lms_spectrum_t *config)
+{
+    assert(stream != nullptr);
+    lime::IStreamChannel* channel = (lime::IStreamChannel*)stream->handle;
+    if (channel == nullptr || config == nullptr)
+        return -1;
+    lime::SpectrumConfig spectrum;
+    spectrum.fftSize = config->fftSize;
+    spectrum.window = lime::SpectrumConfig::Window(config->window);
+    spectrum.overlap = config->overlap;
+    spectrum.averageCount = config->averageCount;
+    spectrum.averaging = lime::SpectrumConfig::Averaging(config->averaging);
+    spectrum.expWeight = config->expWeight;
+    spectrum.frameRate = config->frameRate;
+    return channel->StartSpectrumMonitor(spectrum);
+}
+
+API_EXPORT int CALL_CONV LMS_ReadSpectrum(lms_stream_t *stream, float_type *bins, size_t bin_count, uint64_t *timestamp, unsigned timeout_ms)
+{
+    if (stream==nullptr || stream->handle==0)
+        return -1;
+    lime::IStreamChannel* channel = (lime::IStreamChannel*)stream->handle;
+    std::vector<float> frame(bin_count);
+    uint64_t ts = 0;
+    int status = channel->ReadSpectrum(frame.data(), bin_count, &ts, timeout_ms);
+    for (int i = 0; i < status; ++i)
+        bins[i] = frame[i];
+    if (timestamp)
+        *timestamp = ts;
+    return status;
+}
+
+API_EXPORT int CALL_CONV LMS_StopSpectrumMonitor(lms_stream_t *stream)
+{
+    assert(stream != nullptr);
+    lime::IStreamChannel* channel = (lime::IStreamChannel*)stream->handle;
+    if (channel == nullptr)
+        return -1;
+    return channel->StopSpectrumMonitor();
+}
+
+/** @brief Sweep state behind lms_sweep_handle_t
+*/
+struct SweepHandle
+{
+    SweepHandle(lime::IConnection* port, lime::IStreamChannel* stream) : engine(port, stream) {}
+    lime::SweepEngine engine;
+    std::vector<float_type> frequencies;
+    std::vector<lime::LMS7002M::SX_details> plan;
+    bool computeSpectrum;
+    std::vector<float> bins;
+};
+
+API_EXPORT int CALL_CONV LMS_StartSweep(lms_device_t *device, lms_stream_t *stream, const lms_sweep_t *config, lms_sweep_handle_t **sweep)
+{
+    if (device == nullptr || stream == nullptr || stream->handle == 0 || config == nullptr || sweep == nullptr)
+    {
+        lime::ReportError(EINVAL, "Invalid sweep arguments");
+        return -1;
+    }
+    if (stream->isTx)
+    {
+        lime::ReportError(EINVAL, "Sweep needs RX stream");
+        return -1;
+    }
+    if (!(config->stepFrequency > 0) || config->stopFrequency < config->startFrequency)
+    {
+        lime::ReportError(EINVAL, "Invalid sweep frequency range");
+        return -1;
+    }
+    LMS7_Device* lms = (LMS7_Device*)device;
+    const size_t chan = stream->channel;
+    lime::IStreamChannel* channel = (lime::IStreamChannel*)stream->handle;
+    SweepHandle* handle = new SweepHandle(lms->GetConnection(chan), channel);
+    const size_t stepCount = std::floor((config->stopFrequency - config->startFrequency) / config->stepFrequency + 1e-9) + 1;
+    for (size_t i = 0; i < stepCount; ++i)
+        handle->frequencies.push_back(config->startFrequency + i * config->stepFrequency);
+    if (lms->PrepareRxSweep(chan, handle->frequencies, handle->plan) != 0)
+    {
+        delete handle;
+        return -1;
+    }
+
+    lime::SweepConfig sweepConfig;
+    sweepConfig.stepCount = handle->frequencies.size();
+    sweepConfig.settlingSamples = std::ceil(config->settlingTime * lms->GetRate(false, chan));
+    sweepConfig.samplesPerStep = config->samplesPerStep;
+    sweepConfig.format = StreamDataFormat(stream);
+    sweepConfig.computeSpectrum = config->computeSpectrum;
+    sweepConfig.spectrum.fftSize = config->spectrum.fftSize;
+    sweepConfig.spectrum.window = lime::SpectrumConfig::Window(config->spectrum.window);
+    sweepConfig.spectrum.overlap = config->spectrum.overlap;
+    sweepConfig.spectrum.averageCount = config->spectrum.averageCount;
+    sweepConfig.spectrum.averaging = lime::SpectrumConfig::Averaging(config->spectrum.averaging);
+    sweepConfig.spectrum.expWeight = config->spectrum.expWeight;
+    handle->computeSpectrum = config->computeSpectrum;
+    if (config->computeSpectrum)
+        handle->bins.resize(config->spectrum.fftSize);
+
+    lime::LMS7002M* chip = lms->GetLMS(chan / 2);
+    const auto& plan = handle->plan;
+    auto retune = [chip, &plan](const size_t step)
+    {
+        return chip->ApplyFrequencySX(false, plan[step]);
+    };
+    if (handle->engine.Start(sweepConfig, retune) != 0)
+    {
+        delete handle;
+        return -1;
+    }
+    *sweep = handle;
+    return 0;
+}
+
+API_EXPORT int CALL_CONV LMS_RecvSweepStep(lms_sweep_handle_t *sweep, void *data, size_t count, lms_sweep_meta_t *meta, unsigned timeout_ms)
+{
+    if (sweep == nullptr || data == nullptr)
+    {
+        lime::ReportError(EINVAL, "Invalid sweep arguments");
+        return -1;
+    }
+    SweepHandle* handle = (SweepHandle*)sweep;
+    lime::SweepBlock block;
+    int status;
+    if (handle->computeSpectrum)
+    {
+        status = handle->engine.Next(handle->bins.data(), std::min(count, handle->bins.size()), block, timeout_ms);
+        float_type* bins = (float_type*)data;
+        for (int i = 0; i < status; ++i)
+            bins[i] = handle->bins[i];
+    }
+    else
+        status = handle->engine.Next(data, count, block, timeout_ms);
+    if (status > 0 && meta)
+    {
+        meta->step = block.step;
+        meta->frequency = handle->frequencies[block.step];
+        meta->timestamp = block.timestamp;
+        meta->discontinuity = block.discontinuity;
+    }
+    return status;
+}
+
+API_EXPORT int CALL_CONV LMS_GetSweepRate(lms_sweep_handle_t *sweep, float_type *stepsPerSecond)
+{
+    if (sweep == nullptr || stepsPerSecond == nullptr)
+    {
+        lime::ReportError(EINVAL, "Invalid sweep arguments");
+        return -1;
+    }
+    *stepsPerSecond = ((SweepHandle*)sweep)->engine.GetStepsPerSecond();
+    return 0;
+}
+
+API_EXPORT int CALL_CONV LMS_StopSweep(lms_sweep_handle_t *sweep)
+{
+    delete (SweepHandle*)sweep;
+    return 0;
+}
+
 API_EXPORT const lms_dev_info_t* CALL_CONV LMS_GetDeviceInfo(lms_device_t *device)
 {
     if (device == nullptr)
@@ -1608,6 +1608,32 @@ int LMS7_Device::SetTxFrequency(size_t chan, double f_Hz)
     return 0;
 }
 
+/** @brief Tunes SXR to each frequency of sweep plan once, so that steps
+    can be applied later without VCO tuning by LMS7002M::ApplyFrequencySX()
+    @param chan Rx channel
+    @param frequencies plan frequencies, not lower than 30 MHz
+    @param plan [out] SX settings for each frequency
+    @return 0-success, other-failure
+*/
+int LMS7_Device::PrepareRxSweep(size_t chan, const std::vector<float_type>& frequencies, std::vector<lime::LMS7002M::SX_details>& plan)
+{
+    lime::LMS7002M* lms = lms_list[chan / 2];
+    if (rx_channels[chan].cF_offset_nco != 0)
+        SetNCO(false,chan,-1,true);
+    rx_channels[chan].cF_offset_nco = 0;
+    plan.assign(frequencies.size(), lime::LMS7002M::SX_details());
+    for (size_t i = 0; i < frequencies.size(); ++i)
+    {
+        //frequencies below SX range need NCO offset, which is not stepped
+        if (frequencies[i] < GetFrequencyRange(false).min)
+            return lime::ReportError(ERANGE, "Sweep frequency %g MHz is below SX range", frequencies[i]/1e6);
+        plan[i].success = false;
+        if (lms->SetFrequencySX(false, frequencies[i], &plan[i]) != 0)
+            return -1;
+    }
+    return 0;
+}
+
 lms_range_t LMS7_Device::GetFrequencyRange(bool tx) const
 {
   lms_range_t ret;
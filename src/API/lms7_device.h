@@ -49,6 +49,7 @@ public:
     size_t GetPath(bool tx, size_t chan);
     int SetRxFrequency(size_t chan, float_type f_Hz);
     int SetTxFrequency(size_t chan, float_type f_Hz);
+    int PrepareRxSweep(size_t chan, const std::vector<float_type>& frequencies, std::vector<lime::LMS7002M::SX_details>& plan);
     float_type GetTRXFrequency(bool tx, size_t chan);
     lms_range_t GetFrequencyRange(bool tx) const;
     lms_range_t GetRxPathBand(size_t path, size_t chan) const;
@@ -19,14 +19,39 @@
 #include <stdlib.h>
 #include <iostream>
 #include <stdio.h>
+#include <poll.h>
+#include <chrono>
+#include <algorithm>
 #endif // LINUX
 
 static const int COM_RETRY_INTERVAL = 20; //ms
 static const int COM_TOTAL_TIMEOUT = 300; //ms
+static const int COM_INTERBYTE_TIMEOUT = 50; //ms, gap in reply that ends reading
 static const int COM_BUFFER_LENGTH = 1024; //max buffer size for data
+static const int COM_PACKETS_IN_FLIGHT = 8; //LMS64C packets written before reading replies
 
 using namespace lime;
 
+#ifdef __unix__
+/** @brief Sleeps until port is ready or deadline passes
+    @return false if operation timed out or port failed
+*/
+static bool WaitPort(const int fd, const short events, const std::chrono::steady_clock::time_point deadline)
+{
+    const long remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+    if (remaining <= 0)
+        return false;
+    pollfd fds;
+    fds.fd = fd;
+    fds.events = events;
+    fds.revents = 0;
+    const int ret = poll(&fds, 1, remaining);
+    if (ret < 0)
+        return errno == EINTR;
+    return ret > 0 && (fds.revents & events);
+}
+#endif
+
 ConnectionEVB7COM::ConnectionEVB7COM(const char *comName, int baudrate)
 {
 #ifndef __unix__
@@ -177,7 +202,7 @@ int ConnectionEVB7COM::Open(const char *comName, int baudrate)
 		return NOERROR;
 	}
 #else
-    hComm = open(comName, O_RDWR | O_NOCTTY | O_SYNC);
+    hComm = open(comName, O_RDWR | O_NOCTTY | O_NONBLOCK);
     if(hComm < 0)
     {
 //        printf("%s",strerror(errno));
@@ -201,8 +226,8 @@ int ConnectionEVB7COM::Open(const char *comName, int baudrate)
     tty.c_iflag &= ~ICRNL;
     tty.c_lflag = 0;
     tty.c_oflag = 0;
-    tty.c_cc[VMIN] = 0; // read non blocking
-    tty.c_cc[VTIME] = 5; // 0.5 seconds read timeout
+    tty.c_cc[VMIN] = 0; // read non blocking, timeouts are handled with poll()
+    tty.c_cc[VTIME] = 0;
 
     tty.c_iflag &= ~(IXON | IXOFF | IXANY);
     tty.c_cflag |= (CLOCAL | CREAD);
@@ -212,10 +237,17 @@ int ConnectionEVB7COM::Open(const char *comName, int baudrate)
 //        MessageLog::getInstance()->write("Connection manager: error from tcsetattr\n", LOG_ERROR);
         return ReportError(errno, "error from tcgetattr");
     }
+    tcflush(hComm, TCIOFLUSH);
 #endif
     return 0;
 }
 
+//! @return number of LMS64C packets kept in flight, USB CDC provides flow control
+int ConnectionEVB7COM::ControlPacketsInFlight(void) const
+{
+    return COM_PACKETS_IN_FLIGHT;
+}
+
 /** @brief Sends data through COM port
     @param buffer data buffer to send
     @param length size of data buffer
@@ -228,14 +260,14 @@ int ConnectionEVB7COM::Write(const unsigned char *buffer, int length, int timeou
     {
         timeout_ms = COM_TOTAL_TIMEOUT;
     }
-    int retryCount = 0;
-    const int maxRetries = (timeout_ms/COM_RETRY_INTERVAL) > 1 ? (timeout_ms/COM_RETRY_INTERVAL) : 1;
     bool status = false;
 #ifndef __unix__
-	unsigned long bytesWriten = 0;
-	m_osWOverlap.InternalHigh = 0;
+    int retryCount = 0;
+    const int maxRetries = (timeout_ms/COM_RETRY_INTERVAL) > 1 ? (timeout_ms/COM_RETRY_INTERVAL) : 1;
+    unsigned long bytesWriten = 0;
+    m_osWOverlap.InternalHigh = 0;
 
-	for(int i = 0; i<maxRetries && status == false; ++i)
+    for(int i = 0; i<maxRetries && status == false; ++i)
     {
         if (!WriteFile(hComm, buffer, length , &bytesWriten, NULL))
         {
@@ -246,29 +278,29 @@ int ConnectionEVB7COM::Write(const unsigned char *buffer, int length, int timeou
         ++retryCount;
     }
 #else
+    //non-blocking writes, wait in poll() while output buffer is full
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
     long bytesWriten = 0;
-    for(int i = 0; i<maxRetries && bytesWriten == 0; ++i)
+    while (bytesWriten < length)
     {
-        bytesWriten = write(hComm, buffer, length);
-        if(bytesWriten <= 0)
+        const ssize_t ret = write(hComm, buffer + bytesWriten, length - bytesWriten);
+        if (ret > 0)
         {
-//            if(bytesWriten < 0)
-//                MessageLog::getInstance()->write("COM PORT: error writing data\n", LOG_ERROR);
-//            if(bytesWriten == 0)
-//                MessageLog::getInstance()->write("COM PORT: data bytes sent 0\n", LOG_WARNING);
-            status = false;
+            bytesWriten += ret;
+            continue;
         }
-        else
-            status = true;
-        ++retryCount;
+        if (ret < 0 && errno != EAGAIN && errno != EINTR)
+            break;
+        if (!WaitPort(hComm, POLLOUT, deadline))
+            break;
     }
 #endif
     if(bytesWriten == length)
         status = true;
-    if(status == false);
+    if(status == false)
         ReportError(EIO, "Failed to write data");
 
-	return bytesWriten;
+    return bytesWriten;
 }
 
 /** @brief Reads data from COM port
@@ -283,23 +315,19 @@ int ConnectionEVB7COM::Read(unsigned char *buffer, int length, int timeout_ms)
     {
         timeout_ms = COM_TOTAL_TIMEOUT;
     }
+    memset(buffer, 0, length);
+#ifndef __unix__
     int retryCount = 0;
     const int maxRetries = (timeout_ms/COM_RETRY_INTERVAL) > 1 ? (timeout_ms/COM_RETRY_INTERVAL) : 1;
     bool status = false;
+    long bytesReaded = 0;
+    unsigned long totalBytesReaded = 0;
+    char cRawData[COM_BUFFER_LENGTH];
+    unsigned long bytesToRead = length;
 
-    memset(buffer, 0, length);
-	long bytesReaded = 0;
-	unsigned long totalBytesReaded = 0;
-	char cRawData[COM_BUFFER_LENGTH];
-	unsigned long bytesToRead = length;
-
-	memset(cRawData, '\0', sizeof(cRawData[0])*COM_BUFFER_LENGTH);
-
-	for(int i=0; i<maxRetries && status == false; ++i)
+    for(int i=0; i<maxRetries && status == false; ++i)
     {
         memset(cRawData, '\0', sizeof(cRawData[0])*COM_BUFFER_LENGTH);
-#ifndef __unix__
-
         DWORD bytesReceived = 0;
         if ( !ReadFile(hComm, cRawData, bytesToRead, &bytesReceived, NULL) )
         {
@@ -307,17 +335,6 @@ int ConnectionEVB7COM::Read(unsigned char *buffer, int length, int timeout_ms)
         }
 
         bytesReaded = bytesReceived;
-#else
-        bytesReaded = read(hComm, cRawData, bytesToRead);
-        if(bytesReaded <= 0)
-        {
-//            if(bytesReaded < 0)
-//                MessageLog::getInstance()->write("COM PORT: error reading data\n", LOG_ERROR);
-//            if(bytesReaded == 0)
-//                MessageLog::getInstance()->write("COM PORT: reading 0 bytes\n", LOG_WARNING);
-            status = false;
-        }
-#endif
         retryCount++;
 
         for(int j=0; j<bytesReaded; ++j)
@@ -329,17 +346,27 @@ int ConnectionEVB7COM::Read(unsigned char *buffer, int length, int timeout_ms)
         if(totalBytesReaded == bytesToRead)
             status = true;
     }
-
-//    ss << " read(" << totalBytesReaded << "): ";
-//    for(unsigned int i=0; i<64; ++i)
-//        ss << int2hex(buffer[i], 1) << " ";
-//    ss <<  " - retries: " << retryCount-1 << endl;
-    //MessageLog::getInstance()->write(ss.str(), LOG_DATA);
-
-//	if(retryCount == maxRetries)
-//        MessageLog::getInstance()->write("COM PORT: read data timeout\n", LOG_WARNING);
-//
-//    if(totalBytesReaded > length)
-//        MessageLog::getInstance()->write("COM PORT: read data corrupted, received length > requested length\n", LOG_ERROR);
-	return totalBytesReaded;
+#else
+    //wait for reply up to timeout, once it starts arriving
+    //a gap longer than inter-byte timeout ends the reply
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    long totalBytesReaded = 0;
+    while (totalBytesReaded < length)
+    {
+        const ssize_t ret = read(hComm, buffer + totalBytesReaded, length - totalBytesReaded);
+        if (ret > 0)
+        {
+            totalBytesReaded += ret;
+            continue;
+        }
+        if (ret < 0 && errno != EAGAIN && errno != EINTR)
+            break;
+        auto waitUntil = deadline;
+        if (totalBytesReaded > 0)
+            waitUntil = std::min(deadline, std::chrono::steady_clock::now() + std::chrono::milliseconds(COM_INTERBYTE_TIMEOUT));
+        if (!WaitPort(hComm, POLLIN, waitUntil))
+            break;
+    }
+#endif
+    return totalBytesReaded;
 }
@@ -39,6 +39,7 @@ private:
 
     int Write(const unsigned char *buffer, int length, int timeout_ms = 100);
     int Read(unsigned char *buffer, int length, int timeout_ms = 100);
+    int ControlPacketsInFlight(void) const override;
 
     #ifndef __unix__
         HANDLE hComm;
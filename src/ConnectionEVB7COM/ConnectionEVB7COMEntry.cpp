@@ -7,6 +7,10 @@
 #include "ConnectionEVB7COM.h"
 #include <fstream>
 #include <iostream>
+#include <algorithm>
+#ifdef __unix__
+#include <unistd.h>
+#endif
 
 using namespace std;
 using namespace lime;
@@ -29,6 +33,12 @@ std::vector<ConnectionHandle> ConnectionEVB7COMEntry::enumerate(const Connection
 {
     std::vector<ConnectionHandle> result;
     auto comPortList = this->FindAllComPorts();
+#ifdef __unix__
+    //search covers only ACM devices, other ports can be given by address
+    if (hint.addr.length() != 0 && access(hint.addr.c_str(), R_OK | W_OK) == 0
+        && std::find(comPortList.begin(), comPortList.end(), hint.addr) == comPortList.end())
+        comPortList.push_back(hint.addr);
+#endif
     auto availableComms = this->FilterDeviceList(comPortList);
     for (const auto &comName : availableComms)
     {
@@ -589,10 +589,19 @@ int ConnectionNovenaRF7::ReadStreamStatus(const size_t streamID, const long time
 {
     assert(streamID != 0);
     lime::IStreamChannel* channel = (lime::IStreamChannel*)streamID;
-    StreamChannel::Info info = channel->GetInfo();
-    metadata.hasTimestamp = false;
-    metadata.timestamp = info.timestamp;
-    metadata.lateTimestamp = info.underrun > 0;
-    metadata.packetDropped = info.droppedPackets > 0;
-    return 0;
+    //no event reporting, poll counters until timeout
+    const auto exitTime = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (true)
+    {
+        StreamChannel::Info info = channel->GetInfo();
+        metadata.hasTimestamp = false;
+        metadata.timestamp = info.timestamp;
+        metadata.lateTimestamp = info.underrun > 0;
+        metadata.packetDropped = info.droppedPackets > 0;
+        if (metadata.lateTimestamp || metadata.packetDropped)
+            return 0;
+        if (std::chrono::steady_clock::now() >= exitTime)
+            return -1;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
 }
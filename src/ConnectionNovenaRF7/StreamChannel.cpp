@@ -24,6 +24,7 @@ int ConnectionNovenaRF7::StreamChannel::Read(void* samples, const uint32_t count
         int16_t* samplesShort = (int16_t*)samples;
         float* samplesFloat = (float*)samples;
         popped = fifo->pop_samples(ptr, count, 1, &meta->timestamp, timeout_ms, &meta->flags);
+        meta->flags = RingFIFO::ToMetadataFlags(meta->flags);
         for(int i=2*popped-1; i>=0; --i)
             samplesFloat[i] = (float)samplesShort[i]/2048.0;
     }
@@ -32,6 +33,7 @@ int ConnectionNovenaRF7::StreamChannel::Read(void* samples, const uint32_t count
     {
         complex16_t* ptr = (complex16_t*)samples;
         popped = fifo->pop_samples(ptr, count, 1, &meta->timestamp, timeout_ms, &meta->flags);
+        meta->flags = RingFIFO::ToMetadataFlags(meta->flags);
     }
     return popped;
 }
@@ -46,14 +48,14 @@ int ConnectionNovenaRF7::StreamChannel::Write(const void* samples, const uint32_
         for(size_t i=0; i<2*count; ++i)
             samplesShort[i] = samplesFloat[i]*2047;
         const complex16_t* ptr = (const complex16_t*)samplesShort ;
-        pushed = fifo->push_samples(ptr, count, 1, meta->timestamp, timeout_ms, meta->flags);
+        pushed = fifo->push_samples(ptr, count, 1, meta->timestamp, timeout_ms, RingFIFO::FromMetadataFlags(meta->flags));
         delete[] samplesShort;
     }
     //else if(config.format == StreamConfig::STREAM_12_BIT_IN_16)
     else
     {
         const complex16_t* ptr = (const complex16_t*)samples;
-        pushed = fifo->push_samples(ptr, count, 1, meta->timestamp, timeout_ms, meta->flags);
+        pushed = fifo->push_samples(ptr, count, 1, meta->timestamp, timeout_ms, RingFIFO::FromMetadataFlags(meta->flags));
     }
     return pushed;
 }
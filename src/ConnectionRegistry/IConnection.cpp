@@ -25,17 +25,69 @@ StreamMetadata::StreamMetadata(void):
     hasTimestamp(false),
     endOfBurst(false),
     lateTimestamp(false),
-    packetDropped(false)
+    packetDropped(false),
+    underflow(false),
+    discontinuity(false)
 {
     return;
 }
 
+SignalStats::SignalStats(void):
+    samplesCount(0),
+    clipCount(0),
+    peak(0),
+    sumI(0),
+    sumQ(0),
+    sumPower(0)
+{
+    return;
+}
+
+void SignalStats::Add(const SignalStats &other)
+{
+    samplesCount += other.samplesCount;
+    clipCount += other.clipCount;
+    if (other.peak > peak)
+        peak = other.peak;
+    sumI += other.sumI;
+    sumQ += other.sumQ;
+    sumPower += other.sumPower;
+}
+
 StreamConfig::StreamConfig(void):
     isTx(false),
     performanceLatency(0.5),
     bufferLength(0),
     format(STREAM_12_BIT_IN_16),
-    linkFormat(STREAM_12_BIT_IN_16)
+    linkFormat(STREAM_12_BIT_IN_16),
+    underflowTimeout_ms(100),
+    signalStats(false),
+    gapFillLimit(0),
+    gapFillValue(0),
+    overflowPolicy(OVERFLOW_DROP_OLDEST),
+    overflowTimeout_ms(10)
+{
+    return;
+}
+
+CaptureConfig::CaptureConfig(void):
+    trigger(TRIGGER_SOFTWARE),
+    preTriggerSamples(0),
+    postTriggerSamples(0),
+    level(0),
+    timestamp(0)
+{
+    return;
+}
+
+SpectrumConfig::SpectrumConfig(void):
+    fftSize(1024),
+    window(WINDOW_BLACKMAN_HARRIS),
+    overlap(0),
+    averageCount(16),
+    averaging(AVERAGE_LINEAR),
+    expWeight(0.1),
+    frameRate(10)
 {
     return;
 }
@@ -174,6 +226,16 @@ double IConnection::GetHardwareTimestampRate(void)
     return 1.0;
 }
 
+int IConnection::TimestampToHostTime(const uint64_t timestamp, int64_t &hostTime_ns)
+{
+    return ReportError(EPERM, "TimestampToHostTime not implemented");
+}
+
+int IConnection::HostTimeToTimestamp(const int64_t hostTime_ns, uint64_t &timestamp)
+{
+    return ReportError(EPERM, "HostTimeToTimestamp not implemented");
+}
+
 /***********************************************************************
  * Stream API
  **********************************************************************/
@@ -201,6 +263,11 @@ int IConnection::ControlStream(const size_t streamID, const bool enable)
     return ReportError(EPERM, "ControlStream not implemented");
 }
 
+int IConnection::ScheduleRxStream(const size_t streamID, const size_t burstSize, const StreamMetadata &metadata)
+{
+    return ReportError(EPERM, "ScheduleRxStream not implemented");
+}
+
 int IConnection::ReadStream(const size_t streamID, void* buffs, const size_t length, const long timeout_ms, StreamMetadata &metadata)
 {
     return ReportError(EPERM, "ReadStream not implemented");
@@ -216,6 +283,142 @@ int IConnection::ReadStreamStatus(const size_t streamID, const long timeout_ms,
     return ReportError(EPERM, "ReadStreamStatus not implemented");
 }
 
+int IConnection::ReadStreamEvent(const size_t streamID, const long timeout_ms, StreamEvent &event)
+{
+    return ReportError(EPERM, "ReadStreamEvent not implemented");
+}
+
+int IConnection::GetStreamEventFd(const size_t streamID)
+{
+    ReportError(EPERM, "GetStreamEventFd not implemented");
+    return -1;
+}
+
+int IConnection::GetStreamMetrics(const size_t streamID, StreamMetrics &metrics)
+{
+    return ReportError(EPERM, "GetStreamMetrics not implemented");
+}
+
+int IConnection::GetSignalStats(const size_t streamID, SignalStats &stats)
+{
+    return ReportError(EPERM, "GetSignalStats not implemented");
+}
+
+int IConnection::ArmCapture(const size_t streamID, const CaptureConfig &config)
+{
+    return ReportError(EPERM, "ArmCapture not implemented");
+}
+
+int IConnection::TriggerCapture(const size_t streamID)
+{
+    return ReportError(EPERM, "TriggerCapture not implemented");
+}
+
+int IConnection::ReadCapture(const size_t streamID, void *buffs, const size_t length, const long timeout_ms, StreamMetadata &metadata, uint64_t &triggerTimestamp)
+{
+    return ReportError(EPERM, "ReadCapture not implemented");
+}
+
+int IConnection::DisarmCapture(const size_t streamID)
+{
+    return ReportError(EPERM, "DisarmCapture not implemented");
+}
+
+int IConnection::StartSpectrumMonitor(const size_t streamID, const SpectrumConfig &config)
+{
+    return ReportError(EPERM, "StartSpectrumMonitor not implemented");
+}
+
+int IConnection::ReadSpectrum(const size_t streamID, float *bins, const size_t length, const long timeout_ms, StreamMetadata &metadata)
+{
+    return ReportError(EPERM, "ReadSpectrum not implemented");
+}
+
+int IConnection::StopSpectrumMonitor(const size_t streamID)
+{
+    return ReportError(EPERM, "StopSpectrumMonitor not implemented");
+}
+
+size_t IConnection::GetNumDirectAccessBuffers(const size_t streamID)
+{
+    return 0;
+}
+
+int IConnection::GetDirectAccessBufferAddr(const size_t streamID, const size_t handle, void **buffer)
+{
+    return ReportError(EPERM, "GetDirectAccessBufferAddr not implemented");
+}
+
+int IConnection::AcquireReadBuffer(const size_t streamID, size_t &handle, const void **buffer, const long timeout_ms, StreamMetadata &metadata)
+{
+    return ReportError(EPERM, "AcquireReadBuffer not implemented");
+}
+
+int IConnection::ReleaseReadBuffer(const size_t streamID, const size_t handle)
+{
+    return ReportError(EPERM, "ReleaseReadBuffer not implemented");
+}
+
+int IConnection::AcquireWriteBuffer(const size_t streamID, size_t &handle, void **buffer, const long timeout_ms)
+{
+    return ReportError(EPERM, "AcquireWriteBuffer not implemented");
+}
+
+int IConnection::ReleaseWriteBuffer(const size_t streamID, const size_t handle, const size_t length, const StreamMetadata &metadata)
+{
+    return ReportError(EPERM, "ReleaseWriteBuffer not implemented");
+}
+
+int IStreamChannel::SetCyclicBuffer(const void* samples, const uint32_t count)
+{
+    return ReportError(EPERM, "SetCyclicBuffer not implemented");
+}
+
+int IStreamChannel::GetMetrics(StreamMetrics& metrics)
+{
+    return ReportError(EPERM, "GetMetrics not implemented");
+}
+
+int IStreamChannel::GetSignalStats(SignalStats& stats)
+{
+    return ReportError(EPERM, "GetSignalStats not implemented");
+}
+
+int IStreamChannel::ArmCapture(const CaptureConfig& config)
+{
+    return ReportError(EPERM, "ArmCapture not implemented");
+}
+
+int IStreamChannel::TriggerCapture()
+{
+    return ReportError(EPERM, "TriggerCapture not implemented");
+}
+
+int IStreamChannel::ReadCapture(void* samples, const uint32_t count, Metadata* metadata, uint64_t* triggerTimestamp, const int32_t timeout_ms)
+{
+    return ReportError(EPERM, "ReadCapture not implemented");
+}
+
+int IStreamChannel::DisarmCapture()
+{
+    return ReportError(EPERM, "DisarmCapture not implemented");
+}
+
+int IStreamChannel::StartSpectrumMonitor(const SpectrumConfig& config)
+{
+    return ReportError(EPERM, "StartSpectrumMonitor not implemented");
+}
+
+int IStreamChannel::ReadSpectrum(float* bins, const uint32_t count, uint64_t* timestamp, const int32_t timeout_ms)
+{
+    return ReportError(EPERM, "ReadSpectrum not implemented");
+}
+
+int IStreamChannel::StopSpectrumMonitor()
+{
+    return ReportError(EPERM, "StopSpectrumMonitor not implemented");
+}
+
 int IConnection::UploadWFM(const void * const* samples, uint8_t chCount, size_t sample_count, StreamConfig::StreamDataFormat format, int epIndex)
 {
     return ReportError(EPERM, "UploadTxWFM not implemented");
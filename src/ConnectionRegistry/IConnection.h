@@ -75,6 +75,35 @@ struct LIME_API DeviceInfo
     int addrADF4002;
 };
 
+/*!
+ * Signal statistics of received samples, accumulated while
+ * packets are parsed when StreamConfig::signalStats is enabled.
+ * Averages are sums divided by samplesCount.
+ */
+struct LIME_API SignalStats
+{
+    SignalStats(void);
+
+    //! Accumulate statistics of other samples
+    void Add(const SignalStats &other);
+
+    //! Number of samples the statistics are computed from
+    uint32_t samplesCount;
+
+    //! Number of samples with I or Q at 12 bit full scale
+    uint32_t clipCount;
+
+    //! Maximum absolute value of I or Q
+    uint32_t peak;
+
+    //! Sums of I and Q values, for DC offset
+    int64_t sumI;
+    int64_t sumQ;
+
+    //! Sum of I*I+Q*Q, for mean power
+    uint64_t sumPower;
+};
+
 /*!
  * The Stream metadata structure is used with the streaming API to exchange
  * extra data associated with the stream such as timestamps and burst info.
@@ -110,6 +139,198 @@ struct LIME_API StreamMetadata
      * perhaps in a receiver overflow event.
      */
     bool packetDropped;
+
+    /*!
+     * True to indicate that transmitter ran out of samples
+     * and zeros were sent instead.
+     * Used in stream status reporting.
+     */
+    bool underflow;
+
+    /*!
+     * RX only: true when the returned samples do not continue
+     * the previously returned ones, because samples were lost
+     * or the first returned samples were inserted in place of them.
+     * With StreamConfig::gapFillLimit set or a timed read, reads stop
+     * before discontinuities, so this applies to the first returned
+     * sample. Otherwise reads are not shortened and the flag applies
+     * to any of the returned samples.
+     */
+    bool discontinuity;
+
+    /*!
+     * RX only: signal statistics of the returned samples,
+     * empty unless StreamConfig::signalStats is enabled.
+     */
+    SignalStats signalStats;
+};
+
+/*!
+ * The Stream event structure describes anomalies detected
+ * by the streaming threads, delivered in order of occurrence.
+ */
+struct StreamEvent
+{
+    enum Type
+    {
+        EVENT_OVERFLOW, //!< RX samples were lost because FIFO was full
+        EVENT_UNDERFLOW, //!< TX ran out of samples, zeros were sent instead
+        EVENT_LATE_TIMESTAMP, //!< TX samples were too late for transmission
+        EVENT_PACKET_DROPPED, //!< packets were lost on the link
+        EVENT_END_OF_BURST, //!< last samples of TX burst were sent
+    };
+    Type type;
+
+    /*!
+     * The timestamp of the first affected sample,
+     * for end of burst the timestamp following the last sample
+     */
+    uint64_t timestamp;
+
+    //! Number of affected samples, 0 when not known
+    uint32_t samplesCount;
+};
+
+/*!
+ * The Stream metrics structure holds performance figures
+ * of the stream accumulated since the stream was started.
+ */
+struct StreamMetrics
+{
+    static const int HISTOGRAM_BINS = 16;
+
+    //! FIFO size in samples
+    uint32_t fifoSize;
+
+    //! Maximum number of samples held in FIFO
+    uint32_t fifoHighWatermark;
+
+    //! Data packets and their bytes transferred over the link
+    uint64_t packetsTransferred;
+    uint64_t bytesTransferred;
+
+    /*!
+     * Intervals between completed link transfers,
+     * bin N counts intervals of [2^N, 2^(N+1)) microseconds,
+     * first and last bins also count shorter and longer intervals.
+     */
+    uint32_t transferIntervals[HISTOGRAM_BINS];
+
+    //! Time to parse (RX) or encode (TX) one data packet
+    uint32_t packetTimeAvg_ns;
+    uint32_t packetTimeMax_ns;
+
+    /*!
+     * Difference between TX packet timestamp and
+     * estimated hardware time when the packet was sent.
+     * Valid when txLeadTimeCount is not 0.
+     */
+    int64_t txLeadTimeMin;
+    int64_t txLeadTimeAvg;
+    uint32_t txLeadTimeCount;
+
+    //! Samples lost because RX FIFO was full
+    uint64_t overflowSamples;
+
+    /*!
+     * Overflow losses by cause, see StreamConfig::OverflowPolicy.
+     * Oldest samples are overwritten by OVERFLOW_DROP_OLDEST, newest
+     * samples are dropped by other policies when FIFO stays full.
+     */
+    uint64_t overflowOldestSamples;
+    uint64_t overflowNewestSamples;
+
+    //! RX samples of packets skipped by OVERFLOW_DECIMATE
+    uint64_t overflowDecimatedSamples;
+
+    //! Number and total time of receive loop waits for free FIFO space, OVERFLOW_BLOCK
+    uint32_t overflowBlocks;
+    uint64_t overflowBlockTime_us;
+
+    //! Samples of packets lost on the link
+    uint64_t linkLossSamples;
+
+    //! TX samples dropped for being late
+    uint64_t lateSamples;
+
+    //! Zero samples transmitted because TX ran out of samples
+    uint64_t underflowSamples;
+};
+
+/*!
+ * The capture config structure is used with the ArmCapture() API.
+ * Armed RX stream keeps a rolling window of the latest samples
+ * in place of delivering them, until the trigger condition is met
+ * and samples following the trigger are collected.
+ */
+struct LIME_API CaptureConfig
+{
+    CaptureConfig(void);
+
+    //! Possible trigger conditions
+    enum Trigger
+    {
+        TRIGGER_SOFTWARE, ///< only TriggerCapture() calls
+        TRIGGER_LEVEL, ///< absolute value of I or Q reaches level
+        TRIGGER_TIMESTAMP, ///< sample with given timestamp is received
+    };
+    Trigger trigger;
+
+    //! Number of samples kept before the trigger sample
+    uint32_t preTriggerSamples;
+
+    //! Number of samples collected from the trigger sample
+    uint32_t postTriggerSamples;
+
+    //! Threshold for TRIGGER_LEVEL, 12 bit sample scale
+    uint16_t level;
+
+    //! Timestamp of the trigger sample for TRIGGER_TIMESTAMP
+    uint64_t timestamp;
+};
+
+/*!
+ * The spectrum config structure is used with the StartSpectrumMonitor() API.
+ * Each spectrum frame is computed from averageCount consecutive FFTs,
+ * samples are taken from the stream only while a frame is collected.
+ */
+struct LIME_API SpectrumConfig
+{
+    SpectrumConfig(void);
+
+    //! Number of FFT bins
+    uint32_t fftSize;
+
+    //! Window functions, same as in FFT viewer
+    enum Window
+    {
+        WINDOW_RECTANGULAR,
+        WINDOW_BLACKMAN_HARRIS,
+        WINDOW_HAMMING,
+        WINDOW_HANNING,
+    };
+    Window window;
+
+    //! Fraction of FFT samples shared by consecutive FFTs, [0, 1)
+    float overlap;
+
+    //! Number of FFTs per spectrum frame
+    uint32_t averageCount;
+
+    //! Averaging of FFT power
+    enum Averaging
+    {
+        AVERAGE_LINEAR, ///< mean of FFTs in each frame
+        AVERAGE_EXPONENTIAL, ///< running average across frames
+        AVERAGE_MAX_HOLD, ///< maximum since monitor was started
+    };
+    Averaging averaging;
+
+    //! Weight of each new FFT for AVERAGE_EXPONENTIAL, (0, 1]
+    float expWeight;
+
+    //! Maximum number of spectrum frames per second, 0 for unlimited
+    float frameRate;
 };
 
 /*!
@@ -138,6 +359,8 @@ struct LIME_API StreamConfig
         STREAM_12_BIT_IN_16,
         STREAM_12_BIT_COMPRESSED,
         STREAM_COMPLEX_FLOAT32,
+        STREAM_12_BIT_PACKED, ///< 3 bytes per complex sample, as in FPGA packets
+        STREAM_8_BIT, ///< 8 most significant bits of 12 bit samples
     };
 
     /*!
@@ -158,6 +381,53 @@ struct LIME_API StreamConfig
      * Default: STREAM_12_BIT_IN_16
      */
     StreamDataFormat linkFormat;
+
+    /*!
+     * Transmit only: time in milliseconds to wait for samples
+     * before zero filled packets are sent to keep the link running.
+     * Default: 100
+     */
+    unsigned underflowTimeout_ms;
+
+    /*!
+     * Receive only: compute signal statistics of samples
+     * while parsing packets, see StreamMetadata::signalStats.
+     * Default: false
+     */
+    bool signalStats;
+
+    /*!
+     * Receive only: maximum number of samples inserted in place
+     * of each gap caused by packets lost on the link, so that
+     * samples stay continuous. Inserted samples are flagged with
+     * StreamMetadata::discontinuity. When set, reads also stop before
+     * each discontinuity, so the returned samples are always continuous.
+     * Default: 0, samples are not inserted and reads are not shortened
+     */
+    uint32_t gapFillLimit;
+
+    //! Receive only: I and Q value of inserted samples. Default: 0
+    int16_t gapFillValue;
+
+    //! Possible handling of received samples when FIFO is full
+    enum OverflowPolicy
+    {
+        OVERFLOW_DROP_OLDEST, ///< overwrite the oldest samples, lowest latency
+        OVERFLOW_DROP_NEWEST, ///< drop received samples, FIFO content is kept
+        OVERFLOW_BLOCK, ///< receive loop waits for free space up to overflowTimeout_ms, then drops received samples
+        OVERFLOW_DECIMATE, ///< skip every other packet while FIFO is over 3/4 full, until it is half empty
+    };
+
+    /*!
+     * Receive only: handling of samples when FIFO is full.
+     * Blocking stalls the receive loop, so other channels of the
+     * same device stop too and the link may overflow in hardware.
+     * Default: OVERFLOW_DROP_OLDEST
+     */
+    OverflowPolicy overflowPolicy;
+
+    //! Receive only: maximum wait of OVERFLOW_BLOCK policy. Default: 10
+    unsigned overflowTimeout_ms;
 };
 
 /*!
@@ -342,6 +612,24 @@ public:
      */
     virtual double GetHardwareTimestampRate(void);
 
+    /*!
+     * Convert hardware timestamp to host time.
+     * Host time is std::chrono::steady_clock time in nanoseconds.
+     * @param timestamp the timestamp in clock units
+     * @param [out] hostTime_ns the host time when the sample was received
+     * @return 0 for success, or error code if clock relation is not known
+     */
+    virtual int TimestampToHostTime(const uint64_t timestamp, int64_t &hostTime_ns);
+
+    /*!
+     * Convert host time to hardware timestamp.
+     * Host time is std::chrono::steady_clock time in nanoseconds.
+     * @param hostTime_ns the host time
+     * @param [out] timestamp the timestamp in clock units
+     * @return 0 for success, or error code if clock relation is not known
+     */
+    virtual int HostTimeToTimestamp(const int64_t hostTime_ns, uint64_t &timestamp);
+
     /***********************************************************************
      * Stream API
      **********************************************************************/
@@ -394,6 +682,20 @@ public:
      */
     virtual int ControlStream(const size_t streamID, const bool enable);
 
+    /*!
+     * Queue a timed receive command on the RX stream.
+     * Samples before the requested timestamp are dropped,
+     * and the stream pauses after burstSize samples
+     * until the next command is taken.
+     * Commands queued before ControlStream() apply from stream start.
+     *
+     * @param streamID the RX stream index number
+     * @param burstSize number of samples to receive, 0 for continuous streaming
+     * @param metadata timestamp to start receiving at, used when hasTimestamp is set
+     * @return 0 for success or error code
+     */
+    virtual int ScheduleRxStream(const size_t streamID, const size_t burstSize, const StreamMetadata &metadata);
+
     /*!
      * Read blocking data from the stream into the specified buffer.
      *
@@ -432,6 +734,189 @@ public:
      */
     virtual int ReadStreamStatus(const size_t streamID, const long timeout_ms, StreamMetadata &metadata);
 
+    /*!
+     * Wait for the next event of the stream such as
+     * overflow, underflow, late transmit, end of burst.
+     *
+     * @param streamID the stream index number
+     * @param timeout_ms the timeout in milliseconds, 0 to return immediately
+     * @param [out] event the stream event
+     * @return 0 on success, -1 for timeout no data
+     */
+    virtual int ReadStreamEvent(const size_t streamID, const long timeout_ms, StreamEvent &event);
+
+    /*!
+     * Get file descriptor for waiting on stream events with poll() or select().
+     * The descriptor becomes readable when new events are available,
+     * after that all events should be taken with ReadStreamEvent().
+     *
+     * @param streamID the stream index number
+     * @return file descriptor, -1 if not supported
+     */
+    virtual int GetStreamEventFd(const size_t streamID);
+
+    /*!
+     * Get performance metrics of the stream.
+     *
+     * @param streamID the stream index number
+     * @param [out] metrics stream metrics since stream start
+     * @return 0 for success or error code
+     */
+    virtual int GetStreamMetrics(const size_t streamID, StreamMetrics &metrics);
+
+    /*!
+     * Get signal statistics of samples returned by the last ReadStream()
+     * or AcquireReadBuffer(), same as in their metadata.
+     * Should be called from the thread that reads the stream.
+     *
+     * @param streamID the stream index number
+     * @param [out] stats signal statistics
+     * @return 0 for success or error code
+     */
+    virtual int GetSignalStats(const size_t streamID, SignalStats &stats);
+
+    /*!
+     * Start triggered capture on RX stream. While capture is armed,
+     * samples are kept in the pre-trigger window instead of being
+     * delivered to ReadStream(). Arming again restarts the capture.
+     *
+     * @param streamID the RX stream index number
+     * @param config trigger condition and capture size
+     * @return 0 for success or error code
+     */
+    virtual int ArmCapture(const size_t streamID, const CaptureConfig &config);
+
+    /*!
+     * Trigger armed capture at the next received sample,
+     * regardless of the configured trigger condition.
+     *
+     * @param streamID the RX stream index number
+     * @return 0 for success or error code
+     */
+    virtual int TriggerCapture(const size_t streamID);
+
+    /*!
+     * Wait for triggered capture to complete and read its samples
+     * as one contiguous block. Block starts up to preTriggerSamples
+     * before the trigger, less if the capture was triggered earlier
+     * or samples were lost before the trigger. Stream stays in capture
+     * mode until armed again or disarmed.
+     *
+     * @param streamID the RX stream index number
+     * @param buffs destination buffer for samples
+     * @param length maximum number of samples to read
+     * @param timeout_ms the timeout in milliseconds
+     * @param [out] metadata timestamp of the first sample, discontinuity
+     * is set if samples were lost after the trigger
+     * @param [out] triggerTimestamp timestamp of the trigger sample
+     * @return the number of samples read, 0 on timeout, or error code
+     */
+    virtual int ReadCapture(const size_t streamID, void *buffs, const size_t length, const long timeout_ms, StreamMetadata &metadata, uint64_t &triggerTimestamp);
+
+    /*!
+     * Stop capture and return to delivering samples to ReadStream().
+     *
+     * @param streamID the RX stream index number
+     * @return 0 for success or error code
+     */
+    virtual int DisarmCapture(const size_t streamID);
+
+    /*!
+     * Start computing averaged power spectra of RX stream samples
+     * on a library worker thread. Samples are still delivered to
+     * ReadStream(). Starting again applies new configuration.
+     *
+     * @param streamID the RX stream index number
+     * @param config FFT size, window, overlap, averaging and frame rate
+     * @return 0 for success or error code
+     */
+    virtual int StartSpectrumMonitor(const size_t streamID, const SpectrumConfig &config);
+
+    /*!
+     * Wait for the next spectrum frame. Bin k is at frequency
+     * (k - fftSize/2) * sampleRate / fftSize, values are in dBFS,
+     * full scale complex tone is at 0 dBFS.
+     *
+     * @param streamID the RX stream index number
+     * @param bins destination for power of frequency bins
+     * @param length maximum number of bins to read
+     * @param timeout_ms the timeout in milliseconds
+     * @param [out] metadata timestamp of the first sample of the frame
+     * @return the number of bins read, 0 on timeout, or error code
+     */
+    virtual int ReadSpectrum(const size_t streamID, float *bins, const size_t length, const long timeout_ms, StreamMetadata &metadata);
+
+    /*!
+     * Stop spectrum monitor of RX stream.
+     *
+     * @param streamID the RX stream index number
+     * @return 0 for success or error code
+     */
+    virtual int StopSpectrumMonitor(const size_t streamID);
+
+    /*!
+     * Get the number of buffers available for direct access.
+     * Direct access is available only for formats with 16 bit samples.
+     * @param streamID the stream index number
+     * @return number of buffers, 0 if direct access is not supported
+     */
+    virtual size_t GetNumDirectAccessBuffers(const size_t streamID);
+
+    /*!
+     * Get address of a buffer available for direct access.
+     * Addresses do not change while the stream exists, acquired buffers
+     * start at these addresses unless samples were partially read
+     * with ReadStream().
+     * @param streamID the stream index number
+     * @param handle the buffer identifier, less than GetNumDirectAccessBuffers()
+     * @param [out] buffer pointer to samples of the buffer
+     * @return 0 for success or error code
+     */
+    virtual int GetDirectAccessBufferAddr(const size_t streamID, const size_t handle, void **buffer);
+
+    /*!
+     * Acquire the oldest received buffer for direct reading.
+     * Buffers have to be released in order of acquisition.
+     *
+     * @param streamID the RX stream index number
+     * @param [out] handle the buffer identifier for ReleaseReadBuffer()
+     * @param [out] buffer pointer to samples of the buffer
+     * @param timeout_ms the timeout in milliseconds
+     * @param [out] metadata stream metadata of the buffer
+     * @return the number of samples in buffer, 0 on timeout, or error code
+     */
+    virtual int AcquireReadBuffer(const size_t streamID, size_t &handle, const void **buffer, const long timeout_ms, StreamMetadata &metadata);
+
+    /*!
+     * Release buffer acquired with AcquireReadBuffer().
+     * @param streamID the RX stream index number
+     * @param handle the buffer identifier
+     * @return 0 for success or error code
+     */
+    virtual int ReleaseReadBuffer(const size_t streamID, const size_t handle);
+
+    /*!
+     * Acquire free buffer for direct writing.
+     * Buffers have to be released in order of acquisition.
+     *
+     * @param streamID the TX stream index number
+     * @param [out] handle the buffer identifier for ReleaseWriteBuffer()
+     * @param [out] buffer pointer to samples of the buffer
+     * @param timeout_ms the timeout in milliseconds
+     * @return the number of samples that fit in buffer, 0 on timeout, or error code
+     */
+    virtual int AcquireWriteBuffer(const size_t streamID, size_t &handle, void **buffer, const long timeout_ms);
+
+    /*!
+     * Submit buffer acquired with AcquireWriteBuffer() for transmission.
+     * @param streamID the TX stream index number
+     * @param handle the buffer identifier
+     * @param length the number of samples written to buffer
+     * @param metadata stream metadata of the buffer
+     * @return 0 for success or error code
+     */
+    virtual int ReleaseWriteBuffer(const size_t streamID, const size_t handle, const size_t length, const StreamMetadata &metadata);
+
     /**	@brief Uploads waveform to on board memory for later use
     @param samples multiple channel samples data
     @param chCount number of waveform channels
@@ -652,6 +1137,8 @@ public:
         enum
         {
             SYNC_TIMESTAMP = 1,
+            END_BURST = 2,
+            DISCONTINUITY = 4, //!< RX: samples do not continue previously read ones
         };
         uint64_t timestamp;
         uint32_t flags;
@@ -675,7 +1162,64 @@ public:
     */
     virtual int Write(const void* samples, const uint32_t count, const Metadata* metadata, const int32_t timeout_ms = 100) = 0;
 
+    /** @brief Sets waveform to be transmitted repeatedly instead of FIFO samples
+        @param samples source array of data type used in SetupStream()
+        @param count number of samples in waveform, 0 to return to FIFO samples
+        @return 0 on success
+    */
+    virtual int SetCyclicBuffer(const void* samples, const uint32_t count);
+
     virtual Info GetInfo() = 0;
+
+    /** @brief Returns performance figures accumulated since stream start
+        @param metrics [out] stream metrics
+        @return 0 on success
+    */
+    virtual int GetMetrics(StreamMetrics& metrics);
+
+    /** @brief Returns signal statistics of samples returned by the last Read()
+        @param stats [out] signal statistics
+        @return 0 on success
+    */
+    virtual int GetSignalStats(SignalStats& stats);
+
+    /** @brief Starts triggered capture, see IConnection::ArmCapture()
+        @return 0 on success
+    */
+    virtual int ArmCapture(const CaptureConfig& config);
+
+    //! @brief Triggers armed capture at the next received sample
+    virtual int TriggerCapture();
+
+    /** @brief Waits for triggered capture and reads its samples
+        @param samples destination array of data type used in SetupStream()
+        @param count maximum number of samples to read
+        @param metadata [out] timestamp of the first sample and discontinuity flag
+        @param triggerTimestamp [out] timestamp of the trigger sample
+        @param timeout_ms time to wait for capture to complete
+        @return number of samples read, 0 on timeout
+    */
+    virtual int ReadCapture(void* samples, const uint32_t count, Metadata* metadata, uint64_t* triggerTimestamp, const int32_t timeout_ms = 100);
+
+    //! @brief Stops capture and returns to delivering samples to Read()
+    virtual int DisarmCapture();
+
+    /** @brief Starts spectrum monitor, see IConnection::StartSpectrumMonitor()
+        @return 0 on success
+    */
+    virtual int StartSpectrumMonitor(const SpectrumConfig& config);
+
+    /** @brief Waits for the next spectrum frame
+        @param bins destination for power of frequency bins in dBFS
+        @param count maximum number of bins to read
+        @param timestamp [out] timestamp of the first sample of the frame
+        @param timeout_ms time to wait for frame
+        @return number of bins read, 0 on timeout
+    */
+    virtual int ReadSpectrum(float* bins, const uint32_t count, uint64_t* timestamp, const int32_t timeout_ms = 100);
+
+    //! @brief Stops spectrum monitor
+    virtual int StopSpectrumMonitor();
 };
 
 }
@@ -6,6 +6,9 @@
 
 #include "ConnectionSTREAM.h"
 #include "ErrorReporting.h"
+#ifdef __unix__
+#include "USBEventLoop.h"
+#endif
 #include <cstring>
 #include "Si5351C.h"
 #include "FPGA_common.h"
@@ -52,12 +55,20 @@ const std::set<uint8_t> ConnectionSTREAM::commandsToBulkCtrlHw2 =
 
 /**	@brief Initializes port type and object necessary to communicate to usb device.
 */
-ConnectionSTREAM::ConnectionSTREAM(void *arg, const std::string &vidpid, const std::string &serial, const unsigned index)
+ConnectionSTREAM::ConnectionSTREAM(void *arg, const std::string &vidpid, const std::string &serial, const unsigned index) :
+    readPool(USB_MAX_CONTEXTS),
+    sendPool(USB_MAX_CONTEXTS),
+    transferSequence(0)
 {
+    for (int i = 0; i < USB_MAX_CONTEXTS; ++i)
+    {
+        contexts[i].pool = &readPool;
+        contexts[i].index = i;
+        contextsToSend[i].pool = &sendPool;
+        contextsToSend[i].index = i;
+    }
     bulkCtrlAvailable = false;
     bulkCtrlInProgress = false;
-    RxLoopFunction = bind(&ConnectionSTREAM::ReceivePacketsLoop, this, std::placeholders::_1);
-    TxLoopFunction = bind(&ConnectionSTREAM::TransmitPacketsLoop, this, std::placeholders::_1);
     isConnected = false;
 #ifndef __unix__
     if(arg == nullptr)
@@ -303,6 +314,7 @@ int ConnectionSTREAM::Open(const std::string &vidpid, const std::string &serial,
 
     if(dev_handle == nullptr)
         return ReportError(-1, "ConnectionSTREAM: libusb_open failed");
+    USBEventLoop::AddDevice();
     if(libusb_kernel_driver_active(dev_handle, 0) == 1)   //find out if kernel driver is attached
     {
         lime::info("Kernel Driver Active");
@@ -370,6 +382,7 @@ void ConnectionSTREAM::Close()
         libusb_release_interface(dev_handle, 0);
         libusb_close(dev_handle);
         dev_handle = 0;
+        USBEventLoop::RemoveDevice();
     }
     #endif
     isConnected = false;
@@ -468,56 +481,50 @@ int ConnectionSTREAM::Read(unsigned char *buffer, const int length, int timeout_
     return len;
 }
 
-#ifdef __unix__
+#ifndef __unix__
+/** @brief Finds the earliest submitted transfer that is not finished
+    @return context index, -1 if there are no such transfers
+*/
+static int OldestPending(const USBTransferContext* contexts, TransferPool &pool)
+{
+    int oldest = -1;
+    for (int i = 0; i < USB_MAX_CONTEXTS; ++i)
+        if (pool.IsPending(i) && (oldest < 0 || contexts[i].sequence < contexts[oldest].sequence))
+            oldest = i;
+    return oldest;
+}
+#else
 /**	@brief Function for handling libusb callbacks
 */
 void callback_libusbtransfer(libusb_transfer *trans)
 {
 	USBTransferContext *context = reinterpret_cast<USBTransferContext*>(trans->user_data);
-	std::unique_lock<std::mutex> lck(context->transferLock);
 	switch(trans->status)
 	{
     case LIBUSB_TRANSFER_CANCELLED:
         //lime::error("Transfer %i canceled", context->id);
-        context->bytesXfered = trans->actual_length;
-        context->done.store(true);
-        //context->used = false;
-        //context->reset();
         break;
     case LIBUSB_TRANSFER_COMPLETED:
-        //if(trans->actual_length == context->bytesExpected)
-		{
-			context->bytesXfered = trans->actual_length;
-			context->done.store(true);
-		}
         break;
     case LIBUSB_TRANSFER_ERROR:
         lime::error("TRANSFER ERRROR");
-        context->bytesXfered = trans->actual_length;
-        context->done.store(true);
-        //context->used = false;
         break;
     case LIBUSB_TRANSFER_TIMED_OUT:
         //lime::error("transfer timed out %i", context->id);
-        context->bytesXfered = trans->actual_length;
-        context->done.store(true);
-        //context->used = false;
-
         break;
     case LIBUSB_TRANSFER_OVERFLOW:
         lime::error("transfer overflow");
-
         break;
     case LIBUSB_TRANSFER_STALL:
         lime::error("transfer stalled");
         break;
     case LIBUSB_TRANSFER_NO_DEVICE:
         lime::error("transfer no device");
-
         break;
 	}
-	lck.unlock();
-	context->cv.notify_one();
+    context->bytesXfered = trans->actual_length;
+    //queue context for the thread waiting for any completion
+    context->pool->Complete(context->index);
 }
 #endif
 
@@ -526,27 +533,18 @@ void callback_libusbtransfer(libusb_transfer *trans)
 	@param *buffer buffer where to store received data
 	@param length number of bytes to read
 	@param streamBulkInAddr endpoint index?
+	@param notifyAny completion is reported by WaitForAnyReading()
 	@return handle of transfer context
 */
-int ConnectionSTREAM::BeginDataReading(char *buffer, uint32_t length, const uint8_t streamBulkInAddr)
+int ConnectionSTREAM::BeginDataReading(char *buffer, uint32_t length, const uint8_t streamBulkInAddr, const bool notifyAny)
 {
-    int i = 0;
-	bool contextFound = false;
-	//find not used context
-    for(i = 0; i<USB_MAX_CONTEXTS; i++)
-    {
-        if(!contexts[i].used)
-        {
-            contextFound = true;
-            break;
-        }
-    }
-    if(!contextFound)
+    const int i = readPool.Acquire(notifyAny);
+    if(i < 0)
     {
         lime::error("No contexts left for reading data");
         return -1;
     }
-    contexts[i].used = true;
+    contexts[i].sequence = transferSequence++;
     #ifndef __unix__
     if (InEndPt[streamBulkInAddr & 0xF])
     {
@@ -558,14 +556,13 @@ int ConnectionSTREAM::BeginDataReading(char *buffer, uint32_t length, const uint
     unsigned int Timeout = 500;
     libusb_transfer *tr = contexts[i].transfer;
 	libusb_fill_bulk_transfer(tr, dev_handle, streamBulkInAddr, (unsigned char*)buffer, length, callback_libusbtransfer, &contexts[i], Timeout);
-	contexts[i].done = false;
 	contexts[i].bytesXfered = 0;
 	contexts[i].bytesExpected = length;
 	int status = libusb_submit_transfer(tr);
     if(status != 0)
     {
         lime::error("BEGIN DATA READING %s", libusb_error_name(status));
-        contexts[i].used = false;
+        readPool.Release(i);
         return -1;
     }
     #endif
@@ -580,30 +577,47 @@ int ConnectionSTREAM::BeginDataReading(char *buffer, uint32_t length, const uint
 */
 int ConnectionSTREAM::WaitForReading(int contextHandle, unsigned int timeout_ms)
 {
-    if(contextHandle >= 0 && contexts[contextHandle].used == true)
+    if(contextHandle >= 0 && readPool.IsUsed(contextHandle))
     {
     #ifndef __unix__
     int status = 0;
     status = contexts[contextHandle].EndPt->WaitForXfer(contexts[contextHandle].inOvLap, timeout_ms);
+    if (status)
+        readPool.Complete(contextHandle);
 	return status;
     #else
-    auto t1 = chrono::high_resolution_clock::now();
-    auto t2 = chrono::high_resolution_clock::now();
-
-    std::unique_lock<std::mutex> lck(contexts[contextHandle].transferLock);
-    while(contexts[contextHandle].done.load() == false && std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() < timeout_ms)
-    {
-        //blocking not to waste CPU
-        contexts[contextHandle].cv.wait_for(lck, chrono::milliseconds(timeout_ms));
-        t2 = chrono::high_resolution_clock::now();
-    }
-	return contexts[contextHandle].done.load() == true;
+    //blocking not to waste CPU
+	return readPool.Wait(contextHandle, timeout_ms);
     #endif
     }
     else
         return 0;
 }
 
+/**
+	@brief Waits for any reading started with notifyAny to finish,
+	transfers are returned in order of completion
+	@param timeout_ms number of miliseconds to wait
+	@return handle of finished transfer context, -1 on timeout
+*/
+int ConnectionSTREAM::WaitForAnyReading(unsigned int timeout_ms)
+{
+#ifndef __unix__
+    //no completion callbacks, wait for the oldest transfer
+    const int oldest = OldestPending(contexts, readPool);
+    if (oldest < 0)
+        return -1;
+    if (WaitForReading(oldest, timeout_ms) == false)
+    {
+        if (timeout_ms == 0)
+            return -1;
+        //timed out, FinishDataXfer() handles unfinished transfer
+        readPool.Complete(oldest);
+    }
+#endif
+    return readPool.WaitAny(timeout_ms);
+}
+
 /**
 	@brief Finishes asynchronous data reading from board
 	@param buffer array where to store received data
@@ -613,19 +627,18 @@ int ConnectionSTREAM::WaitForReading(int contextHandle, unsigned int timeout_ms)
 */
 int ConnectionSTREAM::FinishDataReading(char *buffer, uint32_t length, int contextHandle)
 {
-    if(contextHandle >= 0 && contexts[contextHandle].used == true)
+    if(contextHandle >= 0 && readPool.IsUsed(contextHandle))
     {
     #ifndef __unix__
     int status = 0;
     long len = length;
     status = contexts[contextHandle].EndPt->FinishDataXfer((unsigned char*)buffer, len, contexts[contextHandle].inOvLap, contexts[contextHandle].context);
-    contexts[contextHandle].used = false;
     contexts[contextHandle].reset();
+    readPool.Release(contextHandle);
     return len;
     #else
 	length = contexts[contextHandle].bytesXfered;
-	contexts[contextHandle].used = false;
-	contexts[contextHandle].reset();
+	readPool.Release(contextHandle);
 	return length;
     #endif
     }
@@ -645,7 +658,7 @@ void ConnectionSTREAM::AbortReading(int ep)
 #else
     for(int i=0; i<USB_MAX_CONTEXTS; ++i)
     {
-        if(contexts[i].used && contexts[i].transfer->endpoint == ep)
+        if(readPool.IsUsed(i) && contexts[i].transfer->endpoint == ep)
             libusb_cancel_transfer( contexts[i].transfer );
     }
 #endif
@@ -656,24 +669,15 @@ void ConnectionSTREAM::AbortReading(int ep)
 	@param *buffer buffer to send
 	@param length number of bytes to send
 	@param streamBulkOutAddr endpoint index?
+	@param notifyAny completion is reported by WaitForAnySending()
 	@return handle of transfer context
 */
-int ConnectionSTREAM::BeginDataSending(const char *buffer, uint32_t length, const uint8_t streamBulkOutAddr)
+int ConnectionSTREAM::BeginDataSending(const char *buffer, uint32_t length, const uint8_t streamBulkOutAddr, const bool notifyAny)
 {
-    int i = 0;
-	//find not used context
-	bool contextFound = false;
-    for(i = 0; i<USB_MAX_CONTEXTS; i++)
-    {
-        if(!contextsToSend[i].used)
-        {
-            contextFound = true;
-            break;
-        }
-    }
-    if(!contextFound)
+    const int i = sendPool.Acquire(notifyAny);
+    if(i < 0)
         return -1;
-    contextsToSend[i].used = true;
+    contextsToSend[i].sequence = transferSequence++;
     #ifndef __unix__
     if (OutEndPt[streamBulkOutAddr])
     {
@@ -685,14 +689,13 @@ int ConnectionSTREAM::BeginDataSending(const char *buffer, uint32_t length, cons
     unsigned int Timeout = 500;
     libusb_transfer *tr = contextsToSend[i].transfer;
 	libusb_fill_bulk_transfer(tr, dev_handle, streamBulkOutAddr, (unsigned char*)buffer, length, callback_libusbtransfer, &contextsToSend[i], Timeout);
-	contextsToSend[i].done = false;
 	contextsToSend[i].bytesXfered = 0;
 	contextsToSend[i].bytesExpected = length;
     int status = libusb_submit_transfer(tr);
     if(status != 0)
     {
         lime::error("BEGIN DATA SENDING %s", libusb_error_name(status));
-        contextsToSend[i].used = false;
+        sendPool.Release(i);
         return -1;
     }
     #endif
@@ -707,30 +710,47 @@ int ConnectionSTREAM::BeginDataSending(const char *buffer, uint32_t length, cons
 */
 int ConnectionSTREAM::WaitForSending(int contextHandle, unsigned int timeout_ms)
 {
-    if( contextsToSend[contextHandle].used == true )
+    if(contextHandle >= 0 && sendPool.IsUsed(contextHandle))
     {
 #   ifndef __unix__
 	int status = 0;
 	status = contextsToSend[contextHandle].EndPt->WaitForXfer(contextsToSend[contextHandle].inOvLap, timeout_ms);
+    if (status)
+        sendPool.Complete(contextHandle);
 	return status;
 #   else
-    auto t1 = chrono::high_resolution_clock::now();
-    auto t2 = chrono::high_resolution_clock::now();
-
-    std::unique_lock<std::mutex> lck(contextsToSend[contextHandle].transferLock);
-    while(contextsToSend[contextHandle].done.load() == false && std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() < timeout_ms)
-    {
-        //blocking not to waste CPU
-        contextsToSend[contextHandle].cv.wait_for(lck, chrono::milliseconds(timeout_ms));
-        t2 = chrono::high_resolution_clock::now();
-    }
-	return contextsToSend[contextHandle].done == true;
+    //blocking not to waste CPU
+	return sendPool.Wait(contextHandle, timeout_ms);
 #   endif
     }
     else
         return 0;
 }
 
+/**
+	@brief Waits for any sending started with notifyAny to finish,
+	transfers are returned in order of completion
+	@param timeout_ms number of miliseconds to wait
+	@return handle of finished transfer context, -1 on timeout
+*/
+int ConnectionSTREAM::WaitForAnySending(unsigned int timeout_ms)
+{
+#ifndef __unix__
+    //no completion callbacks, wait for the oldest transfer
+    const int oldest = OldestPending(contextsToSend, sendPool);
+    if (oldest < 0)
+        return -1;
+    if (WaitForSending(oldest, timeout_ms) == false)
+    {
+        if (timeout_ms == 0)
+            return -1;
+        //timed out, FinishDataXfer() handles unfinished transfer
+        sendPool.Complete(oldest);
+    }
+#endif
+    return sendPool.WaitAny(timeout_ms);
+}
+
 /**
 	@brief Finishes asynchronous data sending to board
 	@param buffer array where to store received data
@@ -740,18 +760,17 @@ int ConnectionSTREAM::WaitForSending(int contextHandle, unsigned int timeout_ms)
 */
 int ConnectionSTREAM::FinishDataSending(const char *buffer, uint32_t length, int contextHandle)
 {
-    if( contextsToSend[contextHandle].used == true)
+    if(contextHandle >= 0 && sendPool.IsUsed(contextHandle))
     {
 #ifndef __unix__
     long len = length;
     contextsToSend[contextHandle].EndPt->FinishDataXfer((unsigned char*)buffer, len, contextsToSend[contextHandle].inOvLap, contextsToSend[contextHandle].context);
-    contextsToSend[contextHandle].used = false;
     contextsToSend[contextHandle].reset();
+    sendPool.Release(contextHandle);
     return len;
 #else
 	length = contextsToSend[contextHandle].bytesXfered;
-	contextsToSend[contextHandle].used = false;
-    contextsToSend[contextHandle].reset();
+    sendPool.Release(contextHandle);
 	return length;
 #endif
     }
@@ -771,7 +790,7 @@ void ConnectionSTREAM::AbortSending(int ep)
 #else
     for (int i = 0; i<USB_MAX_CONTEXTS; ++i)
     {
-        if(contextsToSend[i].used && contextsToSend[i].transfer->endpoint == ep)
+        if(sendPool.IsUsed(i) && contextsToSend[i].transfer->endpoint == ep)
             libusb_cancel_transfer(contextsToSend[i].transfer);
     }
 #endif
@@ -780,7 +799,7 @@ void ConnectionSTREAM::AbortSending(int ep)
 int ConnectionSTREAM::SendData(const char* buffer, int length, int epIndex, int timeout)
 {
     const unsigned char ep = 0x01;
-    int context = BeginDataSending((char*)buffer, length, ep);
+    int context = BeginDataSending((char*)buffer, length, ep, false);
     if (WaitForSending(context, timeout)==false)
         AbortSending(ep);
     return FinishDataSending((char*)buffer, length , context);
@@ -789,7 +808,7 @@ int ConnectionSTREAM::SendData(const char* buffer, int length, int epIndex, int
 int ConnectionSTREAM::ReceiveData(char* buffer, int length, int epIndex, int timeout)
 {
     const unsigned char ep = 0x81;
-    int context = BeginDataReading(buffer, length, ep);
+    int context = BeginDataReading(buffer, length, ep, false);
     if (WaitForReading(context, timeout) == false)
         AbortReading(ep);
     return FinishDataReading(buffer, length, context);
@@ -15,6 +15,7 @@
 #include <memory>
 #include <thread>
 #include "fifo.h"
+#include "TransferPool.h"
 #include <ciso646>
 
 #ifndef __unix__
@@ -37,7 +38,7 @@ namespace lime
 class USBTransferContext
 {
 public:
-    USBTransferContext() : used(false)
+    USBTransferContext() : pool(nullptr), index(0), sequence(0)
     {
         id = idCounter++;
 #ifndef __unix__
@@ -50,7 +51,6 @@ public:
         transfer = libusb_alloc_transfer(0);
         bytesXfered = 0;
         bytesExpected = 0;
-        done = 0;
 #endif
     }
     ~USBTransferContext()
@@ -64,8 +64,6 @@ public:
     }
     bool reset()
     {
-        if(used)
-            return false;
 #ifndef __unix__
         CloseHandle(inOvLap->hEvent);
         memset(inOvLap, 0, sizeof(OVERLAPPED));
@@ -73,9 +71,11 @@ public:
 #endif
         return true;
     }
-    bool used;
     int id;
     static int idCounter;
+    TransferPool* pool; //!< pool that owns this context
+    int index; //!< position in pool
+    uint64_t sequence; //!< submission order
 #ifndef __unix__
     PUCHAR context;
     CCyUSBEndPoint* EndPt;
@@ -84,9 +84,6 @@ public:
     libusb_transfer* transfer;
     long bytesXfered;
     long bytesExpected;
-    std::atomic<bool> done;
-    std::mutex transferLock;
-    std::condition_variable cv;
 #endif
 };
 
@@ -112,28 +109,34 @@ public:
     int ProgramUpdate(const bool download, ProgrammingCallback callback);
     int ReadRawStreamData(char* buffer, unsigned length, int epIndex, int timeout_ms = 100)override;
 protected:
-    virtual void ReceivePacketsLoop(Streamer* args) override;
-    virtual void TransmitPacketsLoop(Streamer* args) override;
+    class USBStreamTransport;
+    StreamTransport* OpenStreamTransport(Streamer* stream, const bool isTx, TransportConfig& config) override;
     int SendData(const char* buffer, int length, int epIndex = 0, int timeout = 100)override;
     int ReceiveData(char* buffer, int length, int epIndex = 0, int timeout = 100)override;
 
-    virtual int BeginDataReading(char* buffer, uint32_t length, const uint8_t streamBulkInAddr = 0x81);
+    virtual int BeginDataReading(char* buffer, uint32_t length, const uint8_t streamBulkInAddr = 0x81, const bool notifyAny = true);
     virtual int WaitForReading(int contextHandle, unsigned int timeout_ms);
     virtual int FinishDataReading(char* buffer, uint32_t length, int contextHandle);
     virtual void AbortReading(int ep);
+    int WaitForAnyReading(unsigned int timeout_ms);
 
-    virtual int BeginDataSending(const char* buffer, uint32_t length, const uint8_t streamBulkOutAddr = 0x01);
+    virtual int BeginDataSending(const char* buffer, uint32_t length, const uint8_t streamBulkOutAddr = 0x01, const bool notifyAny = true);
     virtual int WaitForSending(int contextHandle, uint32_t timeout_ms);
     virtual int FinishDataSending(const char* buffer, uint32_t length, int contextHandle);
     virtual void AbortSending(int ep);
+    int WaitForAnySending(unsigned int timeout_ms);
 
     int ResetStreamBuffers() override;
     eConnectionType GetType(void) {return USB_PORT;}
 
     double DetectRefClk(void);
+    void* StreamDeviceHandle(void);
 
     USBTransferContext contexts[USB_MAX_CONTEXTS];
     USBTransferContext contextsToSend[USB_MAX_CONTEXTS];
+    TransferPool readPool; //free list and completions of contexts
+    TransferPool sendPool; //free list and completions of contextsToSend
+    std::atomic<uint64_t> transferSequence;
 
     bool isConnected;
 
@@ -180,10 +183,7 @@ protected:
     std::string DeviceName(unsigned int index);
     void *ctx; //not used, just for mirroring unix
 #else
-    libusb_context* ctx; //a libusb session
-    std::thread mUSBProcessingThread;
-    void handle_libusb_events();
-    std::atomic<bool> mProcessUSBEvents;
+    libusb_context* ctx; //shared libusb session
 #endif
 };
 
@@ -6,23 +6,12 @@
 
 #include "ConnectionSTREAM.h"
 #include "Logger.h"
+#ifdef __unix__
+#include "USBEventLoop.h"
+#endif
 
 using namespace lime;
 
-#ifdef __unix__
-void ConnectionSTREAMEntry::handle_libusb_events()
-{
-    struct timeval tv;
-    tv.tv_sec = 0;
-    tv.tv_usec = 250000;
-    while(mProcessUSBEvents.load() == true)
-    {
-        int r = libusb_handle_events_timeout_completed(ctx, &tv, NULL);
-        if(r != 0) lime::error("error libusb_handle_events %s", libusb_strerror(libusb_error(r)));
-    }
-}
-#endif // __UNIX__
-
 //! make a static-initialized entry in the registry
 void __loadConnectionSTREAMEntry(void) //TODO fixme replace with LoadLibrary/dlopen
 {
@@ -35,12 +24,7 @@ ConnectionSTREAMEntry::ConnectionSTREAMEntry(void):
     ConnectionRegistryEntry("STREAM")
 {
 #ifdef __unix__
-    int r = libusb_init(&ctx); //initialize the library for the session we just declared
-    if(r < 0)
-        lime::error("Init Error %i", r); //there was an error
-    libusb_set_debug(ctx, 3); //set verbosity level to 3, as suggested in the documentation
-    mProcessUSBEvents.store(true);
-    mUSBProcessingThread = std::thread(&ConnectionSTREAMEntry::handle_libusb_events, this);
+    ctx = USBEventLoop::AcquireContext();
 #endif
 }
 
@@ -48,21 +32,14 @@ ConnectionSTREAMEntry::ConnectionSTREAMEntry(const std::string entryName):
     ConnectionRegistryEntry(entryName)
 {
 #ifdef __unix__
-    int r = libusb_init(&ctx); //initialize the library for the session we just declared
-    if(r < 0)
-        lime::error("Init Error %i", r); //there was an error
-    libusb_set_debug(ctx, 3); //set verbosity level to 3, as suggested in the documentation
-    mProcessUSBEvents.store(true);
-    mUSBProcessingThread = std::thread(&ConnectionSTREAMEntry::handle_libusb_events, this);
+    ctx = USBEventLoop::AcquireContext();
 #endif
 }
 
 ConnectionSTREAMEntry::~ConnectionSTREAMEntry(void)
 {
 #ifdef __unix__
-    mProcessUSBEvents.store(false);
-    mUSBProcessingThread.join();
-    libusb_exit(ctx);
+    USBEventLoop::ReleaseContext();
 #endif
 }
 
@@ -12,6 +12,8 @@
 #include <chrono>
 #include <algorithm>
 #include <complex>
+#include <cstring>
+#include <new>
 #include <ciso646>
 #include <FPGA_common.h>
 #include "ErrorReporting.h"
@@ -20,6 +22,95 @@
 using namespace lime;
 using namespace std;
 
+/** @brief Streaming transport over asynchronous USB bulk transfers,
+    transfers are reaped in the order they complete. On Linux usbfs maps
+    buffers allocated by the kernel into user space, transfers from them are
+    not copied between kernel and user memory. Plain memory is used when that
+    is not available.
+*/
+class ConnectionSTREAM::USBStreamTransport : public StreamTransport
+{
+public:
+    USBStreamTransport(ConnectionSTREAM* port, const bool isTx) :
+        mPort(port),
+        mIsTx(isTx),
+        mEndPoint(isTx ? 0x01 : 0x81),
+        mBuffers(USB_MAX_CONTEXTS, nullptr),
+        mLengths(USB_MAX_CONTEXTS, 0),
+        mMemory(nullptr),
+        mSize(0),
+        mKernelMapped(false)
+    {
+    }
+
+    ~USBStreamTransport()
+    {
+#if defined(__unix__) && defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000105)
+        if (mKernelMapped)
+        {
+            libusb_dev_mem_free((libusb_device_handle*)mPort->StreamDeviceHandle(), (unsigned char*)mMemory, mSize);
+            return;
+        }
+#endif
+        delete[] mMemory;
+    }
+
+    char* AllocateBuffers(const size_t size) override
+    {
+        mSize = size;
+#if defined(__unix__) && defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000105)
+        mMemory = (char*)libusb_dev_mem_alloc((libusb_device_handle*)mPort->StreamDeviceHandle(), mSize);
+        mKernelMapped = mMemory != nullptr;
+#endif
+        if (mMemory == nullptr)
+            mMemory = new (std::nothrow) char[mSize];
+        if (mMemory == nullptr)
+            return nullptr;
+        memset(mMemory, 0, mSize);
+        lime::info("%s transfer buffers: %s", mIsTx ? "Tx" : "Rx", mKernelMapped ? "kernel mapped (zero-copy)" : "user memory");
+        return mMemory;
+    }
+
+    int Submit(char* buffer, const uint32_t length) override
+    {
+        const int handle = mIsTx ? mPort->BeginDataSending(buffer, length, mEndPoint) : mPort->BeginDataReading(buffer, length, mEndPoint);
+        if (handle < 0)
+            return -1;
+        mBuffers[handle] = buffer;
+        mLengths[handle] = length;
+        return 0;
+    }
+
+    int Reap(char** buffer, const unsigned timeout_ms) override
+    {
+        const int handle = mIsTx ? mPort->WaitForAnySending(timeout_ms) : mPort->WaitForAnyReading(timeout_ms);
+        if (handle < 0)
+            return REAP_TIMEOUT;
+        *buffer = mBuffers[handle];
+        if (mIsTx)
+            return mPort->FinishDataSending(mBuffers[handle], mLengths[handle], handle);
+        return mPort->FinishDataReading(mBuffers[handle], mLengths[handle], handle);
+    }
+
+    void Cancel(void) override
+    {
+        if (mIsTx)
+            mPort->AbortSending(mEndPoint);
+        else
+            mPort->AbortReading(mEndPoint);
+    }
+
+private:
+    ConnectionSTREAM* mPort;
+    const bool mIsTx;
+    const uint8_t mEndPoint;
+    std::vector<char*> mBuffers; //buffer of each transfer context
+    std::vector<uint32_t> mLengths;
+    char* mMemory;
+    size_t mSize;
+    bool mKernelMapped;
+};
+
 /** @brief Configures FPGA PLLs to LimeLight interface frequency
 */
 int ConnectionSTREAM::UpdateExternalDataRate(const size_t channel, const double txRate_Hz, const double rxRate_Hz, const double txPhase, const double rxPhase)
@@ -178,6 +269,16 @@ int ConnectionSTREAM::UpdateExternalDataRate(const size_t channel, const double
     return status;
 }
 
+//! @return libusb device handle for allocating transfer buffers, nullptr if not used
+void* ConnectionSTREAM::StreamDeviceHandle(void)
+{
+#ifdef __unix__
+    return dev_handle;
+#else
+    return nullptr;
+#endif
+}
+
 int ConnectionSTREAM::ResetStreamBuffers()
 {
     //USB FIFO reset
@@ -204,324 +305,11 @@ int ConnectionSTREAM::ReadRawStreamData(char* buffer, unsigned length, int epInd
     return totalBytesReceived;
 }
 
-/** @brief Function dedicated for receiving data samples from board
-    @param stream a pointer to an active receiver stream
-*/
-void ConnectionSTREAM::ReceivePacketsLoop(Streamer* stream)
-{
-    //at this point FPGA has to be already configured to output samples
-    const uint8_t chCount = stream->mRxStreams.size();
-    const auto link = stream->mRxStreams[0]->config.linkFormat;
-    const uint32_t samplesInPacket = (link == StreamConfig::STREAM_12_BIT_COMPRESSED ? 1360 : 1020)/chCount;
-    const unsigned char ep = 0x81;
-    const int chipID = stream->mChipID;
-
-    const uint8_t packetsToBatch = stream->rxBatchSize;
-    const uint32_t bufferSize = packetsToBatch*sizeof(FPGA_DataPacket);
-    const uint8_t buffersCount = 16;
-    vector<int> handles(buffersCount, 0);
-    vector<char>buffers(buffersCount*bufferSize, 0);
-    vector<StreamChannel::Frame> chFrames;
-    try
-    {
-        chFrames.resize(chCount);
-    }
-    catch (const std::bad_alloc &ex)
-    {
-        ReportError("Error allocating Rx buffers, not enough memory");
-        return;
-    }
-
-    int activeTransfers = 0;
-    for (int i = 0; i<buffersCount; ++i)
-    {
-        handles[i] = this->BeginDataReading(&buffers[i*bufferSize], bufferSize, ep);
-        ++activeTransfers;
-    }
-
-    int bi = 0;
-    unsigned long totalBytesReceived = 0; //for data rate calculation
-
-    auto t1 = chrono::high_resolution_clock::now();
-    auto t2 = t1;
-
-    std::mutex txFlagsLock;
-    condition_variable resetTxFlags;
-    //worker thread for reseting late Tx packet flags
-    std::thread txReset([](ILimeSDRStreaming* port,
-                        atomic<bool> *terminate,
-                        mutex *spiLock,
-                        condition_variable *doWork)
-    {
-        uint32_t reg9;
-        port->ReadRegister(0x0009, reg9);
-        const uint32_t addr[] = {0x0009, 0x0009};
-        const uint32_t data[] = {reg9 | (5 << 1), reg9 & ~(5 << 1)};
-        while (not terminate->load())
-        {
-            std::unique_lock<std::mutex> lck(*spiLock);
-            doWork->wait(lck);
-            port->WriteRegisters(addr, data, 2);
-        }
-    }, this, &stream->terminateRx, &txFlagsLock, &resetTxFlags);
-
-    int resetFlagsDelay = 128;
-    uint64_t prevTs = 0;
-    while (stream->terminateRx.load() == false)
-    {
-        if(stream->generateData.load())
-        {
-            if(activeTransfers == 0) //stop FPGA when last transfer completes
-                fpga::StopStreaming(this, chipID);
-            stream->safeToConfigInterface.notify_all(); //notify that it's safe to change chip config
-            const int batchSize = (this->mExpectedSampleRate/chFrames[0].samplesCount)/10;
-            IStreamChannel::Metadata meta;
-            for(int i=0; i<batchSize; ++i)
-            {
-                for(int ch=0; ch<chCount; ++ch)
-                {
-                    meta.timestamp = chFrames[ch].timestamp;
-                    for(int j=0; j<chFrames[ch].samplesCount; ++j)
-                    {
-                        chFrames[ch].samples[j].i = 0;
-                        chFrames[ch].samples[j].q = 0;
-                    }
-                    uint32_t samplesPushed = stream->mRxStreams[ch]->Write((const void*)chFrames[ch].samples, chFrames[ch].samplesCount, &meta);
-                    if(samplesPushed != chFrames[ch].samplesCount)
-                        lime::warning("Rx samples pushed %i/%i", samplesPushed, chFrames[ch].samplesCount);
-                }
-            }
-            this_thread::sleep_for(chrono::milliseconds(100));
-        }
-        int32_t bytesReceived = 0;
-        if(handles[bi] >= 0)
-        {
-            if (this->WaitForReading(handles[bi], 1000) == true)
-                bytesReceived = this->FinishDataReading(&buffers[bi*bufferSize], bufferSize, handles[bi]);
-            --activeTransfers;
-            totalBytesReceived += bytesReceived;
-            if (bytesReceived != int32_t(bufferSize)) //data should come in full sized packets
-                for(auto value: stream->mRxStreams)
-                    value->underflow++;
-        }
-        bool txLate=false;
-        for (uint8_t pktIndex = 0; pktIndex < bytesReceived / sizeof(FPGA_DataPacket); ++pktIndex)
-        {
-            const FPGA_DataPacket* pkt = (FPGA_DataPacket*)&buffers[bi*bufferSize];
-            const uint8_t byte0 = pkt[pktIndex].reserved[0];
-            if ((byte0 & (1 << 3)) != 0 && !txLate) //report only once per batch
-            {
-                txLate = true;
-                if(resetFlagsDelay > 0)
-                    --resetFlagsDelay;
-                else
-                {
-                    lime::info("L");
-                    resetTxFlags.notify_one();
-                    resetFlagsDelay = packetsToBatch*buffersCount;
-                    stream->txLastLateTime.store(pkt[pktIndex].counter);
-                    for(auto value: stream->mTxStreams)
-                        value->pktLost++;
-                }
-            }
-            uint8_t* pktStart = (uint8_t*)pkt[pktIndex].data;
-            if(pkt[pktIndex].counter - prevTs != samplesInPacket && pkt[pktIndex].counter != prevTs)
-            {
-                int packetLoss = ((pkt[pktIndex].counter - prevTs)/samplesInPacket)-1;
-#ifndef NDEBUG
-                printf("\tRx pktLoss: ts diff: %li  pktLoss: %i\n", pkt[pktIndex].counter - prevTs, packetLoss);
-#endif
-                for(auto value: stream->mRxStreams)
-                    value->pktLost += packetLoss;
-            }
-            prevTs = pkt[pktIndex].counter;
-            stream->rxLastTimestamp.store(prevTs);
-            //parse samples
-            vector<complex16_t*> dest(chCount);
-            for(uint8_t c=0; c<chCount; ++c)
-                dest[c] = (chFrames[c].samples);
-            size_t samplesCount = 0;
-            fpga::FPGAPacketPayload2Samples(pktStart, 4080, chCount, link, dest.data(), &samplesCount);
-
-            for(int ch=0; ch<chCount; ++ch)
-            {
-                IStreamChannel::Metadata meta;
-                meta.timestamp = pkt[pktIndex].counter;
-                meta.flags = RingFIFO::OVERWRITE_OLD;
-                uint32_t samplesPushed = stream->mRxStreams[ch]->Write((const void*)chFrames[ch].samples, samplesCount, &meta, 100);
-                if(samplesPushed != samplesCount)
-                    stream->mRxStreams[ch]->overflow++;
-            }
-        }
-        // Re-submit this request to keep the queue full
-        if(not stream->generateData.load())
-        {
-            if(activeTransfers == 0) //reactivate FPGA and USB transfers
-                fpga::StartStreaming(this, chipID);
-            for(int i=0; i<buffersCount-activeTransfers; ++i)
-            {
-                handles[bi] = this->BeginDataReading(&buffers[bi*bufferSize], bufferSize, ep);
-                bi = (bi + 1) & (buffersCount-1);
-                ++activeTransfers;
-            }
-        }
-        else
-        {
-            handles[bi] = -1;
-            bi = (bi + 1) & (buffersCount-1);
-        }
-        t2 = chrono::high_resolution_clock::now();
-        auto timePeriod = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
-        if (timePeriod >= 1000)
-        {
-            t1 = t2;
-            //total number of bytes sent per second
-            double dataRate = 1000.0*totalBytesReceived / timePeriod;
-#ifndef NDEBUG
-            printf("Rx: %.3f MB/s\n", dataRate / 1000000.0);
-#endif
-            totalBytesReceived = 0;
-            stream->rxDataRate_Bps.store((uint32_t)dataRate);
-        }
-    }
-    AbortReading(ep);
-    for (int j = 0; j<buffersCount; j++)
-    {
-        if(handles[bi] >= 0)
-        {
-            this->WaitForReading(handles[bi], 1000);
-            this->FinishDataReading(&buffers[bi*bufferSize], bufferSize, handles[bi]);
-        }
-        bi = (bi + 1) & (buffersCount-1);
-    }
-    resetTxFlags.notify_one();
-    txReset.join();
-    stream->rxDataRate_Bps.store(0);
-}
-
-/** @brief Functions dedicated for transmitting packets to board
-    @param stream an active transmit stream
+/** @brief Creates USB transport for streaming data of the chip,
+    late Tx packet flags are cleared with bits 1 and 3 of register 0x0009
 */
-void ConnectionSTREAM::TransmitPacketsLoop(Streamer* stream)
+StreamTransport* ConnectionSTREAM::OpenStreamTransport(Streamer* stream, const bool isTx, TransportConfig& config)
 {
-    //at this point FPGA has to be already configured to output samples
-    const uint8_t maxChannelCount = 2;
-    const uint8_t chCount = stream->mTxStreams.size();
-    const auto link = stream->mTxStreams[0]->config.linkFormat;
-    const unsigned char ep  = 0x01;
-
-    const uint8_t buffersCount = 16; // must be power of 2
-    const uint8_t packetsToBatch = stream->txBatchSize; //packets in single USB transfer
-    const uint32_t bufferSize = packetsToBatch*4096;
-    const uint32_t popTimeout_ms = 500;
-
-    const int maxSamplesBatch = (link==StreamConfig::STREAM_12_BIT_COMPRESSED?1360:1020)/chCount;
-    vector<int> handles(buffersCount, 0);
-    vector<bool> bufferUsed(buffersCount, 0);
-    vector<complex16_t> samples[maxChannelCount];
-    vector<char> buffers;
-    try
-    {
-        for(int i=0; i<chCount; ++i)
-            samples[i].resize(maxSamplesBatch);
-        buffers.resize(buffersCount*bufferSize, 0);
-    }
-    catch (const std::bad_alloc& ex) //not enough memory for buffers
-    {
-        return lime::error("Error allocating Tx buffers, not enough memory");
-    }
-
-    long totalBytesSent = 0;
-    auto t1 = chrono::high_resolution_clock::now();
-    auto t2 = t1;
-
-    uint8_t bi = 0; //buffer index
-    while (stream->terminateTx.load() != true)
-    {
-        if (bufferUsed[bi])
-        {
-    	    unsigned bytesSent = 0;
-            if (this->WaitForSending(handles[bi], 1000) == true) {
-                bytesSent = this->FinishDataSending(&buffers[bi*bufferSize], bufferSize, handles[bi]);
-	    }
-
-            if (bytesSent != bufferSize) {
-	      for (auto value : stream->mTxStreams) {
-		value->overflow++;
-	      }
-            }
-            else {
-                totalBytesSent += bytesSent;
-	    }
-            bufferUsed[bi] = false;
-        }
-        int i=0;
-
-        while(i<packetsToBatch && stream->terminateTx.load() != true)
-        {
-            IStreamChannel::Metadata meta;
-            FPGA_DataPacket* pkt = reinterpret_cast<FPGA_DataPacket*>(&buffers[bi*bufferSize]);
-            for(int ch=0; ch<chCount; ++ch)
-            {
-                int samplesPopped = stream->mTxStreams[ch]->Read(samples[ch].data(), maxSamplesBatch, &meta, popTimeout_ms);
-                if (samplesPopped != maxSamplesBatch)
-                {
-                    stream->mTxStreams[ch]->underflow++;
-                    stream->terminateTx.store(true);
-#ifndef NDEBUG
-                    printf("popping from TX, samples popped %i/%i\n", samplesPopped, maxSamplesBatch);
-#endif
-                    break;
-                }
-            }
-
-            if(stream->terminateTx.load() == true) //early termination
-                break;
-            pkt[i].counter = meta.timestamp;
-            pkt[i].reserved[0] = 0;
-            //by default ignore timestamps
-            const int ignoreTimestamp = !(meta.flags & IStreamChannel::Metadata::SYNC_TIMESTAMP);
-            pkt[i].reserved[0] |= ((int)ignoreTimestamp << 4); //ignore timestamp
-
-            vector<complex16_t*> src(chCount);
-            for(uint8_t c=0; c<chCount; ++c)
-                src[c] = (samples[c].data());
-            uint8_t* const dataStart = (uint8_t*)pkt[i].data;
-            fpga::Samples2FPGAPacketPayload(src.data(), maxSamplesBatch, chCount, link, dataStart, nullptr);
-            ++i;
-        }
-
-        handles[bi] = this->BeginDataSending(&buffers[bi*bufferSize], bufferSize, ep);
-        bufferUsed[bi] = true;
-
-        t2 = chrono::high_resolution_clock::now();
-        auto timePeriod = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
-        if (timePeriod >= 1000)
-        {
-            //total number of bytes sent per second
-            float dataRate = 1000.0*totalBytesSent / timePeriod;
-            stream->txDataRate_Bps.store(dataRate);
-            totalBytesSent = 0;
-            t1 = t2;
-#ifndef NDEBUG
-            printf("Tx: %.3f MB/s\n", dataRate / 1000000.0);
-#endif
-        }
-        bi = (bi + 1) & (buffersCount-1);
-    }
-
-    // Wait for all the queued requests to be cancelled
-    AbortSending(ep);
-    for (int j = 0; j<buffersCount; j++)
-    {
-        if (bufferUsed[bi])
-        {
-            this->WaitForSending(handles[bi], 1000);
-            this->FinishDataSending(&buffers[bi*bufferSize], bufferSize, handles[bi]);
-        }
-        bi = (bi + 1) & (buffersCount-1);
-    }
-    stream->txRunning.store(false);
-    stream->txDataRate_Bps.store(0);
+    config.lateFlagsMask = 5 << 1;
+    return new USBStreamTransport(this, isTx);
 }
-
@@ -10,6 +10,7 @@
 #include "Windows.h"
 #else
 #include <unistd.h>
+#include <poll.h>
 #endif
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -59,13 +60,27 @@ const ConnectionXillybus::EPConfig ConnectionXillybus::deviceConfigs[] = {
 #endif
 };
 
+#ifdef __unix__
+/** @brief Sleeps until file is ready instead of retrying non-blocking I/O
+    @return false if operation timed out
+*/
+static bool WaitReady(const int fd, const short events, const chrono::high_resolution_clock::time_point start, const int timeout_ms)
+{
+    const int remaining = timeout_ms - std::chrono::duration_cast<std::chrono::milliseconds>(chrono::high_resolution_clock::now() - start).count();
+    if (remaining <= 0)
+        return false;
+    pollfd fds;
+    fds.fd = fd;
+    fds.events = events;
+    fds.revents = 0;
+    return poll(&fds, 1, remaining) > 0 || errno == EINTR;
+}
+#endif
+
 /** @brief Initializes port type and object necessary to communicate to usb device.
 */
 ConnectionXillybus::ConnectionXillybus(const unsigned index)
 {
-    RxLoopFunction = bind(&ConnectionXillybus::ReceivePacketsLoop, this, std::placeholders::_1);
-    TxLoopFunction = bind(&ConnectionXillybus::TransmitPacketsLoop, this, std::placeholders::_1);
-
     m_hardwareName = "";
 #ifndef __unix__
     hWrite = INVALID_HANDLE_VALUE;
@@ -205,6 +220,21 @@ int ConnectionXillybus::OpenControl()
     return 0;
 }
 
+/** @brief Opens stream device file if it is not open yet
+    @return file descriptor, -1 on failure
+*/
+int ConnectionXillybus::OpenStreamPort(const int epIndex, const bool tx)
+{
+    int &handle = tx ? hWriteStream[epIndex] : hReadStream[epIndex];
+    if (handle == -1)
+    {
+        const std::string &port = tx ? writeStreamPort[epIndex] : readStreamPort[epIndex];
+        if ((handle = open(port.c_str(), (tx ? O_WRONLY : O_RDONLY) | O_NOCTTY | O_NONBLOCK)) == -1)
+            ReportError(errno);
+    }
+    return handle;
+}
+
 void ConnectionXillybus::CloseControl()
 {
     close(hWrite);
@@ -284,6 +314,8 @@ int ConnectionXillybus::Write(const unsigned char *buffer, const int length, int
         int bytesSent;
         if ((bytesSent  = write(hWrite, buffer+ totalBytesWritten, bytesToWrite))<0)
         {
+            if(errno == EAGAIN && !WaitReady(hWrite, POLLOUT, t1, timeout_ms))
+                break;
             if(errno == EINTR || errno == EAGAIN)
                  continue;
             ReportError(errno);
@@ -359,6 +391,8 @@ int ConnectionXillybus::Read(unsigned char *buffer, const int length, int timeou
         int bytesReceived;
         if ((bytesReceived = read(hRead, buffer+ totalBytesReaded, bytesToRead))<0)
         {
+           if(errno == EAGAIN && !WaitReady(hRead, POLLIN, t1, timeout_ms))
+               break;
            if(errno == EINTR || errno == EAGAIN)
                continue;
            ReportError(errno);
@@ -396,14 +430,8 @@ int ConnectionXillybus::ReceiveData(char *buffer, int length, int epIndex, int t
         }
     }
 #else
-    if (hReadStream[epIndex] == -1)
-    {
-       if (( hReadStream[epIndex] = open(readStreamPort[epIndex].c_str(), O_RDONLY | O_NOCTTY | O_NONBLOCK))==-1)
-       {
-            ReportError(errno);
-            return -1;
-       }
-    }
+    if (OpenStreamPort(epIndex, false) == -1)
+        return -1;
 #endif
 
     int totalBytesReaded = 0;
@@ -441,6 +469,8 @@ int ConnectionXillybus::ReceiveData(char *buffer, int length, int epIndex, int t
         int bytesReceived;
         if ((bytesReceived = read(hReadStream[epIndex], buffer+ totalBytesReaded, bytesToRead))<0)
         {
+            if(errno == EAGAIN && !WaitReady(hReadStream[epIndex], POLLIN, t1, timeout_ms))
+                break;
             if(errno == EINTR || errno == EAGAIN)
                 continue;
             ReportError(errno);
@@ -498,14 +528,8 @@ int ConnectionXillybus::SendData(const char *buffer, int length, int epIndex, in
         }
     }
 #else
-    if (hWriteStream[epIndex] == -1)
-    {
-       if ((hWriteStream[epIndex] = open(writeStreamPort[epIndex].c_str(), O_WRONLY | O_NOCTTY | O_NONBLOCK))==-1)
-       {
-            ReportError(errno);
-            return -1;
-       }
-    }
+    if (OpenStreamPort(epIndex, true) == -1)
+        return -1;
 #endif
     int totalBytesWritten = 0;
     int bytesToWrite = length;
@@ -542,6 +566,8 @@ int ConnectionXillybus::SendData(const char *buffer, int length, int epIndex, in
         int bytesSent;
         if ((bytesSent  = write(hWriteStream[epIndex], buffer+ totalBytesWritten, bytesToWrite))<0)
         {
+            if(errno == EAGAIN && !WaitReady(hWriteStream[epIndex], POLLOUT, t1, timeout_ms))
+                break;
             if(errno == EINTR || errno == EAGAIN)
                 continue;
             ReportError(errno);
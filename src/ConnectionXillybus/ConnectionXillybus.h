@@ -47,8 +47,8 @@ public:
     int ProgramWrite(const char *data_src, const size_t length, const int prog_mode, const int device, ProgrammingCallback callback)override;
 #endif
 protected:
-    void ReceivePacketsLoop(Streamer* args) override;
-    void TransmitPacketsLoop(Streamer* args) override;
+    class PCIeStreamTransport;
+    StreamTransport* OpenStreamTransport(Streamer* stream, const bool isTx, TransportConfig& config) override;
 
     int ReceiveData(char* buffer, int length, int epIndex, int timeout = 100) override;
     int SendData(const char* buffer, int length, int epIndex, int timeout = 100) override;
@@ -84,6 +84,7 @@ private:
 #else
     int OpenControl();
     void CloseControl();
+    int OpenStreamPort(const int epIndex, const bool tx);
     int hWrite;
     int hRead;
     int hWriteStream[MAX_EP_CNT];
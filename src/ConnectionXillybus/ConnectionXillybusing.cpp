@@ -13,13 +13,22 @@
 #include <algorithm>
 #include <complex>
 #include <ciso646>
+#include <deque>
 #include <FPGA_common.h>
 #include <ErrorReporting.h>
 #include "Logger.h"
+#ifdef __unix__
+#include "FdStreamRing.h"
+#endif
 
 using namespace std;
 using namespace lime;
 
+#ifdef __unix__
+//buffers in flight on each direction, kernel reads or writes one while the others are processed
+static const int STREAM_RING_BUFFERS = 4;
+#endif
+
 int ConnectionXillybus::UpdateExternalDataRate(const size_t channel, const double txRate_Hz, const double rxRate_Hz, const double txPhase, const double rxPhase)
 {
     lime::fpga::FPGA_PLL_clock clocks[2];
@@ -191,268 +200,112 @@ int ConnectionXillybus::ReadRawStreamData(char* buffer, unsigned length, int epI
     return totalBytesReceived;
 }
 
-/** @brief Function dedicated for receiving data samples from board
-    @param rxFIFO FIFO to store received data
-    @param terminate periodically pooled flag to terminate thread
-    @param dataRate_Bps (optional) if not NULL periodically returns data rate in bytes per second
+/** @brief Streaming transport over Xillybus stream device files.
+    On POSIX systems an I/O thread transfers submitted buffers,
+    otherwise each buffer is transferred synchronously by Reap().
 */
-void ConnectionXillybus::ReceivePacketsLoop(Streamer* stream)
+class ConnectionXillybus::PCIeStreamTransport : public StreamTransport
 {
-    //at this point FPGA has to be already configured to output samples
-    const uint8_t chCount = stream->mRxStreams.size();
-    const auto link = stream->mRxStreams[0]->config.linkFormat;
-    const uint32_t samplesInPacket = (link == StreamConfig::STREAM_12_BIT_COMPRESSED ? 1360 : 1020)/chCount;
-    const int epIndex = stream->mChipID;
-
-    const uint8_t packetsToBatch = stream->rxBatchSize*2;
-    const uint32_t bufferSize = packetsToBatch*sizeof(FPGA_DataPacket);
-    vector<char>buffers(bufferSize, 0);
-    vector<StreamChannel::Frame> chFrames;
-    try
-    {
-        chFrames.resize(chCount);
-    }
-    catch (const std::bad_alloc &ex)
+public:
+    PCIeStreamTransport(ConnectionXillybus* port, const int epIndex, const bool isTx) :
+#ifdef __unix__
+        mRing(isTx, STREAM_RING_BUFFERS),
+#endif
+        mPort(port),
+        mEpIndex(epIndex),
+        mIsTx(isTx)
     {
-        ReportError("Error allocating Rx buffers, not enough memory");
-        return;
     }
 
-    unsigned long totalBytesReceived = 0; //for data rate calculation
-    bool generate_started = false;
-
-    vector<uint32_t> samplesReceived(chCount, 0);
-
-    auto t1 = chrono::high_resolution_clock::now();
-    auto t2 = chrono::high_resolution_clock::now();
-
-    std::mutex txFlagsLock;
-    condition_variable resetTxFlags;
-    //worker thread for reseting late Tx packet flags
-    std::thread txReset([](ILimeSDRStreaming* port,
-                        atomic<bool> *terminate,
-                        mutex *spiLock,
-                        condition_variable *doWork)
+    ~PCIeStreamTransport()
     {
-        uint32_t reg9;
-        port->ReadRegister(0x0009, reg9);
-        const uint32_t addr[] = {0x0009, 0x0009};
-        const uint32_t data[] = {reg9 | (1 << 1), reg9 & ~(1 << 1)};
-        while (not terminate->load())
-        {
-            std::unique_lock<std::mutex> lck(*spiLock);
-            doWork->wait(lck);
-            port->WriteRegisters(addr, data, 2);
-        }
-    }, this, &stream->terminateRx, &txFlagsLock, &resetTxFlags);
+#ifdef __unix__
+        mRing.Stop();
+#endif
+        if (mIsTx)
+            mPort->AbortSending(mEpIndex);
+        else
+            mPort->AbortReading(mEpIndex);
+    }
 
-    int resetFlagsDelay = 128;
-    uint64_t prevTs = 0;
-    while (stream->terminateRx.load() == false)
+    //! @return 0 if stream device file is ready for transfers
+    int Open(void)
     {
-        if(stream->generateData.load())
-        {
-            generate_started = true;
-            fpga::StopStreaming(this, epIndex);
-            stream->safeToConfigInterface.notify_all(); //notify that it's safe to change chip config
-            const int batchSize = (this->mExpectedSampleRate/chFrames[0].samplesCount)/10;
-            IStreamChannel::Metadata meta;
-            for(int i=0; i<batchSize; ++i)
-            {
-                for(int ch=0; ch<chCount; ++ch)
-                {
-                    meta.timestamp = chFrames[ch].timestamp;
-                    for(int j=0; j<chFrames[ch].samplesCount; ++j)
-                    {
-                        chFrames[ch].samples[j].i = 0;
-                        chFrames[ch].samples[j].q = 0;
-                    }
-                    uint32_t samplesPushed = stream->mRxStreams[ch]->Write((const void*)chFrames[ch].samples, chFrames[ch].samplesCount, &meta);
-                    samplesReceived[ch] += chFrames[ch].samplesCount;
-                    if(samplesPushed != chFrames[ch].samplesCount)
-                        printf("Rx samples pushed %i/%i\n", samplesPushed, chFrames[ch].samplesCount);
-                }
-            }
-            this_thread::sleep_for(chrono::milliseconds(100));
-        }
-        int32_t bytesReceived = 0;
-
-        bytesReceived = this->ReceiveData(&buffers[0], bufferSize, epIndex, 1000);
-        totalBytesReceived += bytesReceived;
-        if (bytesReceived != int32_t(bufferSize)) //data should come in full sized packets
-            for(auto value: stream->mRxStreams)
-                value->underflow++;
-
-        bool txLate=false;
-        for (uint8_t pktIndex = 0; pktIndex < bytesReceived / sizeof(FPGA_DataPacket); ++pktIndex)
-        {
-            const FPGA_DataPacket* pkt = (FPGA_DataPacket*)&buffers[0];
-            const uint8_t byte0 = pkt[pktIndex].reserved[0];
-            if ((byte0 & (1 << 3)) != 0 && !txLate) //report only once per batch
-            {
-                txLate = true;
-                if(resetFlagsDelay > 0)
-                    --resetFlagsDelay;
-                else
-                {
-                    lime::info("L");
-                    resetTxFlags.notify_one();
-                    resetFlagsDelay = packetsToBatch*2;
-                    stream->txLastLateTime.store(pkt[pktIndex].counter);
-                    for(auto value: stream->mTxStreams)
-                        value->pktLost++;
-                }
-            }
-            uint8_t* pktStart = (uint8_t*)pkt[pktIndex].data;
-            if(pkt[pktIndex].counter - prevTs != samplesInPacket && pkt[pktIndex].counter != prevTs)
-            {
-                int packetLoss = ((pkt[pktIndex].counter - prevTs)/samplesInPacket)-1;
-#ifndef NDEBUG
-                printf("\tRx pktLoss: ts diff: %li  pktLoss: %i\n", pkt[pktIndex].counter - prevTs, packetLoss);
+#ifdef __unix__
+        const int fd = mPort->OpenStreamPort(mEpIndex, mIsTx);
+        if (fd == -1)
+            return -1;
+        return mRing.Start(fd);
+#else
+        return 0;
 #endif
-                for(auto value: stream->mRxStreams)
-                    value->pktLost += packetLoss;
-            }
-            prevTs = pkt[pktIndex].counter;
-            stream->rxLastTimestamp.store(pkt[pktIndex].counter);
-            //parse samples
-            vector<complex16_t*> dest(chCount);
-            for(uint8_t c=0; c<chCount; ++c)
-                dest[c] = (chFrames[c].samples);
-            size_t samplesCount = 0;
-            fpga::FPGAPacketPayload2Samples(pktStart, 4080, chCount, link, dest.data(), &samplesCount);
-
-            for(int ch=0; ch<chCount; ++ch)
-            {
-                IStreamChannel::Metadata meta;
-                meta.timestamp = pkt[pktIndex].counter;
-                meta.flags = RingFIFO::OVERWRITE_OLD;
-                uint32_t samplesPushed = stream->mRxStreams[ch]->Write((const void*)chFrames[ch].samples, samplesCount, &meta, 100);
-                if(samplesPushed != samplesCount)
-                    stream->mRxStreams[ch]->overflow++;;
-            }
-        }
-        // Re-submit this request to keep the queue full
-        if ((generate_started) && (!stream->generateData.load()))
-            fpga::StartStreaming(this, epIndex);
+    }
 
-        t2 = chrono::high_resolution_clock::now();
-        auto timePeriod = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
-        if (timePeriod >= 1000)
-        {
-            t1 = t2;
-            //total number of bytes sent per second
-            double dataRate = 1000.0*totalBytesReceived / timePeriod;
-#ifndef NDEBUG
-            printf("Rx: %.3f MB/s\n", dataRate / 1000000.0);
+    int Submit(char* buffer, const uint32_t length) override
+    {
+#ifdef __unix__
+        return mRing.Submit(buffer, length);
+#else
+        Transfer transfer = {buffer, length};
+        mTransfers.push_back(transfer);
+        return 0;
 #endif
-            totalBytesReceived = 0;
-            stream->rxDataRate_Bps.store((uint32_t)dataRate);
-        }
     }
-    AbortReading(epIndex);
-    resetTxFlags.notify_one();
-    txReset.join();
-    stream->rxDataRate_Bps.store(0);
-}
 
-/** @brief Functions dedicated for transmitting packets to board
-    @param txFIFO data source FIFO
-    @param terminate periodically pooled flag to terminate thread
-    @param dataRate_Bps (optional) if not NULL periodically returns data rate in bytes per second
-*/
-void ConnectionXillybus::TransmitPacketsLoop(Streamer* stream)
-{
-    //at this point FPGA has to be already configured to output samples
-    const uint8_t maxChannelCount = 2;
-    const uint8_t chCount = stream->mTxStreams.size();
-    const auto link = stream->mTxStreams[0]->config.linkFormat;
-    const int epIndex = stream->mChipID;
-
-    const uint8_t packetsToBatch = stream->txBatchSize*2;; //packets in single USB transfer
-    const uint32_t bufferSize = packetsToBatch*4096;
-    const uint32_t popTimeout_ms = 500;
-    const int maxSamplesBatch = (link==StreamConfig::STREAM_12_BIT_COMPRESSED?1360:1020)/chCount;
-    vector<complex16_t> samples[maxChannelCount];
-    vector<char> buffers;
-    try
+    int Reap(char** buffer, const unsigned timeout_ms) override
     {
-        for(int i=0; i<chCount; ++i)
-            samples[i].resize(maxSamplesBatch);
-        buffers.resize(bufferSize, 0);
+#ifdef __unix__
+        return mRing.Reap(buffer, timeout_ms);
+#else
+        if (mTransfers.empty())
+            return REAP_TIMEOUT;
+        const Transfer transfer = mTransfers.front();
+        mTransfers.pop_front();
+        *buffer = transfer.buffer;
+        const int bytes = mIsTx ? mPort->SendData(transfer.buffer, transfer.length, mEpIndex, timeout_ms)
+                                : mPort->ReceiveData(transfer.buffer, transfer.length, mEpIndex, timeout_ms);
+        return bytes > 0 ? bytes : 0;
+#endif
     }
-    catch (const std::bad_alloc& ex) //not enough memory for buffers
+
+    void Cancel(void) override
     {
-        printf("Error allocating Tx buffers, not enough memory\n");
-        return;
+#ifdef __unix__
+        mRing.Cancel();
+#endif
     }
 
-    long totalBytesSent = 0;
-    auto t1 = chrono::high_resolution_clock::now();
-    auto t2 = t1;
-
-    while (stream->terminateTx.load() != true)
+private:
+#ifdef __unix__
+    FdStreamRing mRing;
+#else
+    struct Transfer
     {
-        int i=0;
-
-        while(i<packetsToBatch)
-        {
-            IStreamChannel::Metadata meta;
-            FPGA_DataPacket* pkt = reinterpret_cast<FPGA_DataPacket*>(&buffers[0]);
-            for(int ch=0; ch<chCount; ++ch)
-            {
-                int samplesPopped = stream->mTxStreams[ch]->Read(samples[ch].data(), maxSamplesBatch, &meta, popTimeout_ms);
-                if (samplesPopped != maxSamplesBatch)
-                {
-                    stream->mTxStreams[ch]->underflow++;
-                    stream->terminateTx.store(true);
-                #ifndef NDEBUG
-                    printf("Warning popping from TX, samples popped %i/%i\n", samplesPopped, maxSamplesBatch);
-                #endif
-                    break;
-                }
-            }
-            if(stream->terminateTx.load() == true) //early termination
-                break;
-            pkt[i].counter = meta.timestamp;
-            pkt[i].reserved[0] = 0;
-            //by default ignore timestamps
-            const int ignoreTimestamp = !(meta.flags & IStreamChannel::Metadata::SYNC_TIMESTAMP);
-            pkt[i].reserved[0] |= ((int)ignoreTimestamp << 4); //ignore timestamp
-
-            vector<complex16_t*> src(chCount);
-            for(uint8_t c=0; c<chCount; ++c)
-                src[c] = (samples[c].data());
-            uint8_t* const dataStart = (uint8_t*)pkt[i].data;
-            fpga::Samples2FPGAPacketPayload(src.data(), maxSamplesBatch, chCount, link, dataStart, nullptr);
-            ++i;
-        }
-
-        uint32_t bytesSent = this->SendData(&buffers[0], bufferSize, epIndex, 1000);
-        if (bytesSent != bufferSize){
-            for (auto value : stream->mTxStreams)
-		value->overflow++;
-        }
-        else
-            totalBytesSent += bytesSent;
+        char* buffer;
+        uint32_t length;
+    };
+    std::deque<Transfer> mTransfers;
+#endif
+    ConnectionXillybus* mPort;
+    const int mEpIndex;
+    const bool mIsTx;
+};
 
-        t2 = chrono::high_resolution_clock::now();
-        auto timePeriod = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
-        if (timePeriod >= 1000)
-        {
-            //total number of bytes sent per second
-            float dataRate = 1000.0*totalBytesSent / timePeriod;
-            stream->txDataRate_Bps.store(dataRate);
-            totalBytesSent = 0;
-            t1 = t2;
-#ifndef NDEBUG
-            printf("Tx: %.3f MB/s\n", dataRate / 1000000.0);
+/** @brief Creates transport for streaming data of the chip
+*/
+StreamTransport* ConnectionXillybus::OpenStreamTransport(Streamer* stream, const bool isTx, TransportConfig& config)
+{
+    config.packetsPerTransfer = 2*(isTx ? stream->txBatchSize : stream->rxBatchSize);
+#ifdef __unix__
+    config.buffersCount = STREAM_RING_BUFFERS;
+#else
+    config.buffersCount = 1;
 #endif
-        }
+    PCIeStreamTransport* transport = new PCIeStreamTransport(this, stream->mChipID, isTx);
+    if (transport->Open() != 0)
+    {
+        delete transport;
+        return nullptr;
     }
-
-    // Wait for all the queued requests to be cancelled
-    AbortSending(epIndex);
-    stream->txRunning.store(false);
-    stream->txDataRate_Bps.store(0);
+    return transport;
 }
@@ -6,6 +6,9 @@
 
 #include "Connection_uLimeSDR.h"
 #include "ErrorReporting.h"
+#ifdef __unix__
+#include "USBEventLoop.h"
+#endif
 #include <cstring>
 #include <iostream>
 
@@ -20,9 +23,6 @@ using namespace lime;
 
 Connection_uLimeSDR::Connection_uLimeSDR(void *arg)
 {
-    RxLoopFunction = bind(&Connection_uLimeSDR::ReceivePacketsLoop, this, std::placeholders::_1);
-    TxLoopFunction = bind(&Connection_uLimeSDR::TransmitPacketsLoop, this, std::placeholders::_1);
-
     isConnected = false;
 
     mStreamWrEndPtAddr = 0x03;
@@ -44,8 +44,6 @@ Connection_uLimeSDR::Connection_uLimeSDR(void *arg)
 */
 Connection_uLimeSDR::Connection_uLimeSDR(void *arg, const unsigned index, const int vid, const int pid)
 {
-    RxLoopFunction = bind(&Connection_uLimeSDR::ReceivePacketsLoop, this, std::placeholders::_1);
-    TxLoopFunction = bind(&Connection_uLimeSDR::TransmitPacketsLoop, this, std::placeholders::_1);
     mExpectedSampleRate = 0;
     isConnected = false;
 
@@ -167,6 +165,7 @@ int Connection_uLimeSDR::Open(const unsigned index, const int vid, const int pid
 
     if(dev_handle == nullptr)
         return ReportError(ENODEV, "libusb_open failed");
+    USBEventLoop::AddDevice();
     libusb_reset_device(dev_handle);
     if(libusb_kernel_driver_active(dev_handle, 1) == 1)   //find out if kernel driver is attached
     {
@@ -209,6 +208,7 @@ void Connection_uLimeSDR::Close()
         libusb_release_interface(dev_handle, 1);
         libusb_close(dev_handle);
         dev_handle = 0;
+        USBEventLoop::RemoveDevice();
     }
 #endif
     isConnected = false;
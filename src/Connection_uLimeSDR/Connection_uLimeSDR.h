@@ -95,8 +95,8 @@ public:
     virtual int UpdateExternalDataRate(const size_t channel, const double txRate, const double rxRate) override;
     int ReadRawStreamData(char* buffer, unsigned length, int epIndex, int timeout_ms = 100)override;
 protected:
-    virtual void ReceivePacketsLoop(Streamer* args) override;
-    virtual void TransmitPacketsLoop(Streamer* args) override;
+    class FTStreamTransport;
+    StreamTransport* OpenStreamTransport(Streamer* stream, const bool isTx, TransportConfig& config) override;
 
     virtual int BeginDataReading(char* buffer, uint32_t length);
     virtual int WaitForReading(int contextHandle, unsigned int timeout_ms);
@@ -152,10 +152,7 @@ private:
 #ifndef __unix__
     FT_HANDLE* mFTHandle;
 #else
-    libusb_context *ctx; //a libusb session
-    std::thread mUSBProcessingThread;
-    void handle_libusb_events();
-    std::atomic<bool> mProcessUSBEvents;
+    libusb_context *ctx; //shared libusb session
 #endif
 };
 
@@ -5,21 +5,10 @@
 */
 
 #include "Connection_uLimeSDR.h"
-using namespace lime;
-
 #ifdef __unix__
-void Connection_uLimeSDREntry::handle_libusb_events()
-{
-    struct timeval tv;
-    tv.tv_sec = 0;
-    tv.tv_usec = 250000;
-    while(mProcessUSBEvents.load() == true)
-    {
-        int r = libusb_handle_events_timeout_completed(ctx, &tv, NULL);
-        if(r != 0) printf("error libusb_handle_events %s\n", libusb_strerror(libusb_error(r)));
-    }
-}
-#endif // __UNIX__
+#include "USBEventLoop.h"
+#endif
+using namespace lime;
 
 int Connection_uLimeSDR::USBTransferContext::idCounter=0;
 
@@ -35,12 +24,7 @@ Connection_uLimeSDREntry::Connection_uLimeSDREntry(void):
 #ifndef __unix__
     //m_pDriver = new CDriverInterface();
 #else
-    int r = libusb_init(&ctx); //initialize the library for the session we just declared
-    if(r < 0)
-        printf("Init Error %i\n", r); //there was an error
-    libusb_set_debug(ctx, 3); //set verbosity level to 3, as suggested in the documentation
-    mProcessUSBEvents.store(true);
-    mUSBProcessingThread = std::thread(&Connection_uLimeSDREntry::handle_libusb_events, this);
+    ctx = USBEventLoop::AcquireContext();
 #endif
 }
 
@@ -49,9 +33,7 @@ Connection_uLimeSDREntry::~Connection_uLimeSDREntry(void)
 #ifndef __unix__
     //delete m_pDriver;
 #else
-    mProcessUSBEvents.store(false);
-    mUSBProcessingThread.join();
-    libusb_exit(ctx);
+    USBEventLoop::ReleaseContext();
 #endif
 }
 
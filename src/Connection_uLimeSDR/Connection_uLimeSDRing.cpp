@@ -14,6 +14,7 @@
 #include <complex>
 #include <ciso646>
 #include <vector>
+#include <deque>
 #include <FPGA_common.h>
 #include "ErrorReporting.h"
 
@@ -226,350 +227,80 @@ int Connection_uLimeSDR::ResetStreamBuffers()
     return 0;
 }
 
-/** @brief Function dedicated for receiving data samples from board
-    @param rxFIFO FIFO to store received data
-    @param terminate periodically pooled flag to terminate thread
-    @param dataRate_Bps (optional) if not NULL periodically returns data rate in bytes per second
+/** @brief Streaming transport over FT601 pipe transfers,
+    transfers finish in order of submission
 */
-void Connection_uLimeSDR::ReceivePacketsLoop(Connection_uLimeSDR::Streamer* stream)
+class Connection_uLimeSDR::FTStreamTransport : public StreamTransport
 {
-    //at this point FPGA has to be already configured to output samples
-    const uint8_t chCount = stream->mRxStreams.size();
-    const auto link =stream->mRxStreams[0]->config.linkFormat;
-    const uint32_t samplesInPacket = (link == StreamConfig::STREAM_12_BIT_COMPRESSED ? 1360 : 1020)/chCount;
-    const int chipID = stream->mChipID;
-
-    double latency=0;
-    for (int i = 0; i < chCount; i++)
+public:
+    FTStreamTransport(Connection_uLimeSDR* port, const bool isTx) :
+        mPort(port),
+        mIsTx(isTx)
     {
-        latency += stream->mRxStreams[i]->config.performanceLatency/chCount;
     }
-    const unsigned tmp_cnt = (latency * 4)+0.5;
 
-    const uint8_t packetsToBatch = (1<<tmp_cnt);
-    const uint32_t bufferSize = packetsToBatch*sizeof(FPGA_DataPacket);
-    const uint8_t buffersCount = 16; // must be power of 2
-    vector<int> handles(buffersCount, 0);
-    vector<char>buffers(buffersCount*bufferSize, 0);
-    vector<StreamChannel::Frame> chFrames;
-    try
-    {
-        chFrames.resize(chCount);
-    }
-    catch (const std::bad_alloc &ex)
+    int Submit(char* buffer, const uint32_t length) override
     {
-        ReportError("Error allocating Rx buffers, not enough memory");
-        return;
+        const int handle = mIsTx ? mPort->BeginDataSending(buffer, length) : mPort->BeginDataReading(buffer, length);
+        if (handle < 0)
+            return -1;
+        Transfer transfer = {handle, buffer, length};
+        mTransfers.push_back(transfer);
+        return 0;
     }
 
-    uint8_t activeTransfers = 0;
-    for (int i = 0; i<buffersCount; ++i)
+    int Reap(char** buffer, const unsigned timeout_ms) override
     {
-        handles[i] = this->BeginDataReading(&buffers[i*bufferSize], bufferSize);
-        ++activeTransfers;
+        if (mTransfers.empty())
+            return REAP_TIMEOUT;
+        const Transfer& transfer = mTransfers.front();
+        const bool done = mIsTx ? mPort->WaitForSending(transfer.handle, timeout_ms) : mPort->WaitForReading(transfer.handle, timeout_ms);
+        if (!done)
+            return REAP_TIMEOUT;
+        *buffer = transfer.buffer;
+        const int bytes = mIsTx ? mPort->FinishDataSending(transfer.buffer, transfer.length, transfer.handle)
+                                : mPort->FinishDataReading(transfer.buffer, transfer.length, transfer.handle);
+        mTransfers.pop_front();
+        return bytes;
     }
 
-    int bi = 0;
-    unsigned long totalBytesReceived = 0; //for data rate calculation
-    int m_bufferFailures = 0;
-    int32_t droppedSamples = 0;
-    int32_t packetLoss = 0;
-
-    vector<uint32_t> samplesCollected(chCount, 0);
-    vector<uint32_t> samplesReceived(chCount, 0);
-
-    auto t1 = chrono::high_resolution_clock::now();
-    auto t2 = chrono::high_resolution_clock::now();
-
-    std::mutex txFlagsLock;
-    condition_variable resetTxFlags;
-    //worker thread for reseting late Tx packet flags
-    std::thread txReset([](ILimeSDRStreaming* port,
-                        atomic<bool> *terminate,
-                        mutex *spiLock,
-                        condition_variable *doWork)
+    void Cancel(void) override
     {
-        uint32_t reg9;
-        port->ReadRegister(0x0009, reg9);
-        const uint32_t addr[] = {0x0009, 0x0009};
-        const uint32_t data[] = {reg9 | (1 << 1), reg9 & ~(1 << 1)};
-        while (not terminate->load())
-        {
-            std::unique_lock<std::mutex> lck(*spiLock);
-            doWork->wait(lck);
-            port->WriteRegisters(addr, data, 2);
-        }
-    }, this, &stream->terminateRx, &txFlagsLock, &resetTxFlags);
-
-    int resetFlagsDelay = 128;
-    uint64_t prevTs = 0;
-    while (stream->terminateRx.load() == false)
-    {
-        if(stream->generateData.load())
-        {
-            if(activeTransfers == 0) //stop FPGA when last transfer completes
-                fpga::StopStreaming(this, chipID);
-            stream->safeToConfigInterface.notify_all(); //notify that it's safe to change chip config
-            const int batchSize = (this->mExpectedSampleRate/chFrames[0].samplesCount)/10;
-            IStreamChannel::Metadata meta;
-            for(int i=0; i<batchSize; ++i)
-            {
-                for(int ch=0; ch<chCount; ++ch)
-                {
-                    meta.timestamp = chFrames[ch].timestamp;
-                    for(int j=0; j<chFrames[ch].samplesCount; ++j)
-                    {
-                        chFrames[ch].samples[j].i = 0;
-                        chFrames[ch].samples[j].q = 0;
-                    }
-                    uint32_t samplesPushed = stream->mRxStreams[ch]->Write((const void*)chFrames[ch].samples, chFrames[ch].samplesCount, &meta);
-                    samplesReceived[ch] += chFrames[ch].samplesCount;
-                    if(samplesPushed != chFrames[ch].samplesCount)
-                        printf("Rx samples pushed %i/%i\n", samplesPushed, chFrames[ch].samplesCount);
-                }
-            }
-            this_thread::sleep_for(chrono::milliseconds(100));
-        }
-        int32_t bytesReceived = 0;
-        if(handles[bi] >= 0)
-        {
-            if (this->WaitForReading(handles[bi], 1000) == false)
-                ++m_bufferFailures;
-            bytesReceived = this->FinishDataReading(&buffers[bi*bufferSize], bufferSize, handles[bi]);
-            --activeTransfers;
-            totalBytesReceived += bytesReceived;
-            if (bytesReceived != int32_t(bufferSize)) //data should come in full sized packets
-                ++m_bufferFailures;
-        }
-        bool txLate=false;
-        for (uint8_t pktIndex = 0; pktIndex < bytesReceived / sizeof(FPGA_DataPacket); ++pktIndex)
-        {
-            const FPGA_DataPacket* pkt = (FPGA_DataPacket*)&buffers[bi*bufferSize];
-            const uint8_t byte0 = pkt[pktIndex].reserved[0];
-            if ((byte0 & (1 << 3)) != 0 && !txLate) //report only once per batch
-            {
-                txLate = true;
-                if(resetFlagsDelay > 0)
-                    --resetFlagsDelay;
-                else
-                {
-                    printf("L");
-                    resetTxFlags.notify_one();
-                    resetFlagsDelay = packetsToBatch*buffersCount;
-                    stream->txLastLateTime.store(pkt[pktIndex].counter);
-                }
-            }
-            uint8_t* pktStart = (uint8_t*)pkt[pktIndex].data;
-            if(pkt[pktIndex].counter - prevTs != samplesInPacket && pkt[pktIndex].counter != prevTs)
-            {
-#ifndef NDEBUG
-                printf("\tRx pktLoss ts diff %lli\n", (long long)pkt[pktIndex].counter - prevTs);
-#endif
-                packetLoss += (pkt[pktIndex].counter - prevTs)/samplesInPacket;
-            }
-            prevTs = pkt[pktIndex].counter;
-            stream->rxLastTimestamp.store(pkt[pktIndex].counter);
-            //parse samples
-            vector<complex16_t*> dest(chCount);
-            for(uint8_t c=0; c<chCount; ++c)
-                dest[c] = (chFrames[c].samples);
-            size_t samplesCount = 0;
-            fpga::FPGAPacketPayload2Samples(pktStart, 4080, chCount, link, dest.data(), &samplesCount);
-
-            for(int ch=0; ch<chCount; ++ch)
-            {
-                IStreamChannel::Metadata meta;
-                meta.timestamp = pkt[pktIndex].counter;
-                meta.flags = RingFIFO::OVERWRITE_OLD;
-                uint32_t samplesPushed = stream->mRxStreams[ch]->Write((const void*)chFrames[ch].samples, samplesCount, &meta, 100);
-                if(samplesPushed != samplesCount)
-                    droppedSamples += samplesCount-samplesPushed;
-            }
-        }
-        // Re-submit this request to keep the queue full
-        if(not stream->generateData.load())
-        {
-            if(activeTransfers == 0) //reactivate FPGA and USB transfers
-                fpga::StartStreaming(this, chipID);
-            for(int i=0; i<buffersCount-activeTransfers; ++i)
-            {
-                handles[bi] = this->BeginDataReading(&buffers[bi*bufferSize], bufferSize);
-                bi = (bi + 1) & (buffersCount-1);
-                ++activeTransfers;
-            }
-        }
+        if (mIsTx)
+            mPort->AbortSending();
         else
-        {
-            handles[bi] = -1;
-            bi = (bi + 1) & (buffersCount-1);
-        }
-        t2 = chrono::high_resolution_clock::now();
-        auto timePeriod = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
-        if (timePeriod >= 1000)
-        {
-            t1 = t2;
-            //total number of bytes sent per second
-            double dataRate = 1000.0*totalBytesReceived / timePeriod;
-#ifndef NDEBUG
-            //each channel sample rate
-            float samplingRate = 1000.0*samplesReceived[0] / timePeriod;
-            printf("Rx: %.3f MB/s, Fs: %.3f MHz, overrun: %i, loss: %i \n", dataRate / 1000000.0, samplingRate / 1000000.0, droppedSamples, packetLoss);
-#endif
-            samplesReceived[0] = 0;
-            totalBytesReceived = 0;
-            m_bufferFailures = 0;
-            droppedSamples = 0;
-            packetLoss = 0;
-            stream->rxDataRate_Bps.store((uint32_t)dataRate);
-        }
-    }
-    this->AbortReading();
-    for (int j = 0; j<buffersCount; j++)
-    {
-        if(handles[bi] >= 0)
-        {
-            this->WaitForReading(handles[bi], 1000);
-            this->FinishDataReading(&buffers[bi*bufferSize], bufferSize, handles[bi]);
-        }
-        bi = (bi + 1) & (buffersCount-1);
+            mPort->AbortReading();
     }
-    resetTxFlags.notify_one();
-    txReset.join();
-    stream->rxDataRate_Bps.store(0);
-}
 
-/** @brief Functions dedicated for transmitting packets to board
-    @param txFIFO data source FIFO
-    @param terminate periodically pooled flag to terminate thread
-    @param dataRate_Bps (optional) if not NULL periodically returns data rate in bytes per second
+private:
+    struct Transfer
+    {
+        int handle;
+        char* buffer;
+        uint32_t length;
+    };
+    Connection_uLimeSDR* mPort;
+    const bool mIsTx;
+    std::deque<Transfer> mTransfers; //in order of submission
+};
+
+/** @brief Creates FT601 transport for streaming data of the chip,
+    transfer size follows requested stream latency
 */
-void Connection_uLimeSDR::TransmitPacketsLoop(Streamer* stream)
+StreamTransport* Connection_uLimeSDR::OpenStreamTransport(Streamer* stream, const bool isTx, TransportConfig& config)
 {
-    //at this point FPGA has to be already configured to output samples
-    const uint8_t maxChannelCount = 2;
-    const uint8_t chCount = stream->mTxStreams.size();
-    const auto link = stream->mTxStreams[0]->config.linkFormat;
-
+    const Streamer::ChannelLayout& layout = isTx ? stream->txLayout : stream->rxLayout;
     double latency=0;
-    for (int i = 0; i < chCount; i++)
-    {
-        latency += stream->mTxStreams[i]->config.performanceLatency/chCount;
-    }
-    const unsigned tmp_cnt = (latency * 4)+0.5;
-
-    const uint8_t buffersCount = 16; // must be power of 2
-    assert(buffersCount % 2 == 0);
-    const uint8_t packetsToBatch = (1<<tmp_cnt); //packets in single USB transfer
-    const uint32_t bufferSize = packetsToBatch*4096;
-    const uint32_t popTimeout_ms = 100;
-
-    const int maxSamplesBatch = (link==StreamConfig::STREAM_12_BIT_COMPRESSED?1360:1020)/chCount;
-    vector<int> handles(buffersCount, 0);
-    vector<bool> bufferUsed(buffersCount, 0);
-    vector<uint32_t> bytesToSend(buffersCount, 0);
-    vector<complex16_t> samples[maxChannelCount];
-    vector<char> buffers;
-    try
-    {
-        for(int i=0; i<chCount; ++i)
-            samples[i].resize(maxSamplesBatch);
-        buffers.resize(buffersCount*bufferSize, 0);
-    }
-    catch (const std::bad_alloc& ex) //not enough memory for buffers
-    {
-        printf("Error allocating Tx buffers, not enough memory\n");
-        return;
-    }
-
-    int m_bufferFailures = 0;
-    long totalBytesSent = 0;
-
-    uint32_t samplesSent = 0;
-
-    auto t1 = chrono::high_resolution_clock::now();
-    auto t2 = chrono::high_resolution_clock::now();
-
-    uint8_t bi = 0; //buffer index
-    while (stream->terminateTx.load() != true)
-    {
-        if (bufferUsed[bi])
+    int latencyCount = 0;
+    for (int i = 0; i < layout.chCount; i++)
+        if (layout.streams[i])
         {
-            if (this->WaitForSending(handles[bi], 1000) == false)
-                ++m_bufferFailures;
-            uint32_t bytesSent = this->FinishDataSending(&buffers[bi*bufferSize], bytesToSend[bi], handles[bi]);
-            totalBytesSent += bytesSent;
-            if (bytesSent != bytesToSend[bi])
-                ++m_bufferFailures;
-            bufferUsed[bi] = false;
+            latency += layout.streams[i]->config.performanceLatency;
+            ++latencyCount;
         }
-        int i=0;
-
-        while(i<packetsToBatch && stream->terminateTx.load() != true)
-        {
-            IStreamChannel::Metadata meta;
-            FPGA_DataPacket* pkt = reinterpret_cast<FPGA_DataPacket*>(&buffers[bi*bufferSize]);
-            for(int ch=0; ch<chCount; ++ch)
-            {
-                int samplesPopped = stream->mTxStreams[ch]->Read(samples[ch].data(), maxSamplesBatch, &meta, popTimeout_ms);
-                if (samplesPopped != maxSamplesBatch)
-                {
-                #ifndef NDEBUG
-                    printf("Warning popping from TX, samples popped %i/%i\n", samplesPopped, maxSamplesBatch);
-                #endif
-                }
-
-            }
-            if(stream->terminateTx.load() == true) //early termination
-                break;
-            pkt[i].counter = meta.timestamp;
-            pkt[i].reserved[0] = 0;
-            //by default ignore timestamps
-            const int ignoreTimestamp = !(meta.flags & IStreamChannel::Metadata::SYNC_TIMESTAMP);
-            pkt[i].reserved[0] |= ((int)ignoreTimestamp << 4); //ignore timestamp
-
-            vector<complex16_t*> src(chCount);
-            for(uint8_t c=0; c<chCount; ++c)
-                src[c] = (samples[c].data());
-            uint8_t* const dataStart = (uint8_t*)pkt[i].data;
-            fpga::Samples2FPGAPacketPayload(src.data(), maxSamplesBatch, chCount, link, dataStart, nullptr);
-            samplesSent += maxSamplesBatch;
-            ++i;
-        }
-
-        bytesToSend[bi] = bufferSize;
-        handles[bi] = this->BeginDataSending(&buffers[bi*bufferSize], bytesToSend[bi]);
-        bufferUsed[bi] = true;
-
-        t2 = chrono::high_resolution_clock::now();
-        auto timePeriod = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
-        if (timePeriod >= 1000)
-        {
-            //total number of bytes sent per second
-            float dataRate = 1000.0*totalBytesSent / timePeriod;
-            stream->txDataRate_Bps.store(dataRate);
-            m_bufferFailures = 0;
-            samplesSent = 0;
-            totalBytesSent = 0;
-            t1 = t2;
-#ifndef NDEBUG
-            //total number of samples from all channels per second
-            float sampleRate = 1000.0*samplesSent / timePeriod;
-            printf("Tx: %.3f MB/s, Fs: %.3f MHz, failures: %i\n", dataRate / 1000000.0, sampleRate / 1000000.0, m_bufferFailures);
-#endif
-        }
-        bi = (bi + 1) & (buffersCount-1);
-    }
-
-    // Wait for all the queued requests to be cancelled
-    this->AbortSending();
-    for (int j = 0; j<buffersCount; j++)
-    {
-        if (bufferUsed[bi])
-        {
-            this->WaitForSending(handles[bi], 1000);
-            this->FinishDataSending(&buffers[bi*bufferSize], bufferSize, handles[bi]);
-        }
-        bi = (bi + 1) & (buffersCount-1);
-    }
-    stream->txDataRate_Bps.store(0);
+    if (latencyCount > 0)
+        latency /= latencyCount;
+    const unsigned tmp_cnt = (latency * 4)+0.5;
+    config.packetsPerTransfer = (1<<tmp_cnt);
+    return new FTStreamTransport(this, isTx);
 }
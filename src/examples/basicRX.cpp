@@ -73,7 +73,7 @@ int main(int argc, char** argv)
     //Streaming Setup
 
     //Initialize stream
-    lms_stream_t streamId; //stream structure
+    lms_stream_t streamId = {}; //stream structure
     streamId.channel = 0; //channel number
     streamId.fifoSize = 1024 * 1024; //fifo size in samples
     streamId.throughputVsLatency = 1.0; //optimize for max throughput
@@ -109,8 +109,8 @@ int main(int argc, char** argv)
     //Streaming Setup
 
     const int chCount = 2; //number of RX/TX steams
-    lms_stream_t rx_streams[chCount];
-    lms_stream_t tx_streams[chCount];
+    lms_stream_t rx_streams[chCount] = {};
+    lms_stream_t tx_streams[chCount] = {};
     //Initialize streams
     //All streams setups should be done before starting streams. New streams cannot be set-up if at least stream is running.
     for (int i = 0; i < chCount; ++i)
@@ -148,11 +148,11 @@ int main(int argc, char** argv)
 
     //Streaming
 
-    lms_stream_meta_t rx_metadata; //Use metadata for additional control over sample receive function behaviour
+    lms_stream_meta_t rx_metadata = {}; //Use metadata for additional control over sample receive function behaviour
     rx_metadata.flushPartialPacket = false; //Do not discard data remainder when read size differs from packet size
     rx_metadata.waitForTimestamp = false; //Do not wait for specific timestamps
 
-    lms_stream_meta_t tx_metadata; //Use metadata for additional control over sample send function behaviour
+    lms_stream_meta_t tx_metadata = {}; //Use metadata for additional control over sample send function behaviour
     tx_metadata.flushPartialPacket = false; //Do not discard data remainder when read size differs from packet size
     tx_metadata.waitForTimestamp = true; //Enable synchronization to HW timestamp
 
@@ -148,7 +148,7 @@ int main(int argc, char** argv)
     //Streaming Setup
 
     //Initialize stream
-    lms_stream_t streamId;
+    lms_stream_t streamId = {};
     streamId.channel = 0; //channel number
     streamId.fifoSize = 1024 * 128; //fifo size in samples
     streamId.throughputVsLatency = 1.0; //optimize for max throughput
@@ -165,7 +165,7 @@ int main(int argc, char** argv)
 
     //Streaming
 
-    lms_stream_meta_t metadata; //Use metadata for additional control over sample receive function behaviour
+    lms_stream_meta_t metadata = {}; //Use metadata for additional control over sample receive function behaviour
     metadata.flushPartialPacket = false; //Do not discard data remainder when read size differs from packet size
     metadata.waitForTimestamp = false; //Do not wait for specific timestamps
 
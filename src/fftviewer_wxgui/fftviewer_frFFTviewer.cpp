@@ -391,8 +391,10 @@ void fftviewer_frFFTviewer::StreamingLoop(fftviewer_frFFTviewer* pthis, const un
     wxPostEvent(pthis->GetParent(), evt);
 
     pthis->mStreamRunning.store(true);
-    lms_stream_meta_t meta;
-    meta.waitForTimestamp = true;
+    lms_stream_meta_t rxMeta = {};
+    rxMeta.waitForTimestamp = false;
+    lms_stream_meta_t txMeta = {};
+    txMeta.waitForTimestamp = true;
     int fftCounter = 0;
 
     while (pthis->stopProcessing.load() == false)
@@ -403,15 +405,14 @@ void fftviewer_frFFTviewer::StreamingLoop(fftviewer_frFFTviewer* pthis, const un
             uint64_t ts[cMaxChCount];
             for(int i=0; i<channelsCount; ++i)
             {
-                samplesPopped[i] = LMS_RecvStream(&pthis->rxStreams[i], &buffers[i][0], fftSize, &meta, 1000);
-                ts[i] = meta.timestamp + fifoSize/4;
+                samplesPopped[i] = LMS_RecvStream(&pthis->rxStreams[i], &buffers[i][0], fftSize, &rxMeta, 1000);
+                ts[i] = rxMeta.timestamp + fifoSize/4;
             }
 
             for(int i=0; runTx && i<channelsCount; ++i)
             {
-                meta.timestamp = ts[i];
-                meta.waitForTimestamp = true;
-                LMS_SendStream(&pthis->txStreams[i], &buffers[i][0], samplesPopped[i], &meta, 1000);
+                txMeta.timestamp = ts[i];
+                LMS_SendStream(&pthis->txStreams[i], &buffers[i][0], samplesPopped[i], &txMeta, 1000);
             }
 
             if(pthis->captureSamples.load())
@@ -87,8 +87,8 @@ protected:
     std::thread threadProcessing;
     wxString printDataRate(float dataRate);
 
-    lms_stream_t rxStreams[cMaxChCount];
-    lms_stream_t txStreams[cMaxChCount];
+    lms_stream_t rxStreams[cMaxChCount] = {};
+    lms_stream_t txStreams[cMaxChCount] = {};
 
     lms_device_t* lmsControl;
     wxTimer* mGUIupdater;
@@ -1007,18 +1007,36 @@ typedef struct
     /**In TX: wait for the specified HW timestamp before broadcasting data over
      * the air
      * In RX: wait for the specified HW timestamp before starting to receive
-     * samples
+     * samples. Samples received before the timestamp are dropped.
      */
     bool waitForTimestamp;
 
-    /**Indicates the end of send/receive transaction. Currently has no effect
-     * @todo force send samples to HW (ignore transfer size) when selected
+    /**Indicates the end of send/receive transaction.
+     * In TX: samples are sent without waiting to fill a whole packet,
+     * remainder of the packet is filled with zeros
+     * In RX: used with waitForTimestamp, receive burst of sample_count samples
+     * starting at the specified timestamp, stream is paused after the burst
+     * until the next timed receive request
      */
     bool flushPartialPacket;
 
+    /**In RX: set when the returned samples do not continue previously
+     * returned ones, because samples were lost or the first returned samples
+     * were inserted in place of them (see lms_stream_t::gapFillLimit).
+     * Reads stop before discontinuities only when gapFillLimit is set,
+     * otherwise the flag applies to any of the returned samples.
+     * Not used in TX.
+     */
+    bool discontinuity;
+
 }lms_stream_meta_t;
 
-/**Stream structure*/
+/**Stream structure
+ *
+ * Zero the whole structure (e.g. `lms_stream_t stream = {};`) before setting
+ * the fields used by LMS_SetupStream(); fields left at 0 keep the default
+ * behaviour of earlier releases.
+ */
 typedef struct
 {
     /**
@@ -1048,8 +1066,38 @@ typedef struct
     {
         LMS_FMT_F32=0,    ///<32-bit floating point
         LMS_FMT_I16,      ///<16-bit integers
-        LMS_FMT_I12       ///<12-bit integers stored in 16-bit variables
+        LMS_FMT_I12,      ///<12-bit integers stored in 16-bit variables
+        LMS_FMT_I12_PACKED, ///<12-bit integers packed, 3 bytes per complex sample
+        LMS_FMT_I8        ///<8 most significant bits of 12-bit samples
     }dataFmt;
+
+    /**
+     * RX only: compute signal statistics while parsing received packets,
+     * see LMS_GetSignalStats().
+     */
+    bool signalStats;
+
+    /**
+     * RX only: maximum number of samples inserted in place of each gap
+     * caused by packets lost on the link, 0 to not insert samples.
+     * When set, reads stop before each discontinuity.
+     */
+    uint32_t gapFillLimit;
+
+    /**
+     * RX only: handling of received samples when FIFO is full, counted
+     * separately in ::lms_stream_metrics_t.
+     */
+    enum
+    {
+        LMS_OVERFLOW_DROP_OLDEST=0, ///<overwrite the oldest samples
+        LMS_OVERFLOW_DROP_NEWEST,   ///<drop received samples
+        LMS_OVERFLOW_BLOCK,         ///<wait up to overflowTimeout_ms for free space, stalls all RX channels
+        LMS_OVERFLOW_DECIMATE       ///<skip every other packet while FIFO is over 3/4 full
+    }overflowPolicy;
+
+    ///RX only: maximum wait of LMS_OVERFLOW_BLOCK policy in milliseconds
+    uint32_t overflowTimeout_ms;
 }lms_stream_t;
 
 /**Streaming status structure*/
@@ -1076,6 +1124,155 @@ typedef struct
 
 } lms_stream_status_t;
 
+///Number of bins in ::lms_stream_metrics_t transfer interval histogram
+#define LMS_METRICS_HISTOGRAM_BINS 16
+
+/**Stream performance metrics, accumulated since stream start*/
+typedef struct
+{
+    ///Size of FIFO buffer in samples
+    uint32_t fifoSize;
+    ///Maximum number of samples held in FIFO buffer
+    uint32_t fifoHighWatermark;
+    ///Number of data packets transferred over the link
+    uint64_t packetsTransferred;
+    ///Number of bytes transferred over the link
+    uint64_t bytesTransferred;
+    ///Intervals between link transfers, bin N counts [2^N, 2^(N+1)) us
+    uint32_t transferIntervals[LMS_METRICS_HISTOGRAM_BINS];
+    ///Average time to parse (RX) or encode (TX) one data packet
+    uint32_t packetTimeAvg_ns;
+    ///Maximum time to parse (RX) or encode (TX) one data packet
+    uint32_t packetTimeMax_ns;
+    ///Minimum TX packet timestamp lead over hardware time, in samples
+    int64_t txLeadTimeMin;
+    ///Average TX packet timestamp lead over hardware time, in samples
+    int64_t txLeadTimeAvg;
+    ///Number of TX packets the lead time was measured for
+    uint32_t txLeadTimeCount;
+    ///RX samples lost because FIFO was full
+    uint64_t overflowSamples;
+    ///RX samples overwritten by LMS_OVERFLOW_DROP_OLDEST policy
+    uint64_t overflowOldestSamples;
+    ///RX samples dropped because FIFO stayed full
+    uint64_t overflowNewestSamples;
+    ///RX samples of packets skipped by LMS_OVERFLOW_DECIMATE policy
+    uint64_t overflowDecimatedSamples;
+    ///Number of waits for free FIFO space by LMS_OVERFLOW_BLOCK policy
+    uint32_t overflowBlocks;
+    ///Total time of LMS_OVERFLOW_BLOCK waits in microseconds
+    uint64_t overflowBlockTime_us;
+    ///Samples of packets lost on the link
+    uint64_t linkLossSamples;
+    ///TX samples dropped for being late
+    uint64_t lateSamples;
+    ///Zero samples sent because TX ran out of samples
+    uint64_t underflowSamples;
+} lms_stream_metrics_t;
+
+/**Signal statistics of received samples, values are normalized to full scale*/
+typedef struct
+{
+    ///Number of samples statistics are computed from
+    uint32_t samplesCount;
+    ///Number of samples with I or Q at full scale
+    uint32_t clipCount;
+    ///Maximum absolute value of I or Q
+    float_type peak;
+    ///Mean of I*I+Q*Q
+    float_type meanPower;
+    ///Mean of I
+    float_type dcI;
+    ///Mean of Q
+    float_type dcQ;
+} lms_signal_stats_t;
+
+/**Triggered capture configuration, see LMS_ArmCapture()*/
+typedef struct
+{
+    ///Trigger condition
+    enum
+    {
+        LMS_TRIGGER_SOFTWARE=0, ///<only LMS_TriggerCapture() calls
+        LMS_TRIGGER_LEVEL,      ///<absolute value of I or Q reaches level
+        LMS_TRIGGER_TIMESTAMP   ///<sample with given timestamp is received
+    }trigger;
+    ///Number of samples kept before the trigger sample
+    uint32_t preTriggerSamples;
+    ///Number of samples collected from the trigger sample
+    uint32_t postTriggerSamples;
+    ///Threshold for LMS_TRIGGER_LEVEL, normalized to full scale
+    float_type level;
+    ///Timestamp of the trigger sample for LMS_TRIGGER_TIMESTAMP
+    uint64_t timestamp;
+} lms_capture_t;
+
+/**Spectrum monitor configuration, see LMS_StartSpectrumMonitor()*/
+typedef struct
+{
+    ///Number of FFT bins
+    uint32_t fftSize;
+    ///Window function
+    enum
+    {
+        LMS_WINDOW_RECTANGULAR=0,
+        LMS_WINDOW_BLACKMAN_HARRIS,
+        LMS_WINDOW_HAMMING,
+        LMS_WINDOW_HANNING
+    }window;
+    ///Fraction of FFT samples shared by consecutive FFTs, [0, 1)
+    float_type overlap;
+    ///Number of FFTs per spectrum frame
+    uint32_t averageCount;
+    ///Averaging of FFT power
+    enum
+    {
+        LMS_AVERAGE_LINEAR=0,  ///<mean of FFTs in each frame
+        LMS_AVERAGE_EXPONENTIAL, ///<running average across frames
+        LMS_AVERAGE_MAX_HOLD   ///<maximum since monitor was started
+    }averaging;
+    ///Weight of each new FFT for LMS_AVERAGE_EXPONENTIAL, (0, 1]
+    float_type expWeight;
+    ///Maximum number of spectrum frames per second, 0 for unlimited
+    float_type frameRate;
+} lms_spectrum_t;
+
+/**Frequency sweep configuration, see LMS_StartSweep()*/
+typedef struct
+{
+    ///RF frequency of the first step in Hz, not lower than 30 MHz
+    float_type startFrequency;
+    ///RF frequency of the last step in Hz
+    float_type stopFrequency;
+    ///Frequency increment between steps in Hz
+    float_type stepFrequency;
+    ///Synthesizer settling time after each retune in seconds, samples
+    ///received during settling are not transferred
+    float_type settlingTime;
+    ///Number of samples received for each step when spectrum is not computed
+    uint32_t samplesPerStep;
+    ///Return averaged power spectrum of each step instead of samples
+    bool computeSpectrum;
+    ///Spectrum of each step, frameRate is not used
+    lms_spectrum_t spectrum;
+} lms_sweep_t;
+
+/**Tag of sweep step, see LMS_RecvSweepStep()*/
+typedef struct
+{
+    ///Index of the step in frequency plan
+    uint32_t step;
+    ///RF frequency of the step in Hz
+    float_type frequency;
+    ///Timestamp of the first sample of the step
+    uint64_t timestamp;
+    ///Samples of the step were lost on the link
+    bool discontinuity;
+} lms_sweep_meta_t;
+
+/**Sweep state handle, created by LMS_StartSweep()*/
+typedef void lms_sweep_handle_t;
+
 /**
  * Create new stream based on parameters passed in configuration structure.
  * The structure is initialized with stream handle.
@@ -1140,6 +1337,164 @@ API_EXPORT int CALL_CONV LMS_StopStream(lms_stream_t *stream);
  */
 API_EXPORT int CALL_CONV LMS_GetStreamStatus(lms_stream_t *stream, lms_stream_status_t* status);
 
+/**
+ * Get stream performance metrics accumulated since stream start
+ *
+ * @param stream    structure previously initialized with LMS_SetupStream().
+ * @param metrics   Stream metrics. See the ::lms_stream_metrics_t for description
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_GetStreamMetrics(lms_stream_t *stream, lms_stream_metrics_t* metrics);
+
+/**
+ * Get signal statistics of samples returned by the last LMS_RecvStream().
+ * Statistics are computed while packets are received, when the stream
+ * was set up with lms_stream_t::signalStats enabled. They cover the FIFO
+ * packets whose last sample was returned by LMS_RecvStream().
+ *
+ * @param stream    structure previously initialized with LMS_SetupStream().
+ * @param stats     Signal statistics. See the ::lms_signal_stats_t for description
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_GetSignalStats(lms_stream_t *stream, lms_signal_stats_t* stats);
+
+/**
+ * Start triggered capture on RX stream. While capture is armed, received
+ * samples are kept in a rolling pre-trigger window in the library instead
+ * of being delivered to LMS_RecvStream(). Arming again restarts the capture.
+ *
+ * @param stream    structure previously initialized with LMS_SetupStream().
+ * @param capture   Trigger condition and capture size. See the ::lms_capture_t description.
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_ArmCapture(lms_stream_t *stream, const lms_capture_t *capture);
+
+/**
+ * Trigger armed capture at the next received sample,
+ * regardless of the configured trigger condition.
+ *
+ * @param stream    structure previously initialized with LMS_SetupStream().
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_TriggerCapture(lms_stream_t *stream);
+
+/**
+ * Wait for triggered capture to complete and read pre-trigger and
+ * post-trigger samples as one contiguous block. The block is shorter than
+ * requested if capture was triggered before the pre-trigger window filled
+ * or samples were lost before the trigger.
+ *
+ * @param stream            structure previously initialized with LMS_SetupStream().
+ * @param samples           sample buffer.
+ * @param sample_count      maximum number of samples to read.
+ * @param meta              Metadata, timestamp of the first sample and
+ *                          discontinuity if samples were lost after trigger.
+ * @param triggerTimestamp  timestamp of the trigger sample, can be NULL.
+ * @param timeout_ms        how long to wait for capture to complete.
+ *
+ * @return number of samples received, 0 on timeout, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_RecvCapture(lms_stream_t *stream, void *samples, size_t sample_count, lms_stream_meta_t *meta, uint64_t *triggerTimestamp, unsigned timeout_ms);
+
+/**
+ * Stop capture and return to delivering samples to LMS_RecvStream().
+ *
+ * @param stream    structure previously initialized with LMS_SetupStream().
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_DisarmCapture(lms_stream_t *stream);
+
+/**
+ * Start computing averaged power spectra of RX stream on a library thread.
+ * Samples are copied from the stream only while a spectrum frame is
+ * collected, and are still delivered to LMS_RecvStream().
+ *
+ * @param stream    structure previously initialized with LMS_SetupStream().
+ * @param config    Spectrum configuration. See the ::lms_spectrum_t description.
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_StartSpectrumMonitor(lms_stream_t *stream, const lms_spectrum_t *config);
+
+/**
+ * Wait for the next spectrum frame. Bin k is at frequency
+ * (k - fftSize/2) * sampleRate / fftSize, values are in dBFS.
+ *
+ * @param stream        structure previously initialized with LMS_SetupStream().
+ * @param bins          destination for power of frequency bins.
+ * @param bin_count     maximum number of bins to read.
+ * @param timestamp     timestamp of the first sample of the frame, can be NULL.
+ * @param timeout_ms    how long to wait for frame.
+ *
+ * @return number of bins read, 0 on timeout, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_ReadSpectrum(lms_stream_t *stream, float_type *bins, size_t bin_count, uint64_t *timestamp, unsigned timeout_ms);
+
+/**
+ * Stop spectrum monitor of RX stream.
+ *
+ * @param stream    structure previously initialized with LMS_SetupStream().
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_StopSpectrumMonitor(lms_stream_t *stream);
+
+/**
+ * Start stepping RX stream through frequency plan. SX settings of all
+ * steps are computed once, so that each retune is a single register write
+ * without VCO tuning. Each step is received as timed burst after settling
+ * time, and receiver is retuned for the next step as soon as samples of
+ * the current step are received.
+ *
+ * @param device    Device handle previously obtained by LMS_Open().
+ * @param stream    running RX stream previously initialized with LMS_SetupStream().
+ * @param config    Sweep configuration. See the ::lms_sweep_t description.
+ * @param sweep     [out] sweep handle, released by LMS_StopSweep().
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_StartSweep(lms_device_t *device, lms_stream_t *stream, const lms_sweep_t *config, lms_sweep_handle_t **sweep);
+
+/**
+ * Receive current sweep step and retune to the next one. Sweep restarts
+ * from the first step after the last one.
+ *
+ * @param sweep         handle obtained by LMS_StartSweep().
+ * @param data          buffer for lms_sweep_t::samplesPerStep samples in stream
+ *                      data format, or for lms_spectrum_t::fftSize ::float_type
+ *                      bins in dBFS from lowest frequency.
+ * @param count         size of the buffer in samples or bins.
+ * @param meta          [out] step tag, can be NULL.
+ * @param timeout_ms    how long to wait for samples of the step.
+ *
+ * @return number of samples or bins, 0 on timeout, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_RecvSweepStep(lms_sweep_handle_t *sweep, void *data, size_t count, lms_sweep_meta_t *meta, unsigned timeout_ms);
+
+/**
+ * Get sweep rate.
+ *
+ * @param sweep             handle obtained by LMS_StartSweep().
+ * @param stepsPerSecond    [out] steps completed per second since start.
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_GetSweepRate(lms_sweep_handle_t *sweep, float_type *stepsPerSecond);
+
+/**
+ * Stop sweep and release its handle. Receiver stays tuned to the last step.
+ *
+ * @param sweep     handle obtained by LMS_StartSweep().
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_StopSweep(lms_sweep_handle_t *sweep);
+
 /**
  * Write samples to the FIFO of the specified stream.
  *
@@ -1155,6 +1510,53 @@ API_EXPORT int CALL_CONV LMS_SendStream(lms_stream_t *stream,
                             const void *samples,size_t sample_count,
                             const lms_stream_meta_t *meta, unsigned timeout_ms);
 
+/**
+ * Transmit samples repeatedly from host memory.
+ *
+ * Samples are converted to the link format once and replayed by the
+ * streaming thread, so waveforms larger than the on board memory can be
+ * repeated at full rate. Samples written with LMS_SendStream() are not
+ * transmitted while cyclic buffer is set.
+ *
+ * @param stream        structure previously initialized with LMS_SetupStream().
+ * @param samples       sample buffer.
+ * @param sample_count  Number of samples in waveform, 0 to stop repeating
+ *
+ * @return 0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_SendStreamCyclic(lms_stream_t *stream,
+                            const void *samples, size_t sample_count);
+
+/**
+ * Convert hardware timestamp to host time.
+ *
+ * Relation between sample clock and host monotonic clock is estimated from
+ * arrival times of received packets, so RX stream has to be running.
+ * Host time is std::chrono::steady_clock time in nanoseconds
+ * (CLOCK_MONOTONIC on Linux).
+ *
+ * @param device        Device handle previously obtained by LMS_Open().
+ * @param timestamp     hardware timestamp
+ * @param[out] host_ns  host time when sample with given timestamp is received
+ *
+ * @return 0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_TimestampToHostTime(lms_device_t *device,
+                            uint64_t timestamp, int64_t *host_ns);
+
+/**
+ * Convert host time to hardware timestamp.
+ * See LMS_TimestampToHostTime() for details.
+ *
+ * @param device         Device handle previously obtained by LMS_Open().
+ * @param host_ns        host time
+ * @param[out] timestamp hardware timestamp corresponding to host time
+ *
+ * @return 0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_HostTimeToTimestamp(lms_device_t *device,
+                            int64_t host_ns, uint64_t *timestamp);
+
 /**
  * Uploads waveform to on board memory for later use
  * @param device        Device handle previously obtained by LMS_Open().
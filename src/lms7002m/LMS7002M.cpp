@@ -1855,6 +1855,66 @@ uint16_t LMS7002M::SPI_read(uint16_t address, bool fromChip, int *status)
     return 0;
 }
 
+/** @brief Applies SX settings computed by previous SetFrequencySX() call
+    without VCO tuning, all registers are written in single SPI batch.
+    Intended for fast retuning through a precomputed frequency plan.
+    @param tx Rx/Tx module selection
+    @param details settings returned by SetFrequencySX()
+    @return 0-success, other-failure
+*/
+int LMS7002M::ApplyFrequencySX(bool tx, const SX_details& details)
+{
+    if (!details.success)
+        return ReportError(EINVAL, "ApplyFrequencySX%s(%g MHz) - settings were not tuned", tx?"T":"R", details.frequency / 1e6);
+
+    //SXR registers are cached in bank 0, SXT in bank 1
+    const int bank = tx ? 1 : 0;
+    auto setBits = [](uint16_t reg, const LMS7Parameter &param, uint16_t value) -> uint16_t
+    {
+        const uint16_t mask = (~(~0u << (param.msb - param.lsb + 1))) << param.lsb;
+        return (reg & ~mask) | ((value << param.lsb) & mask);
+    };
+    const uint16_t addrs[] = {0x011C, 0x011D, 0x011E, 0x011F, 0x0121};
+    uint16_t values[5];
+    for (int i = 0; i < 5; ++i)
+        values[i] = mRegistersMap->GetValue(bank, addrs[i]);
+    values[0] = setBits(values[0], LMS7param(EN_INTONLY_SDM), 0);
+    values[0] = setBits(values[0], LMS7param(EN_DIV2_DIVPROG), details.en_div2_divprog);
+    values[0] = setBits(values[0], LMS7param(PD_VCO), 0);
+    values[0] = setBits(values[0], LMS7param(PD_VCO_COMP), 0);
+    values[1] = details.FRAC & 0xFFFF;
+    values[2] = setBits(values[2], LMS7param(INT_SDM), details.INT);
+    values[2] = (values[2] & ~0xF) | ((details.FRAC >> 16) & 0xF);
+    values[3] = setBits(values[3], LMS7param(DIV_LOCH), details.div_loch);
+    values[4] = setBits(values[4], LMS7param(SEL_VCO), details.sel_vco);
+    values[4] = setBits(values[4], LMS7param(CSW_VCO), details.csw);
+
+    std::vector<uint16_t> batchAddr;
+    std::vector<uint16_t> batchData;
+    for (int i = 0; i < 5; ++i)
+    {
+        if (values[i] == mRegistersMap->GetValue(bank, addrs[i]))
+            continue;
+        batchAddr.push_back(addrs[i]);
+        batchData.push_back(values[i]);
+    }
+    if (batchData.empty())
+        return 0; //already applied
+
+    //select SX register space only for the duration of the batch
+    const uint16_t macAddr = LMS7param(MAC).address;
+    const uint16_t macReg = mRegistersMap->GetValue(0, macAddr);
+    const uint16_t sxMacReg = setBits(macReg, LMS7param(MAC), tx ? ChSXT : ChSXR);
+    if (sxMacReg != macReg)
+    {
+        batchAddr.insert(batchAddr.begin(), macAddr);
+        batchData.insert(batchData.begin(), sxMacReg);
+        batchAddr.push_back(macAddr);
+        batchData.push_back(macReg);
+    }
+    return SPI_write_batch(batchAddr.data(), batchData.data(), batchData.size());
+}
+
 /** @brief Batches multiple register writes into least ammount of transactions
     @param spiAddr spi register addresses to be written
     @param spiData registers data to be written
@@ -2225,7 +2285,9 @@ isSyncedEnding:
 }
 
 /** @brief Writes all registers from host to chip
-
+    Registers of both channels are written in single batch, channel is
+    selected by MAC writes placed in between, so the control port can keep
+    several packets in flight instead of waiting for each transfer.
 */
 int LMS7002M::UploadAll()
 {
@@ -2233,42 +2295,40 @@ int LMS7002M::UploadAll()
 
     Channel ch = this->GetActiveChannel(); //remember used channel
 
-    int status;
-
     vector<uint16_t> addrToWrite;
     vector<uint16_t> dataToWrite;
 
-    uint16_t x0020_value = mRegistersMap->GetValue(0, 0x0020);
-    this->SetActiveChannel(ChA); //select A channel
+    const uint16_t x0020_value = mRegistersMap->GetValue(0, 0x0020);
+    const uint16_t macMask = 0x0003;
 
-    addrToWrite = mRegistersMap->GetUsedAddresses(0);
-    //remove 0x0020 register from list, to not change MAC
-    addrToWrite.erase( find(addrToWrite.begin(), addrToWrite.end(), 0x0020) );
-    for (auto address : addrToWrite)
+    //select A channel
+    addrToWrite.push_back(0x0020);
+    dataToWrite.push_back((x0020_value & ~macMask) | ChA);
+    for (auto address : mRegistersMap->GetUsedAddresses(0))
+    {
+        //0x0020 is written only with channel selection, to not change MAC
+        if (address == 0x0020)
+            continue;
+        addrToWrite.push_back(address);
         dataToWrite.push_back(mRegistersMap->GetValue(0, address));
+    }
 
-    status = SPI_write_batch(&addrToWrite[0], &dataToWrite[0], addrToWrite.size());
-    if (status != 0)
-        return status;
-    //after all channel A registers have been written, update 0x0020 register value
-    status = SPI_write(0x0020, x0020_value);
-    if (status != 0)
-        return status;
-    this->SetActiveChannel(ChB);
-    if (status != 0)
-        return status;
-
-    addrToWrite = mRegistersMap->GetUsedAddresses(1);
-    dataToWrite.clear();
-    for (auto address : addrToWrite)
+    //after all channel A registers have been written, 0x0020 is updated with B channel selected
+    addrToWrite.push_back(0x0020);
+    dataToWrite.push_back((x0020_value & ~macMask) | ChB);
+    for (auto address : mRegistersMap->GetUsedAddresses(1))
     {
+        addrToWrite.push_back(address);
         dataToWrite.push_back(mRegistersMap->GetValue(1, address));
     }
-    this->SetActiveChannel(ChB); //select B channel
-    status = SPI_write_batch(&addrToWrite[0], &dataToWrite[0], addrToWrite.size());
+
+    //restore last used channel
+    addrToWrite.push_back(0x0020);
+    dataToWrite.push_back((x0020_value & ~macMask) | ch);
+
+    int status = SPI_write_batch(&addrToWrite[0], &dataToWrite[0], addrToWrite.size());
     if (status != 0)
         return status;
-    this->SetActiveChannel(ch); //restore last used channel
 
     //update external band-selection to match
     this->UpdateExternalBandSelect();
@@ -296,6 +296,7 @@ public:
 	float_type GetFrequencySX(bool tx);
     int SetFrequencySX(bool tx, float_type freq_Hz, SX_details* output = nullptr);
     int SetFrequencySXWithSpurCancelation(bool tx, float_type freq_Hz, float_type BW);
+    int ApplyFrequencySX(bool tx, const SX_details& details);
 	bool GetSXLocked(bool tx);
     ///VCO modules available for tuning
     enum VCO_Module
@@ -0,0 +1,144 @@
+/**
+    @file ClockEstimator.cpp
+    @author Lime Microsystems
+    @brief Estimation of relation between hardware timestamps and host clock.
+*/
+
+#include "ClockEstimator.h"
+#include <chrono>
+#include <cmath>
+
+using namespace lime;
+
+ClockEstimator::ClockEstimator(void)
+{
+    Reset(1.0);
+}
+
+void ClockEstimator::Reset(const double rate_Hz)
+{
+    mNominalRate = rate_Hz / 1e9;
+    mWindowValid = false;
+    mWindowStart = 0;
+    mWindowBestScore = 0;
+    mPointIndex = 0;
+    mPointCount = 0;
+    mLastTimestamp = 0;
+    std::lock_guard<std::mutex> lock(mFitLock);
+    mValid = false;
+    mRefTime = 0;
+    mRefTimestamp = 0;
+    mRate = mNominalRate;
+}
+
+void ClockEstimator::AddObservation(const uint64_t timestamp, const int64_t hostTime_ns)
+{
+    //timestamps restarted or changed, previous observations are no longer valid
+    if (timestamp < mLastTimestamp)
+        Reset(mNominalRate * 1e9);
+    else if (mPointCount > 0 && mNominalRate > 0)
+    {
+        const Point &last = mPoints[(mPointIndex + maxPoints - 1) % maxPoints];
+        const double expected = mNominalRate * double(hostTime_ns - last.hostTime);
+        if (std::fabs(double(timestamp - last.timestamp) - expected) > mNominalRate * maxJump_ns)
+            Reset(mNominalRate * 1e9);
+    }
+    mLastTimestamp = timestamp;
+
+    if (mWindowValid && hostTime_ns - mWindowStart >= windowDuration_ns)
+    {
+        mPoints[mPointIndex] = mWindowBest;
+        mPointIndex = (mPointIndex + 1) % maxPoints;
+        if (mPointCount < maxPoints)
+            ++mPointCount;
+        mWindowValid = false;
+        UpdateFit();
+    }
+
+    //samples delivered with the lowest latency have the highest timestamp for their arrival time
+    const double score = double(timestamp) - mNominalRate * double(hostTime_ns - mWindowStart);
+    if (!mWindowValid)
+    {
+        mWindowValid = true;
+        mWindowStart = hostTime_ns;
+        mWindowBest.hostTime = hostTime_ns;
+        mWindowBest.timestamp = timestamp;
+        mWindowBestScore = double(timestamp);
+    }
+    else if (score > mWindowBestScore)
+    {
+        mWindowBest.hostTime = hostTime_ns;
+        mWindowBest.timestamp = timestamp;
+        mWindowBestScore = score;
+    }
+}
+
+void ClockEstimator::UpdateFit(void)
+{
+    if (mPointCount < 2)
+        return;
+    //values relative to the oldest point to keep precision
+    const int first = (mPointIndex - mPointCount + maxPoints) % maxPoints;
+    const Point &ref = mPoints[first];
+    double sumX = 0, sumY = 0;
+    for (int i = 0; i < mPointCount; ++i)
+    {
+        const Point &p = mPoints[(first + i) % maxPoints];
+        sumX += double(p.hostTime - ref.hostTime);
+        sumY += double(p.timestamp - ref.timestamp);
+    }
+    const double meanX = sumX / mPointCount;
+    const double meanY = sumY / mPointCount;
+    double covXY = 0, varX = 0;
+    for (int i = 0; i < mPointCount; ++i)
+    {
+        const Point &p = mPoints[(first + i) % maxPoints];
+        const double dx = double(p.hostTime - ref.hostTime) - meanX;
+        const double dy = double(p.timestamp - ref.timestamp) - meanY;
+        covXY += dx * dy;
+        varX += dx * dx;
+    }
+    if (varX <= 0)
+        return;
+    const double rate = covXY / varX;
+    //reject fits too far from nominal rate, e.g. while sample rate is changing
+    if (mNominalRate > 0 && std::fabs(rate - mNominalRate) > mNominalRate * 0.01)
+        return;
+
+    std::lock_guard<std::mutex> lock(mFitLock);
+    mRate = rate;
+    mRefTime = ref.hostTime + int64_t(meanX);
+    mRefTimestamp = double(ref.timestamp) + meanY;
+    mValid = true;
+}
+
+bool ClockEstimator::IsValid(void) const
+{
+    std::lock_guard<std::mutex> lock(mFitLock);
+    return mValid;
+}
+
+bool ClockEstimator::ToHostTime(const uint64_t timestamp, int64_t &hostTime_ns) const
+{
+    std::lock_guard<std::mutex> lock(mFitLock);
+    if (!mValid)
+        return false;
+    hostTime_ns = mRefTime + int64_t(std::llround((double(timestamp) - mRefTimestamp) / mRate));
+    return true;
+}
+
+bool ClockEstimator::ToTimestamp(const int64_t hostTime_ns, uint64_t &timestamp) const
+{
+    std::lock_guard<std::mutex> lock(mFitLock);
+    if (!mValid)
+        return false;
+    const double ts = mRefTimestamp + mRate * double(hostTime_ns - mRefTime);
+    timestamp = ts > 0 ? uint64_t(std::llround(ts)) : 0;
+    return true;
+}
+
+int64_t ClockEstimator::HostTimeNow(void)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
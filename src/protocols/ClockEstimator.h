@@ -0,0 +1,83 @@
+/**
+    @file ClockEstimator.h
+    @author Lime Microsystems
+    @brief Estimation of relation between hardware timestamps and host clock.
+*/
+
+#pragma once
+#include <stdint.h>
+#include <mutex>
+#include <LimeSuiteConfig.h>
+
+namespace lime{
+
+/*!
+ * Estimates hardware sample clock offset and drift relative to host
+ * monotonic clock (std::chrono::steady_clock) from packet arrival times.
+ * Observations are decimated to the one with lowest latency in each window,
+ * clock relation is fitted to the recent windows using linear regression.
+ */
+class LIME_API ClockEstimator
+{
+public:
+    ClockEstimator(void);
+
+    /** @brief Discards all observations
+        @param rate_Hz nominal hardware timestamp rate
+    */
+    void Reset(const double rate_Hz);
+
+    /** @brief Adds packet arrival observation, called by receive loop
+        @param timestamp hardware timestamp following last received sample
+        @param hostTime_ns host time when samples were received
+    */
+    void AddObservation(const uint64_t timestamp, const int64_t hostTime_ns);
+
+    //! @return true if clock relation is available
+    bool IsValid(void) const;
+
+    /** @brief Converts hardware timestamp to host time
+        @return false if clock relation is not available
+    */
+    bool ToHostTime(const uint64_t timestamp, int64_t &hostTime_ns) const;
+
+    /** @brief Converts host time to hardware timestamp
+        @return false if clock relation is not available
+    */
+    bool ToTimestamp(const int64_t hostTime_ns, uint64_t &timestamp) const;
+
+    //! @return current host monotonic clock time in nanoseconds
+    static int64_t HostTimeNow(void);
+
+private:
+    struct Point
+    {
+        int64_t hostTime;
+        uint64_t timestamp;
+    };
+    static const int maxPoints = 128;
+    static const int64_t windowDuration_ns = 50000000;
+    static const int64_t maxJump_ns = 100000000;
+
+    void UpdateFit(void);
+
+    //receive loop state
+    double mNominalRate; //ticks per nanosecond
+    bool mWindowValid;
+    int64_t mWindowStart;
+    Point mWindowBest;
+    double mWindowBestScore;
+    Point mPoints[maxPoints];
+    int mPointIndex;
+    int mPointCount;
+    uint64_t mLastTimestamp;
+
+    //fitted relation: timestamp = mRefTimestamp + mRate*(hostTime - mRefTime)
+    mutable std::mutex mFitLock;
+    bool mValid;
+    int64_t mRefTime;
+    double mRefTimestamp;
+    double mRate;
+};
+
+}
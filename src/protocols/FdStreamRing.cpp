@@ -0,0 +1,245 @@
+/**
+    @file FdStreamRing.cpp
+    @author Lime Microsystems
+    @brief Stream buffers transferred to or from file descriptor by I/O thread.
+*/
+
+#ifdef __unix__
+#include "FdStreamRing.h"
+#include "ErrorReporting.h"
+#include "Logger.h"
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <chrono>
+
+using namespace lime;
+
+FdStreamRing::FdStreamRing(const bool isTx, const uint32_t bufferCount) :
+    mIsTx(isTx),
+    mBuffers(bufferCount, nullptr),
+    mLengths(bufferCount, 0),
+    mFd(-1),
+    mHead(0),
+    mSubmitted(0),
+    mDone(0),
+    mRunning(false),
+    mFailed(false),
+    mBytes(0),
+    mTransfers(0),
+    mPolls(0),
+    mCpuTime_us(0)
+{
+    mWakePipe[0] = -1;
+    mWakePipe[1] = -1;
+}
+
+FdStreamRing::~FdStreamRing(void)
+{
+    Stop();
+}
+
+int FdStreamRing::Start(const int fd)
+{
+    Stop();
+    if (mBuffers.empty())
+        return ReportError(EINVAL, "Stream ring needs at least one buffer");
+    const int flags = fcntl(fd, F_GETFL);
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
+        return ReportError(errno);
+    if (pipe(mWakePipe) != 0)
+        return ReportError(errno);
+    mFd = fd;
+    mHead = 0;
+    mSubmitted = 0;
+    mDone = 0;
+    mFailed = false;
+    mRunning = true;
+    mBytes = 0;
+    mTransfers = 0;
+    mPolls = 0;
+    mCpuTime_us = 0;
+    mThread = std::thread(&FdStreamRing::IoLoop, this);
+    return 0;
+}
+
+void FdStreamRing::Stop(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (!mRunning && !mThread.joinable())
+            return;
+        mRunning = false;
+    }
+    mChanged.notify_all();
+    const char wake = 0;
+    if (write(mWakePipe[1], &wake, 1) < 0)
+        lime::warning("Failed to wake stream I/O thread");
+    if (mThread.joinable())
+        mThread.join();
+    close(mWakePipe[0]);
+    close(mWakePipe[1]);
+    mWakePipe[0] = -1;
+    mWakePipe[1] = -1;
+    mFd = -1;
+}
+
+/** @brief Sleeps until file is ready for given events
+    @return false if ring is stopped or file failed
+*/
+bool FdStreamRing::WaitFd(const short events)
+{
+    pollfd fds[2];
+    fds[0].fd = mFd;
+    fds[0].events = events;
+    fds[1].fd = mWakePipe[0];
+    fds[1].events = POLLIN;
+    while (true)
+    {
+        fds[0].revents = 0;
+        fds[1].revents = 0;
+        ++mPolls;
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            lime::error("Stream poll failed: %s", strerror(errno));
+            return false;
+        }
+        if (fds[1].revents)
+            return false;
+        if (fds[0].revents & events)
+            return true;
+        //hang up without data or error
+        if (fds[0].revents)
+            return false;
+    }
+}
+
+/** @brief Reads or writes whole buffer
+    @return false if ring is stopped or file failed
+*/
+bool FdStreamRing::Transfer(char* buffer, const uint32_t length)
+{
+    uint32_t done = 0;
+    while (done < length)
+    {
+        const ssize_t ret = mIsTx ? write(mFd, buffer + done, length - done) : read(mFd, buffer + done, length - done);
+        if (ret > 0)
+        {
+            done += ret;
+            continue;
+        }
+        if (ret == 0 && !mIsTx)
+        {
+            lime::error("Stream file ended");
+            return false;
+        }
+        if (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        {
+            lime::error("Stream %s failed: %s", mIsTx ? "write" : "read", strerror(errno));
+            return false;
+        }
+        if (!WaitFd(mIsTx ? POLLOUT : POLLIN))
+            return false;
+    }
+    //Xillybus sends partially filled DMA buffer on zero length write
+    while (mIsTx && write(mFd, nullptr, 0) < 0)
+    {
+        if (errno == EINTR)
+            continue;
+        lime::error("Stream flush failed: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void FdStreamRing::IoLoop(void)
+{
+    std::unique_lock<std::mutex> lock(mLock);
+    while (mRunning)
+    {
+        if (mDone == mSubmitted)
+        {
+            mChanged.wait(lock);
+            continue;
+        }
+        const uint32_t index = (mHead + mDone) % mBuffers.size();
+        char* buffer = mBuffers[index];
+        const uint32_t length = mLengths[index];
+        lock.unlock();
+        const bool ok = Transfer(buffer, length);
+        timespec cpu;
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu) == 0)
+            mCpuTime_us = uint64_t(cpu.tv_sec)*1000000 + cpu.tv_nsec/1000;
+        lock.lock();
+        if (!ok)
+        {
+            mFailed = mRunning;
+            break;
+        }
+        mBytes += length;
+        ++mTransfers;
+        ++mDone;
+        mChanged.notify_all();
+    }
+    mRunning = false;
+    mChanged.notify_all();
+}
+
+int FdStreamRing::Submit(char* buffer, const uint32_t length)
+{
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (!mRunning || mSubmitted == mBuffers.size())
+            return -1;
+        const uint32_t index = (mHead + mSubmitted) % mBuffers.size();
+        mBuffers[index] = buffer;
+        mLengths[index] = length;
+        ++mSubmitted;
+    }
+    mChanged.notify_all();
+    return 0;
+}
+
+int FdStreamRing::Reap(char** buffer, const unsigned timeout_ms)
+{
+    std::unique_lock<std::mutex> lock(mLock);
+    if (!mChanged.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]{return mDone != 0 || !mRunning;}))
+        return REAP_TIMEOUT;
+    if (mSubmitted == 0)
+        return mFailed ? REAP_FAILED : REAP_TIMEOUT;
+    //buffers left by stopped I/O thread are returned without data
+    int bytes = 0;
+    if (mDone != 0)
+    {
+        bytes = mLengths[mHead];
+        --mDone;
+    }
+    else if (mFailed)
+        return REAP_FAILED;
+    *buffer = mBuffers[mHead];
+    mHead = (mHead + 1) % mBuffers.size();
+    --mSubmitted;
+    return bytes;
+}
+
+void FdStreamRing::Cancel(void)
+{
+    Stop();
+}
+
+FdStreamRing::Stats FdStreamRing::GetStats(void) const
+{
+    Stats stats;
+    stats.bytesTransferred = mBytes.load();
+    stats.buffersTransferred = mTransfers.load();
+    stats.polls = mPolls.load();
+    stats.ioCpuTime_us = mCpuTime_us.load();
+    return stats;
+}
+
+#endif // __unix__
@@ -0,0 +1,102 @@
+/**
+    @file FdStreamRing.h
+    @author Lime Microsystems
+    @brief Stream buffers transferred to or from file descriptor by I/O thread.
+*/
+
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <LimeSuiteConfig.h>
+#include "StreamTransport.h"
+
+namespace lime{
+
+/*!
+ * Moves submitted buffers between a stream device file and memory
+ * on an I/O thread, so that system calls overlap with packet processing.
+ * The I/O thread sleeps in poll() until the file is ready or it is stopped,
+ * so waiting for data costs no CPU time. Available on POSIX systems only.
+ *
+ * Receive ring: I/O thread fills submitted buffers completely from the file.
+ * Transmit ring: I/O thread writes submitted buffers to the file and flushes
+ * each one. In both directions buffers are transferred and reaped in order
+ * of submission.
+ */
+class LIME_API FdStreamRing : public StreamTransport
+{
+public:
+    struct Stats
+    {
+        uint64_t bytesTransferred;
+        uint64_t buffersTransferred;
+        uint64_t polls; //!< poll() calls made by I/O thread
+        uint64_t ioCpuTime_us; //!< CPU time used by I/O thread
+    };
+
+    /** @param isTx true to write buffers to file, false to read them
+        @param bufferCount maximum number of submitted buffers
+    */
+    FdStreamRing(const bool isTx, const uint32_t bufferCount);
+    ~FdStreamRing(void);
+
+    /** @brief Starts I/O thread, file is switched to non-blocking mode
+        @param fd open file, it is not closed by the ring
+        @return 0 on success
+    */
+    int Start(const int fd);
+
+    /** @brief Stops I/O thread, buffers not yet transferred are returned
+        by Reap() with zero length
+    */
+    void Stop(void);
+
+    /** @brief Queues buffer for transfer
+        @return 0 on success, -1 if ring is full or stopped
+    */
+    int Submit(char* buffer, const uint32_t length) override;
+
+    /** @brief Waits for the oldest submitted buffer
+        @return number of bytes, REAP_TIMEOUT, REAP_FAILED if I/O thread
+        stopped on error or end of file
+    */
+    int Reap(char** buffer, const unsigned timeout_ms) override;
+
+    //! @brief Same as Stop()
+    void Cancel(void) override;
+
+    //! @return transfer statistics since Start()
+    Stats GetStats(void) const;
+
+private:
+    void IoLoop(void);
+    bool WaitFd(const short events);
+    bool Transfer(char* buffer, const uint32_t length);
+
+    const bool mIsTx;
+    std::vector<char*> mBuffers;
+    std::vector<uint32_t> mLengths;
+    int mFd;
+    int mWakePipe[2]; //written by Stop() to interrupt poll()
+    std::thread mThread;
+
+    //submitted buffers are mHead..mHead+mSubmitted-1, the first mDone of them are transferred
+    std::mutex mLock;
+    std::condition_variable mChanged;
+    uint32_t mHead;
+    uint32_t mSubmitted;
+    uint32_t mDone;
+    bool mRunning;
+    bool mFailed;
+
+    std::atomic<uint64_t> mBytes;
+    std::atomic<uint64_t> mTransfers;
+    std::atomic<uint64_t> mPolls;
+    std::atomic<uint64_t> mCpuTime_us;
+};
+
+}
@@ -4,16 +4,125 @@
 #include "FPGA_common.h"
 #include "LMS7002M.h"
 #include <ciso646>
+#include <algorithm>
+#include <limits>
+#include <cstdlib>
 #include "Logger.h"
+#if defined(__SSE2__) || defined(_M_X64)
+#define LIME_USE_SSE2
+#include <emmintrin.h>
+#endif
 
 using namespace lime;
 
 static const int MAX_CHANNEL_COUNT = 4;
 
+static inline uint16_t GetRegBits(const uint16_t reg, const LMS7Parameter &param)
+{
+    return (reg & (~(~0u << (param.msb+1)))) >> param.lsb;
+}
+
+static inline uint16_t SetRegBits(const uint16_t reg, const LMS7Parameter &param, const uint16_t value)
+{
+    const uint16_t mask = (~(~0u << (param.msb - param.lsb + 1))) << param.lsb;
+    return (reg & ~mask) | ((value << param.lsb) & mask);
+}
+
+/** @brief Returns true if samples of the format are stored in FIFO without conversion
+*/
+static inline bool IsNativeFormat(const StreamConfig::StreamDataFormat format)
+{
+    return format == StreamConfig::STREAM_12_BIT_IN_16 || format == StreamConfig::STREAM_12_BIT_COMPRESSED;
+}
+
+/** @brief Returns bytes per complex sample of host stream format
+*/
+uint32_t ILimeSDRStreaming::HostSampleSize(const StreamConfig::StreamDataFormat format)
+{
+    switch (format)
+    {
+    case StreamConfig::STREAM_COMPLEX_FLOAT32: return 2*sizeof(float);
+    case StreamConfig::STREAM_12_BIT_PACKED: return 3;
+    case StreamConfig::STREAM_8_BIT: return 2;
+    default: return sizeof(complex16_t);
+    }
+}
+
+/** @brief Converts samples from host stream format to 16 bit samples
+*/
+void ILimeSDRStreaming::HostToSamples(const void* src, complex16_t* dest, const uint32_t count, const StreamConfig::StreamDataFormat format)
+{
+    if (format == StreamConfig::STREAM_COMPLEX_FLOAT32)
+    {
+        const float* in = (const float*)src;
+        for(uint32_t i=0; i<count; ++i)
+        {
+            dest[i].i = in[2*i]*2047;
+            dest[i].q = in[2*i+1]*2047;
+        }
+    }
+    else if (format == StreamConfig::STREAM_12_BIT_PACKED)
+    {
+        const uint8_t* in = (const uint8_t*)src;
+        for(uint32_t i=0; i<count; ++i, in+=3)
+        {
+            dest[i].i = int16_t((in[0] | (in[1] << 8)) << 4) >> 4;
+            dest[i].q = int16_t(((in[1] >> 4) | (in[2] << 4)) << 4) >> 4;
+        }
+    }
+    else if (format == StreamConfig::STREAM_8_BIT)
+    {
+        const int8_t* in = (const int8_t*)src;
+        for(uint32_t i=0; i<count; ++i)
+        {
+            dest[i].i = in[2*i] * 16;
+            dest[i].q = in[2*i+1] * 16;
+        }
+    }
+    else
+        memcpy(dest, src, count*sizeof(complex16_t));
+}
+
+/** @brief Converts 16 bit samples to packed 12 bit or 8 bit host stream format
+*/
+static void SamplesToHost(const complex16_t* src, void* dest, const uint32_t count, const StreamConfig::StreamDataFormat format)
+{
+    if (format == StreamConfig::STREAM_12_BIT_PACKED)
+    {
+        uint8_t* out = (uint8_t*)dest;
+        for(uint32_t i=0; i<count; ++i, out+=3)
+        {
+            out[0] = src[i].i & 0xFF;
+            out[1] = ((src[i].i >> 8) & 0x0F) | ((src[i].q << 4) & 0xF0);
+            out[2] = (src[i].q >> 4) & 0xFF;
+        }
+    }
+    else if (format == StreamConfig::STREAM_8_BIT)
+    {
+        int8_t* out = (int8_t*)dest;
+        for(uint32_t i=0; i<count; ++i)
+        {
+            out[2*i] = src[i].i >> 4;
+            out[2*i+1] = src[i].q >> 4;
+        }
+    }
+}
+
+//! @brief Converts 16 bit samples to float in place
+static void SamplesToFloat(void* samples, const int count)
+{
+    int16_t* samplesShort = (int16_t*)samples;
+    float* samplesFloat = (float*)samples;
+    for(int i=2*count-1; i>=0; --i)
+        samplesFloat[i] = (float)samplesShort[i]/2048.0;
+}
+
 ILimeSDRStreaming::ILimeSDRStreaming()
 {
     for (int i = 0; i < MAX_CHANNEL_COUNT/2; i++)
     	mStreamers.push_back(new Streamer(this));
+    RxLoopFunction = std::bind(&ILimeSDRStreaming::ReceivePacketsLoop, this, std::placeholders::_1);
+    TxLoopFunction = std::bind(&ILimeSDRStreaming::TransmitPacketsLoop, this, std::placeholders::_1);
 }
 ILimeSDRStreaming::~ILimeSDRStreaming()
 {
@@ -53,6 +162,13 @@ int ILimeSDRStreaming::ControlStream(const size_t streamID, const bool enable)
         return stream->Stop();
 }
 
+int ILimeSDRStreaming::ScheduleRxStream(const size_t streamID, const size_t burstSize, const StreamMetadata& metadata)
+{
+    auto *stream = (StreamChannel* )streamID;
+    assert(stream != nullptr);
+    return stream->ScheduleRx(metadata.timestamp, metadata.hasTimestamp, burstSize);
+}
+
 int ILimeSDRStreaming::ReadStream(const size_t streamID, void* buffs, const size_t length, const long timeout_ms, StreamMetadata& metadata)
 {
     assert(streamID != 0);
@@ -64,6 +180,9 @@ int ILimeSDRStreaming::ReadStream(const size_t streamID, void* buffs, const size
     int status = channel->Read(buffs, length, &meta, timeout_ms);
     metadata.hasTimestamp = true;
     metadata.timestamp = meta.timestamp;
+    metadata.endOfBurst = (meta.flags & lime::IStreamChannel::Metadata::END_BURST) != 0;
+    metadata.discontinuity = (meta.flags & lime::IStreamChannel::Metadata::DISCONTINUITY) != 0;
+    channel->GetSignalStats(metadata.signalStats);
     return status;
 }
 
@@ -74,33 +193,174 @@ int ILimeSDRStreaming::WriteStream(const size_t streamID, const void* buffs, con
     lime::IStreamChannel::Metadata meta;
     meta.flags = 0;
     meta.flags |= metadata.hasTimestamp ? lime::IStreamChannel::Metadata::SYNC_TIMESTAMP : 0;
+    meta.flags |= metadata.endOfBurst ? lime::IStreamChannel::Metadata::END_BURST : 0;
     meta.timestamp = metadata.timestamp;
     int status = channel->Write(buffs, length, &meta, timeout_ms);
     return status;
 }
 
 int ILimeSDRStreaming::ReadStreamStatus(const size_t streamID, const long timeout_ms, StreamMetadata& metadata)
+{
+    StreamEvent event;
+    if (ReadStreamEvent(streamID, timeout_ms, event) != 0)
+        return -1;
+    metadata.hasTimestamp = true;
+    metadata.timestamp = event.timestamp;
+    metadata.endOfBurst = event.type == StreamEvent::EVENT_END_OF_BURST;
+    metadata.lateTimestamp = event.type == StreamEvent::EVENT_LATE_TIMESTAMP;
+    metadata.underflow = event.type == StreamEvent::EVENT_UNDERFLOW;
+    metadata.packetDropped = event.type == StreamEvent::EVENT_PACKET_DROPPED
+        || event.type == StreamEvent::EVENT_OVERFLOW
+        || event.type == StreamEvent::EVENT_LATE_TIMESTAMP;
+    return 0;
+}
+
+int ILimeSDRStreaming::ReadStreamEvent(const size_t streamID, const long timeout_ms, StreamEvent& event)
 {
     assert(streamID != 0);
     StreamChannel* channel = (StreamChannel*)streamID;
-
-    //support late timestamp reporting
-    auto txLastLateTime = channel->mStreamer->txLastLateTime.exchange(0);
-    if (txLastLateTime != 0)
+    if (!channel->events.pop(event, timeout_ms))
     {
-        metadata.hasTimestamp = true;
-        metadata.timestamp = txLastLateTime;
-        metadata.lateTimestamp = true;
-        metadata.packetDropped = true;
-        return 0;
+        ReportError(ETIMEDOUT, "No stream events");
+        return -1;
     }
+    return 0;
+}
+
+int ILimeSDRStreaming::GetStreamMetrics(const size_t streamID, StreamMetrics &metrics)
+{
+    assert(streamID != 0);
+    StreamChannel* channel = (StreamChannel*)streamID;
+    return channel->GetMetrics(metrics);
+}
+
+int ILimeSDRStreaming::GetSignalStats(const size_t streamID, SignalStats &stats)
+{
+    assert(streamID != 0);
+    StreamChannel* channel = (StreamChannel*)streamID;
+    return channel->GetSignalStats(stats);
+}
+
+int ILimeSDRStreaming::ArmCapture(const size_t streamID, const CaptureConfig &config)
+{
+    assert(streamID != 0);
+    StreamChannel* channel = (StreamChannel*)streamID;
+    return channel->ArmCapture(config);
+}
+
+int ILimeSDRStreaming::TriggerCapture(const size_t streamID)
+{
+    assert(streamID != 0);
+    StreamChannel* channel = (StreamChannel*)streamID;
+    return channel->TriggerCapture();
+}
 
-    IStreamChannel::Info info = channel->GetInfo();
+int ILimeSDRStreaming::ReadCapture(const size_t streamID, void* buffs, const size_t length, const long timeout_ms, StreamMetadata& metadata, uint64_t& triggerTimestamp)
+{
+    assert(streamID != 0);
+    StreamChannel* channel = (StreamChannel*)streamID;
+    IStreamChannel::Metadata meta;
+    meta.flags = 0;
+    meta.timestamp = 0;
+    int status = channel->ReadCapture(buffs, length, &meta, &triggerTimestamp, timeout_ms);
     metadata.hasTimestamp = true;
-    metadata.timestamp = info.timestamp;
-    metadata.lateTimestamp = info.underrun > 0;
-    metadata.packetDropped = info.droppedPackets > 0;
-    return 0;
+    metadata.timestamp = meta.timestamp;
+    metadata.discontinuity = (meta.flags & IStreamChannel::Metadata::DISCONTINUITY) != 0;
+    return status;
+}
+
+int ILimeSDRStreaming::DisarmCapture(const size_t streamID)
+{
+    assert(streamID != 0);
+    StreamChannel* channel = (StreamChannel*)streamID;
+    return channel->DisarmCapture();
+}
+
+int ILimeSDRStreaming::StartSpectrumMonitor(const size_t streamID, const SpectrumConfig &config)
+{
+    assert(streamID != 0);
+    StreamChannel* channel = (StreamChannel*)streamID;
+    return channel->StartSpectrumMonitor(config);
+}
+
+int ILimeSDRStreaming::ReadSpectrum(const size_t streamID, float* bins, const size_t length, const long timeout_ms, StreamMetadata& metadata)
+{
+    assert(streamID != 0);
+    StreamChannel* channel = (StreamChannel*)streamID;
+    int status = channel->ReadSpectrum(bins, length, &metadata.timestamp, timeout_ms);
+    metadata.hasTimestamp = true;
+    return status;
+}
+
+int ILimeSDRStreaming::StopSpectrumMonitor(const size_t streamID)
+{
+    assert(streamID != 0);
+    StreamChannel* channel = (StreamChannel*)streamID;
+    return channel->StopSpectrumMonitor();
+}
+
+int ILimeSDRStreaming::GetStreamEventFd(const size_t streamID)
+{
+    assert(streamID != 0);
+    StreamChannel* channel = (StreamChannel*)streamID;
+    const int fd = channel->events.get_fd();
+    if (fd < 0)
+        ReportError(ENOTSUP, "Stream event file descriptors are not supported");
+    return fd;
+}
+
+size_t ILimeSDRStreaming::GetNumDirectAccessBuffers(const size_t streamID)
+{
+    assert(streamID != 0);
+    StreamChannel* channel = (StreamChannel*)streamID;
+    return channel->GetDirectBufferCount();
+}
+
+int ILimeSDRStreaming::GetDirectAccessBufferAddr(const size_t streamID, const size_t handle, void** buffer)
+{
+    assert(streamID != 0);
+    StreamChannel* channel = (StreamChannel*)streamID;
+    return channel->GetDirectBufferAddr(handle, buffer);
+}
+
+int ILimeSDRStreaming::AcquireReadBuffer(const size_t streamID, size_t& handle, const void** buffer, const long timeout_ms, StreamMetadata& metadata)
+{
+    assert(streamID != 0);
+    StreamChannel* channel = (StreamChannel*)streamID;
+    IStreamChannel::Metadata meta;
+    int status = channel->AcquireReadBuffer(handle, buffer, &meta, timeout_ms);
+    channel->GetSignalStats(metadata.signalStats);
+    metadata.hasTimestamp = true;
+    metadata.timestamp = meta.timestamp;
+    metadata.endOfBurst = (meta.flags & IStreamChannel::Metadata::END_BURST) != 0;
+    metadata.discontinuity = (meta.flags & IStreamChannel::Metadata::DISCONTINUITY) != 0;
+    return status;
+}
+
+int ILimeSDRStreaming::ReleaseReadBuffer(const size_t streamID, const size_t handle)
+{
+    assert(streamID != 0);
+    StreamChannel* channel = (StreamChannel*)streamID;
+    return channel->ReleaseReadBuffer(handle);
+}
+
+int ILimeSDRStreaming::AcquireWriteBuffer(const size_t streamID, size_t& handle, void** buffer, const long timeout_ms)
+{
+    assert(streamID != 0);
+    StreamChannel* channel = (StreamChannel*)streamID;
+    return channel->AcquireWriteBuffer(handle, buffer, timeout_ms);
+}
+
+int ILimeSDRStreaming::ReleaseWriteBuffer(const size_t streamID, const size_t handle, const size_t length, const StreamMetadata& metadata)
+{
+    assert(streamID != 0);
+    StreamChannel* channel = (StreamChannel*)streamID;
+    IStreamChannel::Metadata meta;
+    meta.flags = 0;
+    meta.flags |= metadata.hasTimestamp ? IStreamChannel::Metadata::SYNC_TIMESTAMP : 0;
+    meta.flags |= metadata.endOfBurst ? IStreamChannel::Metadata::END_BURST : 0;
+    meta.timestamp = metadata.timestamp;
+    return channel->ReleaseWriteBuffer(handle, length, &meta);
 }
 
 void ILimeSDRStreaming::EnterSelfCalibration(const size_t channel)
@@ -130,6 +390,20 @@ double ILimeSDRStreaming::GetHardwareTimestampRate(void)
     return mExpectedSampleRate;
 }
 
+int ILimeSDRStreaming::TimestampToHostTime(const uint64_t timestamp, int64_t& hostTime_ns)
+{
+    if (not mStreamers[0]->clockEstimator.ToHostTime(timestamp, hostTime_ns))
+        return ReportError(EAGAIN, "Clock relation is not known, Rx stream has to be running");
+    return 0;
+}
+
+int ILimeSDRStreaming::HostTimeToTimestamp(const int64_t hostTime_ns, uint64_t& timestamp)
+{
+    if (not mStreamers[0]->clockEstimator.ToTimestamp(hostTime_ns, timestamp))
+        return ReportError(EAGAIN, "Clock relation is not known, Rx stream has to be running");
+    return 0;
+}
+
 int ILimeSDRStreaming::ReceiveData(char* buffer, int length, int epIndex, int timeout)
 {
     return ReportError("Function not supported");
@@ -222,6 +496,30 @@ ILimeSDRStreaming::StreamChannel::StreamChannel(Streamer* streamer, StreamConfig
     overflow = 0;
     underflow = 0;
     pktLost = 0;
+    txBurstEnded = true;
+    rxDiscontinuity = false;
+    mRxCmdQueued = false;
+    mRxCmdReset = false;
+    mRxCmdActive = false;
+    mRxPaused = false;
+    mRxNextTimestamp = 0;
+    mRxSyncPending = false;
+    mRxSyncTimestamp = 0;
+    for (auto &count : mEventSamples)
+        count = 0;
+    mOverflowOldest = 0;
+    mOverflowNewest = 0;
+    mOverflowDecimated = 0;
+    mRxDecimating = false;
+    mRxDecimateSkip = false;
+
+    if (!config.isTx && config.gapFillLimit != 0)
+    {
+        complex16_t value;
+        value.i = config.gapFillValue;
+        value.q = config.gapFillValue;
+        mGapSamples.assign(std::min<uint32_t>(config.gapFillLimit, SamplesPacket::maxSamplesInPacket), value);
+    }
 
     if (this->config.bufferLength == 0) //default size
         this->config.bufferLength = 1024*8*SamplesPacket::maxSamplesInPacket;
@@ -242,140 +540,594 @@ ILimeSDRStreaming::StreamChannel::~StreamChannel()
 
 int ILimeSDRStreaming::StreamChannel::Read(void* samples, const uint32_t count, Metadata* meta, const int32_t timeout_ms)
 {
-    int popped = 0;
-    if(config.format == StreamConfig::STREAM_COMPLEX_FLOAT32 && !config.isTx)
+    const bool rxSync = !config.isTx && (meta->flags & Metadata::SYNC_TIMESTAMP);
+    const uint64_t syncTimestamp = meta->timestamp;
+    if (rxSync)
     {
-        //in place conversion
-        complex16_t* ptr = (complex16_t*)samples;
-        int16_t* samplesShort = (int16_t*)samples;
-        float* samplesFloat = (float*)samples;
-        popped = fifo->pop_samples(ptr, count, 1, &meta->timestamp, timeout_ms, &meta->flags);
-        for(int i=2*popped-1; i>=0; --i)
-            samplesFloat[i] = (float)samplesShort[i]/2048.0;
+        //request samples from given timestamp, unless they are already being read
+        if (syncTimestamp > mRxNextTimestamp && !(mRxSyncPending && syncTimestamp == mRxSyncTimestamp))
+        {
+            const bool burst = meta->flags & Metadata::END_BURST;
+            if (ScheduleRx(syncTimestamp, true, burst ? count : 0) != 0)
+                return -1;
+            mRxSyncPending = true;
+            mRxSyncTimestamp = syncTimestamp;
+        }
+        fifo->drop_samples_before(syncTimestamp);
     }
-    else
+    uint32_t fifoFlags = 0;
+
+    //formats smaller than FIFO samples are popped to temporary buffer
+    const bool convert = !config.isTx && !IsNativeFormat(config.format)
+        && config.format != StreamConfig::STREAM_COMPLEX_FLOAT32;
+    complex16_t* ptr = (complex16_t*)samples;
+    if (convert)
+    {
+        if (mConvertBuffer.size() < count)
+            mConvertBuffer.resize(count);
+        ptr = mConvertBuffer.data();
+    }
+    mReadStats = SignalStats();
+    //pending timed read has to find the start of requested burst after samples skipped by the command
+    const bool splitGaps = (rxSync && mRxSyncPending) || config.gapFillLimit != 0;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    int popped = fifo->pop_samples(ptr, count, 1, &meta->timestamp, timeout_ms, &fifoFlags, config.signalStats ? &mReadStats : nullptr, splitGaps);
+    while (rxSync && popped > 0 && meta->timestamp < syncTimestamp)
+    {
+        //samples pushed before receive loop took the command
+        const int skip = std::min<uint64_t>(syncTimestamp - meta->timestamp, popped);
+        popped -= skip;
+        memmove(ptr, ptr+skip, popped*sizeof(complex16_t));
+        meta->timestamp += skip;
+        if (popped > 0)
+            break;
+        //all popped samples were skipped, wait for requested ones
+        const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0)
+            break;
+        popped = fifo->pop_samples(ptr, count, 1, &meta->timestamp, remaining, &fifoFlags, config.signalStats ? &mReadStats : nullptr, splitGaps);
+    }
+    meta->flags = RingFIFO::ToMetadataFlags(fifoFlags);
+    if (!config.isTx && popped > 0)
     {
-        complex16_t* ptr = (complex16_t*)samples;
-        popped = fifo->pop_samples(ptr, count, 1, &meta->timestamp, timeout_ms, &meta->flags);
+        mRxNextTimestamp = meta->timestamp + popped;
+        mRxSyncPending = false;
     }
+
+    if(config.format == StreamConfig::STREAM_COMPLEX_FLOAT32 && !config.isTx)
+        SamplesToFloat(samples, popped);
+    else if (convert)
+        SamplesToHost(ptr, samples, popped, config.format);
     return popped;
 }
 
 int ILimeSDRStreaming::StreamChannel::Write(const void* samples, const uint32_t count, const Metadata *meta, const int32_t timeout_ms)
 {
+    if (!config.isTx)
+        return PushRxSamples((const complex16_t*)samples, count, meta, nullptr);
     int pushed = 0;
-    if (config.isTx && mActive && mStreamer->txRunning.load() == false)
+    if (mActive && mStreamer->txRunning.load() == false)
         mStreamer->UpdateThreads();
-    if(config.format == StreamConfig::STREAM_COMPLEX_FLOAT32 && config.isTx)
+    if(!IsNativeFormat(config.format))
     {
-        const float* samplesFloat = (const float*)samples;
-        int16_t* samplesShort = new int16_t[2*count];
-        for(size_t i=0; i<2*count; ++i)
-            samplesShort[i] = samplesFloat[i]*2047;
-        const complex16_t* ptr = (const complex16_t*)samplesShort ;
-        pushed = fifo->push_samples(ptr, count, 1, meta->timestamp, timeout_ms, meta->flags);
-        delete[] samplesShort;
+        if (mConvertBuffer.size() < count)
+            mConvertBuffer.resize(count);
+        HostToSamples(samples, mConvertBuffer.data(), count, config.format);
+        pushed = fifo->push_samples(mConvertBuffer.data(), count, 1, meta->timestamp, timeout_ms, RingFIFO::FromMetadataFlags(meta->flags));
     }
-    //else if(config.format == StreamConfig::STREAM_12_BIT_IN_16)
     else
     {
         const complex16_t* ptr = (const complex16_t*)samples;
-        pushed = fifo->push_samples(ptr, count, 1, meta->timestamp, timeout_ms, meta->flags);
+        pushed = fifo->push_samples(ptr, count, 1, meta->timestamp, timeout_ms, RingFIFO::FromMetadataFlags(meta->flags));
     }
     return pushed;
 }
 
-IStreamChannel::Info ILimeSDRStreaming::StreamChannel::GetInfo()
+/** @brief Pushes received samples to FIFO, used by receive loop.
+    Full FIFO is handled by StreamConfig::overflowPolicy, lost samples
+    are reported as overflow events.
+    @param stats optional signal statistics of the samples
+    @return number of samples pushed
+*/
+int ILimeSDRStreaming::StreamChannel::PushRxSamples(const complex16_t* samples, const uint32_t count, const Metadata *meta, const SignalStats* stats)
 {
-    Info stats;
-    memset(&stats,0,sizeof(stats));
-    RingFIFO::BufferInfo info = fifo->GetInfo();
-    stats.fifoSize = info.size;
-    stats.fifoItemsCount = info.itemsFilled;
-    stats.active = mActive;
-    stats.droppedPackets = pktLost;
-    stats.overrun = overflow;
-    stats.overrun = underflow;
-    pktLost = 0;
-    overflow = 0;
-    underflow = 0;
-    if(config.isTx)
-        stats.linkRate = mStreamer->txDataRate_Bps.load();
-    else
-        stats.linkRate = mStreamer->rxDataRate_Bps.load();
-    return stats;
-}
+    if (spectrum.IsCollecting())
+        spectrum.Push(samples, count, meta->timestamp);
+    if (capture.IsEnabled())
+    {
+        capture.Push(samples, count, meta->timestamp);
+        return count;
+    }
 
-bool ILimeSDRStreaming::StreamChannel::IsActive() const
-{
-    return mActive;
+    uint32_t flags = RingFIFO::FromMetadataFlags(meta->flags);
+    uint32_t timeout_ms = 0;
+    if (config.overflowPolicy == StreamConfig::OVERFLOW_DROP_OLDEST)
+        flags |= RingFIFO::OVERWRITE_OLD;
+    else if (config.overflowPolicy == StreamConfig::OVERFLOW_BLOCK)
+        timeout_ms = config.overflowTimeout_ms;
+    else if (config.overflowPolicy == StreamConfig::OVERFLOW_DECIMATE)
+    {
+        //hysteresis keeps skipping until consumer catches up
+        const RingFIFO::BufferInfo info = fifo->GetInfo();
+        if (uint64_t(info.itemsFilled)*4 >= uint64_t(info.size)*3)
+            mRxDecimating = true;
+        else if (uint64_t(info.itemsFilled)*2 <= info.size)
+            mRxDecimating = false;
+        mRxDecimateSkip = mRxDecimating && !mRxDecimateSkip;
+        if (mRxDecimateSkip)
+        {
+            mOverflowDecimated.fetch_add(count, std::memory_order_relaxed);
+            overflow++;
+            StreamEvent event;
+            event.type = StreamEvent::EVENT_OVERFLOW;
+            event.timestamp = meta->timestamp;
+            event.samplesCount = count;
+            PushEvent(event);
+            return 0;
+        }
+    }
+
+    const uint32_t pushed = fifo->push_samples(samples, count, 1, meta->timestamp, timeout_ms, flags, stats);
+    StreamEvent event;
+    event.type = StreamEvent::EVENT_OVERFLOW;
+    event.samplesCount = fifo->take_overwritten(&event.timestamp);
+    if (event.samplesCount != 0)
+    {
+        mOverflowOldest.fetch_add(event.samplesCount, std::memory_order_relaxed);
+        overflow++;
+        PushEvent(event);
+    }
+    if (pushed != count)
+    {
+        mOverflowNewest.fetch_add(count - pushed, std::memory_order_relaxed);
+        overflow++;
+        event.timestamp = meta->timestamp + pushed;
+        event.samplesCount = count - pushed;
+        PushEvent(event);
+    }
+    return pushed;
 }
 
-int ILimeSDRStreaming::StreamChannel::Start()
+/** @brief Inserts samples in place of samples lost on the link, called by receive loop.
+    Inserted samples are flagged as discontinuity, as well as samples
+    following them if the gap was longer than StreamConfig::gapFillLimit.
+    @param timestamp timestamp of the first lost sample
+    @param count number of lost samples
+*/
+bool ILimeSDRStreaming::StreamChannel::FillRxGap(const uint64_t timestamp, const uint32_t count)
 {
-    mActive = true;
-    fifo->Clear();
-    overflow = 0;
-    underflow = 0;
-    pktLost = 0;
-    return mStreamer->UpdateThreads();
+    const uint32_t fillCount = std::min(count, config.gapFillLimit);
+    rxDiscontinuity = true;
+    uint32_t filled = 0;
+    while (filled < fillCount)
+    {
+        uint32_t chunk = std::min<uint32_t>(fillCount - filled, mGapSamples.size());
+        const uint64_t chunkTimestamp = timestamp + filled;
+        filled += chunk;
+        uint32_t offset;
+        Metadata meta;
+        meta.flags = rxDiscontinuity ? Metadata::DISCONTINUITY : 0;
+        if (!FilterRxPacket(chunkTimestamp, offset, chunk, meta.flags))
+            continue;
+        meta.timestamp = chunkTimestamp + offset;
+        if (PushRxSamples(mGapSamples.data(), chunk, &meta, nullptr) > 0)
+            rxDiscontinuity = false;
+    }
+    if (fillCount != count)
+        rxDiscontinuity = true;
+    return fillCount == count;
 }
 
-int ILimeSDRStreaming::StreamChannel::Stop()
+int ILimeSDRStreaming::StreamChannel::GetSignalStats(SignalStats& stats)
 {
-    mActive = false;
-    return mStreamer->UpdateThreads();
+    stats = mReadStats;
+    return 0;
 }
 
-ILimeSDRStreaming::Streamer::Streamer(ILimeSDRStreaming* port)
+int ILimeSDRStreaming::StreamChannel::ArmCapture(const CaptureConfig& captureConfig)
 {
-    dataPort = port;
-    rxRunning = false;
-    txRunning = false;
-    mTimestampOffset = 0;
-    rxLastTimestamp = 0;
-    terminateRx = false;
-    terminateTx = false;
-    rxRunning = false;
-    txRunning = false;
-    generateData = false;
-    rxDataRate_Bps = 0;
-    txDataRate_Bps = 0;
-    txBatchSize = 1;
-    rxBatchSize = 1;
-    mChipID = dataPort->mStreamers.size();
+    if (config.isTx)
+        return ReportError(EINVAL, "Capture is supported only by Rx streams");
+    return capture.Arm(captureConfig);
 }
 
-ILimeSDRStreaming::Streamer::~Streamer()
+int ILimeSDRStreaming::StreamChannel::TriggerCapture()
 {
-    for(auto i : mTxStreams)
-        CloseStream((size_t)i);
-    for(auto i : mRxStreams)
-        CloseStream((size_t)i);
+    return capture.Trigger();
 }
 
-int ILimeSDRStreaming::Streamer::SetupStream(size_t& streamID, const StreamConfig& config)
+int ILimeSDRStreaming::StreamChannel::ReadCapture(void* samples, const uint32_t count, Metadata* meta, uint64_t* triggerTimestamp, const int32_t timeout_ms)
 {
-    /*if(rxRunning.load() == true || txRunning.load() == true)
-        return ReportError(EPERM, "All streams must be stopped before doing setups");*/
-    streamID = ~0;
-    StreamChannel* stream = new StreamChannel(this,config);
-    //TODO check for duplicate streams
-    if(config.isTx){
-        mTxStreams.push_back(stream);
-    }
-    else
+    const bool convert = !IsNativeFormat(config.format) && config.format != StreamConfig::STREAM_COMPLEX_FLOAT32;
+    complex16_t* ptr = (complex16_t*)samples;
+    if (convert)
     {
-        mRxStreams.push_back(stream);
+        if (mConvertBuffer.size() < count)
+            mConvertBuffer.resize(count);
+        ptr = mConvertBuffer.data();
     }
-    streamID = size_t(stream);
-    LMS7002M lms;
-    lms.SetConnection(dataPort, mChipID);
-    double rate = lms.GetSampleRate(config.isTx,LMS7002M::ChA)/1e6;
-    int size = (config.isTx) ?  mRxStreams.size(): mRxStreams.size();
+    bool discontinuity = false;
+    const int captured = capture.Read(ptr, count, meta->timestamp, *triggerTimestamp, discontinuity, timeout_ms);
+    meta->flags = discontinuity ? Metadata::DISCONTINUITY : 0;
+    if (captured <= 0)
+        return captured;
+    if (config.format == StreamConfig::STREAM_COMPLEX_FLOAT32)
+        SamplesToFloat(samples, captured);
+    else if (convert)
+        SamplesToHost(ptr, samples, captured, config.format);
+    return captured;
+}
 
-    if (config.performanceLatency < 0.5)
-        rate = 0.5 + rate * config.performanceLatency * 2.0 * size;
+int ILimeSDRStreaming::StreamChannel::DisarmCapture()
+{
+    capture.Disarm();
+    return 0;
+}
+
+int ILimeSDRStreaming::StreamChannel::StartSpectrumMonitor(const SpectrumConfig& spectrumConfig)
+{
+    if (config.isTx)
+        return ReportError(EINVAL, "Spectrum monitor is supported only by Rx streams");
+    return spectrum.Start(spectrumConfig);
+}
+
+int ILimeSDRStreaming::StreamChannel::ReadSpectrum(float* bins, const uint32_t count, uint64_t* timestamp, const int32_t timeout_ms)
+{
+    return spectrum.Read(bins, count, *timestamp, timeout_ms);
+}
+
+int ILimeSDRStreaming::StreamChannel::StopSpectrumMonitor()
+{
+    spectrum.Stop();
+    return 0;
+}
+
+/** @brief Sets waveform to be transmitted repeatedly.
+    Samples are converted once, transmit loop encodes them to FPGA packets
+    and replays the packets until cyclic buffer is cleared.
+    FIFO samples are not transmitted while cyclic buffer is set.
+*/
+int ILimeSDRStreaming::StreamChannel::SetCyclicBuffer(const void* samples, const uint32_t count)
+{
+    if (!config.isTx)
+        return ReportError(EINVAL, "Cyclic buffer is supported only by Tx streams");
+    std::vector<complex16_t> buffer(count);
+    if (count != 0)
+        HostToSamples(samples, buffer.data(), count, config.format);
+    {
+        std::lock_guard<std::mutex> lock(mStreamer->cyclicLock);
+        cyclicSamples.swap(buffer);
+    }
+    mStreamer->cyclicVersion++;
+    return 0;
+}
+
+/** @brief Drops timestamped Tx samples that are too late to be transmitted
+    @param timestamp current hardware timestamp
+    @return number of samples dropped
+*/
+uint32_t ILimeSDRStreaming::StreamChannel::DropLateSamples(const uint64_t timestamp)
+{
+    return fifo->drop_samples_before(timestamp, RingFIFO::SYNC_TIMESTAMP);
+}
+
+/** @brief Returns number of FIFO buffers available for direct access.
+    Direct access is possible only when samples are stored in FIFO in stream format.
+*/
+size_t ILimeSDRStreaming::StreamChannel::GetDirectBufferCount() const
+{
+    if (!IsNativeFormat(config.format))
+        return 0;
+    return fifo->GetBufferCount();
+}
+
+/** @brief Returns address of FIFO buffer given by direct access handle.
+    Addresses stay the same while the stream exists.
+*/
+int ILimeSDRStreaming::StreamChannel::GetDirectBufferAddr(const size_t handle, void** buffer)
+{
+    if (handle >= GetDirectBufferCount())
+        return ReportError(EINVAL, "Invalid direct access buffer handle");
+    *buffer = fifo->GetBufferAddress(handle);
+    return 0;
+}
+
+/** @brief Gives direct access to the oldest received FIFO buffer.
+    @return number of samples in buffer, 0 on timeout
+*/
+int ILimeSDRStreaming::StreamChannel::AcquireReadBuffer(size_t& handle, const void** buffer, Metadata* meta, const int32_t timeout_ms)
+{
+    if (config.isTx || GetDirectBufferCount() == 0)
+        return ReportError(ENOTSUP, "Direct buffer access is not supported by this stream");
+    uint32_t index = 0;
+    const complex16_t* samples = nullptr;
+    uint32_t fifoFlags = 0;
+    const uint32_t count = fifo->acquire_read(index, &samples, &meta->timestamp, timeout_ms, &fifoFlags, &mReadStats);
+    meta->flags = RingFIFO::ToMetadataFlags(fifoFlags);
+    if (count == 0)
+        return 0;
+    handle = index;
+    *buffer = samples;
+    return count;
+}
+
+int ILimeSDRStreaming::StreamChannel::ReleaseReadBuffer(const size_t handle)
+{
+    if (fifo->release_read(handle) != 0)
+        return ReportError(EINVAL, "Buffers have to be released in order of acquisition");
+    return 0;
+}
+
+/** @brief Gives direct access to free FIFO buffer for transmit samples.
+    @return number of samples that fit in buffer, 0 on timeout
+*/
+int ILimeSDRStreaming::StreamChannel::AcquireWriteBuffer(size_t& handle, void** buffer, const int32_t timeout_ms)
+{
+    if (!config.isTx || GetDirectBufferCount() == 0)
+        return ReportError(ENOTSUP, "Direct buffer access is not supported by this stream");
+    if (mActive && mStreamer->txRunning.load() == false)
+        mStreamer->UpdateThreads();
+    uint32_t index = 0;
+    complex16_t* samples = nullptr;
+    const uint32_t count = fifo->acquire_write(index, &samples, timeout_ms);
+    if (count == 0)
+        return 0;
+    handle = index;
+    *buffer = samples;
+    return count;
+}
+
+int ILimeSDRStreaming::StreamChannel::ReleaseWriteBuffer(const size_t handle, const uint32_t count, const Metadata* meta)
+{
+    if (fifo->release_write(handle, count, meta->timestamp, RingFIFO::FromMetadataFlags(meta->flags)) != 0)
+        return ReportError(EINVAL, "Buffers have to be released in order of acquisition");
+    return 0;
+}
+
+IStreamChannel::Info ILimeSDRStreaming::StreamChannel::GetInfo()
+{
+    Info stats;
+    memset(&stats,0,sizeof(stats));
+    RingFIFO::BufferInfo info = fifo->GetInfo();
+    stats.fifoSize = info.size;
+    stats.fifoItemsCount = info.itemsFilled;
+    stats.active = mActive;
+    stats.droppedPackets = pktLost;
+    stats.overrun = overflow;
+    stats.underrun = underflow;
+    pktLost = 0;
+    overflow = 0;
+    underflow = 0;
+    if(config.isTx)
+        stats.linkRate = mStreamer->txDataRate_Bps.load();
+    else
+        stats.linkRate = mStreamer->rxDataRate_Bps.load();
+    return stats;
+}
+
+/** @brief Accounts samples affected by event and queues it for the user
+*/
+void ILimeSDRStreaming::StreamChannel::PushEvent(const StreamEvent& event)
+{
+    mEventSamples[event.type].fetch_add(event.samplesCount, std::memory_order_relaxed);
+    events.push(event);
+}
+
+int ILimeSDRStreaming::StreamChannel::GetMetrics(StreamMetrics& metrics)
+{
+    memset(&metrics, 0, sizeof(metrics));
+    RingFIFO::BufferInfo info = fifo->GetInfo();
+    metrics.fifoSize = info.size;
+    metrics.fifoHighWatermark = info.maxItemsFilled;
+    if (config.isTx)
+        mStreamer->txMetrics.Get(metrics);
+    else
+        mStreamer->rxMetrics.Get(metrics);
+    metrics.overflowSamples = mEventSamples[StreamEvent::EVENT_OVERFLOW].load();
+    metrics.linkLossSamples = mEventSamples[StreamEvent::EVENT_PACKET_DROPPED].load();
+    metrics.lateSamples = mEventSamples[StreamEvent::EVENT_LATE_TIMESTAMP].load();
+    metrics.underflowSamples = mEventSamples[StreamEvent::EVENT_UNDERFLOW].load();
+    metrics.overflowOldestSamples = mOverflowOldest.load();
+    metrics.overflowNewestSamples = mOverflowNewest.load();
+    metrics.overflowDecimatedSamples = mOverflowDecimated.load();
+    if (!config.isTx)
+    {
+        metrics.overflowBlocks = info.pushWaits;
+        metrics.overflowBlockTime_us = info.pushWaitTime_us;
+    }
+    return 0;
+}
+
+bool ILimeSDRStreaming::StreamChannel::IsActive() const
+{
+    return mActive;
+}
+
+int ILimeSDRStreaming::StreamChannel::Start()
+{
+    mRxCmdReset = true;
+    mRxNextTimestamp = 0;
+    mRxSyncPending = false;
+    txBurstEnded = true; //underflows are not counted before first samples
+    rxDiscontinuity = false;
+    mActive = true;
+    fifo->Clear();
+    overflow = 0;
+    underflow = 0;
+    pktLost = 0;
+    events.clear();
+    for (auto &count : mEventSamples)
+        count.store(0);
+    mOverflowOldest.store(0);
+    mOverflowNewest.store(0);
+    mOverflowDecimated.store(0);
+    mRxDecimating = false;
+    mRxDecimateSkip = false;
+    if (mStreamer->UpdateThreads() != 0)
+    {
+        mActive = false;
+        return -1;
+    }
+    return 0;
+}
+
+int ILimeSDRStreaming::StreamChannel::Stop()
+{
+    mActive = false;
+    {
+        std::lock_guard<std::mutex> lock(rxCmdLock);
+        mRxCommands.clear();
+        mRxCmdQueued = false;
+    }
+    return mStreamer->UpdateThreads();
+}
+
+/** @brief Queues timed receive command.
+    Continuous streaming command is replaced by the next queued command,
+    burst command is completed before the next one is taken.
+    @param timestamp timestamp of the first sample to receive
+    @param waitForTimestamp drop samples before timestamp
+    @param burstSize number of samples to receive before pausing, 0 for continuous streaming
+*/
+int ILimeSDRStreaming::StreamChannel::ScheduleRx(const uint64_t timestamp, const bool waitForTimestamp, const size_t burstSize)
+{
+    if (config.isTx)
+        return ReportError(EINVAL, "Timed receive commands are not supported by Tx streams");
+    RxCommand cmd;
+    cmd.timestamp = timestamp;
+    cmd.waitForTimestamp = waitForTimestamp;
+    cmd.burstSize = burstSize;
+    std::lock_guard<std::mutex> lock(rxCmdLock);
+    mRxCommands.push_back(cmd);
+    mRxCmdQueued = true;
+    return 0;
+}
+
+/** @brief Applies timed receive command to packet samples, called by receive loop.
+    @param timestamp timestamp of the first sample in packet
+    @param offset [out] index of the first sample to push
+    @param count [in,out] number of samples to push
+    @param flags [in,out] metadata flags for pushed samples
+    @return false if packet should be dropped
+*/
+bool ILimeSDRStreaming::StreamChannel::FilterRxPacket(const uint64_t timestamp, uint32_t& offset, uint32_t& count, uint32_t& flags)
+{
+    offset = 0;
+    if (mRxCmdReset.exchange(false))
+    {
+        mRxCmdActive = false;
+        mRxPaused = false;
+    }
+    //take next command when idle or streaming continuously
+    while (mRxCmdQueued.load() && (!mRxCmdActive || mRxCmd.burstSize == 0))
+    {
+        std::lock_guard<std::mutex> lock(rxCmdLock);
+        if (mRxCommands.empty())
+        {
+            mRxCmdQueued = false;
+            break;
+        }
+        mRxCmd = mRxCommands.front();
+        mRxCommands.pop_front();
+        mRxCmdQueued = !mRxCommands.empty();
+        mRxCmdActive = true;
+        mRxPaused = false;
+    }
+    if (!mRxCmdActive)
+        return !mRxPaused;
+
+    if (mRxCmd.waitForTimestamp)
+    {
+        if (timestamp + count <= mRxCmd.timestamp)
+            return false;
+        if (timestamp < mRxCmd.timestamp)
+        {
+            offset = mRxCmd.timestamp - timestamp;
+            count -= offset;
+        }
+        mRxCmd.waitForTimestamp = false;
+    }
+    if (mRxCmd.burstSize != 0)
+    {
+        if (count >= mRxCmd.burstSize)
+        {
+            count = mRxCmd.burstSize;
+            flags |= IStreamChannel::Metadata::END_BURST;
+            mRxCmdActive = false;
+            mRxPaused = true;
+        }
+        mRxCmd.burstSize -= count;
+    }
+    return true;
+}
+
+ILimeSDRStreaming::Streamer::Streamer(ILimeSDRStreaming* port)
+{
+    dataPort = port;
+    rxRunning = false;
+    txRunning = false;
+    mTimestampOffset = 0;
+    rxLastTimestamp = 0;
+    txLatePackets = 0;
+    rxMetrics.Reset();
+    txMetrics.Reset();
+    cyclicVersion = 0;
+    terminateRx = false;
+    terminateTx = false;
+    rxRunning = false;
+    txRunning = false;
+    generateData = false;
+    startLatency_us = 0;
+    stopLatency_us = 0;
+    startControlTransfers = 0;
+    stopControlTransfers = 0;
+    mInterfaceState.valid = false;
+    mChannelMask = 0;
+    mLinkFormat = StreamConfig::STREAM_12_BIT_COMPRESSED;
+    layoutVersion = 0;
+    rxLayoutAck = rxLayoutApplied = txLayoutAck = txLayoutApplied = 0;
+    txLayoutRelease = 0;
+    memset(&mRxLayoutNext, 0, sizeof(mRxLayoutNext));
+    memset(&mTxLayoutNext, 0, sizeof(mTxLayoutNext));
+    ResetLoopState(false);
+    ResetLoopState(true);
+    rxDataRate_Bps = 0;
+    txDataRate_Bps = 0;
+    txBatchSize = 1;
+    rxBatchSize = 1;
+    mChipID = dataPort->mStreamers.size();
+}
+
+ILimeSDRStreaming::Streamer::~Streamer()
+{
+    for(auto i : mTxStreams)
+        delete i;
+    for(auto i : mRxStreams)
+        delete i;
+}
+
+int ILimeSDRStreaming::Streamer::SetupStream(size_t& streamID, const StreamConfig& config)
+{
+    /*if(rxRunning.load() == true || txRunning.load() == true)
+        return ReportError(EPERM, "All streams must be stopped before doing setups");*/
+    streamID = ~0;
+    StreamChannel* stream = new StreamChannel(this,config);
+    //TODO check for duplicate streams
+    if(config.isTx){
+        mTxStreams.push_back(stream);
+    }
+    else
+    {
+        mRxStreams.push_back(stream);
+    }
+    streamID = size_t(stream);
+    LMS7002M lms;
+    lms.SetConnection(dataPort, mChipID);
+    double rate = lms.GetSampleRate(config.isTx,LMS7002M::ChA)/1e6;
+    int size = (config.isTx) ?  mRxStreams.size(): mRxStreams.size();
+
+    if (config.performanceLatency < 0.5)
+        rate = 0.5 + rate * config.performanceLatency * 2.0 * size;
     else
         rate += (config.performanceLatency - 0.5) * 40.0 * size;
 
@@ -390,9 +1142,10 @@ int ILimeSDRStreaming::Streamer::SetupStream(size_t& streamID, const StreamConfi
 
 int ILimeSDRStreaming::Streamer::CloseStream(const size_t streamID)
 {
-    if(rxRunning.load() == true || txRunning.load() == true)
-        return ReportError(EPERM, "All streams must be stopped before closing");
     StreamChannel *stream = (StreamChannel*)streamID;
+    //detach from data loops, other streams keep running
+    if (stream->IsActive())
+        stream->Stop();
     for(auto i=mRxStreams.begin(); i!=mRxStreams.end(); ++i)
     {
         if(*i==stream)
@@ -411,6 +1164,9 @@ int ILimeSDRStreaming::Streamer::CloseStream(const size_t streamID)
             break;
         }
     }
+    //disable channels that are no longer used by running streamer
+    if (rxRunning.load() or txRunning.load())
+        return UpdateThreads();
     return 0;
 }
 
@@ -474,6 +1230,9 @@ int ILimeSDRStreaming::Streamer::UpdateThreads(bool stopAll)
 {
     bool needTx = false;
     bool needRx = false;
+    const bool wasRunning = rxRunning.load() or txRunning.load();
+    const auto t1 = std::chrono::high_resolution_clock::now();
+    const uint32_t transfers = dataPort->GetControlTransferCount();
 
     //check which threads are needed
     if (!stopAll)
@@ -509,122 +1268,963 @@ int ILimeSDRStreaming::Streamer::UpdateThreads(bool stopAll)
     //configure FPGA on first start, or disable FPGA when not streaming
     if((needTx or needRx) && (not rxRunning.load() and not txRunning.load()))
     {
-        LMS7002M lmsControl;
-        lmsControl.SetConnection(dataPort, mChipID);
-        //enable FPGA streaming
-        fpga::StopStreaming(dataPort, mChipID);
-        fpga::ResetTimestamp(dataPort, mChipID);
         rxLastTimestamp.store(0);
-        //Clear device stream buffers
+        if (ConfigureInterface() != 0)
+            return -1;
+        PublishLayout();
+    }
+    else if(not needTx and not needRx)
+    {
+        //disable FPGA streaming
+        fpga::StopStreaming(dataPort, mChipID);
+    }
+    else if (UpdateRunningLayout() != 0)
+    {
+        //streams could not be switched on the fly, restart streaming
+        lime::warning("Restarting streams to apply channel changes");
+        if (txRunning.load())
+        {
+            terminateTx.store(true);
+            txThread.join();
+            txRunning.store(false);
+        }
+        if (rxRunning.load())
+        {
+            terminateRx.store(true);
+            rxThread.join();
+            rxRunning.store(false);
+        }
+        if (ConfigureInterface() != 0)
+            return -1;
+        PublishLayout();
+    }
+
+    //FPGA should be configured and activated, start needed threads
+    if(needRx and not rxRunning.load())
+    {
+        ResetLoopState(false);
+        rxMetrics.Reset();
+        clockEstimator.Reset(dataPort->GetHardwareTimestampRate());
+        rxRunning.store(true);
+        terminateRx.store(false);
+        rxThread = std::thread(dataPort->RxLoopFunction, this);
+    }
+    if(needTx and not txRunning.load())
+    {
+        if (txThread.joinable())
+            txThread.join();
+        ResetLoopState(true);
+        txMetrics.Reset();
+        txRunning.store(true);
+        terminateTx.store(false);
+        txThread = std::thread(dataPort->TxLoopFunction, this);
+    }
+
+    const bool isRunning = rxRunning.load() or txRunning.load();
+    if (isRunning != wasRunning)
+    {
+        const auto t2 = std::chrono::high_resolution_clock::now();
+        const uint32_t duration_us = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+        const uint32_t transferCount = dataPort->GetControlTransferCount() - transfers;
+        if (isRunning)
+        {
+            startLatency_us.store(duration_us);
+            startControlTransfers.store(transferCount);
+        }
+        else
+        {
+            stopLatency_us.store(duration_us);
+            stopControlTransfers.store(transferCount);
+        }
+        lime::debug("Stream %s took %.3f ms, %u control transfers", isRunning ? "start" : "stop", duration_us/1000.0, transferCount);
+    }
+    return 0;
+}
+
+/** @brief Configures FPGA and LMS7002M LimeLight interface for streaming.
+    All register values are computed from a single batched read and applied
+    with as few control transfers as possible. If the hardware is still in the
+    state applied by the previous start, only stream buffers are flushed and
+    FPGA streaming is enabled again.
+    @return 0-success, other-failure
+*/
+int ILimeSDRStreaming::Streamer::ConfigureInterface()
+{
+    const StreamConfig::StreamDataFormat linkFormat = GetLinkFormat();
+    for(auto i : mRxStreams)
+        i->config.linkFormat = linkFormat;
+    for(auto i : mTxStreams)
+        i->config.linkFormat = linkFormat;
+
+    const uint16_t channelEnables = GetChannelMask();
+    mChannelMask = channelEnables;
+    mLinkFormat = linkFormat;
+
+    //FPGA stream control registers, also used to validate cached interface state
+    const uint32_t fpgaRdAddrs[] = {0x0007, 0x0008, 0x0009, 0x000A};
+    uint32_t fpgaRegs[4];
+    if (dataPort->ReadRegisters(fpgaRdAddrs, fpgaRegs, 4) != 0)
+        return ReportError(EIO, "Failed to read FPGA interface configuration");
+    const uint32_t streamEn = 0x3 << (2*mChipID); //RX_EN | TX_EN
+    const uint32_t tsReset = 0x3 << (2*mChipID); //TXPCT_LOSS_CLR | SMPL_NR_CLR
+    const uint32_t reg000A = fpgaRegs[3] & ~streamEn;
+
+    if (mInterfaceState.valid
+        && mInterfaceState.linkFormat == linkFormat
+        && mInterfaceState.channelEnables == channelEnables
+        && mInterfaceState.lmsWriteCount == dataPort->GetLMS7002MWriteCount()
+        && fpgaRegs[0] == channelEnables
+        && fpgaRegs[1] == mInterfaceState.fpgaMode
+        && (fpgaRegs[3] & streamEn) == 0)
+    {
+        //warm restart: flush buffers, reset timestamp and enable streaming
         dataPort->ResetStreamBuffers();
+        const uint32_t addrs[] = {0x0009, 0x0009, 0x0009, 0x000A};
+        const uint32_t data[] = {fpgaRegs[2] & ~tsReset, fpgaRegs[2] | tsReset,
+            fpgaRegs[2] & ~tsReset, reg000A | (0x1 << (2*mChipID))}; //RX_EN
+        if (dataPort->WriteRegisters(addrs, data, 4) != 0)
+        {
+            mInterfaceState.valid = false;
+            return ReportError(EIO, "Failed to enable FPGA streaming");
+        }
+        return 0;
+    }
+    mInterfaceState.valid = false;
+
+    //read all LMS7002M registers involved in interface setup at once
+    enum {MAC_REG, LML_CFG_REG, LML_MODE_REG, LML2_SRC_REG, AFE_REG, MASK_REG, LMS_REG_COUNT};
+    const uint16_t lmsAddrs[LMS_REG_COUNT] = {0x0020, 0x0022, 0x0023, 0x0027, 0x0082, 0x002F};
+    uint32_t spiWr[LMS_REG_COUNT];
+    uint32_t lmsRegs[LMS_REG_COUNT];
+    for (int i = 0; i < LMS_REG_COUNT; ++i)
+        spiWr[i] = uint32_t(lmsAddrs[i]) << 16;
+    if (dataPort->ReadLMS7002MSPI(spiWr, lmsRegs, LMS_REG_COUNT, mChipID) != 0)
+        return ReportError(EIO, "Failed to read LMS7002M interface configuration");
+    for (int i = 0; i < LMS_REG_COUNT; ++i)
+        lmsRegs[i] &= 0xFFFF;
+
+    uint16_t smpl_width; // 0-16 bit, 1-14 bit, 2-12 bit
+    uint16_t mode;
+    if(linkFormat == StreamConfig::STREAM_12_BIT_IN_16)
+        smpl_width = 0x0;
+    else
+        smpl_width = 0x2;
 
-        //enable MIMO mode, 12 bit compressed values
-        StreamConfig config;
-        config.linkFormat = StreamConfig::STREAM_12_BIT_COMPRESSED;
-        //by default use 12 bit compressed, adjust link format for stream
+    if (GetRegBits(lmsRegs[LML_CFG_REG], LMS7param(LML1_SISODDR)))
+        mode = 0x0040;
+    else if (GetRegBits(lmsRegs[LML_CFG_REG], LMS7param(LML1_TRXIQPULSE)))
+        mode = 0x0180;
+    else
+        mode = 0x0100;
+
+    //FPGA: stop streaming, reset timestamp, set sample format and channels
+    const uint32_t fpgaWrAddrs[] = {0x000A, 0x0009, 0x0009, 0x0009, 0x0008, 0x0007};
+    const uint32_t fpgaWrData[] = {reg000A,
+        fpgaRegs[2] & ~tsReset, fpgaRegs[2] | tsReset, fpgaRegs[2] & ~tsReset,
+        uint32_t(mode | smpl_width), channelEnables};
+    if (dataPort->WriteRegisters(fpgaWrAddrs, fpgaWrData, 6) != 0)
+        return ReportError(EIO, "Failed to configure FPGA for streaming");
+
+    //Clear device stream buffers
+    dataPort->ResetStreamBuffers();
+
+    //LMS7002M: LimeLight ports, sample sources and AFE power
+    uint16_t lmlMode = lmsRegs[LML_MODE_REG];
+    lmlMode = SetRegBits(lmlMode, LMS7param(LML1_MODE), 0);
+    lmlMode = SetRegBits(lmlMode, LMS7param(LML2_MODE), 0);
+    lmlMode = SetRegBits(lmlMode, LMS7param(LML1_FIDM), 0);
+    lmlMode = SetRegBits(lmlMode, LMS7param(LML2_FIDM), 0);
+
+    uint16_t afe = lmsRegs[AFE_REG];
+    afe = SetRegBits(afe, LMS7param(PD_RX_AFE1), 0);
+    afe = SetRegBits(afe, LMS7param(PD_TX_AFE1), 0);
+    afe = SetRegBits(afe, LMS7param(PD_RX_AFE2), 0);
+    afe = SetRegBits(afe, LMS7param(PD_TX_AFE2), 0);
+
+    const bool maskZero = GetRegBits(lmsRegs[MASK_REG], LMS7_MASK) == 0;
+    uint16_t lml2src = lmsRegs[LML2_SRC_REG];
+    lml2src = SetRegBits(lml2src, LMS7param(LML2_S0S), maskZero ? 1 : 0);
+    lml2src = SetRegBits(lml2src, LMS7param(LML2_S1S), maskZero ? 0 : 1);
+    lml2src = SetRegBits(lml2src, LMS7param(LML2_S2S), maskZero ? 3 : 2);
+    lml2src = SetRegBits(lml2src, LMS7param(LML2_S3S), maskZero ? 2 : 3);
+
+    std::vector<uint32_t> spiData;
+    spiData.push_back((1 << 31) | (uint32_t(lmsAddrs[LML_MODE_REG]) << 16) | lmlMode);
+    spiData.push_back((1 << 31) | (uint32_t(lmsAddrs[LML2_SRC_REG]) << 16) | lml2src);
+    spiData.push_back((1 << 31) | (uint32_t(lmsAddrs[AFE_REG]) << 16) | afe);
+
+    if(channelEnables & 0x2) //enable MIMO
+    {
+        if (EnableMIMO(spiData, lmsRegs[MAC_REG]) != 0)
+            return -1;
+    }
+    else if (dataPort->WriteLMS7002MSPI(spiData.data(), spiData.size(), mChipID) != 0)
+        return ReportError(EIO, "Failed to configure LMS7002M for streaming");
+
+    //enable FPGA streaming
+    const uint32_t startAddr = 0x000A;
+    const uint32_t startData = reg000A | (0x1 << (2*mChipID)); //RX_EN
+    if (dataPort->WriteRegisters(&startAddr, &startData, 1) != 0)
+        return ReportError(EIO, "Failed to enable FPGA streaming");
+
+    mInterfaceState.linkFormat = linkFormat;
+    mInterfaceState.channelEnables = channelEnables;
+    mInterfaceState.fpgaMode = mode | smpl_width;
+    mInterfaceState.lmsWriteCount = dataPort->GetLMS7002MWriteCount();
+    mInterfaceState.valid = true;
+    return 0;
+}
 
-        for(auto i : mRxStreams)
+/** @brief Enables channel B LO and RFE sharing needed for MIMO streaming.
+    @param spiData pending LMS7002M SPI writes, sent together with MAC change
+    @param reg0020 current value of LMS7002M register 0x0020
+    @return 0-success, other-failure
+*/
+int ILimeSDRStreaming::Streamer::EnableMIMO(std::vector<uint32_t>& spiData, const uint16_t reg0020)
+{
+    //LO daisy chain controls are in channel A register space
+    const uint16_t macA = SetRegBits(reg0020, LMS7param(MAC), 1);
+    spiData.push_back((1 << 31) | (uint32_t(0x0020) << 16) | macA);
+    if (dataPort->WriteLMS7002MSPI(spiData.data(), spiData.size(), mChipID) != 0)
+        return ReportError(EIO, "Failed to configure LMS7002M for streaming");
+    spiData.clear();
+
+    const uint32_t nextAddrs[] = {uint32_t(LMS7param(EN_NEXTTX_TRF).address) << 16,
+                                  uint32_t(LMS7param(EN_NEXTRX_RFE).address) << 16};
+    uint32_t nextRegs[2];
+    if (dataPort->ReadLMS7002MSPI(nextAddrs, nextRegs, 2, mChipID) != 0)
+        return ReportError(EIO, "Failed to read LMS7002M MIMO configuration");
+    spiData.push_back((1 << 31) | nextAddrs[0] | SetRegBits(nextRegs[0] & 0xFFFF, LMS7param(EN_NEXTTX_TRF), 1));
+    spiData.push_back((1 << 31) | nextAddrs[1] | SetRegBits(nextRegs[1] & 0xFFFF, LMS7param(EN_NEXTRX_RFE), 1));
+    spiData.push_back((1 << 31) | (uint32_t(0x0020) << 16) | reg0020);
+    if (dataPort->WriteLMS7002MSPI(spiData.data(), spiData.size(), mChipID) != 0)
+        return ReportError(EIO, "Failed to configure LMS7002M for streaming");
+    return 0;
+}
+
+/** @brief Returns FPGA channel enables required by all set up streams
+*/
+uint16_t ILimeSDRStreaming::Streamer::GetChannelMask() const
+{
+    uint16_t channelEnables = 0;
+    for(auto i : mRxStreams)
+        channelEnables |= (1 << (i->config.channelID&1));
+    for(auto i : mTxStreams)
+        channelEnables |= (1 << (i->config.channelID&1));
+    return channelEnables;
+}
+
+/** @brief Returns link format required by all set up streams
+*/
+StreamConfig::StreamDataFormat ILimeSDRStreaming::Streamer::GetLinkFormat() const
+{
+    //by default use 12 bit compressed, adjust link format for stream
+    for(auto i : mRxStreams)
+        if(i->config.format == StreamConfig::STREAM_12_BIT_IN_16)
+            return StreamConfig::STREAM_12_BIT_IN_16;
+    for(auto i : mTxStreams)
+        if(i->config.format == StreamConfig::STREAM_12_BIT_IN_16)
+            return StreamConfig::STREAM_12_BIT_IN_16;
+    return StreamConfig::STREAM_12_BIT_COMPRESSED;
+}
+
+static inline uint32_t SamplesInPacket(const ILimeSDRStreaming::Streamer::ChannelLayout& layout)
+{
+    if (layout.chCount == 0)
+        return 0;
+    return (layout.linkFormat == StreamConfig::STREAM_12_BIT_COMPRESSED ? 1360 : 1020)/layout.chCount;
+}
+
+/** @brief Routes active streams to packet slots of current FPGA channel mask
+    and hands the new layout over to data loops.
+*/
+void ILimeSDRStreaming::Streamer::PublishLayout()
+{
+    ChannelLayout rx, tx;
+    memset(&rx, 0, sizeof(rx));
+    memset(&tx, 0, sizeof(tx));
+    rx.chCount = tx.chCount = (mChannelMask & 1) + ((mChannelMask >> 1) & 1);
+    rx.linkFormat = tx.linkFormat = mLinkFormat;
+    for (int ch = 0; ch < 2; ++ch)
+    {
+        if ((mChannelMask & (1 << ch)) == 0)
+            continue;
+        const int slot = (ch == 1 && (mChannelMask & 1)) ? 1 : 0;
+        for (auto i : mRxStreams)
+            if (i->IsActive() && (i->config.channelID&1) == ch)
+                rx.streams[slot] = i;
+        for (auto i : mTxStreams)
+            if (i->IsActive() && (i->config.channelID&1) == ch)
+                tx.streams[slot] = i;
+    }
+    std::lock_guard<std::mutex> lock(layoutLock);
+    rx.version = tx.version = layoutVersion.load() + 1;
+    mRxLayoutNext = rx;
+    mTxLayoutNext = tx;
+    layoutVersion.store(rx.version);
+}
+
+/** @brief Waits until running data loops take over published layout.
+    @param version layout version to wait for
+    @param applied wait for data loops to start parsing and encoding packets with new layout
+    @return true if all running loops use new layout
+*/
+bool ILimeSDRStreaming::Streamer::WaitLayout(const unsigned version, const bool applied)
+{
+    std::unique_lock<std::mutex> lock(layoutLock);
+    return layoutAcked.wait_for(lock, std::chrono::seconds(2), [&]{
+        const bool rxDone = not rxRunning.load() or terminateRx.load()
+            or (applied ? rxLayoutApplied : rxLayoutAck) == version;
+        const bool txDone = not txRunning.load() or terminateTx.load()
+            or (applied ? txLayoutApplied : txLayoutAck) == version;
+        return rxDone and txDone;
+    });
+}
+
+/** @brief Adds or removes streams of running streamer without interrupting others.
+    Stopped streams keep their channels enabled in FPGA and their data is
+    discarded, channels are disabled when their last stream is closed.
+    Changing enabled channels switches packet layout at packet boundary,
+    transmit loop switches once receive loop has detected packets of new size.
+    @return 0-success, other-streams have to be restarted
+*/
+int ILimeSDRStreaming::Streamer::UpdateRunningLayout()
+{
+    if (GetLinkFormat() != mLinkFormat)
+        return -1;
+    for(auto i : mRxStreams)
+        i->config.linkFormat = mLinkFormat;
+    for(auto i : mTxStreams)
+        i->config.linkFormat = mLinkFormat;
+
+    const uint16_t mask = GetChannelMask();
+    if (mask != mChannelMask)
+    {
+        const uint16_t oldMask = mChannelMask;
+        mChannelMask = mask;
+        mInterfaceState.valid = false;
+        PublishLayout();
+        const unsigned version = layoutVersion.load();
+        if (not WaitLayout(version, false))
+            return -1;
+
+        if ((mask & 0x2) && not (oldMask & 0x2))
         {
-            if(i->config.format == StreamConfig::STREAM_12_BIT_IN_16)
+            const uint32_t macAddr = 0x0020 << 16;
+            uint32_t reg0020;
+            std::vector<uint32_t> spiData;
+            if (dataPort->ReadLMS7002MSPI(&macAddr, &reg0020, 1, mChipID) != 0
+                || EnableMIMO(spiData, reg0020 & 0xFFFF) != 0)
+                return -1;
+        }
+        if (dataPort->WriteRegister(0x0007, mask) != 0)
+            return -1;
+        txLayoutRelease.store(version);
+        return WaitLayout(version, true) ? 0 : -1;
+    }
+    PublishLayout();
+    return WaitLayout(layoutVersion.load(), false) ? 0 : -1;
+}
+
+/** @brief Resets state of data loop before it is started
+*/
+void ILimeSDRStreaming::Streamer::ResetLoopState(const bool isTx)
+{
+    std::lock_guard<std::mutex> lock(layoutLock);
+    if (isTx)
+    {
+        txLayout = mTxLayoutNext;
+        txLayoutAck = txLayoutApplied = txLayout.version;
+        mTxSwitchPending = false;
+        mTxNextTs = 0;
+        mTxCyclicValid = false;
+        return;
+    }
+    rxLayout = mRxLayoutNext;
+    rxLayoutAck = rxLayoutApplied = rxLayout.version;
+    mRxSwitchPending = false;
+    mRxHeld = false;
+    mRxPrevTs = 0;
+    mRxPrevSamples = 0;
+}
+
+/** @brief Takes over layout published for receive loop.
+    If channel count changes, new layout is applied when the first packet
+    of new size is detected.
+    @return true if layout has changed
+*/
+bool ILimeSDRStreaming::Streamer::RefreshRxLayout()
+{
+    if (layoutVersion.load() == rxLayoutAck)
+        return false;
+    std::lock_guard<std::mutex> lock(layoutLock);
+    const ChannelLayout& next = mRxLayoutNext;
+    if (next.chCount == rxLayout.chCount)
+    {
+        rxLayout = next;
+        mRxSwitchPending = false;
+        rxLayoutApplied = next.version;
+    }
+    else
+    {
+        mRxPendingLayout = next;
+        mRxSwitchPending = true;
+    }
+    rxLayoutAck = next.version;
+    layoutAcked.notify_all();
+    return true;
+}
+
+/** @brief Takes over layout published for transmit loop.
+    If channel count changes, new layout is applied after FPGA channels are
+    switched and receive loop has detected packets of new size.
+    @return true if layout has changed
+*/
+bool ILimeSDRStreaming::Streamer::RefreshTxLayout()
+{
+    if (layoutVersion.load() == txLayoutAck && not mTxSwitchPending)
+        return false;
+    std::lock_guard<std::mutex> lock(layoutLock);
+    if (txLayoutAck != mTxLayoutNext.version)
+    {
+        const ChannelLayout& next = mTxLayoutNext;
+        if (next.chCount == txLayout.chCount)
+        {
+            txLayout = next;
+            mTxSwitchPending = false;
+            txLayoutApplied = next.version;
+        }
+        else
+        {
+            mTxPendingLayout = next;
+            mTxSwitchPending = true;
+        }
+        txLayoutAck = next.version;
+        layoutAcked.notify_all();
+        return not mTxSwitchPending;
+    }
+    const unsigned version = mTxPendingLayout.version;
+    if (txLayoutRelease.load() != version or (rxRunning.load() and rxLayoutApplied != version))
+        return false;
+    txLayout = mTxPendingLayout;
+    mTxSwitchPending = false;
+    txLayoutApplied = version;
+    layoutAcked.notify_all();
+    return true;
+}
+
+/** @brief Parses received FPGA packet and pushes samples to Rx streams.
+    While FPGA channel count change is pending, packets are delayed by one,
+    packet size is determined by timestamp difference to next packet.
+*/
+void ILimeSDRStreaming::Streamer::ProcessRxPacket(const FPGA_DataPacket& pkt)
+{
+    RefreshRxLayout();
+    if (not mRxSwitchPending)
+    {
+        if (mRxHeld)
+        {
+            ParseRxPacket(mRxHeldPacket);
+            mRxHeld = false;
+        }
+        ParseRxPacket(pkt);
+        return;
+    }
+    if (mRxHeld)
+    {
+        if (pkt.counter - mRxHeldPacket.counter == SamplesInPacket(mRxPendingLayout))
+        {
+            //held packet is the first one with new layout
             {
-                config.linkFormat = StreamConfig::STREAM_12_BIT_IN_16;
-                break;
+                std::lock_guard<std::mutex> lock(layoutLock);
+                rxLayout = mRxPendingLayout;
+                mRxSwitchPending = false;
+                rxLayoutApplied = rxLayout.version;
+                layoutAcked.notify_all();
             }
+            ParseRxPacket(mRxHeldPacket);
+            ParseRxPacket(pkt);
+            mRxHeld = false;
+            return;
         }
-        for(auto i : mTxStreams)
+        ParseRxPacket(mRxHeldPacket);
+    }
+    mRxHeldPacket = pkt;
+    mRxHeld = true;
+}
+
+/** @brief Computes signal statistics of received samples.
+    Runs in the receive loop right after unpacking, while samples are in cache.
+*/
+static void ComputeSignalStats(const complex16_t* samples, const uint32_t count, SignalStats& stats)
+{
+    const int16_t fullScale = 2047;
+    int64_t sumI = 0;
+    int64_t sumQ = 0;
+    uint64_t sumPower = 0;
+    int16_t peak = 0;
+    uint32_t clipCount = 0;
+    uint32_t n = 0;
+#ifdef LIME_USE_SSE2
+    //4 samples per vector, 12 bit sums stay in 16 bit lanes for a run of
+    //16 vectors, 32 bit power accumulators are flushed every block
+    const uint32_t blockSize = 256;
+    const uint32_t runSize = 64;
+    const __m128i selectI = _mm_set1_epi32(0x00000001);
+    const __m128i selectQ = _mm_set1_epi32(0x00010000);
+    const __m128i clipLevel = _mm_set1_epi16(fullScale-1);
+    __m128i peakV = _mm_setzero_si128();
+    while (n + 4 <= count)
+    {
+        const uint32_t end = std::min(n + blockSize, count & ~3u);
+        __m128i sumIV = _mm_setzero_si128();
+        __m128i sumQV = _mm_setzero_si128();
+        __m128i powerV = _mm_setzero_si128();
+        while (n < end)
         {
-            if(i->config.format == StreamConfig::STREAM_12_BIT_IN_16)
+            const uint32_t runStart = n;
+            const uint32_t runEnd = std::min(n + runSize, end);
+            __m128i sumV = _mm_setzero_si128();
+            __m128i runPeakV = _mm_setzero_si128();
+            for (; n < runEnd; n += 4)
             {
-                config.linkFormat = StreamConfig::STREAM_12_BIT_IN_16;
-                break;
+                const __m128i v = _mm_loadu_si128((const __m128i*)&samples[n]);
+                sumV = _mm_add_epi16(sumV, v);
+                powerV = _mm_add_epi32(powerV, _mm_madd_epi16(v, v));
+                runPeakV = _mm_max_epi16(runPeakV, _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v)));
+            }
+            sumIV = _mm_add_epi32(sumIV, _mm_madd_epi16(sumV, selectI));
+            sumQV = _mm_add_epi32(sumQV, _mm_madd_epi16(sumV, selectQ));
+            peakV = _mm_max_epi16(peakV, runPeakV);
+            //clipping is rare, samples are counted only in runs that reach full scale
+            if (_mm_movemask_epi8(_mm_cmpgt_epi16(runPeakV, clipLevel)) != 0)
+            {
+                for (uint32_t k = runStart; k < runEnd; ++k)
+                    clipCount += std::max<int16_t>(std::abs(samples[k].i), std::abs(samples[k].q)) >= fullScale;
             }
         }
-        for(auto i : mRxStreams)
-            i->config.linkFormat = config.linkFormat;
-        for(auto i : mTxStreams)
-            i->config.linkFormat = config.linkFormat;
-
-        uint16_t smpl_width; // 0-16 bit, 1-14 bit, 2-12 bit
-        uint16_t mode;
-        if(config.linkFormat == StreamConfig::STREAM_12_BIT_IN_16)
-            smpl_width = 0x0;
-        else if(config.linkFormat == StreamConfig::STREAM_12_BIT_COMPRESSED)
-            smpl_width = 0x2;
-        else
-            smpl_width = 0x2;
-
-        if (lmsControl.Get_SPI_Reg_bits(LMS7param(LML1_SISODDR),true))
-            mode = 0x0040;
-        else if (lmsControl.Get_SPI_Reg_bits(LMS7param(LML1_TRXIQPULSE),true))
-            mode = 0x0180;
-        else
-            mode = 0x0100;
-
-        dataPort->WriteRegister(0x0008, mode | smpl_width);
-
-        uint16_t channelEnables = 0;
-        for(uint8_t i=0; i<mRxStreams.size(); ++i)
-            channelEnables |= (1 << (mRxStreams[i]->config.channelID&1));
-        for(uint8_t i=0; i<mTxStreams.size(); ++i)
-            channelEnables |= (1 << (mTxStreams[i]->config.channelID&1));
-        dataPort->WriteRegister(0x0007, channelEnables);
-
-        bool fromChip = true;
-        lmsControl.Modify_SPI_Reg_bits(LMS7param(LML1_MODE), 0, fromChip);
-        lmsControl.Modify_SPI_Reg_bits(LMS7param(LML2_MODE), 0, fromChip);
-        lmsControl.Modify_SPI_Reg_bits(LMS7param(LML1_FIDM), 0, fromChip);
-        lmsControl.Modify_SPI_Reg_bits(LMS7param(LML2_FIDM), 0, fromChip);
-        lmsControl.Modify_SPI_Reg_bits(LMS7param(PD_RX_AFE1), 0, fromChip);
-        lmsControl.Modify_SPI_Reg_bits(LMS7param(PD_TX_AFE1), 0, fromChip);
-        lmsControl.Modify_SPI_Reg_bits(LMS7param(PD_RX_AFE2), 0, fromChip);
-        lmsControl.Modify_SPI_Reg_bits(LMS7param(PD_TX_AFE2), 0, fromChip);
-
-        if (lmsControl.Get_SPI_Reg_bits(LMS7_MASK, true) == 0)
+        int32_t lanes[3][4];
+        _mm_storeu_si128((__m128i*)lanes[0], sumIV);
+        _mm_storeu_si128((__m128i*)lanes[1], sumQV);
+        _mm_storeu_si128((__m128i*)lanes[2], powerV);
+        for (int k = 0; k < 4; ++k)
         {
-            lmsControl.Modify_SPI_Reg_bits(LMS7param(LML2_S0S), 1, fromChip);
-            lmsControl.Modify_SPI_Reg_bits(LMS7param(LML2_S1S), 0, fromChip);
-            lmsControl.Modify_SPI_Reg_bits(LMS7param(LML2_S2S), 3, fromChip);
-            lmsControl.Modify_SPI_Reg_bits(LMS7param(LML2_S3S), 2, fromChip);
+            sumI += lanes[0][k];
+            sumQ += lanes[1][k];
+            sumPower += uint32_t(lanes[2][k]);
         }
-        else
+    }
+    int16_t peaks[8];
+    _mm_storeu_si128((__m128i*)peaks, peakV);
+    for (int k = 0; k < 8; ++k)
+        peak = std::max(peak, peaks[k]);
+#endif
+    for (; n < count; ++n)
+    {
+        const int16_t i = samples[n].i;
+        const int16_t q = samples[n].q;
+        sumI += i;
+        sumQ += q;
+        sumPower += int32_t(i)*i + int32_t(q)*q;
+        const int16_t magnitude = std::max<int16_t>(std::abs(i), std::abs(q));
+        peak = std::max(peak, magnitude);
+        clipCount += magnitude >= fullScale;
+    }
+    stats.samplesCount = count;
+    stats.clipCount = clipCount;
+    stats.peak = peak;
+    stats.sumI = sumI;
+    stats.sumQ = sumQ;
+    stats.sumPower = sumPower;
+}
+
+void ILimeSDRStreaming::Streamer::ParseRxPacket(const FPGA_DataPacket& pkt)
+{
+    const uint32_t samplesInPacket = SamplesInPacket(rxLayout);
+    if(mRxPrevSamples != 0 && pkt.counter - mRxPrevTs != mRxPrevSamples && pkt.counter != mRxPrevTs)
+    {
+        int packetLoss = ((pkt.counter - mRxPrevTs)/mRxPrevSamples)-1;
+#ifndef NDEBUG
+        printf("\tRx pktLoss: ts diff: %li  pktLoss: %i\n", long(pkt.counter - mRxPrevTs), packetLoss);
+#endif
+        StreamEvent event;
+        event.type = StreamEvent::EVENT_PACKET_DROPPED;
+        event.timestamp = mRxPrevTs + mRxPrevSamples;
+        event.samplesCount = pkt.counter > event.timestamp ? pkt.counter - event.timestamp : 0;
+        for(int ch=0; ch<rxLayout.chCount; ++ch)
+            if (rxLayout.streams[ch])
+            {
+                StreamChannel* stream = rxLayout.streams[ch];
+                stream->pktLost += packetLoss;
+                stream->PushEvent(event);
+                if (event.samplesCount != 0 && stream->config.gapFillLimit != 0)
+                    stream->FillRxGap(event.timestamp, event.samplesCount);
+                else
+                    stream->rxDiscontinuity = true;
+            }
+    }
+    mRxPrevTs = pkt.counter;
+    mRxPrevSamples = samplesInPacket;
+    rxLastTimestamp.store(pkt.counter);
+    clockEstimator.AddObservation(pkt.counter + samplesInPacket, ClockEstimator::HostTimeNow());
+
+    //samples outside of timed receive commands are dropped without parsing
+    uint32_t offset[2];
+    uint32_t count[2];
+    uint32_t flags[2];
+    bool needed = false;
+    for(int ch=0; ch<rxLayout.chCount; ++ch)
+    {
+        count[ch] = samplesInPacket;
+        flags[ch] = 0;
+        if (rxLayout.streams[ch] && rxLayout.streams[ch]->rxDiscontinuity)
+            flags[ch] |= IStreamChannel::Metadata::DISCONTINUITY;
+        if (rxLayout.streams[ch] == nullptr
+        || !rxLayout.streams[ch]->FilterRxPacket(pkt.counter, offset[ch], count[ch], flags[ch]))
+            count[ch] = 0;
+        needed |= count[ch] != 0;
+    }
+    if (!needed)
+        return;
+
+    const bool timed = rxMetrics.PacketProcessed();
+    std::chrono::steady_clock::time_point parseStart;
+    if (timed)
+        parseStart = std::chrono::steady_clock::now();
+    complex16_t* dest[2] = {mRxFrames[0].samples, mRxFrames[1].samples};
+    size_t samplesCount = 0;
+    fpga::FPGAPacketPayload2Samples(pkt.data, sizeof(pkt.data), rxLayout.chCount, rxLayout.linkFormat, dest, &samplesCount);
+
+    for(int ch=0; ch<rxLayout.chCount; ++ch)
+    {
+        StreamChannel* stream = rxLayout.streams[ch];
+        if (stream == nullptr || count[ch] == 0)
+            continue;
+        IStreamChannel::Metadata meta;
+        meta.timestamp = pkt.counter + offset[ch];
+        meta.flags = flags[ch];
+        SignalStats stats;
+        if (stream->config.signalStats)
+            ComputeSignalStats(dest[ch]+offset[ch], count[ch], stats);
+        uint32_t samplesPushed = stream->PushRxSamples(dest[ch]+offset[ch], count[ch], &meta, stream->config.signalStats ? &stats : nullptr);
+        stream->rxDiscontinuity = samplesPushed != count[ch];
+    }
+    if (timed)
+        rxMetrics.PacketTime(parseStart);
+}
+
+/** @brief Fills FPGA packet with samples from Tx streams.
+    Slots without active stream are filled with zeros, as well as missing
+    samples after end of burst or when stream underflows.
+    Waiting for samples of all streams is limited by one deadline, each
+    stream waits up to its underflowTimeout_ms from the start of the packet.
+    Packets without any samples continue timestamps of previous packets
+    and are sent without waiting for timestamp.
+    @return false if any of the streams did not have enough samples
+*/
+bool ILimeSDRStreaming::Streamer::ReadTxPacket(FPGA_DataPacket& pkt)
+{
+    RefreshTxLayout();
+    const uint32_t samplesInPacket = SamplesInPacket(txLayout);
+    const uint32_t latePackets = txLatePackets.exchange(0);
+    if (latePackets != 0)
+    {
+        //FPGA reported packets that arrived after their timestamp
+        StreamEvent event;
+        event.type = StreamEvent::EVENT_LATE_TIMESTAMP;
+        event.timestamp = txLastLateTime.load();
+        event.samplesCount = latePackets * samplesInPacket;
+        for(int ch=0; ch<txLayout.chCount; ++ch)
+            if (txLayout.streams[ch])
+            {
+                txLayout.streams[ch]->pktLost += latePackets;
+                txLayout.streams[ch]->PushEvent(event);
+            }
+    }
+    if (!mTxCyclicValid || cyclicVersion.load() != mTxCyclicVersion || txLayout.version != mTxCyclicLayout)
+        EncodeCyclicPackets();
+    if (!mTxCyclicPackets.empty())
+    {
+        pkt = mTxCyclicPackets[mTxCyclicIndex];
+        if (++mTxCyclicIndex == mTxCyclicPackets.size())
+            mTxCyclicIndex = 0;
+        pkt.counter = mTxNextTs;
+        mTxNextTs += samplesInPacket;
+        txMetrics.PacketProcessed();
+        return true;
+    }
+    //samples already in the past would be discarded by FPGA, drop them before sending
+    const uint64_t hwTime = EstimateHardwareTime();
+    IStreamChannel::Metadata meta;
+    meta.timestamp = mTxNextTs;
+    meta.flags = 0;
+    bool complete = true;
+    bool hasSamples = false;
+    const complex16_t* src[2] = {mTxSamples[0], mTxSamples[1]};
+    const auto packetStart = std::chrono::steady_clock::now();
+    auto reportLate = [&](StreamChannel* stream, const uint64_t time, const uint32_t samplesDropped)
+    {
+        if (samplesDropped == 0)
+            return;
+        stream->pktLost += (samplesDropped + samplesInPacket - 1) / samplesInPacket;
+        txLastLateTime.store(time);
+        StreamEvent event;
+        event.type = StreamEvent::EVENT_LATE_TIMESTAMP;
+        event.timestamp = time;
+        event.samplesCount = samplesDropped;
+        stream->PushEvent(event);
+    };
+    for(int ch=0; ch<txLayout.chCount; ++ch)
+    {
+        StreamChannel* stream = txLayout.streams[ch];
+        uint32_t samplesPopped = 0;
+        if (stream)
         {
-            lmsControl.Modify_SPI_Reg_bits(LMS7param(LML2_S0S), 0, fromChip);
-            lmsControl.Modify_SPI_Reg_bits(LMS7param(LML2_S1S), 1, fromChip);
-            lmsControl.Modify_SPI_Reg_bits(LMS7param(LML2_S2S), 2, fromChip);
-            lmsControl.Modify_SPI_Reg_bits(LMS7param(LML2_S3S), 3, fromChip);
+            if (hwTime != 0)
+                reportLate(stream, hwTime, stream->DropLateSamples(hwTime));
+            IStreamChannel::Metadata streamMeta;
+            streamMeta.timestamp = 0;
+            streamMeta.flags = 0;
+            //stalled streams do not add up their timeouts
+            const auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - packetStart).count();
+            const int32_t timeout_ms = std::max<int64_t>(0, int64_t(stream->config.underflowTimeout_ms) - waited);
+            samplesPopped = stream->Read(mTxSamples[ch], samplesInPacket, &streamMeta, timeout_ms);
+            //samples written while waiting for them were not checked above
+            if (samplesPopped != 0 && hwTime != 0 && (streamMeta.flags & IStreamChannel::Metadata::SYNC_TIMESTAMP))
+            {
+                const uint64_t now = EstimateHardwareTime();
+                if (streamMeta.timestamp < now)
+                {
+                    const uint32_t late = std::min<uint64_t>(now - streamMeta.timestamp, samplesPopped);
+                    samplesPopped -= late;
+                    memmove(mTxSamples[ch], mTxSamples[ch]+late, samplesPopped*sizeof(complex16_t));
+                    streamMeta.timestamp += late;
+                    reportLate(stream, now, late);
+                }
+            }
+            if (samplesPopped != 0)
+            {
+                meta = streamMeta;
+                hasSamples = true;
+                stream->txBurstEnded = false;
+            }
+            if (streamMeta.flags & IStreamChannel::Metadata::END_BURST)
+            {
+                stream->txBurstEnded = true;
+                StreamEvent event;
+                event.type = StreamEvent::EVENT_END_OF_BURST;
+                event.timestamp = streamMeta.timestamp + samplesPopped;
+                event.samplesCount = 0;
+                stream->PushEvent(event);
+            }
+            else if (samplesPopped != samplesInPacket && !stream->txBurstEnded)
+            {
+                stream->underflow++;
+                complete = false;
+                StreamEvent event;
+                event.type = StreamEvent::EVENT_UNDERFLOW;
+                event.timestamp = (samplesPopped != 0 ? streamMeta.timestamp : mTxNextTs) + samplesPopped;
+                event.samplesCount = samplesInPacket - samplesPopped;
+                stream->PushEvent(event);
+#ifndef NDEBUG
+                printf("popping from TX, samples popped %i/%i\n", samplesPopped, samplesInPacket);
+#endif
+            }
         }
+        memset(&mTxSamples[ch][samplesPopped], 0, (samplesInPacket-samplesPopped)*sizeof(complex16_t));
+    }
+    if (!hasSamples)
+        meta.flags = 0;
+    pkt.counter = meta.timestamp;
+    mTxNextTs = meta.timestamp + samplesInPacket;
+    pkt.reserved[0] = 0;
+    //by default ignore timestamps
+    const int ignoreTimestamp = !(meta.flags & IStreamChannel::Metadata::SYNC_TIMESTAMP);
+    pkt.reserved[0] |= ((int)ignoreTimestamp << 4); //ignore timestamp
+    if (!ignoreTimestamp && hwTime != 0)
+        txMetrics.LeadTime(int64_t(pkt.counter - hwTime));
+    if (txMetrics.PacketProcessed())
+    {
+        const auto encodeStart = std::chrono::steady_clock::now();
+        fpga::Samples2FPGAPacketPayload(src, samplesInPacket, txLayout.chCount, txLayout.linkFormat, pkt.data, nullptr);
+        txMetrics.PacketTime(encodeStart);
+    }
+    else
+        fpga::Samples2FPGAPacketPayload(src, samplesInPacket, txLayout.chCount, txLayout.linkFormat, pkt.data, nullptr);
+    return complete;
+}
+
+/** @brief Estimates current hardware timestamp for transmit loop.
+    Uses clock relation estimated by receive loop, or last received timestamp.
+    Estimate is not later than actual hardware time.
+    @return estimated timestamp, 0 if receive loop is not running
+*/
+uint64_t ILimeSDRStreaming::Streamer::EstimateHardwareTime()
+{
+    if (not rxRunning.load())
+        return 0;
+    uint64_t timestamp = 0;
+    if (clockEstimator.ToTimestamp(ClockEstimator::HostTimeNow(), timestamp))
+        return std::max<uint64_t>(timestamp, rxLastTimestamp.load());
+    return rxLastTimestamp.load();
+}
 
-        if(channelEnables & 0x2) //enable MIMO
+template<typename T>
+static inline void RelaxedAdd(std::atomic<T>& value, const T amount)
+{
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+void ILimeSDRStreaming::Streamer::LinkMetrics::Reset()
+{
+    lastTransfer = std::chrono::steady_clock::time_point();
+    packetsToTiming = 0;
+    packets = 0;
+    bytes = 0;
+    for (auto &bin : intervals)
+        bin = 0;
+    packetTimeSum_ns = 0;
+    packetTimeMax_ns = 0;
+    packetTimeCount = 0;
+    leadTimeMin = std::numeric_limits<int64_t>::max();
+    leadTimeSum = 0;
+    leadTimeCount = 0;
+}
+
+/** @brief Accounts completed link transfer and time since previous one
+*/
+void ILimeSDRStreaming::Streamer::LinkMetrics::TransferCompleted(const uint32_t transferBytes)
+{
+    const auto now = std::chrono::steady_clock::now();
+    if (lastTransfer != std::chrono::steady_clock::time_point())
+    {
+        uint64_t interval_us = std::chrono::duration_cast<std::chrono::microseconds>(now - lastTransfer).count();
+        int bin = 0;
+        while (interval_us > 1 && bin < StreamMetrics::HISTOGRAM_BINS-1)
         {
-            uint16_t macBck = lmsControl.Get_SPI_Reg_bits(LMS7param(MAC), fromChip);
-            lmsControl.Modify_SPI_Reg_bits(LMS7param(MAC), 1, fromChip);
-            lmsControl.Modify_SPI_Reg_bits(LMS7param(EN_NEXTRX_RFE), 1, fromChip);
-            lmsControl.Modify_SPI_Reg_bits(LMS7param(EN_NEXTTX_TRF), 1, fromChip);
-            lmsControl.Modify_SPI_Reg_bits(LMS7param(MAC), macBck, fromChip);
+            interval_us >>= 1;
+            ++bin;
         }
+        RelaxedAdd(intervals[bin], 1u);
+    }
+    lastTransfer = now;
+    RelaxedAdd(bytes, uint64_t(transferBytes));
+}
 
-        fpga::StartStreaming(dataPort, mChipID);
+/** @brief Counts processed packet
+    @return true if processing time of this packet should be measured
+*/
+bool ILimeSDRStreaming::Streamer::LinkMetrics::PacketProcessed()
+{
+    RelaxedAdd(packets, uint64_t(1));
+    if (packetsToTiming != 0)
+    {
+        --packetsToTiming;
+        return false;
     }
-    else if(not needTx and not needRx)
+    packetsToTiming = TIMING_INTERVAL-1;
+    return true;
+}
+
+void ILimeSDRStreaming::Streamer::LinkMetrics::PacketTime(const std::chrono::steady_clock::time_point start)
+{
+    const uint32_t time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    RelaxedAdd(packetTimeSum_ns, uint64_t(time_ns));
+    RelaxedAdd(packetTimeCount, 1u);
+    if (time_ns > packetTimeMax_ns.load(std::memory_order_relaxed))
+        packetTimeMax_ns.store(time_ns, std::memory_order_relaxed);
+}
+
+/** @brief Accounts how far ahead of hardware time Tx packet was sent
+    @param samples packet timestamp minus estimated hardware time
+*/
+void ILimeSDRStreaming::Streamer::LinkMetrics::LeadTime(const int64_t samples)
+{
+    RelaxedAdd(leadTimeSum, samples);
+    RelaxedAdd(leadTimeCount, 1u);
+    if (samples < leadTimeMin.load(std::memory_order_relaxed))
+        leadTimeMin.store(samples, std::memory_order_relaxed);
+}
+
+void ILimeSDRStreaming::Streamer::LinkMetrics::Get(StreamMetrics& metrics) const
+{
+    metrics.packetsTransferred = packets.load();
+    metrics.bytesTransferred = bytes.load();
+    for (int i = 0; i < StreamMetrics::HISTOGRAM_BINS; ++i)
+        metrics.transferIntervals[i] = intervals[i].load();
+    const uint32_t timedPackets = packetTimeCount.load();
+    metrics.packetTimeAvg_ns = timedPackets ? packetTimeSum_ns.load() / timedPackets : 0;
+    metrics.packetTimeMax_ns = packetTimeMax_ns.load();
+    metrics.txLeadTimeCount = leadTimeCount.load();
+    metrics.txLeadTimeMin = metrics.txLeadTimeCount ? leadTimeMin.load() : 0;
+    metrics.txLeadTimeAvg = metrics.txLeadTimeCount ? leadTimeSum.load() / metrics.txLeadTimeCount : 0;
+}
+
+/** @brief Encodes cyclic buffers of Tx streams into FPGA packets.
+    Waveform is repeated until it ends on packet boundary, so that packets
+    can be replayed without discontinuities. If that takes too much memory,
+    last packet of the waveform is padded with zeros.
+*/
+void ILimeSDRStreaming::Streamer::EncodeCyclicPackets()
+{
+    const size_t maxPackets = 16384;
+    std::lock_guard<std::mutex> lock(cyclicLock);
+    mTxCyclicValid = true;
+    mTxCyclicVersion = cyclicVersion.load();
+    mTxCyclicLayout = txLayout.version;
+    mTxCyclicPackets.clear();
+    mTxCyclicIndex = 0;
+
+    size_t length = 0;
+    const complex16_t* cyclic[2] = {nullptr, nullptr};
+    for(int ch=0; ch<txLayout.chCount; ++ch)
     {
-        //disable FPGA streaming
-        fpga::StopStreaming(dataPort, mChipID);
+        StreamChannel* stream = txLayout.streams[ch];
+        if (stream == nullptr || stream->cyclicSamples.empty())
+            continue;
+        if (length != 0 && stream->cyclicSamples.size() != length)
+        {
+            lime::warning("Cyclic buffers of Tx channels have different lengths, transmitting FIFO samples");
+            return;
+        }
+        length = stream->cyclicSamples.size();
+        cyclic[ch] = stream->cyclicSamples.data();
     }
+    if (length == 0)
+        return;
 
-    //FPGA should be configured and activated, start needed threads
-    if(needRx and not rxRunning.load())
+    const size_t samplesInPacket = SamplesInPacket(txLayout);
+    size_t a = length, b = samplesInPacket;
+    while (b != 0)
     {
-        rxRunning.store(true);
-        terminateRx.store(false);
-        rxThread = std::thread(dataPort->RxLoopFunction, this);
+        const size_t r = a % b;
+        a = b;
+        b = r;
     }
-    if(needTx and not txRunning.load())
+    size_t totalSamples = length * (samplesInPacket / a);
+    if (totalSamples / samplesInPacket > maxPackets)
     {
-        if (txThread.joinable())
-            txThread.join();
-        txRunning.store(true);
-        terminateTx.store(false);
-        txThread = std::thread(dataPort->TxLoopFunction, this);
+        lime::warning("Cyclic buffer length is not multiple of %u samples, waveform is padded with zeros", unsigned(samplesInPacket));
+        totalSamples = length;
+    }
+    mTxCyclicPackets.resize((totalSamples + samplesInPacket - 1) / samplesInPacket);
+
+    const complex16_t* src[2] = {mTxSamples[0], mTxSamples[1]};
+    size_t pos = 0;
+    for (auto &pkt : mTxCyclicPackets)
+    {
+        for(int ch=0; ch<txLayout.chCount; ++ch)
+            for (size_t i = 0; i < samplesInPacket; ++i)
+            {
+                if (cyclic[ch] == nullptr || pos + i >= totalSamples)
+                    mTxSamples[ch][i].i = mTxSamples[ch][i].q = 0;
+                else
+                    mTxSamples[ch][i] = cyclic[ch][(pos + i) % length];
+            }
+        pos += samplesInPacket;
+        memset(pkt.reserved, 0, sizeof(pkt.reserved));
+        pkt.reserved[0] = 1 << 4; //ignore timestamp
+        pkt.counter = 0;
+        fpga::Samples2FPGAPacketPayload(src, samplesInPacket, txLayout.chCount, txLayout.linkFormat, pkt.data, nullptr);
     }
-    return 0;
 }
@@ -6,15 +6,22 @@
 #include <mutex>
 #include <condition_variable>
 #include <vector>
+#include <deque>
+#include <chrono>
 
 #include "dataTypes.h"
 #include "fifo.h"
+#include "StreamEventQueue.h"
+#include "ClockEstimator.h"
+#include "RxCapture.h"
+#include "SpectrumMonitor.h"
 #include "LMS64CProtocol.h"
+#include "StreamTransport.h"
 
 namespace lime
 {
 
-class ILimeSDRStreaming : public LMS64CProtocol
+class LIME_API ILimeSDRStreaming : public LMS64CProtocol
 {
 public:
 
@@ -34,19 +41,76 @@ public:
 
         int Read(void* samples, const uint32_t count, Metadata* meta, const int32_t timeout_ms = 100);
         int Write(const void* samples, const uint32_t count, const Metadata* meta, const int32_t timeout_ms = 100);
+        int SetCyclicBuffer(const void* samples, const uint32_t count);
+        int PushRxSamples(const complex16_t* samples, const uint32_t count, const Metadata* meta, const SignalStats* stats);
+        bool FillRxGap(const uint64_t timestamp, const uint32_t count);
+        int GetSignalStats(SignalStats& stats);
+        int ArmCapture(const CaptureConfig& config);
+        int TriggerCapture();
+        int ReadCapture(void* samples, const uint32_t count, Metadata* meta, uint64_t* triggerTimestamp, const int32_t timeout_ms = 100);
+        int DisarmCapture();
+        int StartSpectrumMonitor(const SpectrumConfig& config);
+        int ReadSpectrum(float* bins, const uint32_t count, uint64_t* timestamp, const int32_t timeout_ms = 100);
+        int StopSpectrumMonitor();
+        uint32_t DropLateSamples(const uint64_t timestamp);
+        void PushEvent(const StreamEvent& event);
+        int GetMetrics(StreamMetrics& metrics);
+        size_t GetDirectBufferCount() const;
+        int GetDirectBufferAddr(const size_t handle, void** buffer);
+        int AcquireReadBuffer(size_t& handle, const void** buffer, Metadata* meta, const int32_t timeout_ms);
+        int ReleaseReadBuffer(const size_t handle);
+        int AcquireWriteBuffer(size_t& handle, void** buffer, const int32_t timeout_ms);
+        int ReleaseWriteBuffer(const size_t handle, const uint32_t count, const Metadata* meta);
         StreamChannel::Info GetInfo();
 
         bool IsActive() const;
         int Start();
         int Stop();
+        int ScheduleRx(const uint64_t timestamp, const bool waitForTimestamp, const size_t burstSize);
+        bool FilterRxPacket(const uint64_t timestamp, uint32_t& offset, uint32_t& count, uint32_t& flags);
         StreamConfig config;
         Streamer* mStreamer;
         unsigned overflow;
         unsigned underflow;
         unsigned pktLost;
+        bool txBurstEnded; //transmit loop: no samples expected until next burst
+        bool rxDiscontinuity; //receive loop: next pushed samples do not continue previous ones
+        std::vector<complex16_t> cyclicSamples; //guarded by Streamer::cyclicLock
+        StreamEventQueue events;
+        RxCapture capture; //takes received samples in place of FIFO while enabled
+        SpectrumMonitor spectrum; //copies received samples while collecting frame
     protected:
+        std::atomic<uint64_t> mEventSamples[StreamEvent::EVENT_END_OF_BURST+1]; //samples affected by events since Start()
+        std::atomic<uint64_t> mOverflowOldest; //overflow samples by cause since Start()
+        std::atomic<uint64_t> mOverflowNewest;
+        std::atomic<uint64_t> mOverflowDecimated;
+        bool mRxDecimating; //receive loop: OVERFLOW_DECIMATE is skipping packets
+        bool mRxDecimateSkip; //receive loop: last packet was skipped
         RingFIFO* fifo;
         bool mActive;
+        std::vector<complex16_t> mConvertBuffer; //host format conversion in Read()/Write()
+        SignalStats mReadStats; //statistics of samples returned by last Read()
+        std::vector<complex16_t> mGapSamples; //samples inserted in place of lost packets
+
+        //timed receive command
+        struct RxCommand
+        {
+            uint64_t timestamp;
+            bool waitForTimestamp;
+            size_t burstSize; //0 for continuous streaming
+        };
+        std::mutex rxCmdLock;
+        std::deque<RxCommand> mRxCommands;
+        std::atomic<bool> mRxCmdQueued;
+        std::atomic<bool> mRxCmdReset;
+        //used by receive loop
+        RxCommand mRxCmd;
+        bool mRxCmdActive;
+        bool mRxPaused;
+        //used by Read()
+        uint64_t mRxNextTimestamp; //timestamp following last read sample
+        bool mRxSyncPending;
+        uint64_t mRxSyncTimestamp;
     private:
         StreamChannel() = default;
     };
@@ -66,9 +130,62 @@ public:
         uint64_t GetHardwareTimestamp(void);
         void SetHardwareTimestamp(const uint64_t now);
         int UpdateThreads(bool stopAll = false);
+        int ConfigureInterface();
+
+        /** @brief Routing of streams to channel slots of FPGA packets.
+            Slots are the enabled channels in order of appearance in a packet.
+        */
+        struct ChannelLayout
+        {
+            unsigned version;
+            uint8_t chCount;
+            StreamConfig::StreamDataFormat linkFormat;
+            StreamChannel* streams[2]; //nullptr if slot has no active stream
+        };
+        void ProcessRxPacket(const FPGA_DataPacket& pkt);
+        bool ReadTxPacket(FPGA_DataPacket& pkt);
+        bool RefreshRxLayout();
+        bool RefreshTxLayout();
+        uint64_t EstimateHardwareTime();
+        ChannelLayout rxLayout; //used by receive loop
+        ChannelLayout txLayout; //used by transmit loop
+
+        /** @brief Performance figures of one streaming thread.
+            Only the owning thread writes the values, so updates are plain
+            relaxed load and store, other threads read them at any time.
+        */
+        class LinkMetrics
+        {
+        public:
+            void Reset();
+            void TransferCompleted(const uint32_t bytes);
+            bool PacketProcessed(); //true for packets that should be timed
+            void PacketTime(const std::chrono::steady_clock::time_point start);
+            void LeadTime(const int64_t samples);
+            void Get(StreamMetrics& metrics) const;
+        private:
+            static const unsigned TIMING_INTERVAL = 16;
+            std::chrono::steady_clock::time_point lastTransfer;
+            unsigned packetsToTiming;
+            std::atomic<uint64_t> packets;
+            std::atomic<uint64_t> bytes;
+            std::atomic<uint32_t> intervals[StreamMetrics::HISTOGRAM_BINS];
+            std::atomic<uint64_t> packetTimeSum_ns;
+            std::atomic<uint32_t> packetTimeMax_ns;
+            std::atomic<uint32_t> packetTimeCount;
+            std::atomic<int64_t> leadTimeMin;
+            std::atomic<int64_t> leadTimeSum;
+            std::atomic<uint32_t> leadTimeCount;
+        };
+        LinkMetrics rxMetrics; //updated by receive loop
+        LinkMetrics txMetrics; //updated by transmit loop
 
         std::atomic<uint32_t> rxDataRate_Bps;
         std::atomic<uint32_t> txDataRate_Bps;
+        std::atomic<uint32_t> startLatency_us; //duration of last stream start
+        std::atomic<uint32_t> stopLatency_us; //duration of last stream stop
+        std::atomic<uint32_t> startControlTransfers; //control transfers issued by last stream start
+        std::atomic<uint32_t> stopControlTransfers; //control transfers issued by last stream stop
         ILimeSDRStreaming* dataPort;
         std::thread rxThread;
         std::thread txThread;
@@ -83,11 +200,67 @@ public:
         std::vector<StreamChannel*> mRxStreams;
         std::vector<StreamChannel*> mTxStreams;
         std::atomic<uint64_t> rxLastTimestamp;
+        ClockEstimator clockEstimator; //updated by receive loop
         std::atomic<uint64_t> txLastLateTime;
+        std::atomic<uint32_t> txLatePackets; //reported by FPGA, accounted to Tx streams by transmit loop
+        std::mutex cyclicLock;
+        std::atomic<unsigned> cyclicVersion; //incremented when cyclic buffer of any stream changes
         uint64_t mTimestampOffset;
         int mChipID;
         unsigned txBatchSize;
         unsigned rxBatchSize;
+    protected:
+        //last interface configuration applied to hardware
+        struct InterfaceState
+        {
+            bool valid;
+            StreamConfig::StreamDataFormat linkFormat;
+            uint16_t channelEnables;
+            uint32_t fpgaMode;
+            uint32_t lmsWriteCount;
+        };
+        InterfaceState mInterfaceState;
+
+        uint16_t GetChannelMask() const;
+        StreamConfig::StreamDataFormat GetLinkFormat() const;
+        int EnableMIMO(std::vector<uint32_t>& spiData, const uint16_t reg0020);
+        void PublishLayout();
+        bool WaitLayout(const unsigned version, const bool applied);
+        int UpdateRunningLayout();
+        void ParseRxPacket(const FPGA_DataPacket& pkt);
+        void ResetLoopState(const bool isTx);
+        void EncodeCyclicPackets();
+
+        uint16_t mChannelMask; //channels enabled in FPGA packets
+        StreamConfig::StreamDataFormat mLinkFormat;
+        std::mutex layoutLock;
+        std::condition_variable layoutAcked;
+        std::atomic<unsigned> layoutVersion;
+        ChannelLayout mRxLayoutNext;
+        ChannelLayout mTxLayoutNext;
+        unsigned rxLayoutAck; //layout version seen by receive loop
+        unsigned rxLayoutApplied; //layout version used for parsing
+        unsigned txLayoutAck;
+        unsigned txLayoutApplied; //layout version used for encoding
+        std::atomic<unsigned> txLayoutRelease; //layout version enabled in FPGA
+        //receive loop state
+        ChannelLayout mRxPendingLayout;
+        bool mRxSwitchPending;
+        bool mRxHeld;
+        FPGA_DataPacket mRxHeldPacket;
+        uint64_t mRxPrevTs;
+        uint32_t mRxPrevSamples;
+        StreamChannel::Frame mRxFrames[2];
+        //transmit loop state
+        ChannelLayout mTxPendingLayout;
+        bool mTxSwitchPending;
+        complex16_t mTxSamples[2][SamplesPacket::maxSamplesInPacket];
+        uint64_t mTxNextTs; //timestamp following last sent packet
+        bool mTxCyclicValid;
+        unsigned mTxCyclicVersion; //cyclic buffers version used for encoding
+        unsigned mTxCyclicLayout; //layout version used for encoding
+        std::vector<FPGA_DataPacket> mTxCyclicPackets;
+        size_t mTxCyclicIndex;
     };
 
     ILimeSDRStreaming();
@@ -97,9 +270,27 @@ public:
     virtual int CloseStream(const size_t streamID);
     virtual size_t GetStreamSize(const size_t streamID);
     virtual int ControlStream(const size_t streamID, const bool enable);
+    virtual int ScheduleRxStream(const size_t streamID, const size_t burstSize, const StreamMetadata& metadata);
     virtual int ReadStream(const size_t streamID, void* buffs, const size_t length, const long timeout_ms, StreamMetadata& metadata);
     virtual int WriteStream(const size_t streamID, const void* buffs, const size_t length, const long timeout_ms, const StreamMetadata& metadata);
     virtual int ReadStreamStatus(const size_t streamID, const long timeout_ms, StreamMetadata& metadata);
+    virtual int ReadStreamEvent(const size_t streamID, const long timeout_ms, StreamEvent& event);
+    virtual int GetStreamEventFd(const size_t streamID);
+    virtual int GetStreamMetrics(const size_t streamID, StreamMetrics &metrics);
+    virtual int GetSignalStats(const size_t streamID, SignalStats &stats);
+    virtual int ArmCapture(const size_t streamID, const CaptureConfig &config);
+    virtual int TriggerCapture(const size_t streamID);
+    virtual int ReadCapture(const size_t streamID, void* buffs, const size_t length, const long timeout_ms, StreamMetadata& metadata, uint64_t& triggerTimestamp);
+    virtual int DisarmCapture(const size_t streamID);
+    virtual int StartSpectrumMonitor(const size_t streamID, const SpectrumConfig &config);
+    virtual int ReadSpectrum(const size_t streamID, float* bins, const size_t length, const long timeout_ms, StreamMetadata& metadata);
+    virtual int StopSpectrumMonitor(const size_t streamID);
+    virtual size_t GetNumDirectAccessBuffers(const size_t streamID);
+    virtual int GetDirectAccessBufferAddr(const size_t streamID, const size_t handle, void** buffer);
+    virtual int AcquireReadBuffer(const size_t streamID, size_t& handle, const void** buffer, const long timeout_ms, StreamMetadata& metadata);
+    virtual int ReleaseReadBuffer(const size_t streamID, const size_t handle);
+    virtual int AcquireWriteBuffer(const size_t streamID, size_t& handle, void** buffer, const long timeout_ms);
+    virtual int ReleaseWriteBuffer(const size_t streamID, const size_t handle, const size_t length, const StreamMetadata& metadata);
 
     virtual int UpdateExternalDataRate(const size_t channel, const double txRate_Hz, const double rxRate_Hz) = 0;
     virtual void EnterSelfCalibration(const size_t channel);
@@ -107,14 +298,37 @@ public:
     virtual uint64_t GetHardwareTimestamp(void);
     virtual void SetHardwareTimestamp(const uint64_t now);
     virtual double GetHardwareTimestampRate(void);
+    virtual int TimestampToHostTime(const uint64_t timestamp, int64_t& hostTime_ns);
+    virtual int HostTimeToTimestamp(const int64_t hostTime_ns, uint64_t& timestamp);
 
     int UploadWFM(const void* const* samples, uint8_t chCount, size_t sample_count, StreamConfig::StreamDataFormat format, int epIndex) override;
 
+    static uint32_t HostSampleSize(const StreamConfig::StreamDataFormat format);
+    static void HostToSamples(const void* src, complex16_t* dest, const uint32_t count, const StreamConfig::StreamDataFormat format);
+
 protected:
+    /** @brief Transfer settings of one streaming direction,
+        filled with defaults before OpenStreamTransport() is called
+    */
+    struct TransportConfig
+    {
+        uint32_t packetsPerTransfer; //FPGA packets in one buffer
+        uint32_t buffersCount; //transfers kept in flight
+        uint32_t lateFlagsMask; //register 0x0009 bits pulsed to clear late Tx flags
+    };
+
     virtual int ReceiveData(char* buffer, int length, int epIndex, int timeout = 100);
     virtual int SendData(const char* buffer, int length, int epIndex, int timeout = 100);
-    virtual void ReceivePacketsLoop(Streamer* args) = 0;
-    virtual void TransmitPacketsLoop(Streamer* args) = 0;
+
+    /** @brief Creates transport moving FPGA packets of given stream
+        @param stream streamer of the chip
+        @param isTx true for transmit direction
+        @param config [in,out] transfer settings
+        @return transport owned by the caller, nullptr on failure
+    */
+    virtual StreamTransport* OpenStreamTransport(Streamer* stream, const bool isTx, TransportConfig& config);
+    virtual void ReceivePacketsLoop(Streamer* args);
+    virtual void TransmitPacketsLoop(Streamer* args);
     std::vector<Streamer*> mStreamers;
     std::condition_variable safeToConfigInterface;
     double mExpectedSampleRate; //rate used for generating data
@@ -44,11 +44,12 @@ LMS64CProtocol::LMS64CProtocol(void)
 {
     //set a sane-default for the rate
     _cachedRefClockRate = 61.44e6/2;
+    mControlTransferCount = 0;
+    mLMS7002MWriteCount = 0;
 }
 
 LMS64CProtocol::~LMS64CProtocol(void)
 {
-    return;
 }
 
 int LMS64CProtocol::DeviceReset(void)
@@ -61,6 +62,7 @@ int LMS64CProtocol::DeviceReset(void)
     GenericPacket pkt;
     pkt.cmd = CMD_LMS7002_RST;
     pkt.outBuffer.push_back (LMS_RST_PULSE);
+    mLMS7002MWriteCount++;
     int status = this->TransferPacket(pkt);
 
     return convertStatus(status, pkt);
@@ -160,6 +162,7 @@ int LMS64CProtocol::WriteLMS7002MSPI(const uint32_t *writeData, size_t size, uns
         pkt.outBuffer.push_back(data & 0xFF);
     }
 
+    mLMS7002MWriteCount++;
     int status = this->TransferPacket(pkt);
 
     return convertStatus(status, pkt);
@@ -389,40 +392,26 @@ int LMS64CProtocol::TransferPacket(GenericPacket& pkt)
     int status = 0;
     if(IsOpen() == false) ReportError(ENOTCONN, "connection is not open");
 
-    int packetLen;
     eLMS_PROTOCOL protocol = LMS_PROTOCOL_UNDEFINED;
     if(this->GetType() == SPI_PORT)
         protocol = LMS_PROTOCOL_NOVENA;
     else
         protocol = LMS_PROTOCOL_LMS64C;
-    switch(protocol)
-    {
-    case LMS_PROTOCOL_UNDEFINED:
-        return ReportError("protocol type undefined");
-    case LMS_PROTOCOL_LMS64C:
-        packetLen = ProtocolLMS64C::pktLength;
-        break;
-    case LMS_PROTOCOL_NOVENA:
-        packetLen = pkt.outBuffer.size() > ProtocolNovena::pktLength ? ProtocolNovena::pktLength : pkt.outBuffer.size();
-        break;
-    default:
-        packetLen = 0;
-        return ReportError("Unknown protocol type %d", int(protocol));
-    }
-    int outLen = 0;
-    unsigned char* outBuffer = NULL;
-    outBuffer = PreparePacket(pkt, outLen, protocol);
-    unsigned char* inBuffer = new unsigned char[outLen];
-    memset(inBuffer, 0, outLen);
-
-    int outBufPos = 0;
-    int inDataPos = 0;
+
+    //buffers keep their capacity between transfers
+    mOutBuffer.clear();
+    int outLen = PreparePacket(pkt, mOutBuffer, protocol);
     if(outLen == 0)
     {
         //printf("packet outlen = 0\n");
         outLen = 1;
+        mOutBuffer.resize(outLen, 0);
     }
+    mInBuffer.assign(outLen, 0);
+    const unsigned char* outBuffer = mOutBuffer.data();
+    unsigned char* inBuffer = mInBuffer.data();
 
+    int inDataPos = 0;
     if(protocol == LMS_PROTOCOL_NOVENA)
     {
         bool transferData = true; //some commands are fake, so don't need transferring
@@ -444,6 +433,7 @@ int LMS64CProtocol::TransferPacket(GenericPacket& pkt)
         {
             if (callback_logData)
                 callback_logData(true, outBuffer, outLen);
+            mControlTransferCount++;
             int bytesWritten = Write(outBuffer, outLen);
             if( bytesWritten == outLen)
             {
@@ -466,49 +456,67 @@ int LMS64CProtocol::TransferPacket(GenericPacket& pkt)
     }
     else
     {
-        for(int i=0; i<outLen; i+=packetLen)
+        status = TransferLMS64C(outBuffer, inBuffer, outLen, inDataPos);
+        ParsePacket(pkt, inBuffer, inDataPos, protocol);
+    }
+    return convertStatus(status, pkt);
+}
+
+/** @brief Exchanges LMS64C packets with device. Several packets are kept
+    in flight, replies arrive in order and each is matched to its request.
+    @param outBuffer packets to send
+    @param inBuffer receives replies, same size as outBuffer
+    @param length number of bytes to send, multiple of packet length
+    @param inLength returns number of bytes received
+    @return 0: success, other: failure
+*/
+int LMS64CProtocol::TransferLMS64C(const unsigned char* outBuffer, unsigned char* inBuffer, const int length, int &inLength)
+{
+    const int packetLen = ProtocolLMS64C::pktLength;
+    const int packetCount = length/packetLen;
+    const int window = std::max(1, ControlPacketsInFlight());
+    int sent = 0;
+    inLength = 0;
+    for(int received = 0; received < packetCount; ++received)
+    {
+        //refill once half of the window is free, to write packets in chunks
+        if(sent < packetCount && sent - received <= window/2)
         {
-            int bytesToSend = packetLen;
+            const int count = std::min(window - (sent - received), packetCount - sent);
+            const int bytesToSend = count*packetLen;
             if (callback_logData)
-                callback_logData(true, &outBuffer[outBufPos], bytesToSend);
-            if( Write(&outBuffer[outBufPos], bytesToSend) )
-            {
-                outBufPos += packetLen;
-                long readLen = packetLen;
-                int bread = Read(&inBuffer[inDataPos], readLen);
-                if(bread != readLen && protocol != LMS_PROTOCOL_NOVENA)
-                {
-                    status = ReportError(EIO, "Read(%d bytes) failed", (int)readLen);
-                    break;
-                }
-                if (callback_logData)
-                    callback_logData(false, &inBuffer[inDataPos], bread);
-                inDataPos += bread;
-            }
-            else
-            {
-                status = ReportError(EIO, "Write(%d bytes) failed", (int)bytesToSend);
-                break;
-            }
+                callback_logData(true, &outBuffer[sent*packetLen], bytesToSend);
+            mControlTransferCount += count;
+            if(Write(&outBuffer[sent*packetLen], bytesToSend) != bytesToSend)
+                return ReportError(EIO, "Write(%d bytes) failed", bytesToSend);
+            sent += count;
         }
-        ParsePacket(pkt, inBuffer, inDataPos, protocol);
+        unsigned char* reply = &inBuffer[received*packetLen];
+        const int bread = Read(reply, packetLen);
+        if(bread != packetLen)
+            return ReportError(EIO, "Read(%d bytes) failed", packetLen);
+        if (callback_logData)
+            callback_logData(false, reply, bread);
+        inLength += bread;
+        if(reply[0] != outBuffer[received*packetLen])
+            return ReportError(EPROTO, "Reply to command 0x%02X received for command 0x%02X",
+                int(reply[0]), int(outBuffer[received*packetLen]));
     }
-    delete[] outBuffer;
-    delete[] inBuffer;
-    return convertStatus(status, pkt);
+    return 0;
 }
 
 /** @brief Takes generic packet and converts to specific protocol buffer
     @param pkt generic data packet to convert
-    @param length returns length of returned buffer
+    @param output buffer to append converted data to
     @param protocol which protocol to use for data
-    @return pointer to data buffer, must be manually deleted after use
+    @return number of bytes appended
 */
-unsigned char* LMS64CProtocol::PreparePacket(const GenericPacket& pkt, int& length, const eLMS_PROTOCOL protocol)
+int LMS64CProtocol::PreparePacket(const GenericPacket& pkt, std::vector<unsigned char> &output, const eLMS_PROTOCOL protocol)
 {
-    unsigned char* buffer = NULL;
+    const size_t start = output.size();
+    int length = 0;
     if(protocol == LMS_PROTOCOL_UNDEFINED)
-        return NULL;
+        return 0;
 
     if(protocol == LMS_PROTOCOL_LMS64C)
     {
@@ -556,8 +564,8 @@ unsigned char* LMS64CProtocol::PreparePacket(const GenericPacket& pkt, int& leng
         bufLen *= packet.pktLength;
         if(bufLen == 0)
             bufLen = packet.pktLength;
-        buffer = new unsigned char[bufLen];
-        memset(buffer, 0, bufLen);
+        output.resize(start + bufLen, 0);
+        unsigned char* buffer = &output[start];
         unsigned int srcPos = 0;
         for(int j=0; j*packet.pktLength<bufLen; ++j)
         {
@@ -583,7 +591,8 @@ unsigned char* LMS64CProtocol::PreparePacket(const GenericPacket& pkt, int& leng
     {
         if(pkt.cmd == CMD_LMS7002_RST)
         {
-            buffer = new unsigned char[8];
+            output.resize(start + 8);
+            unsigned char* buffer = &output[start];
             buffer[0] = 0x88;
             buffer[1] = 0x06;
             buffer[2] = 0x00;
@@ -596,8 +605,8 @@ unsigned char* LMS64CProtocol::PreparePacket(const GenericPacket& pkt, int& leng
         }
         else
         {
-            buffer = new unsigned char[pkt.outBuffer.size()];
-            memcpy(buffer, &pkt.outBuffer[0], pkt.outBuffer.size());
+            output.insert(output.end(), pkt.outBuffer.begin(), pkt.outBuffer.end());
+            unsigned char* buffer = output.data() + start;
             if (pkt.cmd == CMD_LMS7002_WR)
             {
                 for(size_t i=0; i<pkt.outBuffer.size(); i+=4)
@@ -606,7 +615,7 @@ unsigned char* LMS64CProtocol::PreparePacket(const GenericPacket& pkt, int& leng
             length = pkt.outBuffer.size();
         }
     }
-    return buffer;
+    return length;
 }
 
 /** @brief Parses given data buffer into generic packet
@@ -629,7 +638,9 @@ int LMS64CProtocol::ParsePacket(GenericPacket& pkt, const unsigned char* buffer,
         for(int i=0; i<length; i+=packet.pktLength)
         {
             pkt.cmd = (eCMD_LMS)buffer[i];
-            pkt.status = (eCMD_STATUS)buffer[i+1];
+            //status of first failed packet is reported
+            if(i == 0 || pkt.status == STATUS_COMPLETED_CMD)
+                pkt.status = (eCMD_STATUS)buffer[i+1];
             memcpy(&pkt.inBuffer[inBufPos], &buffer[i+8], packet.maxDataLength);
             inBufPos += packet.maxDataLength;
         }
@@ -7,6 +7,7 @@
 #pragma once
 #include <IConnection.h>
 #include <mutex>
+#include <atomic>
 #include <LMS64CCommands.h>
 #include <LMSBoards.h>
 
@@ -189,10 +190,22 @@ public:
     int ProgramMCU(const uint8_t *buffer, const size_t length, const MCU_PROG_MODE mode, ProgrammingCallback callback) override;
     int WriteLMS7002MSPI(const uint32_t *writeData, size_t size,unsigned periphID = 0) override;
     int ReadLMS7002MSPI(const uint32_t *writeData, uint32_t *readData, size_t size, unsigned periphID = 0) override;
+
+    //! Number of control packets exchanged with the device since connecting
+    uint32_t GetControlTransferCount(void) const {return mControlTransferCount.load();}
+
+    //! Number of LMS7002M SPI write commands issued, used to detect register changes
+    uint32_t GetLMS7002MWriteCount(void) const {return mLMS7002MWriteCount.load();}
 protected:
     int GetChipVersion();
     unsigned chipVersion;
+
+    /** @brief Number of LMS64C packets written before their replies are
+        read, links where firmware handles one command at a time send one
+    */
+    virtual int ControlPacketsInFlight(void) const {return 1;}
 private:
+    int TransferLMS64C(const unsigned char* outBuffer, unsigned char* inBuffer, const int length, int &inLength);
 
     int WriteSi5351I2C(const std::string &data);
     int ReadSi5351I2C(const size_t numBytes, std::string &data);
@@ -200,9 +213,13 @@ private:
     int WriteADF4002SPI(const uint32_t *writeData, const size_t size);
     int ReadADF4002SPI(const uint32_t *writeData, uint32_t *readData, const size_t size);
 
-    unsigned char* PreparePacket(const GenericPacket &pkt, int &length, const eLMS_PROTOCOL protocol);
+    int PreparePacket(const GenericPacket &pkt, std::vector<unsigned char> &buffer, const eLMS_PROTOCOL protocol);
     int ParsePacket(GenericPacket &pkt, const unsigned char* buffer, const int length, const eLMS_PROTOCOL protocol);
     std::mutex mControlPortLock;
+    std::vector<unsigned char> mOutBuffer; //!< reused by transfers, guarded by mControlPortLock
+    std::vector<unsigned char> mInBuffer;
     double _cachedRefClockRate;
+    std::atomic<uint32_t> mControlTransferCount;
+    std::atomic<uint32_t> mLMS7002MWriteCount;
 };
 }
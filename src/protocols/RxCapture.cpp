@@ -0,0 +1,185 @@
+/**
+    @file RxCapture.cpp
+    @author Lime Microsystems
+    @brief Triggered capture of received samples with pre-trigger window.
+*/
+
+#include "RxCapture.h"
+#include "ErrorReporting.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64)
+#define LIME_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace lime;
+
+static const uint32_t MAX_CAPTURE_SAMPLES = 1 << 26;
+
+/** @brief Finds first sample with absolute value of I or Q at or above level
+    @return index of the sample, count if there is none
+*/
+static uint32_t FindLevel(const complex16_t* samples, const uint32_t count, const uint16_t level)
+{
+    if (level == 0)
+        return 0;
+    uint32_t n = 0;
+#ifdef LIME_USE_SSE2
+    //4 samples per vector, exact position is found by scalar loop below
+    const __m128i threshold = _mm_set1_epi16(std::min<int>(level, 0x7FFF) - 1);
+    for (; n + 4 <= count; n += 4)
+    {
+        const __m128i v = _mm_loadu_si128((const __m128i*)&samples[n]);
+        const __m128i magnitude = _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v));
+        if (_mm_movemask_epi8(_mm_cmpgt_epi16(magnitude, threshold)) != 0)
+            break;
+    }
+#endif
+    for (; n < count; ++n)
+        if (std::abs(samples[n].i) >= level || std::abs(samples[n].q) >= level)
+            return n;
+    return count;
+}
+
+RxCapture::RxCapture(void) :
+    mState(STATE_OFF),
+    mSoftwareTrigger(false),
+    mStarted(false),
+    mDiscontinuity(false),
+    mNextTimestamp(0),
+    mValidFrom(0),
+    mTriggerTimestamp(0)
+{
+}
+
+int RxCapture::Arm(const CaptureConfig &config)
+{
+    if (config.postTriggerSamples == 0)
+        return ReportError(EINVAL, "Capture needs at least one sample after trigger");
+    if (uint64_t(config.preTriggerSamples) + config.postTriggerSamples > MAX_CAPTURE_SAMPLES)
+        return ReportError(EINVAL, "Capture size exceeds %u samples", MAX_CAPTURE_SAMPLES);
+    std::lock_guard<std::mutex> lock(mLock);
+    mConfig = config;
+    mWindow.resize(config.preTriggerSamples + config.postTriggerSamples);
+    mSoftwareTrigger = false;
+    mStarted = false;
+    mDiscontinuity = false;
+    mState.store(STATE_ARMED);
+    return 0;
+}
+
+int RxCapture::Trigger(void)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mState.load() != STATE_ARMED)
+        return ReportError(EINVAL, "Capture is not armed");
+    mSoftwareTrigger = true;
+    return 0;
+}
+
+void RxCapture::Disarm(void)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    mState.store(STATE_OFF);
+    std::vector<complex16_t>().swap(mWindow);
+    mDone.notify_all();
+}
+
+void RxCapture::Push(const complex16_t* samples, const uint32_t count, const uint64_t timestamp)
+{
+    //samples after completed capture are dropped until it is armed again
+    const int state = mState.load();
+    if (state == STATE_OFF || state == STATE_DONE)
+        return;
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mState.load() != state)
+        return;
+
+    if (!mStarted || timestamp != mNextTimestamp)
+    {
+        //window must not contain samples from before the gap
+        if (state == STATE_ARMED)
+            mValidFrom = timestamp;
+        else
+            mDiscontinuity = true;
+        mStarted = true;
+    }
+    mNextTimestamp = timestamp + count;
+
+    if (state == STATE_ARMED)
+    {
+        uint32_t index = count;
+        if (mSoftwareTrigger)
+            index = 0;
+        else if (mConfig.trigger == CaptureConfig::TRIGGER_LEVEL)
+            index = FindLevel(samples, count, mConfig.level);
+        else if (mConfig.trigger == CaptureConfig::TRIGGER_TIMESTAMP && mNextTimestamp > mConfig.timestamp)
+            index = mConfig.timestamp > timestamp ? mConfig.timestamp - timestamp : 0;
+        if (index < count)
+        {
+            mTriggerTimestamp = timestamp + index;
+            mState.store(STATE_TRIGGERED);
+        }
+    }
+    Store(samples, count, timestamp);
+
+    if (mState.load() == STATE_TRIGGERED && mNextTimestamp >= mTriggerTimestamp + mConfig.postTriggerSamples)
+    {
+        mState.store(STATE_DONE);
+        mDone.notify_all();
+    }
+}
+
+void RxCapture::Store(const complex16_t* samples, const uint32_t count, const uint64_t timestamp)
+{
+    const uint64_t size = mWindow.size();
+    uint64_t end = timestamp + count;
+    if (mState.load() == STATE_TRIGGERED)
+        end = std::min(end, mTriggerTimestamp + mConfig.postTriggerSamples);
+    uint64_t first = std::max(timestamp, end > size ? end - size : 0);
+    while (first < end)
+    {
+        const uint64_t pos = first % size;
+        const uint64_t chunk = std::min(end - first, size - pos);
+        memcpy(&mWindow[pos], &samples[first - timestamp], chunk*sizeof(complex16_t));
+        first += chunk;
+    }
+}
+
+int RxCapture::Read(complex16_t* samples, const uint32_t count, uint64_t &timestamp, uint64_t &triggerTimestamp, bool &discontinuity, const int32_t timeout_ms)
+{
+    std::unique_lock<std::mutex> lock(mLock);
+    if (mState.load() == STATE_OFF)
+    {
+        ReportError(EINVAL, "Capture is not armed");
+        return -1;
+    }
+    if (!mDone.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]{return mState.load() != STATE_ARMED && mState.load() != STATE_TRIGGERED;}))
+        return 0;
+    if (mState.load() != STATE_DONE)
+    {
+        ReportError(EINVAL, "Capture was disarmed");
+        return -1;
+    }
+
+    const uint64_t size = mWindow.size();
+    const uint64_t end = mTriggerTimestamp + mConfig.postTriggerSamples;
+    uint64_t first = std::max(mValidFrom, end - std::min(end, size));
+    timestamp = first;
+    triggerTimestamp = mTriggerTimestamp;
+    discontinuity = mDiscontinuity;
+    const uint64_t last = std::min(end, first + count);
+    uint32_t copied = 0;
+    while (first < last)
+    {
+        const uint64_t pos = first % size;
+        const uint64_t chunk = std::min(last - first, size - pos);
+        memcpy(&samples[copied], &mWindow[pos], chunk*sizeof(complex16_t));
+        copied += chunk;
+        first += chunk;
+    }
+    return copied;
+}
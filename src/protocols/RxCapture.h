@@ -0,0 +1,87 @@
+/**
+    @file RxCapture.h
+    @author Lime Microsystems
+    @brief Triggered capture of received samples with pre-trigger window.
+*/
+
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "IConnection.h"
+#include "dataTypes.h"
+
+namespace lime{
+
+/*!
+ * Keeps the latest received samples in a ring indexed by timestamp,
+ * so that samples preceding the trigger are available without
+ * delivering every sample to the reader. Receive loop pushes samples
+ * and evaluates trigger condition, reader waits for completed capture.
+ */
+class RxCapture
+{
+public:
+    RxCapture(void);
+
+    //! @return true if received samples should be pushed to capture instead of FIFO
+    bool IsEnabled(void) const
+    {
+        return mState.load(std::memory_order_relaxed) != STATE_OFF;
+    }
+
+    /** @brief Starts new capture, discarding previous one
+        @return 0 on success
+    */
+    int Arm(const CaptureConfig &config);
+
+    //! @brief Triggers armed capture at the next pushed sample
+    int Trigger(void);
+
+    //! @brief Stops capture and releases window memory
+    void Disarm(void);
+
+    /** @brief Adds received samples, called by receive loop
+        @param samples received samples
+        @param count number of samples
+        @param timestamp timestamp of the first sample
+    */
+    void Push(const complex16_t* samples, const uint32_t count, const uint64_t timestamp);
+
+    /** @brief Waits for capture to complete and copies its samples
+        @param samples destination array
+        @param count maximum number of samples to copy
+        @param timestamp [out] timestamp of the first copied sample
+        @param triggerTimestamp [out] timestamp of the trigger sample
+        @param discontinuity [out] true if samples were lost after trigger
+        @param timeout_ms time to wait for capture to complete
+        @return number of copied samples, 0 on timeout, -1 if not armed
+    */
+    int Read(complex16_t* samples, const uint32_t count, uint64_t &timestamp, uint64_t &triggerTimestamp, bool &discontinuity, const int32_t timeout_ms);
+
+private:
+    enum State
+    {
+        STATE_OFF,
+        STATE_ARMED,
+        STATE_TRIGGERED,
+        STATE_DONE,
+    };
+    void Store(const complex16_t* samples, const uint32_t count, const uint64_t timestamp);
+
+    std::atomic<int> mState;
+    std::mutex mLock; //guards everything below, taken by receive loop only while capture is enabled
+    std::condition_variable mDone;
+    CaptureConfig mConfig;
+    std::vector<complex16_t> mWindow; //sample with timestamp t is at t % size
+    bool mSoftwareTrigger;
+    bool mStarted;
+    bool mDiscontinuity;
+    uint64_t mNextTimestamp; //timestamp following last pushed sample
+    uint64_t mValidFrom; //first sample after last gap before trigger
+    uint64_t mTriggerTimestamp;
+};
+
+}
@@ -0,0 +1,250 @@
+/**
+    @file SpectrumMonitor.cpp
+    @author Lime Microsystems
+    @brief Averaged power spectra of received samples computed in library.
+*/
+
+#include "SpectrumMonitor.h"
+#include "ErrorReporting.h"
+#include "windowFunction.h"
+#include "kiss_fft.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+using namespace lime;
+
+static const uint32_t MIN_FFT_SIZE = 16;
+static const uint32_t MAX_FFT_SIZE = 65536;
+static const uint32_t MAX_BLOCK_SAMPLES = 1 << 24;
+
+PowerSpectrum::PowerSpectrum(void) :
+    mPlan(nullptr),
+    mCount(0)
+{
+}
+
+PowerSpectrum::~PowerSpectrum(void)
+{
+    kiss_fft_free(mPlan);
+}
+
+void PowerSpectrum::Configure(const SpectrumConfig &config)
+{
+    const uint32_t N = config.fftSize;
+    mConfig = config;
+    kiss_fft_free(mPlan);
+    mPlan = kiss_fft_alloc(N, 0, nullptr, nullptr);
+    GenerateWindowCoefficients(config.window, N, mWindow, 1);
+    mFftIn.assign(2*N, 0);
+    mFftOut.assign(2*N, 0);
+    Reset();
+}
+
+void PowerSpectrum::Reset(void)
+{
+    mPower.assign(mConfig.fftSize, 0);
+    mCount = 0;
+}
+
+void PowerSpectrum::Add(const complex16_t* samples)
+{
+    const uint32_t N = mConfig.fftSize;
+    const float scale = 1.0f / (float(N) * N * 2048 * 2048);
+    kiss_fft_cpx* in = (kiss_fft_cpx*)mFftIn.data();
+    kiss_fft_cpx* out = (kiss_fft_cpx*)mFftOut.data();
+    for (uint32_t i = 0; i < N; ++i)
+    {
+        in[i].r = samples[i].i * mWindow[i];
+        in[i].i = samples[i].q * mWindow[i];
+    }
+    kiss_fft(mPlan, in, out);
+    for (uint32_t i = 0; i < N; ++i)
+    {
+        const float power = (out[i].r * out[i].r + out[i].i * out[i].i) * scale;
+        switch (mConfig.averaging)
+        {
+        case SpectrumConfig::AVERAGE_LINEAR:
+            mPower[i] += power;
+            break;
+        case SpectrumConfig::AVERAGE_EXPONENTIAL:
+            mPower[i] = mCount ? mPower[i] + mConfig.expWeight * (power - mPower[i]) : power;
+            break;
+        case SpectrumConfig::AVERAGE_MAX_HOLD:
+            mPower[i] = mCount ? std::max(mPower[i], power) : power;
+            break;
+        }
+    }
+    ++mCount;
+}
+
+void PowerSpectrum::GetBins(float* bins) const
+{
+    const uint32_t N = mConfig.fftSize;
+    float scale = 1.0f;
+    if (mConfig.averaging == SpectrumConfig::AVERAGE_LINEAR && mCount > 1)
+        scale /= mCount;
+    for (uint32_t i = 0; i < N; ++i)
+        bins[i] = 10 * std::log10(std::max(mPower[(i + N/2) % N] * scale, 1e-30f));
+}
+
+int lime::ValidateSpectrumConfig(const SpectrumConfig &config)
+{
+    if (config.fftSize < MIN_FFT_SIZE || config.fftSize > MAX_FFT_SIZE)
+        return ReportError(EINVAL, "FFT size must be in range [%u, %u]", MIN_FFT_SIZE, MAX_FFT_SIZE);
+    if (config.window > SpectrumConfig::WINDOW_HANNING || config.averaging > SpectrumConfig::AVERAGE_MAX_HOLD)
+        return ReportError(EINVAL, "Invalid spectrum window or averaging");
+    if (!(config.overlap >= 0 && config.overlap < 1) || config.averageCount == 0)
+        return ReportError(EINVAL, "Invalid spectrum overlap or average count");
+    if (config.averaging == SpectrumConfig::AVERAGE_EXPONENTIAL && !(config.expWeight > 0 && config.expWeight <= 1))
+        return ReportError(EINVAL, "Exponential averaging weight must be in range (0, 1]");
+    const uint64_t blockSize = config.fftSize + uint64_t(config.averageCount-1)*SpectrumHop(config);
+    if (blockSize > MAX_BLOCK_SAMPLES)
+        return ReportError(EINVAL, "Spectrum frame needs too many samples");
+    return 0;
+}
+
+uint32_t lime::SpectrumHop(const SpectrumConfig &config)
+{
+    return std::max<uint32_t>(1, std::lround(config.fftSize * (1 - config.overlap)));
+}
+
+SpectrumMonitor::SpectrumMonitor(void) :
+    mHop(0),
+    mCollecting(false),
+    mTerminate(false),
+    mFilled(0),
+    mBlockTimestamp(0),
+    mRunning(false),
+    mFrameTimestamp(0),
+    mFrameCount(0),
+    mFrameRead(0)
+{
+}
+
+SpectrumMonitor::~SpectrumMonitor(void)
+{
+    Stop();
+}
+
+int SpectrumMonitor::Start(const SpectrumConfig &config)
+{
+    if (ValidateSpectrumConfig(config) != 0)
+        return -1;
+
+    Stop();
+    const uint32_t N = config.fftSize;
+    mConfig = config;
+    mHop = SpectrumHop(config);
+    mSpectrum.Configure(config);
+    mBlock.resize(N + (config.averageCount-1)*mHop);
+    mFilled = 0;
+    mTerminate = false;
+    {
+        std::lock_guard<std::mutex> lock(mFrameLock);
+        mFrame.assign(N, 0);
+        mFrameCount = 0;
+        mFrameRead = 0;
+        mRunning = true;
+    }
+    mWorker = std::thread(&SpectrumMonitor::WorkerLoop, this);
+    return 0;
+}
+
+void SpectrumMonitor::Stop(void)
+{
+    if (!mWorker.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mTerminate = true;
+        mCollecting.store(false);
+        mCollected.notify_all();
+    }
+    mWorker.join();
+    std::lock_guard<std::mutex> lock(mFrameLock);
+    mRunning = false;
+    mFrameReady.notify_all();
+}
+
+void SpectrumMonitor::Push(const complex16_t* samples, const uint32_t count, const uint64_t timestamp)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    if (!mCollecting.load())
+        return;
+    //FFTs of a frame are computed from contiguous samples
+    if (mFilled != 0 && timestamp != mBlockTimestamp + mFilled)
+        mFilled = 0;
+    if (mFilled == 0)
+        mBlockTimestamp = timestamp;
+    const uint32_t n = std::min<uint32_t>(count, mBlock.size() - mFilled);
+    memcpy(&mBlock[mFilled], samples, n*sizeof(complex16_t));
+    mFilled += n;
+    if (mFilled == mBlock.size())
+    {
+        mCollecting.store(false);
+        mCollected.notify_all();
+    }
+}
+
+void SpectrumMonitor::WorkerLoop(void)
+{
+    typedef std::chrono::steady_clock clock;
+    const auto period = std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>(mConfig.frameRate > 0 ? 1.0/mConfig.frameRate : 0));
+    auto nextFrame = clock::now();
+    std::unique_lock<std::mutex> lock(mLock);
+    while (!mTerminate)
+    {
+        if (mCollected.wait_until(lock, nextFrame, [this]{return mTerminate;}))
+            break;
+        mFilled = 0;
+        mCollecting.store(true);
+        mCollected.wait(lock, [this]{return mTerminate || !mCollecting.load();});
+        if (mTerminate)
+            break;
+        //receive loop does not touch the block until collection restarts
+        lock.unlock();
+        ProcessFrame();
+        lock.lock();
+        nextFrame = std::max(nextFrame + period, clock::now());
+    }
+}
+
+void SpectrumMonitor::ProcessFrame(void)
+{
+    //exponential and max hold averaging continue over frames
+    if (mConfig.averaging == SpectrumConfig::AVERAGE_LINEAR)
+        mSpectrum.Reset();
+    for (uint32_t k = 0; k < mConfig.averageCount; ++k)
+        mSpectrum.Add(&mBlock[k*mHop]);
+
+    std::lock_guard<std::mutex> lock(mFrameLock);
+    mSpectrum.GetBins(mFrame.data());
+    mFrameTimestamp = mBlockTimestamp;
+    ++mFrameCount;
+    mFrameReady.notify_all();
+}
+
+int SpectrumMonitor::Read(float* bins, const uint32_t count, uint64_t &timestamp, const int32_t timeout_ms)
+{
+    std::unique_lock<std::mutex> lock(mFrameLock);
+    if (!mRunning)
+    {
+        ReportError(EINVAL, "Spectrum monitor is not running");
+        return -1;
+    }
+    if (!mFrameReady.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]{return !mRunning || mFrameCount != mFrameRead;}))
+        return 0;
+    if (!mRunning)
+    {
+        ReportError(EINVAL, "Spectrum monitor was stopped");
+        return -1;
+    }
+    mFrameRead = mFrameCount;
+    const uint32_t n = std::min<uint32_t>(count, mFrame.size());
+    memcpy(bins, mFrame.data(), n*sizeof(float));
+    timestamp = mFrameTimestamp;
+    return n;
+}
@@ -0,0 +1,133 @@
+/**
+    @file SpectrumMonitor.h
+    @author Lime Microsystems
+    @brief Averaged power spectra of received samples computed in library.
+*/
+
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "IConnection.h"
+#include "dataTypes.h"
+
+struct kiss_fft_state;
+
+namespace lime{
+
+/*!
+ * Averaged power of FFTs of 16 bit samples, with window applied.
+ * FFT plan and window are prepared once by Configure().
+ */
+class PowerSpectrum
+{
+public:
+    PowerSpectrum(void);
+    ~PowerSpectrum(void);
+
+    //! @brief Prepares FFT plan and window, config has to be validated
+    void Configure(const SpectrumConfig &config);
+
+    //! @brief Clears averaged power
+    void Reset(void);
+
+    //! @brief Adds FFT of fftSize samples to average
+    void Add(const complex16_t* samples);
+
+    //! @brief Converts averaged power to dBFS, from lowest frequency
+    void GetBins(float* bins) const;
+
+private:
+    SpectrumConfig mConfig;
+    kiss_fft_state* mPlan;
+    std::vector<float> mWindow;
+    std::vector<float> mFftIn; //interleaved complex
+    std::vector<float> mFftOut;
+    std::vector<float> mPower; //averaged power of bins in FFT order
+    uint32_t mCount; //FFTs in average
+};
+
+/** @brief Checks spectrum configuration
+    @return 0 if valid
+*/
+int ValidateSpectrumConfig(const SpectrumConfig &config);
+
+//! @return samples between starts of consecutive FFTs
+uint32_t SpectrumHop(const SpectrumConfig &config);
+
+/*!
+ * Computes spectrum frames on a worker thread. For each frame the worker
+ * asks receive loop for one contiguous block of samples, that covers all
+ * overlapping FFTs of the frame, so samples are copied only at the rate
+ * needed for requested frame rate. FFT plan and window are prepared once
+ * when monitor is started.
+ */
+class SpectrumMonitor
+{
+public:
+    SpectrumMonitor(void);
+    ~SpectrumMonitor(void);
+
+    //! @return true if receive loop should pass samples to Push()
+    bool IsCollecting(void) const
+    {
+        return mCollecting.load(std::memory_order_relaxed);
+    }
+
+    /** @brief Starts worker thread, restarting it if already running
+        @return 0 on success
+    */
+    int Start(const SpectrumConfig &config);
+
+    //! @brief Stops worker thread
+    void Stop(void);
+
+    /** @brief Adds received samples to the frame being collected, called by receive loop
+        @param samples received samples
+        @param count number of samples
+        @param timestamp timestamp of the first sample
+    */
+    void Push(const complex16_t* samples, const uint32_t count, const uint64_t timestamp);
+
+    /** @brief Waits for spectrum frame that was not read yet
+        @param bins destination for power of bins in dBFS, from lowest frequency
+        @param count maximum number of bins to copy
+        @param timestamp [out] timestamp of the first sample of the frame
+        @param timeout_ms time to wait for frame
+        @return number of copied bins, 0 on timeout, -1 if monitor is not running
+    */
+    int Read(float* bins, const uint32_t count, uint64_t &timestamp, const int32_t timeout_ms);
+
+private:
+    void WorkerLoop(void);
+    void ProcessFrame(void);
+
+    SpectrumConfig mConfig;
+    uint32_t mHop; //samples between starts of consecutive FFTs
+    std::thread mWorker;
+
+    //frame collection, shared with receive loop
+    std::atomic<bool> mCollecting;
+    std::mutex mLock;
+    std::condition_variable mCollected;
+    bool mTerminate;
+    std::vector<complex16_t> mBlock;
+    uint32_t mFilled;
+    uint64_t mBlockTimestamp;
+
+    PowerSpectrum mSpectrum; //used by worker thread
+
+    //last computed frame
+    std::mutex mFrameLock;
+    std::condition_variable mFrameReady;
+    bool mRunning;
+    std::vector<float> mFrame;
+    uint64_t mFrameTimestamp;
+    unsigned mFrameCount;
+    unsigned mFrameRead;
+};
+
+}
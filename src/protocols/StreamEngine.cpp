@@ -0,0 +1,350 @@
+/**
+    @file StreamEngine.cpp
+    @author Lime Microsystems
+    @brief Receive and transmit loops shared by all streaming connections.
+*/
+
+#include "ILimeSDRStreaming.h"
+#include "ErrorReporting.h"
+#include "FPGA_common.h"
+#include "Logger.h"
+#include <memory>
+#include <ciso646>
+
+using namespace lime;
+using namespace std;
+
+/** @brief Creates transport moving FPGA packets of given stream,
+    connections without streaming transport return nullptr
+*/
+StreamTransport* ILimeSDRStreaming::OpenStreamTransport(Streamer* stream, const bool isTx, TransportConfig& config)
+{
+    return nullptr;
+}
+
+/** @brief Function dedicated for receiving data samples from board
+    @param stream a pointer to an active receiver stream
+*/
+void ILimeSDRStreaming::ReceivePacketsLoop(Streamer* stream)
+{
+    //at this point FPGA has to be already configured to output samples
+    const uint8_t maxChannelCount = 2;
+    const int chipID = stream->mChipID;
+
+    TransportConfig config;
+    config.packetsPerTransfer = stream->rxBatchSize;
+    config.buffersCount = 16;
+    config.lateFlagsMask = 1 << 1;
+    std::unique_ptr<StreamTransport> transport(OpenStreamTransport(stream, false, config));
+    if (transport == nullptr)
+    {
+        lime::error("Failed to start Rx stream");
+        return;
+    }
+    const uint32_t packetsToBatch = config.packetsPerTransfer;
+    const uint32_t bufferSize = packetsToBatch*sizeof(FPGA_DataPacket);
+    const uint32_t buffersCount = config.buffersCount;
+    vector<bool> submitted(buffersCount, false);
+    vector<int32_t> bytesDone(buffersCount, -1); //finished transfers waiting for processing
+    vector<StreamChannel::Frame> chFrames;
+    try
+    {
+        chFrames.resize(maxChannelCount);
+    }
+    catch (const std::bad_alloc &ex)
+    {
+        ReportError("Error allocating Rx buffers, not enough memory");
+        return;
+    }
+    char* buffers = transport->AllocateBuffers(buffersCount*bufferSize);
+    if (buffers == nullptr)
+    {
+        ReportError("Error allocating Rx buffers, not enough memory");
+        return;
+    }
+
+    int activeTransfers = 0;
+    for (uint32_t i = 0; i<buffersCount; ++i)
+    {
+        if (transport->Submit(&buffers[i*bufferSize], bufferSize) != 0)
+            break;
+        submitted[i] = true;
+        ++activeTransfers;
+    }
+
+    uint32_t bi = 0;
+    unsigned long totalBytesReceived = 0; //for data rate calculation
+
+    auto t1 = chrono::high_resolution_clock::now();
+    auto t2 = t1;
+
+    std::mutex txFlagsLock;
+    condition_variable resetTxFlags;
+    bool txResetStop = false; //set before final notify, loop may end before terminateRx
+    int txResetRequests = 0;
+    //worker thread for reseting late Tx packet flags
+    std::thread txReset([](ILimeSDRStreaming* port,
+                        bool *stop,
+                        int *requests,
+                        mutex *spiLock,
+                        condition_variable *doWork,
+                        const uint32_t mask)
+    {
+        uint32_t reg9;
+        port->ReadRegister(0x0009, reg9);
+        const uint32_t addr[] = {0x0009, 0x0009};
+        const uint32_t data[] = {reg9 | mask, reg9 & ~mask};
+        std::unique_lock<std::mutex> lck(*spiLock);
+        while (true)
+        {
+            doWork->wait(lck, [=]{return *stop || *requests > 0;});
+            if (*stop)
+                break;
+            *requests = 0;
+            lck.unlock();
+            port->WriteRegisters(addr, data, 2);
+            lck.lock();
+        }
+    }, this, &txResetStop, &txResetRequests, &txFlagsLock, &resetTxFlags, config.lateFlagsMask);
+
+    int resetFlagsDelay = 128;
+    while (stream->terminateRx.load() == false)
+    {
+        if(stream->generateData.load())
+        {
+            if(activeTransfers == 0) //stop FPGA when last transfer completes
+                fpga::StopStreaming(this, chipID);
+            stream->safeToConfigInterface.notify_all(); //notify that it's safe to change chip config
+            stream->RefreshRxLayout();
+            const int batchSize = (this->mExpectedSampleRate/chFrames[0].samplesCount)/10;
+            IStreamChannel::Metadata meta;
+            meta.flags = 0;
+            for(int i=0; i<batchSize; ++i)
+            {
+                for(int ch=0; ch<stream->rxLayout.chCount; ++ch)
+                {
+                    if (stream->rxLayout.streams[ch] == nullptr)
+                        continue;
+                    meta.timestamp = chFrames[ch].timestamp;
+                    for(int j=0; j<chFrames[ch].samplesCount; ++j)
+                    {
+                        chFrames[ch].samples[j].i = 0;
+                        chFrames[ch].samples[j].q = 0;
+                    }
+                    uint32_t samplesPushed = stream->rxLayout.streams[ch]->Write((const void*)chFrames[ch].samples, chFrames[ch].samplesCount, &meta);
+                    if(samplesPushed != chFrames[ch].samplesCount)
+                        lime::warning("Rx samples pushed %i/%i", samplesPushed, chFrames[ch].samplesCount);
+                }
+            }
+            this_thread::sleep_for(chrono::milliseconds(100));
+        }
+        //buffers are submitted in ring order, start transfers on the ones processed
+        else
+        {
+            for(uint32_t i=0; i<buffersCount; ++i)
+            {
+                const uint32_t b = (bi + i) % buffersCount;
+                if(submitted[b] || bytesDone[b] >= 0)
+                    continue;
+                if(activeTransfers == 0) //reactivate FPGA and transfers
+                    fpga::StartStreaming(this, chipID);
+                if(transport->Submit(&buffers[b*bufferSize], bufferSize) != 0)
+                    break;
+                submitted[b] = true;
+                ++activeTransfers;
+            }
+            if(activeTransfers == 0 && bytesDone[bi] < 0)
+            {
+                lime::error("Rx transfers could not be started");
+                break;
+            }
+        }
+        //take transfers as they complete, a finished transfer behind an
+        //unfinished one is kept until packets can be processed in order
+        if(bytesDone[bi] < 0)
+        {
+            if(activeTransfers == 0)
+                continue;
+            char* buffer = nullptr;
+            const int bytes = transport->Reap(&buffer, 1000);
+            if(bytes == StreamTransport::REAP_FAILED)
+                break;
+            if(bytes < 0)
+                continue;
+            const uint32_t b = (buffer - buffers)/bufferSize;
+            bytesDone[b] = bytes;
+            submitted[b] = false;
+            --activeTransfers;
+            if(bytesDone[bi] < 0)
+                continue;
+        }
+        const int32_t bytesReceived = bytesDone[bi];
+        bytesDone[bi] = -1;
+        totalBytesReceived += bytesReceived;
+        stream->rxMetrics.TransferCompleted(bytesReceived);
+        if (bytesReceived != int32_t(bufferSize)) //data should come in full sized packets
+            for(int ch=0; ch<stream->rxLayout.chCount; ++ch)
+                if (stream->rxLayout.streams[ch])
+                    stream->rxLayout.streams[ch]->underflow++;
+        bool txLate=false;
+        const FPGA_DataPacket* pkt = (const FPGA_DataPacket*)&buffers[bi*bufferSize];
+        for (uint32_t pktIndex = 0; pktIndex < bytesReceived / sizeof(FPGA_DataPacket); ++pktIndex)
+        {
+            const uint8_t byte0 = pkt[pktIndex].reserved[0];
+            if ((byte0 & (1 << 3)) != 0 && !txLate) //report only once per batch
+            {
+                txLate = true;
+                if(resetFlagsDelay > 0)
+                    --resetFlagsDelay;
+                else
+                {
+                    lime::info("L");
+                    {
+                        std::lock_guard<std::mutex> lck(txFlagsLock);
+                        ++txResetRequests;
+                    }
+                    resetTxFlags.notify_one();
+                    resetFlagsDelay = packetsToBatch*buffersCount;
+                    stream->txLastLateTime.store(pkt[pktIndex].counter);
+                    stream->txLatePackets++;
+                }
+            }
+            stream->ProcessRxPacket(pkt[pktIndex]);
+        }
+        bi = (bi + 1) % buffersCount;
+        t2 = chrono::high_resolution_clock::now();
+        auto timePeriod = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+        if (timePeriod >= 1000)
+        {
+            t1 = t2;
+            //total number of bytes sent per second
+            double dataRate = 1000.0*totalBytesReceived / timePeriod;
+#ifndef NDEBUG
+            printf("Rx: %.3f MB/s\n", dataRate / 1000000.0);
+#endif
+            totalBytesReceived = 0;
+            stream->rxDataRate_Bps.store((uint32_t)dataRate);
+        }
+    }
+    transport->Cancel();
+    while(activeTransfers > 0)
+    {
+        char* buffer = nullptr;
+        if(transport->Reap(&buffer, 1000) < 0)
+            break;
+        --activeTransfers;
+    }
+    {
+        std::lock_guard<std::mutex> lck(txFlagsLock);
+        txResetStop = true;
+    }
+    resetTxFlags.notify_one();
+    txReset.join();
+    stream->rxDataRate_Bps.store(0);
+}
+
+/** @brief Functions dedicated for transmitting packets to board
+    @param stream an active transmit stream
+*/
+void ILimeSDRStreaming::TransmitPacketsLoop(Streamer* stream)
+{
+    //at this point FPGA has to be already configured to output samples
+    TransportConfig config;
+    config.packetsPerTransfer = stream->txBatchSize;
+    config.buffersCount = 16;
+    config.lateFlagsMask = 1 << 1;
+    std::unique_ptr<StreamTransport> transport(OpenStreamTransport(stream, true, config));
+    if (transport == nullptr)
+    {
+        lime::error("Failed to start Tx stream");
+        stream->txRunning.store(false);
+        return;
+    }
+    const uint32_t packetsToBatch = config.packetsPerTransfer; //packets in single transfer
+    const uint32_t bufferSize = packetsToBatch*sizeof(FPGA_DataPacket);
+    const uint32_t buffersCount = config.buffersCount;
+
+    char* buffers = transport->AllocateBuffers(buffersCount*bufferSize);
+    if (buffers == nullptr) //not enough memory for buffers
+    {
+        lime::error("Error allocating Tx buffers, not enough memory");
+        stream->txRunning.store(false);
+        return;
+    }
+    vector<uint32_t> freeBuffers;
+    for (int i = buffersCount-1; i >= 0; --i)
+        freeBuffers.push_back(i);
+    int activeTransfers = 0;
+
+    long totalBytesSent = 0;
+    auto t1 = chrono::high_resolution_clock::now();
+    auto t2 = t1;
+
+    while (stream->terminateTx.load() != true)
+    {
+        //reuse buffers in order their transfers complete, wait only if all are in flight
+        char* buffer = nullptr;
+        int bytesSent = 0;
+        while (activeTransfers > 0 && (bytesSent = transport->Reap(&buffer, freeBuffers.empty() ? 1000 : 0)) != StreamTransport::REAP_TIMEOUT)
+        {
+            if (bytesSent == StreamTransport::REAP_FAILED)
+                break;
+            --activeTransfers;
+            if (bytesSent != int(bufferSize))
+            {
+                for (int ch = 0; ch < stream->txLayout.chCount; ++ch)
+                    if (stream->txLayout.streams[ch])
+                        stream->txLayout.streams[ch]->overflow++;
+            }
+            else
+                totalBytesSent += bytesSent;
+            stream->txMetrics.TransferCompleted(bytesSent);
+            freeBuffers.push_back((buffer - buffers)/bufferSize);
+        }
+        if (bytesSent == StreamTransport::REAP_FAILED)
+            break;
+        if (freeBuffers.empty())
+            continue;
+        const uint32_t bi = freeBuffers.back();
+        FPGA_DataPacket* pkt = reinterpret_cast<FPGA_DataPacket*>(&buffers[bi*bufferSize]);
+        for (uint32_t i = 0; i<packetsToBatch && stream->terminateTx.load() != true; ++i)
+            stream->ReadTxPacket(pkt[i]); //underflows are zero filled
+
+        if (transport->Submit(&buffers[bi*bufferSize], bufferSize) == 0)
+        {
+            freeBuffers.pop_back();
+            ++activeTransfers;
+        }
+        else if (activeTransfers == 0)
+        {
+            lime::error("Tx transfers could not be started");
+            break;
+        }
+
+        t2 = chrono::high_resolution_clock::now();
+        auto timePeriod = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+        if (timePeriod >= 1000)
+        {
+            //total number of bytes sent per second
+            float dataRate = 1000.0*totalBytesSent / timePeriod;
+            stream->txDataRate_Bps.store(dataRate);
+            totalBytesSent = 0;
+            t1 = t2;
+#ifndef NDEBUG
+            printf("Tx: %.3f MB/s\n", dataRate / 1000000.0);
+#endif
+        }
+    }
+
+    // Wait for all the queued requests to be cancelled
+    transport->Cancel();
+    while (activeTransfers > 0)
+    {
+        char* buffer = nullptr;
+        if (transport->Reap(&buffer, 1000) < 0)
+            break;
+        --activeTransfers;
+    }
+    stream->txRunning.store(false);
+    stream->txDataRate_Bps.store(0);
+}
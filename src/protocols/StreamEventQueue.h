@@ -0,0 +1,197 @@
+/**
+    @file StreamEventQueue.h
+    @author Lime Microsystems
+    @brief Bounded queue of timestamped stream events.
+*/
+
+#ifndef LMS_STREAM_EVENT_QUEUE_H
+#define LMS_STREAM_EVENT_QUEUE_H
+
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include "IConnection.h"
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+namespace lime{
+
+/** @brief Bounded queue of stream events.
+    Streaming threads push events without locking, events are dropped when
+    queue is full. Single reader can wait for events with timeout, or on Linux
+    poll file descriptor that becomes readable when events are pushed.
+*/
+class StreamEventQueue
+{
+public:
+    StreamEventQueue() : mHead(0), mTail(0), mWaiting(0), mDropped(0), mEventFd(-1)
+    {
+        for (size_t i = 0; i < QUEUE_SIZE; ++i)
+            mCells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    ~StreamEventQueue()
+    {
+#ifdef __linux__
+        if (mEventFd.load() >= 0)
+            close(mEventFd.load());
+#endif
+    }
+
+    /** @brief Adds event to queue, can be called from any thread
+        @return false if queue was full and event was dropped
+    */
+    bool push(const StreamEvent& event)
+    {
+        size_t pos = mTail.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;)
+        {
+            cell = &mCells[pos & (QUEUE_SIZE-1)];
+            const size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0)
+            {
+                if (mTail.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                ++mDropped;
+                return false;
+            }
+            else
+                pos = mTail.load(std::memory_order_relaxed);
+        }
+        cell->event = event;
+        cell->sequence.store(pos+1, std::memory_order_release);
+
+        //wake up reader only if it is waiting
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (mWaiting.load() != 0)
+        {
+            std::lock_guard<std::mutex> lock(mWaitLock);
+            mEventSignal.notify_all();
+        }
+#ifdef __linux__
+        const int fd = mEventFd.load();
+        if (fd >= 0)
+        {
+            const uint64_t one = 1;
+            ssize_t ret = write(fd, &one, sizeof(one));
+            (void)ret;
+        }
+#endif
+        return true;
+    }
+
+    /** @brief Takes the oldest event from queue
+        @param event [out] event
+        @param timeout_ms time to wait for event
+        @return true if event was taken
+    */
+    bool pop(StreamEvent& event, const long timeout_ms = 0)
+    {
+#ifdef __linux__
+        //clear before taking events, events pushed later set it again
+        const int fd = mEventFd.load();
+        if (fd >= 0)
+        {
+            uint64_t value;
+            ssize_t ret = read(fd, &value, sizeof(value));
+            (void)ret;
+        }
+#endif
+        if (try_pop(event))
+            return true;
+        if (timeout_ms <= 0)
+            return false;
+        std::unique_lock<std::mutex> lock(mWaitLock);
+        ++mWaiting;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const bool taken = mEventSignal.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&]{return try_pop(event);});
+        --mWaiting;
+        return taken;
+    }
+
+    //! @brief Removes all events from queue
+    void clear()
+    {
+        StreamEvent event;
+        while (try_pop(event));
+        mDropped.store(0);
+    }
+
+    //! @brief Returns number of events dropped because queue was full
+    uint32_t dropped() const
+    {
+        return mDropped.load();
+    }
+
+    /** @brief Returns file descriptor that becomes readable when events are pushed.
+        Reader should take all queued events with pop() after descriptor becomes readable.
+        @return file descriptor, -1 if not supported
+    */
+    int get_fd()
+    {
+#ifdef __linux__
+        if (mEventFd.load() < 0)
+        {
+            std::lock_guard<std::mutex> lock(mWaitLock);
+            if (mEventFd.load() < 0)
+                mEventFd.store(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+        }
+        return mEventFd.load();
+#else
+        return -1;
+#endif
+    }
+
+private:
+    static const size_t QUEUE_SIZE = 256; //must be power of 2
+
+    bool try_pop(StreamEvent& event)
+    {
+        size_t pos = mHead.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;)
+        {
+            cell = &mCells[pos & (QUEUE_SIZE-1)];
+            const size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t)seq - (intptr_t)(pos+1);
+            if (diff == 0)
+            {
+                if (mHead.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;
+            else
+                pos = mHead.load(std::memory_order_relaxed);
+        }
+        event = cell->event;
+        cell->sequence.store(pos+QUEUE_SIZE, std::memory_order_release);
+        return true;
+    }
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        StreamEvent event;
+    };
+    Cell mCells[QUEUE_SIZE];
+    std::atomic<size_t> mHead;
+    std::atomic<size_t> mTail;
+    std::atomic<int> mWaiting;
+    std::atomic<uint32_t> mDropped;
+    std::atomic<int> mEventFd;
+    std::mutex mWaitLock;
+    std::condition_variable mEventSignal;
+};
+
+}
+#endif
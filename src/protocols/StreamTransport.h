@@ -0,0 +1,78 @@
+/**
+    @file StreamTransport.h
+    @author Lime Microsystems
+    @brief Asynchronous transfer of stream buffers to or from hardware.
+*/
+
+#ifndef LMS_STREAM_TRANSPORT_H
+#define LMS_STREAM_TRANSPORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <new>
+
+namespace lime{
+
+/*!
+ * Minimal asynchronous transport used by the streaming loops of
+ * ILimeSDRStreaming. Buffers are submitted for transfer, the loops take
+ * them back with Reap() once the transfer finishes. Receive transports
+ * fill buffers with FPGA packets, transmit transports send them.
+ *
+ * Data is transferred in order of submission, but transfers may finish
+ * in any order. Connection types only implement this interface, packet
+ * parsing, flow control and statistics are shared by all of them.
+ */
+class StreamTransport
+{
+public:
+    enum ReapStatus
+    {
+        REAP_TIMEOUT = -1, //!< no transfer finished in time
+        REAP_FAILED = -2, //!< transport stopped working
+    };
+
+    virtual ~StreamTransport(void) {}
+
+    /** @brief Allocates memory for all buffers used with this transport,
+        it stays valid until the transport is destroyed
+        @param size total number of bytes
+        @return memory, nullptr if not enough memory
+    */
+    virtual char* AllocateBuffers(const size_t size)
+    {
+        try
+        {
+            mMemory.assign(size, 0);
+        }
+        catch (const std::bad_alloc&)
+        {
+            return nullptr;
+        }
+        return mMemory.data();
+    }
+
+    /** @brief Starts transfer of whole buffer
+        @param buffer memory from AllocateBuffers()
+        @param length number of bytes to transfer
+        @return 0 on success, -1 if transfer could not be started
+    */
+    virtual int Submit(char* buffer, const uint32_t length) = 0;
+
+    /** @brief Waits for any submitted transfer to finish
+        @param buffer [out] buffer of finished transfer
+        @param timeout_ms time to wait
+        @return number of bytes transferred, REAP_TIMEOUT or REAP_FAILED
+    */
+    virtual int Reap(char** buffer, const unsigned timeout_ms) = 0;
+
+    //! @brief Aborts submitted transfers, they are still returned by Reap()
+    virtual void Cancel(void) = 0;
+
+private:
+    std::vector<char> mMemory;
+};
+
+}
+#endif
@@ -0,0 +1,177 @@
+/**
+    @file SweepEngine.cpp
+    @author Lime Microsystems
+    @brief Stepping receiver through a frequency plan for wideband surveys.
+*/
+
+#include "SweepEngine.h"
+#include "ILimeSDRStreaming.h"
+#include "ClockEstimator.h"
+#include "ErrorReporting.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace lime;
+
+SweepConfig::SweepConfig(void):
+    stepCount(0),
+    settlingSamples(0),
+    samplesPerStep(0),
+    format(StreamConfig::STREAM_12_BIT_IN_16),
+    computeSpectrum(false)
+{
+    return;
+}
+
+SweepEngine::SweepEngine(IConnection* port, IStreamChannel* stream) :
+    mPort(port),
+    mStream(stream),
+    mRunning(false),
+    mSampleSize(0),
+    mBlockSamples(0),
+    mHop(0),
+    mStep(0),
+    mStartTimestamp(0),
+    mFilled(0),
+    mBlockTimestamp(0),
+    mDiscontinuity(false),
+    mNextTimestamp(0),
+    mSteps(0)
+{
+}
+
+SweepEngine::~SweepEngine(void)
+{
+}
+
+int SweepEngine::Start(const SweepConfig &config, RetuneFunction retune)
+{
+    mRunning = false;
+    if (config.stepCount == 0 || !retune)
+        return ReportError(EINVAL, "Sweep needs at least one step and retune function");
+    uint32_t blockSamples = config.samplesPerStep;
+    if (config.computeSpectrum)
+    {
+        if (ValidateSpectrumConfig(config.spectrum) != 0)
+            return -1;
+        mHop = SpectrumHop(config.spectrum);
+        blockSamples = config.spectrum.fftSize + (config.spectrum.averageCount-1)*mHop;
+        mSpectrum.Configure(config.spectrum);
+        mSpectrumSamples.resize(blockSamples);
+    }
+    if (blockSamples == 0)
+        return ReportError(EINVAL, "Sweep needs at least one sample per step");
+
+    mConfig = config;
+    mRetune = retune;
+    mSampleSize = ILimeSDRStreaming::HostSampleSize(config.format);
+    mBlockSamples = blockSamples;
+    mBuffer.resize(size_t(blockSamples)*mSampleSize);
+    mFilled = 0;
+    mDiscontinuity = false;
+    mNextTimestamp = 0;
+    if (Retune(0) != 0)
+        return -1;
+    mSteps = 0;
+    mStartTime = std::chrono::steady_clock::now();
+    mRunning = true;
+    return 0;
+}
+
+int SweepEngine::Retune(const size_t step)
+{
+    if (mRetune(step) != 0)
+        return -1;
+    //samples received after this point were taken at new frequency,
+    //estimate is not later than hardware time, so settling is not shortened
+    uint64_t now = mPort->GetHardwareTimestamp();
+    uint64_t estimate = 0;
+    if (mPort->HostTimeToTimestamp(ClockEstimator::HostTimeNow(), estimate) == 0)
+        now = std::max(now, estimate);
+    //burst has to start after samples already read from stream
+    mStartTimestamp = std::max(now + mConfig.settlingSamples, mNextTimestamp + 1);
+    mStep = step;
+    return 0;
+}
+
+int SweepEngine::Next(void* data, const uint32_t count, SweepBlock &block, const int32_t timeout_ms)
+{
+    if (!mRunning)
+    {
+        ReportError(EINVAL, "Sweep is not started");
+        return -1;
+    }
+    const uint32_t outputCount = mConfig.computeSpectrum ? mConfig.spectrum.fftSize : mBlockSamples;
+    if (count < outputCount)
+    {
+        ReportError(EINVAL, "Sweep step needs buffer for %u samples or bins", outputCount);
+        return -1;
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (mFilled < mBlockSamples)
+    {
+        //step is requested as timed burst, it is continued after timeout
+        IStreamChannel::Metadata meta;
+        meta.flags = 0;
+        meta.timestamp = 0;
+        if (mFilled == 0)
+        {
+            meta.flags = IStreamChannel::Metadata::SYNC_TIMESTAMP | IStreamChannel::Metadata::END_BURST;
+            meta.timestamp = mStartTimestamp;
+        }
+        const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        const int ret = mStream->Read(&mBuffer[size_t(mFilled)*mSampleSize], mBlockSamples - mFilled, &meta, std::max<int32_t>(remaining, 0));
+        if (ret < 0)
+            return -1;
+        if (ret == 0)
+        {
+            if (remaining <= 0)
+                return 0;
+            continue;
+        }
+        if (mFilled == 0)
+            mBlockTimestamp = meta.timestamp;
+        else if (meta.timestamp != mBlockTimestamp + mFilled)
+            mDiscontinuity = true;
+        if (meta.flags & IStreamChannel::Metadata::DISCONTINUITY)
+            mDiscontinuity = true;
+        mFilled += ret;
+        mNextTimestamp = meta.timestamp + ret;
+    }
+
+    block.step = mStep;
+    block.timestamp = mBlockTimestamp;
+    block.discontinuity = mDiscontinuity;
+    //synthesizer settles for the next step while this one is processed
+    if (Retune((mStep + 1) % mConfig.stepCount) != 0)
+        return -1;
+
+    if (mConfig.computeSpectrum)
+    {
+        ILimeSDRStreaming::HostToSamples(mBuffer.data(), mSpectrumSamples.data(), mBlockSamples, mConfig.format);
+        mSpectrum.Reset();
+        for (uint32_t k = 0; k < mConfig.spectrum.averageCount; ++k)
+            mSpectrum.Add(&mSpectrumSamples[k*mHop]);
+        mSpectrum.GetBins((float*)data);
+    }
+    else
+        memcpy(data, mBuffer.data(), size_t(mBlockSamples)*mSampleSize);
+    mFilled = 0;
+    mDiscontinuity = false;
+    ++mSteps;
+    return outputCount;
+}
+
+uint64_t SweepEngine::GetStepCount(void) const
+{
+    return mSteps;
+}
+
+double SweepEngine::GetStepsPerSecond(void) const
+{
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - mStartTime;
+    if (!mRunning || elapsed.count() <= 0)
+        return 0;
+    return mSteps / elapsed.count();
+}
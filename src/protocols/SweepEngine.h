@@ -0,0 +1,121 @@
+/**
+    @file SweepEngine.h
+    @author Lime Microsystems
+    @brief Stepping receiver through a frequency plan for wideband surveys.
+*/
+
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include "IConnection.h"
+#include "SpectrumMonitor.h"
+
+namespace lime{
+
+struct LIME_API SweepConfig
+{
+    SweepConfig(void);
+
+    //! Number of steps in frequency plan, sweep restarts after the last one
+    size_t stepCount;
+
+    //! Samples discarded after each retune while synthesizer settles
+    uint32_t settlingSamples;
+
+    //! Samples returned for each step, ignored when spectrum is computed
+    uint32_t samplesPerStep;
+
+    //! Host format of the stream samples
+    StreamConfig::StreamDataFormat format;
+
+    //! Return averaged power spectrum of each step instead of samples
+    bool computeSpectrum;
+
+    /*!
+     * Spectrum of each step, averageCount FFTs are computed from
+     * contiguous samples of the step, frame rate is not used.
+     */
+    SpectrumConfig spectrum;
+};
+
+//! Tags block returned for sweep step
+struct LIME_API SweepBlock
+{
+    size_t step;
+    uint64_t timestamp; //!< timestamp of the first sample of the step
+    bool discontinuity; //!< samples of the step were lost on the link
+};
+
+/*!
+ * Steps receiver through precomputed frequency plan. Each step is received
+ * as a timed burst starting after synthesizer settling time, so settling
+ * samples are never transferred. Receiver is retuned for the next step
+ * as soon as samples of the current one are received, before they are
+ * processed or returned, so settling overlaps with processing.
+ */
+class LIME_API SweepEngine
+{
+public:
+    /** @brief Applies settings of plan step, should not do slow calibrations
+        @return 0 on success
+    */
+    typedef std::function<int(const size_t step)> RetuneFunction;
+
+    /** @param port connection used for timestamp estimates
+        @param stream running Rx stream
+    */
+    SweepEngine(IConnection* port, IStreamChannel* stream);
+    ~SweepEngine(void);
+
+    /** @brief Validates configuration and tunes to the first step
+        @return 0 on success
+    */
+    int Start(const SweepConfig &config, RetuneFunction retune);
+
+    /** @brief Receives current step and retunes to the next one
+        @param data destination for samplesPerStep samples in stream format,
+        or for spectrum.fftSize float bins in dBFS from lowest frequency
+        @param count size of destination in samples or bins
+        @param block [out] step tag
+        @param timeout_ms time to wait for samples
+        @return number of samples or bins, 0 on timeout, -1 on failure
+    */
+    int Next(void* data, const uint32_t count, SweepBlock &block, const int32_t timeout_ms);
+
+    //! @return number of completed steps since Start()
+    uint64_t GetStepCount(void) const;
+
+    //! @return completed steps per second since Start()
+    double GetStepsPerSecond(void) const;
+
+private:
+    int Retune(const size_t step);
+
+    IConnection* mPort;
+    IStreamChannel* mStream;
+    SweepConfig mConfig;
+    RetuneFunction mRetune;
+    bool mRunning;
+    uint32_t mSampleSize; //bytes per sample in stream format
+    uint32_t mBlockSamples; //samples received for each step
+    uint32_t mHop; //samples between FFTs in spectrum mode
+
+    //step being received
+    size_t mStep;
+    uint64_t mStartTimestamp; //first sample after settling
+    std::vector<char> mBuffer;
+    uint32_t mFilled;
+    uint64_t mBlockTimestamp;
+    bool mDiscontinuity;
+    uint64_t mNextTimestamp; //after the last received sample
+
+    PowerSpectrum mSpectrum;
+    std::vector<complex16_t> mSpectrumSamples;
+
+    uint64_t mSteps;
+    std::chrono::steady_clock::time_point mStartTime;
+};
+
+}
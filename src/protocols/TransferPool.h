@@ -0,0 +1,161 @@
+/**
+    @file TransferPool.h
+    @author Lime Microsystems
+    @brief Pool of asynchronous transfer contexts with completion queue.
+*/
+
+#ifndef LMS_TRANSFER_POOL_H
+#define LMS_TRANSFER_POOL_H
+
+#include <stdint.h>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+namespace lime{
+
+/*!
+ * Hands out indexes of transfer contexts from a free list in constant time
+ * and collects completed transfers in the order they finish.
+ *
+ * Transfer callbacks call Complete(). Owners either wait for a particular
+ * context with Wait() or take whichever completes first with WaitAny(),
+ * so that finished transfers are not stuck behind a slow one.
+ */
+class TransferPool
+{
+public:
+    /** @param count number of contexts, indexes are 0..count-1
+    */
+    explicit TransferPool(const int count) :
+        mState(count, FREE),
+        mQueued(count, false),
+        mNotifyAny(count, false),
+        mCompleted(count, 0),
+        mCompletedHead(0),
+        mCompletedCount(0)
+    {
+        mFree.reserve(count);
+        for (int i = count-1; i >= 0; --i)
+            mFree.push_back(i);
+    }
+
+    /** @brief Takes context from free list
+        @param notifyAny true if completion is reported by WaitAny()
+        @return context index, -1 if all contexts are in use
+    */
+    int Acquire(const bool notifyAny = true)
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mFree.empty())
+            return -1;
+        const int id = mFree.back();
+        mFree.pop_back();
+        mState[id] = PENDING;
+        mNotifyAny[id] = notifyAny;
+        return id;
+    }
+
+    //! @brief Returns context to free list
+    void Release(const int id)
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mState[id] == FREE)
+            return;
+        mState[id] = FREE;
+        mFree.push_back(id);
+    }
+
+    //! @brief Marks transfer finished, called from transfer callback
+    void Complete(const int id)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            if (mState[id] != PENDING)
+                return;
+            mState[id] = DONE;
+            //each context is queued at most once, queue never overflows
+            if (mNotifyAny[id] && !mQueued[id])
+            {
+                mQueued[id] = true;
+                mCompleted[(mCompletedHead + mCompletedCount) % mCompleted.size()] = id;
+                ++mCompletedCount;
+            }
+        }
+        mCompletedCV.notify_all();
+    }
+
+    /** @brief Waits for particular transfer to finish
+        @return true if transfer finished
+    */
+    bool Wait(const int id, const unsigned timeout_ms)
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        return mCompletedCV.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+            [this, id]{return mState[id] != PENDING;});
+    }
+
+    /** @brief Waits for any transfer acquired with notifyAny to finish
+        @return index of finished context, -1 on timeout
+    */
+    int WaitAny(const unsigned timeout_ms)
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        while (true)
+        {
+            while (mCompletedCount > 0)
+            {
+                const int id = mCompleted[mCompletedHead];
+                mCompletedHead = (mCompletedHead + 1) % mCompleted.size();
+                --mCompletedCount;
+                mQueued[id] = false;
+                //skip contexts released without being taken from queue
+                if (mState[id] == DONE && mNotifyAny[id])
+                {
+                    mState[id] = TAKEN;
+                    return id;
+                }
+            }
+            if (mCompletedCV.wait_until(lock, deadline) == std::cv_status::timeout && mCompletedCount == 0)
+                return -1;
+        }
+    }
+
+    //! @return true if transfer is submitted and not yet finished
+    bool IsPending(const int id)
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mState[id] == PENDING;
+    }
+
+    //! @return true if context is not in free list
+    bool IsUsed(const int id)
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mState[id] != FREE;
+    }
+
+private:
+    enum State : uint8_t
+    {
+        FREE,
+        PENDING, //submitted, transfer in progress
+        DONE, //finished, not yet taken by WaitAny()
+        TAKEN, //returned by WaitAny(), waiting for Release()
+    };
+
+    std::mutex mLock;
+    std::condition_variable mCompletedCV;
+    std::vector<int> mFree; //stack of free context indexes
+    std::vector<State> mState;
+    std::vector<bool> mQueued;
+    std::vector<bool> mNotifyAny;
+    std::vector<int> mCompleted; //ring of finished contexts in completion order
+    size_t mCompletedHead;
+    size_t mCompletedCount;
+};
+
+}
+#endif
@@ -0,0 +1,225 @@
+/**
+    @file USBEventLoop.cpp
+    @author Lime Microsystems
+    @brief libusb context and event thread shared by USB connections.
+*/
+
+#ifdef __unix__
+#include "USBEventLoop.h"
+#include "Logger.h"
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+using namespace lime;
+
+namespace
+{
+struct EventLoopState
+{
+    EventLoopState() :
+        ctx(nullptr),
+        contextRefs(0),
+        deviceRefs(0),
+        running(false),
+        pollfdsChanged(true)
+    {
+        wakePipe[0] = -1;
+        wakePipe[1] = -1;
+    }
+
+    std::mutex lock; //guards references, context and thread
+    libusb_context* ctx;
+    int contextRefs;
+    int deviceRefs;
+    std::thread thread;
+    std::atomic<bool> running;
+    std::atomic<bool> pollfdsChanged;
+    int wakePipe[2]; //interrupts poll() when stopping or libusb file descriptors change
+};
+
+EventLoopState& GetState(void)
+{
+    static EventLoopState state;
+    return state;
+}
+
+void Wake(EventLoopState* state)
+{
+    const char wake = 0;
+    if (write(state->wakePipe[1], &wake, 1) < 0 && errno != EAGAIN)
+        lime::warning("Failed to wake USB event thread");
+}
+
+void PollfdAdded(int, short, void* user_data)
+{
+    EventLoopState* state = (EventLoopState*)user_data;
+    state->pollfdsChanged.store(true);
+    Wake(state);
+}
+
+void PollfdRemoved(int, void* user_data)
+{
+    PollfdAdded(-1, 0, user_data);
+}
+
+void FreePollfds(const libusb_pollfd** pollfds)
+{
+#if defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000104)
+    libusb_free_pollfds(pollfds);
+#else
+    free(pollfds);
+#endif
+}
+
+//! @brief Handles events until libusb stops providing file descriptors or loop is stopped
+bool PollEvents(EventLoopState* state)
+{
+    std::vector<pollfd> fds;
+    while (state->running.load())
+    {
+        if (state->pollfdsChanged.exchange(false))
+        {
+            const libusb_pollfd** pollfds = libusb_get_pollfds(state->ctx);
+            if (pollfds == nullptr)
+                return false;
+            fds.resize(1);
+            fds[0].fd = state->wakePipe[0];
+            fds[0].events = POLLIN;
+            for (int i = 0; pollfds[i] != nullptr; ++i)
+            {
+                pollfd fd;
+                fd.fd = pollfds[i]->fd;
+                fd.events = pollfds[i]->events;
+                fds.push_back(fd);
+            }
+            FreePollfds(pollfds);
+        }
+
+        //sleep until transfer activity or the nearest libusb timeout
+        int timeout_ms = -1;
+        timeval tv;
+        if (libusb_get_next_timeout(state->ctx, &tv) == 1)
+            timeout_ms = tv.tv_sec*1000 + (tv.tv_usec+999)/1000;
+        for (auto &fd : fds)
+            fd.revents = 0;
+        if (poll(fds.data(), fds.size(), timeout_ms) < 0 && errno != EINTR)
+        {
+            lime::error("USB event poll failed: %s", strerror(errno));
+            return false;
+        }
+        if (fds[0].revents)
+        {
+            char buf[16];
+            while (read(state->wakePipe[0], buf, sizeof(buf)) > 0);
+        }
+        timeval zero = {0, 0};
+        const int r = libusb_handle_events_timeout_completed(state->ctx, &zero, nullptr);
+        if (r != 0 && r != LIBUSB_ERROR_INTERRUPTED)
+            lime::error("error libusb_handle_events %s", libusb_strerror(libusb_error(r)));
+    }
+    return true;
+}
+
+void EventThread(EventLoopState* state)
+{
+    libusb_set_pollfd_notifiers(state->ctx, PollfdAdded, PollfdRemoved, state);
+    state->pollfdsChanged.store(true);
+    const bool polled = PollEvents(state);
+    libusb_set_pollfd_notifiers(state->ctx, nullptr, nullptr, nullptr);
+    if (polled)
+        return;
+
+    //file descriptors not available on this platform
+    while (state->running.load())
+    {
+        timeval tv;
+        tv.tv_sec = 0;
+        tv.tv_usec = 250000;
+        const int r = libusb_handle_events_timeout_completed(state->ctx, &tv, nullptr);
+        if (r != 0 && r != LIBUSB_ERROR_INTERRUPTED)
+            lime::error("error libusb_handle_events %s", libusb_strerror(libusb_error(r)));
+    }
+}
+
+void StopThread(EventLoopState& state)
+{
+    state.running.store(false);
+    Wake(&state);
+#if defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000105)
+    libusb_interrupt_event_handler(state.ctx);
+#endif
+    state.thread.join();
+    close(state.wakePipe[0]);
+    close(state.wakePipe[1]);
+    state.wakePipe[0] = -1;
+    state.wakePipe[1] = -1;
+}
+}
+
+libusb_context* USBEventLoop::AcquireContext(void)
+{
+    EventLoopState& state = GetState();
+    std::lock_guard<std::mutex> lock(state.lock);
+    if (state.contextRefs == 0)
+    {
+        int r = libusb_init(&state.ctx); //initialize the library for the session we just declared
+        if(r < 0)
+        {
+            lime::error("Init Error %i", r); //there was an error
+            state.ctx = nullptr;
+            return nullptr;
+        }
+        libusb_set_debug(state.ctx, 3); //set verbosity level to 3, as suggested in the documentation
+    }
+    ++state.contextRefs;
+    return state.ctx;
+}
+
+void USBEventLoop::ReleaseContext(void)
+{
+    EventLoopState& state = GetState();
+    std::lock_guard<std::mutex> lock(state.lock);
+    if (state.contextRefs == 0 || --state.contextRefs > 0)
+        return;
+    if (state.thread.joinable())
+        StopThread(state);
+    libusb_exit(state.ctx);
+    state.ctx = nullptr;
+}
+
+void USBEventLoop::AddDevice(void)
+{
+    EventLoopState& state = GetState();
+    std::lock_guard<std::mutex> lock(state.lock);
+    if (state.ctx == nullptr || state.deviceRefs++ > 0)
+        return;
+    if (pipe(state.wakePipe) != 0)
+    {
+        lime::error("USB event thread: %s", strerror(errno));
+        return;
+    }
+    fcntl(state.wakePipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(state.wakePipe[1], F_SETFL, O_NONBLOCK);
+    state.running.store(true);
+    state.thread = std::thread(EventThread, &state);
+}
+
+void USBEventLoop::RemoveDevice(void)
+{
+    EventLoopState& state = GetState();
+    std::lock_guard<std::mutex> lock(state.lock);
+    if (state.deviceRefs == 0 || --state.deviceRefs > 0)
+        return;
+    if (state.thread.joinable())
+        StopThread(state);
+}
+
+#endif // __unix__
@@ -0,0 +1,40 @@
+/**
+    @file USBEventLoop.h
+    @author Lime Microsystems
+    @brief libusb context and event thread shared by USB connections.
+*/
+
+#pragma once
+#include <stdint.h>
+#include <libusb-1.0/libusb.h>
+
+namespace lime{
+
+/*!
+ * One libusb context serves all USB connection types and boards.
+ * The context lives while any connection registry entry holds a reference.
+ * A single event thread runs while at least one device is open, it sleeps
+ * in poll() on the libusb file descriptors until a transfer completes or a
+ * libusb timeout expires, so idle boards cause no periodic wakeups.
+ * When libusb does not expose its file descriptors the thread falls back
+ * to libusb_handle_events_timeout_completed().
+ */
+class USBEventLoop
+{
+public:
+    /** @brief Takes reference to shared context, first reference creates it
+        @return libusb context, nullptr if initialization failed
+    */
+    static libusb_context* AcquireContext(void);
+
+    //! @brief Drops context reference, last one frees the context
+    static void ReleaseContext(void);
+
+    //! @brief Registers opened device, first one starts event thread
+    static void AddDevice(void);
+
+    //! @brief Unregisters closed device, last one stops event thread
+    static void RemoveDevice(void);
+};
+
+}
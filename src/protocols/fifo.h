@@ -9,6 +9,7 @@
 #include <queue>
 #include <condition_variable>
 #include "dataTypes.h"
+#include "IConnection.h"
 #include <cmath>
 #include <assert.h>
 
@@ -19,13 +20,45 @@ class RingFIFO
 public:
     enum FLAGS
     {
-        OVERWRITE_OLD = 1,
+        OVERWRITE_OLD = 1, //push only, not stored with samples
+        END_BURST = 2, //last samples of burst, pop stops after them
+        DISCONTINUITY = 4, //samples do not continue previous ones, splitting pop stops before them
+        SYNC_TIMESTAMP = 8, //samples have to be sent at their timestamp
     };
 
+    //! @brief Converts stream metadata flags to FIFO sample flags
+    static uint32_t FromMetadataFlags(const uint32_t metaFlags)
+    {
+        uint32_t flags = 0;
+        if (metaFlags & IStreamChannel::Metadata::SYNC_TIMESTAMP)
+            flags |= SYNC_TIMESTAMP;
+        if (metaFlags & IStreamChannel::Metadata::END_BURST)
+            flags |= END_BURST;
+        if (metaFlags & IStreamChannel::Metadata::DISCONTINUITY)
+            flags |= DISCONTINUITY;
+        return flags;
+    }
+
+    //! @brief Converts FIFO sample flags to stream metadata flags
+    static uint32_t ToMetadataFlags(const uint32_t flags)
+    {
+        uint32_t metaFlags = 0;
+        if (flags & SYNC_TIMESTAMP)
+            metaFlags |= IStreamChannel::Metadata::SYNC_TIMESTAMP;
+        if (flags & END_BURST)
+            metaFlags |= IStreamChannel::Metadata::END_BURST;
+        if (flags & DISCONTINUITY)
+            metaFlags |= IStreamChannel::Metadata::DISCONTINUITY;
+        return metaFlags;
+    }
+
     struct BufferInfo
     {
         uint32_t size;
         uint32_t itemsFilled;
+        uint32_t maxItemsFilled; //highest fullness since last Clear()
+        uint32_t pushWaits; //push_samples() calls that waited for free space since last Clear()
+        uint64_t pushWaitTime_us; //total time of the waits
     };
 
     //! @brief Returns information about FIFO size and fullness
@@ -35,6 +68,9 @@ public:
         BufferInfo stats;
         stats.size = mBufferSize*mBuffer->maxSamplesInPacket;
         stats.itemsFilled = mElementsFilled*mBuffer->maxSamplesInPacket;
+        stats.maxItemsFilled = mMaxElementsFilled*mBuffer->maxSamplesInPacket;
+        stats.pushWaits = mPushWaits;
+        stats.pushWaitTime_us = mPushWaitTime_us;
         return stats;
     }
 
@@ -56,35 +92,61 @@ public:
     @param channelsCount number of channels to insert
     @param timeout_ms timeout duration for operation
     @param flags optional flags associated with the samples
+    @param stats optional signal statistics of the samples, kept with the first packet buffer
     @return number of items inserted
     */
-    uint32_t push_samples(const complex16_t *buffer, const uint32_t samplesCount, const uint8_t channelsCount, uint64_t timestamp, const uint32_t timeout_ms, const uint32_t flags = 0)
+    uint32_t push_samples(const complex16_t *buffer, const uint32_t samplesCount, const uint8_t channelsCount, uint64_t timestamp, const uint32_t timeout_ms, const uint32_t flags = 0, const SignalStats* stats = nullptr)
     {
         assert(buffer != nullptr);
         uint32_t samplesTaken = 0;
+        bool overwritten = false;
+        bool waited = false;
         std::unique_lock<std::mutex> lck(lock);
         auto t1 = std::chrono::high_resolution_clock::now();
         while (samplesTaken < samplesCount)
         {
             if (mElementsFilled >= mBufferSize) //buffer might be full, wait for free slots
             {
-                auto t2 = std::chrono::high_resolution_clock::now();
-                if(t2-t1 >= std::chrono::milliseconds(timeout_ms))
+                if((flags & OVERWRITE_OLD) && mReadAcquired != 0)
+                {
+                    //oldest samples are in use by reader, drop new ones
+                    lck.unlock();
+                    hasItems.notify_one();
                     return samplesTaken;
-
-                if(flags & OVERWRITE_OLD)
+                }
+                else if(flags & OVERWRITE_OLD)
                 {
                     int dropElements = ceil(((float)samplesCount-samplesTaken)/mBuffer[mTail].maxSamplesInPacket);
                     if(dropElements == 0)
                         dropElements = 1;
+                    for(int i=0; i<dropElements; ++i)
+                    {
+                        const SamplesPacket &pkt = mBuffer[(mHead + i) & (mBufferSize - 1)];
+                        if (mOverwrittenCount == 0)
+                            mOverwrittenTimestamp = pkt.timestamp + pkt.first;
+                        mOverwrittenCount += pkt.last - pkt.first;
+                    }
                     mHead = (mHead + dropElements) & (mBufferSize - 1);//advance to next one
                     mElementsFilled -= dropElements;
+                    //reader continues after dropped samples
+                    if (mElementsFilled > 0)
+                        mBuffer[mHead].flags |= DISCONTINUITY;
+                    else
+                        overwritten = true;
                 }
 
                 //there is no space, wait on CV to give pop_samples the thread context
                 else
                 {
+                    auto t2 = std::chrono::high_resolution_clock::now();
+                    if(t2-t1 >= std::chrono::milliseconds(timeout_ms))
+                        return samplesTaken;
+                    const auto waitStart = std::chrono::steady_clock::now();
                     hasItems.wait_for(lck, std::chrono::milliseconds(timeout_ms));
+                    mPushWaitTime_us += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - waitStart).count();
+                    if (!waited)
+                        ++mPushWaits;
+                    waited = true;
                 }
             }
 
@@ -93,7 +155,16 @@ public:
                 mBuffer[mTail].timestamp = timestamp + samplesTaken;
                 mBuffer[mTail].first = 0;
                 mBuffer[mTail].last = 0;
-                mBuffer[mTail].flags = flags;
+                mBuffer[mTail].flags = flags & ~(END_BURST | OVERWRITE_OLD);
+                if (overwritten)
+                {
+                    mBuffer[mTail].flags |= DISCONTINUITY;
+                    overwritten = false;
+                }
+                if (stats != nullptr && mStats.empty())
+                    mStats.resize(mBufferSize);
+                if (!mStats.empty())
+                    mStats[mTail] = (stats != nullptr && samplesTaken == 0) ? *stats : SignalStats();
                 while (mBuffer[mTail].last < mBuffer[mTail].maxSamplesInPacket && samplesTaken < samplesCount)
                 {
                     const int sampleIndex = mBuffer[mTail].last;
@@ -101,11 +172,15 @@ public:
                     ++samplesTaken;
                     ++mBuffer[mTail].last;
                 }
+                if (samplesTaken == samplesCount) //end of burst applies to last samples only
+                    mBuffer[mTail].flags |= flags & END_BURST;
                 mTail = (mTail + 1) & (mBufferSize - 1);//advance to next one
                 mTail = mTail;
                 ++mElementsFilled;
             }
         }
+        if (mElementsFilled > mMaxElementsFilled)
+            mMaxElementsFilled = mElementsFilled;
         lck.unlock();
         hasItems.notify_one();
         return samplesTaken;
@@ -118,15 +193,21 @@ public:
         @param timestamp returns timestamp of the first sample in buffer
         @param timeout_ms timeout duration for operation
         @param flags optional flags associated with the samples
-        @return number of samples popped
+        @param stats [out] optional signal statistics of packet buffers emptied by this call
+        @param splitGaps stop before discontinuities and timestamp gaps, so that
+        returned samples are continuous, used when all samples have valid timestamps
+        @return number of samples popped, fewer than requested if end of burst or split gap was reached
     */
-    uint32_t pop_samples(complex16_t* buffer, const uint32_t samplesCount, const uint8_t channelsCount, uint64_t *timestamp, const uint32_t timeout_ms, uint32_t *flags = nullptr)
+    uint32_t pop_samples(complex16_t* buffer, const uint32_t samplesCount, const uint8_t channelsCount, uint64_t *timestamp, const uint32_t timeout_ms, uint32_t *flags = nullptr, SignalStats* stats = nullptr, const bool splitGaps = false)
     {
         assert(buffer != nullptr);
         uint32_t samplesFilled = 0;
+        uint64_t nextTimestamp = 0;
+        bool burstEnd = false;
+        bool gapAhead = false;
         if (flags != nullptr) *flags = 0;
         std::unique_lock<std::mutex> lck(lock);
-        while (samplesFilled < samplesCount)
+        while (samplesFilled < samplesCount && !burstEnd && !gapAhead)
         {
             while (mElementsFilled == 0) //buffer might be empty, wait for packets
             {
@@ -138,17 +219,29 @@ public:
             if(samplesFilled == 0 && timestamp != nullptr)
                 *timestamp = mBuffer[mHead].timestamp + mBuffer[mHead].first;
 
-            while(mElementsFilled > 0 && samplesFilled < samplesCount)
+            while(mElementsFilled > 0 && samplesFilled < samplesCount && !burstEnd)
             {
-                if (flags != nullptr) *flags |= mBuffer[mHead].flags;
+                //packets dropped by timed receive commands leave gaps without discontinuity flag
+                if (splitGaps && samplesFilled != 0 && ((mBuffer[mHead].flags & DISCONTINUITY)
+                    || mBuffer[mHead].timestamp + mBuffer[mHead].first != nextTimestamp))
+                {
+                    gapAhead = true;
+                    break;
+                }
+                if (flags != nullptr) *flags |= mBuffer[mHead].flags & ~END_BURST;
+                mBuffer[mHead].flags &= ~DISCONTINUITY; //reported once
                 while (mBuffer[mHead].first < mBuffer[mHead].last && samplesFilled < samplesCount)
                 {
                     buffer[samplesFilled] = mBuffer[mHead].samples[mBuffer[mHead].first];
                     ++mBuffer[mHead].first;
                     ++samplesFilled;
                 }
+                nextTimestamp = mBuffer[mHead].timestamp + mBuffer[mHead].first;
                 if (mBuffer[mHead].first == mBuffer[mHead].last) //packet depleated
                 {
+                    burstEnd = mBuffer[mHead].flags & END_BURST;
+                    if (stats != nullptr && !mStats.empty())
+                        stats->Add(mStats[mHead]);
                     mBuffer[mHead].first = 0;
                     mBuffer[mHead].last = 0;
                     mBuffer[mHead].timestamp = 0;
@@ -160,15 +253,189 @@ public:
         }
         lck.unlock();
         hasItems.notify_one();
+        if (burstEnd && flags != nullptr)
+            *flags |= END_BURST;
         return samplesFilled;
     }
 
+    /** @brief Drops samples that are older than given timestamp, operation is thread-safe
+        @param timestamp timestamp of the first sample to keep
+        @param requiredFlags only samples pushed with all of these flags are dropped
+        @return number of samples dropped
+    */
+    uint32_t drop_samples_before(const uint64_t timestamp, const uint32_t requiredFlags = 0)
+    {
+        uint32_t samplesDropped = 0;
+        std::unique_lock<std::mutex> lck(lock);
+        while (mElementsFilled > 0 && mReadAcquired == 0)
+        {
+            SamplesPacket &pkt = mBuffer[mHead];
+            if ((pkt.flags & requiredFlags) != requiredFlags)
+                break;
+            if (pkt.timestamp + pkt.last > timestamp)
+            {
+                if (pkt.timestamp + pkt.first < timestamp)
+                {
+                    samplesDropped += timestamp - (pkt.timestamp + pkt.first);
+                    pkt.first = timestamp - pkt.timestamp;
+                }
+                break;
+            }
+            samplesDropped += pkt.last - pkt.first;
+            pkt.first = 0;
+            pkt.last = 0;
+            pkt.timestamp = 0;
+            mHead = (mHead + 1) & (mBufferSize - 1);
+            --mElementsFilled;
+        }
+        lck.unlock();
+        hasItems.notify_one();
+        return samplesDropped;
+    }
+
+    /** @brief Gives direct access to the oldest samples in FIFO, operation is thread-safe.
+        Acquired samples stay in FIFO until released, buffers have to be released
+        in order of acquisition. Should not be mixed with pop_samples().
+        @param handle [out] index of acquired buffer
+        @param buffer [out] pointer to samples of acquired buffer
+        @param timestamp [out] timestamp of the first sample in buffer
+        @param timeout_ms timeout duration for operation
+        @param flags [out] optional flags associated with the samples
+        @param stats [out] optional signal statistics of the samples
+        @return number of samples in buffer, 0 on timeout
+    */
+    uint32_t acquire_read(uint32_t &handle, const complex16_t** buffer, uint64_t *timestamp, const uint32_t timeout_ms, uint32_t *flags = nullptr, SignalStats* stats = nullptr)
+    {
+        std::unique_lock<std::mutex> lck(lock);
+        while (mElementsFilled <= mReadAcquired) //no unacquired packets, wait
+        {
+            if (timeout_ms == 0)
+                return 0;
+            if (hasItems.wait_for(lck, std::chrono::milliseconds(timeout_ms)) == std::cv_status::timeout)
+                return 0;
+        }
+        handle = (mHead + mReadAcquired) & (mBufferSize - 1);
+        ++mReadAcquired;
+        const SamplesPacket &pkt = mBuffer[handle];
+        *buffer = &pkt.samples[pkt.first];
+        if (timestamp != nullptr)
+            *timestamp = pkt.timestamp + pkt.first;
+        if (flags != nullptr)
+            *flags = pkt.flags;
+        if (stats != nullptr)
+            *stats = mStats.empty() ? SignalStats() : mStats[handle];
+        return pkt.last - pkt.first;
+    }
+
+    /** @brief Removes buffer acquired by acquire_read() from FIFO, operation is thread-safe
+        @param handle buffer index returned by acquire_read()
+        @return 0 on success, -1 if handle is not the oldest acquired buffer
+    */
+    int release_read(const uint32_t handle)
+    {
+        std::unique_lock<std::mutex> lck(lock);
+        if (mReadAcquired == 0 || handle != mHead)
+            return -1;
+        mBuffer[mHead].first = 0;
+        mBuffer[mHead].last = 0;
+        mBuffer[mHead].timestamp = 0;
+        mHead = (mHead + 1) & (mBufferSize - 1);
+        --mElementsFilled;
+        --mReadAcquired;
+        lck.unlock();
+        hasItems.notify_one();
+        return 0;
+    }
+
+    /** @brief Gives direct access to free FIFO buffer for writing, operation is thread-safe.
+        Buffers have to be released in order of acquisition. Should not be mixed with push_samples().
+        @param handle [out] index of acquired buffer
+        @param buffer [out] pointer to samples of acquired buffer
+        @param timeout_ms timeout duration for operation
+        @return number of samples that fit in buffer, 0 on timeout
+    */
+    uint32_t acquire_write(uint32_t &handle, complex16_t** buffer, const uint32_t timeout_ms)
+    {
+        std::unique_lock<std::mutex> lck(lock);
+        while (mElementsFilled + mWriteAcquired >= mBufferSize) //no free packets, wait
+        {
+            if (timeout_ms == 0)
+                return 0;
+            if (hasItems.wait_for(lck, std::chrono::milliseconds(timeout_ms)) == std::cv_status::timeout)
+                return 0;
+        }
+        handle = (mTail + mWriteAcquired) & (mBufferSize - 1);
+        ++mWriteAcquired;
+        *buffer = mBuffer[handle].samples;
+        return mBuffer[handle].maxSamplesInPacket;
+    }
+
+    /** @brief Inserts buffer acquired by acquire_write() to FIFO, operation is thread-safe
+        @param handle buffer index returned by acquire_write()
+        @param samplesCount number of samples written to buffer
+        @param timestamp timestamp of the first sample in buffer
+        @param flags optional flags associated with the samples
+        @return 0 on success, -1 if handle is not the oldest acquired buffer
+    */
+    int release_write(const uint32_t handle, const uint32_t samplesCount, const uint64_t timestamp, const uint32_t flags = 0)
+    {
+        std::unique_lock<std::mutex> lck(lock);
+        if (mWriteAcquired == 0 || handle != mTail)
+            return -1;
+        SamplesPacket &pkt = mBuffer[mTail];
+        pkt.timestamp = timestamp;
+        pkt.first = 0;
+        pkt.last = samplesCount < pkt.maxSamplesInPacket ? samplesCount : pkt.maxSamplesInPacket;
+        pkt.flags = flags;
+        mTail = (mTail + 1) & (mBufferSize - 1);
+        ++mElementsFilled;
+        if (mElementsFilled > mMaxElementsFilled)
+            mMaxElementsFilled = mElementsFilled;
+        --mWriteAcquired;
+        lck.unlock();
+        hasItems.notify_one();
+        return 0;
+    }
+
+    /** @brief Returns number of samples dropped by OVERWRITE_OLD since last call
+        @param timestamp [out] timestamp of the first dropped sample
+    */
+    uint32_t take_overwritten(uint64_t *timestamp)
+    {
+        if (mOverwrittenCount.load(std::memory_order_relaxed) == 0)
+            return 0;
+        std::unique_lock<std::mutex> lck(lock);
+        const uint32_t count = mOverwrittenCount;
+        *timestamp = mOverwrittenTimestamp;
+        mOverwrittenCount = 0;
+        return count;
+    }
+
+    //! @brief Returns number of packet buffers in FIFO
+    uint32_t GetBufferCount() const
+    {
+        return mBufferSize;
+    }
+
+    //! @brief Returns samples of packet buffer with index returned by acquire_read() or acquire_write()
+    complex16_t* GetBufferAddress(const uint32_t handle)
+    {
+        return mBuffer[handle].samples;
+    }
+
     void Clear()
     {
         std::unique_lock<std::mutex> lck(lock);
         mHead = 0;
         mTail = 0;
         mElementsFilled = 0;
+        mMaxElementsFilled = 0;
+        mReadAcquired = 0;
+        mWriteAcquired = 0;
+        mOverwrittenCount = 0;
+        mOverwrittenTimestamp = 0;
+        mPushWaits = 0;
+        mPushWaitTime_us = 0;
     }
 
 protected:
@@ -177,6 +444,14 @@ protected:
     uint32_t mHead;
     uint32_t mTail;
     uint32_t mElementsFilled;
+    uint32_t mMaxElementsFilled;
+    uint32_t mReadAcquired; //packets given for direct reading
+    uint32_t mWriteAcquired; //packets given for direct writing
+    std::atomic<uint32_t> mOverwrittenCount; //samples dropped by OVERWRITE_OLD
+    std::vector<SignalStats> mStats; //statistics of each packet buffer, allocated on first use
+    uint64_t mOverwrittenTimestamp;
+    uint32_t mPushWaits;
+    uint64_t mPushWaitTime_us;
     std::mutex lock;
     std::condition_variable hasItems;
 };
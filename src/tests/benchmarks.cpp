@@ -0,0 +1,183 @@
+#include "gtest/gtest.h"
+#include "syntheticConnection.h"
+#include "pipelineConnection.h"
+#include "serialEmulator.h"
+#include "LMS7002M.h"
+#include <ctime>
+#include <algorithm>
+#include <cstdlib>
+using namespace std;
+using namespace lime;
+
+/** @brief Compares CPU time used to receive samples by copying them with
+    ReadStream() and by accessing FIFO buffers directly.
+*/
+TEST (Benchmark, DirectAccessRx)
+{
+    const size_t samplesToReceive = 50e6;
+    const int bufferSize = spp*16;
+    double cpuPerMSps[2];
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        SyntheticConnection conn;
+        StreamConfig config;
+        config.isTx = false;
+        config.channelID = 0;
+        config.format = StreamConfig::STREAM_12_BIT_COMPRESSED;
+        size_t streamID = 0;
+        ASSERT_EQ(0, conn.SetupStream(streamID, config));
+        ASSERT_NE(0u, conn.GetNumDirectAccessBuffers(streamID));
+        conn.rxStream = streamID;
+        ASSERT_EQ(0, conn.ControlStream(streamID, true));
+
+        std::vector<complex16_t> buffer(bufferSize);
+        size_t samplesReceived = 0;
+        std::clock_t cpuStart = std::clock();
+        while (samplesReceived < samplesToReceive)
+        {
+            StreamMetadata meta;
+            int count;
+            if (mode == 0)
+                count = conn.ReadStream(streamID, buffer.data(), bufferSize, 1000, meta);
+            else
+            {
+                size_t handle;
+                const void* samples;
+                count = conn.AcquireReadBuffer(streamID, handle, &samples, 1000, meta);
+                if (count > 0)
+                    conn.ReleaseReadBuffer(streamID, handle);
+            }
+            ASSERT_GT(count, 0);
+            samplesReceived += count;
+        }
+        const double cpuSeconds = double(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+        conn.ControlStream(streamID, false);
+        conn.CloseStream(streamID);
+        cpuPerMSps[mode] = 100.0 * cpuSeconds / (samplesReceived / 1e6);
+    }
+    printf("CPU load per 1 MS/s: ReadStream %.3f%%, direct access %.3f%%\n", cpuPerMSps[0], cpuPerMSps[1]);
+}
+
+/** @brief Synthetic connection where packets are parsed by the benchmark
+    thread itself, so receive path is measured without generator pacing.
+*/
+class ManualRxConnection : public SyntheticConnection
+{
+public:
+    ManualRxConnection() : streamer(nullptr)
+    {
+        RxLoopFunction = [this](Streamer* stream)
+        {
+            streamer = stream;
+            while (!stream->terminateRx.load())
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        };
+    }
+    std::atomic<Streamer*> streamer;
+};
+
+/** @brief Compares time of the receive path, from packet parsing to
+    ReadStream(), with and without signal statistics. Both streams are
+    processed in the benchmark thread in alternating batches and median
+    batch times are compared, so scheduling noise affects both equally.
+*/
+TEST (Benchmark, SignalStatsRx)
+{
+    const int batches = 20000;
+    const int packetsInBatch = 4;
+    ManualRxConnection conn[2];
+    size_t streamID[2] = {0, 0};
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        StreamConfig config;
+        config.isTx = false;
+        config.channelID = 0;
+        config.format = StreamConfig::STREAM_12_BIT_COMPRESSED;
+        config.signalStats = mode == 1;
+        ASSERT_EQ(0, conn[mode].SetupStream(streamID[mode], config));
+        ASSERT_EQ(0, conn[mode].ControlStream(streamID[mode], true));
+        while (conn[mode].streamer.load() == nullptr)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    FPGA_DataPacket pkt;
+    memset(&pkt, 0, sizeof(pkt));
+    for (size_t i = 0; i < sizeof(pkt.data); ++i)
+        pkt.data[i] = rand();
+    std::vector<complex16_t> buffer(spp*packetsInBatch);
+    std::vector<double> times[2];
+    for (int b = 0; b < batches; ++b)
+    {
+        for (int mode = 0; mode < 2; ++mode)
+        {
+            const auto begin = std::chrono::steady_clock::now();
+            for (int i = 0; i < packetsInBatch; ++i)
+            {
+                pkt.counter = uint64_t(b*packetsInBatch + i)*spp;
+                conn[mode].streamer.load()->ProcessRxPacket(pkt);
+            }
+            StreamMetadata meta;
+            ASSERT_EQ(int(buffer.size()), conn[mode].ReadStream(streamID[mode], buffer.data(), buffer.size(), 1000, meta));
+            times[mode].push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+        }
+    }
+    double cpuPerMSps[2];
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        conn[mode].ControlStream(streamID[mode], false);
+        conn[mode].CloseStream(streamID[mode]);
+        std::nth_element(times[mode].begin(), times[mode].begin()+batches/2, times[mode].end());
+        cpuPerMSps[mode] = 100.0 * times[mode][batches/2] / (buffer.size() / 1e6);
+    }
+    printf("CPU load per 1 MS/s: without statistics %.3f%%, with statistics %.3f%% (+%.1f%%)\n",
+        cpuPerMSps[0], cpuPerMSps[1], 100.0*(cpuPerMSps[1]/cpuPerMSps[0] - 1));
+}
+
+/** @brief Compares time of LMS7002M::UploadAll() with one and with eight
+    control packets in flight, replies arrive 200 us after request.
+*/
+TEST (Benchmark, UploadAllPipelined)
+{
+    const int windows[2] = {1, 8};
+    for (int i = 0; i < 2; ++i)
+    {
+        PipelineConnection conn(windows[i], 200);
+        LMS7002M lms;
+        lms.SetConnection(&conn, 0);
+        const auto begin = std::chrono::steady_clock::now();
+        ASSERT_EQ(0, lms.UploadAll());
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        printf("UploadAll with %d packets in flight: %.1f ms, %u packets\n",
+            windows[i], seconds*1e3, conn.GetControlTransferCount());
+    }
+}
+
+#ifdef __unix__
+/** @brief Measures rate of register writes to EVB7COM over pseudo terminal,
+    board replies 1 ms after each received chunk.
+*/
+TEST (Benchmark, SerialControl)
+{
+    SerialEmulator board(1000);
+    IConnection* conn = board.Connect();
+    if (conn == nullptr)
+    {
+        printf("EVB7COM connection not available, skipping\n");
+        return;
+    }
+    const int packets = 200;
+    std::vector<uint32_t> addrs(packets*14);
+    std::vector<uint32_t> values(addrs.size());
+    for (size_t i = 0; i < addrs.size(); ++i)
+    {
+        addrs[i] = i & 0xFF;
+        values[i] = i;
+    }
+    const auto begin = std::chrono::steady_clock::now();
+    EXPECT_EQ(0, conn->WriteRegisters(addrs.data(), values.data(), addrs.size()));
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    printf("Serial control over pty: %.0f packets/s, %d writes for %d packets\n",
+        packets/seconds, board.chunks.load(), packets);
+    ConnectionRegistry::freeConnection(conn);
+}
+#endif
@@ -0,0 +1,137 @@
+#include "gtest/gtest.h"
+#include "syntheticConnection.h"
+using namespace std;
+using namespace lime;
+
+static size_t SetupRx(SyntheticConnection& conn)
+{
+    StreamConfig config;
+    config.isTx = false;
+    config.channelID = 0;
+    config.format = StreamConfig::STREAM_12_BIT_COMPRESSED;
+    size_t streamID = 0;
+    if (conn.SetupStream(streamID, config) != 0)
+        return 0;
+    conn.rxStream = streamID;
+    return streamID;
+}
+
+TEST (Capture, LevelTrigger)
+{
+    SyntheticConnection conn(true);
+    StreamConfig config;
+    config.isTx = false;
+    config.channelID = 0;
+    config.format = StreamConfig::STREAM_12_BIT_IN_16;
+    size_t rxStream = 0;
+    size_t txStream = 0;
+    ASSERT_EQ(0, conn.SetupStream(rxStream, config));
+    config.isTx = true;
+    ASSERT_EQ(0, conn.SetupStream(txStream, config));
+    ASSERT_EQ(0, conn.ControlStream(rxStream, true));
+    ASSERT_EQ(0, conn.ControlStream(txStream, true));
+
+    CaptureConfig capture;
+    capture.trigger = CaptureConfig::TRIGGER_LEVEL;
+    capture.level = 1000;
+    capture.preTriggerSamples = 500;
+    capture.postTriggerSamples = 1000;
+    ASSERT_EQ(0, conn.ArmCapture(rxStream, capture));
+
+    //step from zero to level above threshold
+    const uint64_t timestamp = 100000;
+    std::vector<complex16_t> tx(5000);
+    for (size_t i = 3000; i < tx.size(); ++i)
+    {
+        tx[i].i = 1500;
+        tx[i].q = -1500;
+    }
+    StreamMetadata txMeta;
+    txMeta.timestamp = timestamp;
+    txMeta.hasTimestamp = true;
+    txMeta.endOfBurst = true;
+    ASSERT_EQ(int(tx.size()), conn.WriteStream(txStream, tx.data(), tx.size(), 1000, txMeta));
+
+    std::vector<complex16_t> rx(2000);
+    StreamMetadata meta;
+    uint64_t trigger = 0;
+    ASSERT_EQ(1500, conn.ReadCapture(rxStream, rx.data(), rx.size(), 1000, meta, trigger));
+    EXPECT_EQ(timestamp + 3000, trigger);
+    EXPECT_EQ(trigger - 500, meta.timestamp);
+    EXPECT_FALSE(meta.discontinuity);
+    EXPECT_EQ(0, rx[499].i);
+    EXPECT_EQ(1500, rx[500].i);
+    EXPECT_EQ(-1500, rx[1499].q);
+
+    //samples are delivered to stream again after disarming
+    ASSERT_EQ(0, conn.DisarmCapture(rxStream));
+    EXPECT_GT(conn.ReadStream(rxStream, rx.data(), rx.size(), 1000, meta), 0);
+
+    conn.ControlStream(txStream, false);
+    conn.ControlStream(rxStream, false);
+    conn.CloseStream(txStream);
+    conn.CloseStream(rxStream);
+}
+
+TEST (Capture, SoftwareTrigger)
+{
+    SyntheticConnection conn;
+    const size_t streamID = SetupRx(conn);
+    ASSERT_NE(0u, streamID);
+    ASSERT_EQ(0, conn.ControlStream(streamID, true));
+
+    CaptureConfig capture;
+    capture.preTriggerSamples = 4000;
+    capture.postTriggerSamples = 1000;
+    ASSERT_EQ(0, conn.ArmCapture(streamID, capture));
+    std::vector<complex16_t> rx(5000);
+    StreamMetadata meta;
+    uint64_t trigger = 0;
+    //not triggered yet
+    EXPECT_EQ(0, conn.ReadCapture(streamID, rx.data(), rx.size(), 10, meta, trigger));
+    ASSERT_EQ(0, conn.TriggerCapture(streamID));
+    ASSERT_EQ(5000, conn.ReadCapture(streamID, rx.data(), rx.size(), 1000, meta, trigger));
+    EXPECT_EQ(trigger - 4000, meta.timestamp);
+
+    conn.ControlStream(streamID, false);
+    conn.CloseStream(streamID);
+}
+
+TEST (Capture, TimestampTrigger)
+{
+    SyntheticConnection conn;
+    const size_t streamID = SetupRx(conn);
+    ASSERT_NE(0u, streamID);
+    CaptureConfig capture;
+    capture.trigger = CaptureConfig::TRIGGER_TIMESTAMP;
+    capture.timestamp = 1000005;
+    capture.preTriggerSamples = 2000;
+    capture.postTriggerSamples = 3000;
+    ASSERT_EQ(0, conn.ArmCapture(streamID, capture));
+    ASSERT_EQ(0, conn.ControlStream(streamID, true));
+
+    std::vector<complex16_t> rx(10000);
+    StreamMetadata meta;
+    uint64_t trigger = 0;
+    ASSERT_EQ(5000, conn.ReadCapture(streamID, rx.data(), rx.size(), 1000, meta, trigger));
+    EXPECT_EQ(capture.timestamp, trigger);
+    EXPECT_EQ(capture.timestamp - 2000, meta.timestamp);
+
+    conn.ControlStream(streamID, false);
+    conn.CloseStream(streamID);
+}
+
+TEST (Capture, InvalidConfig)
+{
+    SyntheticConnection conn;
+    const size_t streamID = SetupRx(conn);
+    ASSERT_NE(0u, streamID);
+    CaptureConfig capture;
+    EXPECT_NE(0, conn.ArmCapture(streamID, capture));
+    std::vector<complex16_t> rx(16);
+    StreamMetadata meta;
+    uint64_t trigger = 0;
+    EXPECT_LT(conn.ReadCapture(streamID, rx.data(), rx.size(), 10, meta, trigger), 0);
+    EXPECT_NE(0, conn.TriggerCapture(streamID));
+    conn.CloseStream(streamID);
+}
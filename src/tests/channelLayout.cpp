@@ -0,0 +1,107 @@
+#include "gtest/gtest.h"
+#include "syntheticConnection.h"
+using namespace std;
+using namespace lime;
+
+TEST (ChannelLayout, ClosedChannelDisabled)
+{
+    SyntheticConnection conn;
+    StreamConfig config;
+    config.isTx = false;
+    config.format = StreamConfig::STREAM_12_BIT_COMPRESSED;
+    size_t streams[2];
+    for (int ch = 0; ch < 2; ++ch)
+    {
+        config.channelID = ch;
+        ASSERT_EQ(0, conn.SetupStream(streams[ch], config));
+    }
+    conn.rxStream = streams[0];
+    for (int ch = 0; ch < 2; ++ch)
+        ASSERT_EQ(0, conn.ControlStream(streams[ch], true));
+
+    complex16_t buffer[spp];
+    StreamMetadata meta;
+    uint32_t channelEnables = 0;
+    for (int ch = 0; ch < 2; ++ch)
+        EXPECT_GT(conn.ReadStream(streams[ch], buffer, spp, 1000, meta), 0);
+    ASSERT_EQ(0, conn.ReadRegister(0x0007, channelEnables));
+    EXPECT_EQ(0x3u, channelEnables & 0x3);
+
+    //stopped channel stays enabled until its stream is closed
+    ASSERT_EQ(0, conn.ControlStream(streams[1], false));
+    ASSERT_EQ(0, conn.ReadRegister(0x0007, channelEnables));
+    EXPECT_EQ(0x3u, channelEnables & 0x3);
+    ASSERT_EQ(0, conn.CloseStream(streams[1]));
+    ASSERT_EQ(0, conn.ReadRegister(0x0007, channelEnables));
+    EXPECT_EQ(0x1u, channelEnables & 0x3);
+
+    //remaining channel gets whole packets after buffered two channel packets
+    int count = 0;
+    for (int i = 0; i < 1000 && count != spp; ++i)
+        count = conn.ReadStream(streams[0], buffer, spp, 1000, meta);
+    EXPECT_EQ(spp, count);
+
+    conn.ControlStream(streams[0], false);
+    conn.CloseStream(streams[0]);
+}
+
+TEST (ChannelLayout, TxContinuesWhenRxAdded)
+{
+    SyntheticConnection conn;
+    StreamConfig config;
+    config.format = StreamConfig::STREAM_12_BIT_COMPRESSED;
+    config.channelID = 0;
+    size_t rxA, rxB, txA;
+    config.isTx = false;
+    ASSERT_EQ(0, conn.SetupStream(rxA, config));
+    conn.rxStream = rxA;
+    config.isTx = true;
+    config.underflowTimeout_ms = 1;
+    ASSERT_EQ(0, conn.SetupStream(txA, config));
+    ASSERT_EQ(0, conn.ControlStream(rxA, true));
+    ASSERT_EQ(0, conn.ControlStream(txA, true));
+
+    std::atomic<bool> stop(false);
+    std::thread reader([&]{
+        complex16_t buffer[spp];
+        StreamMetadata meta;
+        while (!stop.load())
+            conn.ReadStream(rxA, buffer, spp, 100, meta);
+    });
+    conn.recordTxPackets = 100000;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    config.isTx = false;
+    config.channelID = 1;
+    EXPECT_EQ(0, conn.SetupStream(rxB, config));
+    EXPECT_EQ(0, conn.ControlStream(rxB, true));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    stop.store(true);
+    reader.join();
+    uint32_t channelEnables = 0;
+    EXPECT_EQ(0, conn.ReadRegister(0x0007, channelEnables));
+    EXPECT_EQ(0x3u, channelEnables & 0x3);
+
+    //transmit timestamps continue from one channel to two channel packets
+    const std::vector<FPGA_DataPacket> packets = conn.TakeTxPackets();
+    ASSERT_GT(packets.size(), 2u);
+    uint32_t samplesInPacket = spp;
+    int switches = 0;
+    for (size_t i = 1; i < packets.size(); ++i)
+    {
+        const uint64_t step = packets[i].counter - packets[i-1].counter;
+        if (step != samplesInPacket && step == spp/2)
+        {
+            samplesInPacket = step;
+            ++switches;
+        }
+        ASSERT_EQ(samplesInPacket, step) << "packet " << i;
+    }
+    EXPECT_EQ(1, switches);
+
+    conn.ControlStream(rxB, false);
+    conn.ControlStream(txA, false);
+    conn.ControlStream(rxA, false);
+    conn.CloseStream(rxB);
+    conn.CloseStream(txA);
+    conn.CloseStream(rxA);
+}
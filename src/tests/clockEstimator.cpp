@@ -0,0 +1,109 @@
+#include "gtest/gtest.h"
+#include "ClockEstimator.h"
+#include <random>
+#include <cmath>
+using namespace std;
+using namespace lime;
+
+static const double nominalRate = 10e6;
+static const int64_t startTime_ns = 1000000000;
+
+/** @brief Packets of hardware clock running at given rate, received with
+    random latency up to maxLatency_ns after their last sample
+*/
+class ClockSimulator
+{
+public:
+    ClockSimulator(const double rate_Hz, const int64_t maxLatency_ns) :
+        rate(rate_Hz), mLatency(0, maxLatency_ns), mRandom(5), mSampleTime(startTime_ns)
+    {
+    }
+
+    //! @brief Feeds observations of given duration to estimator
+    void Run(ClockEstimator& estimator, const int64_t duration_ns)
+    {
+        const int64_t packetPeriod_ns = 100000;
+        const int64_t end = mSampleTime + duration_ns;
+        for (; mSampleTime < end; mSampleTime += packetPeriod_ns)
+            estimator.AddObservation(Timestamp(mSampleTime), mSampleTime + mLatency(mRandom));
+    }
+
+    //! @brief Hardware timestamp of sample taken at host time
+    uint64_t Timestamp(const int64_t hostTime_ns) const
+    {
+        return uint64_t(rate * (hostTime_ns - startTime_ns) / 1e9);
+    }
+
+    int64_t Now(void) const {return mSampleTime;}
+
+    const double rate;
+private:
+    std::uniform_int_distribution<int64_t> mLatency;
+    std::mt19937 mRandom;
+    int64_t mSampleTime;
+};
+
+//! @brief Returns estimated timestamp error at host time in nanoseconds
+static double TimestampError_ns(const ClockEstimator& estimator, const ClockSimulator& clock, const int64_t hostTime_ns)
+{
+    uint64_t timestamp = 0;
+    EXPECT_TRUE(estimator.ToTimestamp(hostTime_ns, timestamp));
+    return (double(timestamp) - double(clock.Timestamp(hostTime_ns))) / clock.rate * 1e9;
+}
+
+TEST (ClockEstimator, DriftConverges)
+{
+    //hardware clock 50 ppm faster than nominal rate
+    ClockSimulator clock(nominalRate * (1 + 50e-6), 500000);
+    ClockEstimator estimator;
+    estimator.Reset(nominalRate);
+    clock.Run(estimator, 40000000);
+    EXPECT_FALSE(estimator.IsValid());
+
+    clock.Run(estimator, 6000000000);
+    ASSERT_TRUE(estimator.IsValid());
+    //fitted rate follows hardware clock instead of nominal rate
+    const int64_t now = clock.Now();
+    uint64_t ts1 = 0, ts2 = 0;
+    ASSERT_TRUE(estimator.ToTimestamp(now, ts1));
+    ASSERT_TRUE(estimator.ToTimestamp(now + 1000000000, ts2));
+    const double rate = double(ts2 - ts1);
+    EXPECT_NEAR(clock.rate, rate, nominalRate * 2e-6);
+    EXPECT_NEAR(0, TimestampError_ns(estimator, clock, now), 20000);
+
+    //conversions are inverse of each other
+    int64_t hostTime = 0;
+    ASSERT_TRUE(estimator.ToHostTime(ts1, hostTime));
+    EXPECT_NEAR(double(now), double(hostTime), 1000);
+}
+
+TEST (ClockEstimator, JitterConverges)
+{
+    //latency up to 5 ms, lowest latency observations are kept
+    ClockSimulator clock(nominalRate, 5000000);
+    ClockEstimator estimator;
+    estimator.Reset(nominalRate);
+    clock.Run(estimator, 200000000);
+    ASSERT_TRUE(estimator.IsValid());
+    EXPECT_LT(std::fabs(TimestampError_ns(estimator, clock, clock.Now())), 100000);
+
+    //error stays well below latency jitter once history is filled
+    for (int i = 0; i < 10; ++i)
+    {
+        clock.Run(estimator, 1000000000);
+        EXPECT_LT(std::fabs(TimestampError_ns(estimator, clock, clock.Now())), 20000);
+    }
+}
+
+TEST (ClockEstimator, TimestampRestartResets)
+{
+    ClockSimulator clock(nominalRate, 100000);
+    ClockEstimator estimator;
+    estimator.Reset(nominalRate);
+    clock.Run(estimator, 500000000);
+    ASSERT_TRUE(estimator.IsValid());
+
+    //hardware timestamps restarted from zero
+    estimator.AddObservation(0, clock.Now() + 1000000);
+    EXPECT_FALSE(estimator.IsValid());
+}
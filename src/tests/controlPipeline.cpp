@@ -0,0 +1,63 @@
+#include "gtest/gtest.h"
+#include "pipelineConnection.h"
+#include "LMS7002M.h"
+#include <vector>
+using namespace std;
+using namespace lime;
+
+//! @brief LMS7002M SPI words writing value i to register i
+static std::vector<uint32_t> SpiWrites(const int count)
+{
+    std::vector<uint32_t> words(count);
+    for (int i = 0; i < count; ++i)
+        words[i] = (uint32_t(i) << 16) | i;
+    return words;
+}
+
+TEST (ControlPipeline, WindowLimitsPacketsInFlight)
+{
+    PipelineConnection conn(4, 0);
+    const int packets = 40;
+    const auto words = SpiWrites(packets*14); //LMS7002 write packet carries 14 registers
+    ASSERT_EQ(0, conn.WriteLMS7002MSPI(words.data(), words.size()));
+    EXPECT_EQ(uint32_t(packets), conn.GetControlTransferCount());
+    EXPECT_LE(conn.maxInFlight, 4);
+    EXPECT_GE(conn.maxInFlight, 2);
+    ASSERT_EQ(words.size(), conn.lmsRegs.size());
+    for (size_t i = 0; i < words.size(); ++i)
+        EXPECT_EQ(i, conn.lmsRegs[i]);
+
+    uint32_t addr = 5 << 16;
+    uint32_t value = 0;
+    ASSERT_EQ(0, conn.ReadLMS7002MSPI(&addr, &value, 1));
+    EXPECT_EQ(5u, value & 0xFFFF);
+}
+
+TEST (ControlPipeline, MismatchedReplyFails)
+{
+    PipelineConnection conn(4, 0);
+    conn.corruptReply = 2;
+    const auto words = SpiWrites(10*14);
+    EXPECT_NE(0, conn.WriteLMS7002MSPI(words.data(), words.size()));
+}
+
+TEST (ControlPipeline, UploadAllPipelined)
+{
+    uint32_t packets[2];
+    int writes[2];
+    const int windows[2] = {1, 8};
+    for (int i = 0; i < 2; ++i)
+    {
+        PipelineConnection conn(windows[i], 0);
+        LMS7002M lms;
+        lms.SetConnection(&conn, 0);
+        ASSERT_EQ(0, lms.UploadAll());
+        EXPECT_EQ(windows[i], conn.maxInFlight);
+        packets[i] = conn.GetControlTransferCount();
+        writes[i] = conn.writes;
+    }
+    EXPECT_EQ(packets[0], packets[1]);
+    EXPECT_EQ(int(packets[0]), writes[0]);
+    //window is refilled in chunks once half of it is free
+    EXPECT_LT(writes[1], writes[0]/2);
+}
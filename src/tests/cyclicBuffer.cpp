@@ -0,0 +1,94 @@
+#include "gtest/gtest.h"
+#include "syntheticConnection.h"
+using namespace std;
+using namespace lime;
+
+static const int txSpp = 1020; //12 bit in 16 single channel
+
+class CyclicBufferTest : public SyntheticStreamTest<>
+{
+public:
+    CyclicBufferTest() : txStream(0)
+    {
+    }
+
+    void SetUp()
+    {
+        ASSERT_NO_FATAL_FAILURE(SetupStream(txStream, ChannelConfig(true, StreamConfig::STREAM_12_BIT_IN_16)));
+    }
+
+    //! @brief Sets cyclic waveform of given length, I is sample index, Q is waveform id
+    int SetWaveform(const int length, const int16_t id)
+    {
+        std::vector<complex16_t> samples(length);
+        for (int i = 0; i < length; ++i)
+        {
+            samples[i].i = i;
+            samples[i].q = id;
+        }
+        return ((IStreamChannel*)txStream)->SetCyclicBuffer(samples.data(), length);
+    }
+
+    //! @brief Waits until at least given number of transmitted packets are recorded
+    void Record(std::vector<FPGA_DataPacket> &packets, const size_t count)
+    {
+        for (int i = 0; i < 2000 && packets.size() < count; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            for (const auto &pkt : conn.TakeTxPackets())
+                packets.push_back(pkt);
+        }
+        ASSERT_GE(packets.size(), count);
+    }
+
+    static complex16_t Sample(const FPGA_DataPacket &pkt, const int index)
+    {
+        complex16_t sample;
+        sample.i = int16_t(pkt.data[4*index] | (pkt.data[4*index+1] << 8));
+        sample.q = int16_t(pkt.data[4*index+2] | (pkt.data[4*index+3] << 8));
+        return sample;
+    }
+
+    size_t txStream;
+};
+
+TEST_F (CyclicBufferTest, ReplayedAcrossWrapsAndReplacement)
+{
+    //waveforms are not multiples of packet size, encoded into 25 and 35 packets
+    const int lengthA = 1500;
+    const int lengthB = 700;
+    ASSERT_EQ(0, SetWaveform(lengthA, 1));
+    conn.recordTxPackets = 100000;
+    ASSERT_EQ(0, conn.ControlStream(txStream, true));
+    std::vector<FPGA_DataPacket> packets;
+    ASSERT_NO_FATAL_FAILURE(Record(packets, 2*25 + 5));
+    ASSERT_EQ(0, SetWaveform(lengthB, 2));
+    const size_t replaced = packets.size();
+    ASSERT_NO_FATAL_FAILURE(Record(packets, replaced + 2*35 + 10));
+
+    //replay starts from the beginning of the waveform set last
+    int64_t position = 0;
+    int16_t id = 1;
+    int length = lengthA;
+    for (size_t p = 0; p < packets.size(); ++p)
+    {
+        const FPGA_DataPacket &pkt = packets[p];
+        ASSERT_EQ(p*txSpp, pkt.counter) << "packet " << p;
+        if (id == 1 && Sample(pkt, 0).q == 2)
+        {
+            ASSERT_GE(p, replaced) << "replaced waveform sent before it was set";
+            id = 2;
+            length = lengthB;
+            position = 0;
+        }
+        for (int i = 0; i < txSpp; ++i, ++position)
+        {
+            const complex16_t sample = Sample(pkt, i);
+            ASSERT_EQ(id, sample.q) << "packet " << p << " sample " << i;
+            ASSERT_EQ(position % length, sample.i) << "packet " << p << " sample " << i;
+        }
+    }
+    EXPECT_EQ(2, id);
+    //encoded packets of second waveform wrapped at least twice
+    EXPECT_GE(position, 2*35*txSpp);
+}
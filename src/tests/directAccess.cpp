@@ -0,0 +1,168 @@
+#include "gtest/gtest.h"
+#include "syntheticConnection.h"
+using namespace std;
+using namespace lime;
+
+class DirectAccessTest : public SyntheticStreamTest<>
+{
+public:
+    DirectAccessTest() : streamID(0)
+    {
+    }
+
+    void SetUp()
+    {
+        ASSERT_NO_FATAL_FAILURE(StartStream(streamID, ChannelConfig(false)));
+        ASSERT_NE(0u, conn.GetNumDirectAccessBuffers(streamID));
+    }
+
+    size_t streamID;
+};
+
+TEST_F (DirectAccessTest, ContinuesReadStream)
+{
+    complex16_t buffer[100];
+    StreamMetadata meta;
+    ASSERT_EQ(100, conn.ReadStream(streamID, buffer, 100, 1000, meta));
+    uint64_t expectedTimestamp = meta.timestamp + 100;
+
+    //direct access returns rest of the partially read packet, then whole packets
+    for (int i = 0; i < 100; ++i)
+    {
+        size_t handle;
+        const void* samples = nullptr;
+        const int count = conn.AcquireReadBuffer(streamID, handle, &samples, 1000, meta);
+        ASSERT_GT(count, 0);
+        ASSERT_NE(nullptr, samples);
+        EXPECT_EQ(i == 0 ? SamplesPacket::maxSamplesInPacket-100 : SamplesPacket::maxSamplesInPacket, count);
+        EXPECT_EQ(expectedTimestamp, meta.timestamp);
+        const complex16_t* s = (const complex16_t*)samples;
+        EXPECT_EQ(0, s[0].i);
+        EXPECT_EQ(0, s[count-1].q);
+        expectedTimestamp = meta.timestamp + count;
+        ASSERT_EQ(0, conn.ReleaseReadBuffer(streamID, handle));
+    }
+
+    //copying reads continue after directly accessed buffers
+    ASSERT_EQ(100, conn.ReadStream(streamID, buffer, 100, 1000, meta));
+    EXPECT_EQ(expectedTimestamp, meta.timestamp);
+}
+
+TEST_F (DirectAccessTest, ReleaseInOrder)
+{
+    StreamMetadata meta;
+    size_t handles[2];
+    const void* samples[2];
+    ASSERT_GT(conn.AcquireReadBuffer(streamID, handles[0], &samples[0], 1000, meta), 0);
+    const uint64_t firstTimestamp = meta.timestamp;
+    ASSERT_GT(conn.AcquireReadBuffer(streamID, handles[1], &samples[1], 1000, meta), 0);
+    EXPECT_NE(samples[0], samples[1]);
+    EXPECT_EQ(firstTimestamp + SamplesPacket::maxSamplesInPacket, meta.timestamp);
+
+    //buffers are at addresses reported before acquisition
+    for (int i = 0; i < 2; ++i)
+    {
+        void* addr = nullptr;
+        ASSERT_EQ(0, conn.GetDirectAccessBufferAddr(streamID, handles[i], &addr));
+        EXPECT_EQ(addr, samples[i]);
+    }
+    void* addr = nullptr;
+    EXPECT_NE(0, conn.GetDirectAccessBufferAddr(streamID, conn.GetNumDirectAccessBuffers(streamID), &addr));
+
+    EXPECT_NE(0, conn.ReleaseReadBuffer(streamID, handles[1]));
+    EXPECT_EQ(0, conn.ReleaseReadBuffer(streamID, handles[0]));
+    EXPECT_EQ(0, conn.ReleaseReadBuffer(streamID, handles[1]));
+}
+
+/** @brief Transmit stream with direct buffer access, receive stream provides
+    hardware time used to drop late samples.
+*/
+class DirectAccessTxTest : public SyntheticStreamTest<>
+{
+public:
+    DirectAccessTxTest() : rxStream(0), txStream(0)
+    {
+    }
+
+    void SetUp()
+    {
+        ASSERT_NO_FATAL_FAILURE(StartStream(rxStream, ChannelConfig(false)));
+        ASSERT_NO_FATAL_FAILURE(StartStream(txStream, ChannelConfig(true)));
+        ASSERT_NE(0u, conn.GetNumDirectAccessBuffers(txStream));
+    }
+
+    //! @brief Returns timestamp of received samples, receiving stops once FIFO is full
+    uint64_t ReceivedTimestamp()
+    {
+        complex16_t buffer[spp];
+        StreamMetadata meta;
+        EXPECT_EQ(spp, conn.ReadStream(rxStream, buffer, spp, 1000, meta));
+        return meta.timestamp + spp;
+    }
+
+    //! @brief Transmits one direct access buffer of nonzero samples at timestamp
+    void SendBuffer(const uint64_t timestamp)
+    {
+        size_t handle;
+        void* buffer = nullptr;
+        const int count = conn.AcquireWriteBuffer(txStream, handle, &buffer, 1000);
+        ASSERT_GT(count, 0);
+        complex16_t* samples = (complex16_t*)buffer;
+        for (int i = 0; i < count; ++i)
+            samples[i].i = samples[i].q = 100;
+        StreamMetadata meta;
+        meta.timestamp = timestamp;
+        meta.hasTimestamp = true;
+        meta.endOfBurst = true;
+        ASSERT_EQ(0, conn.ReleaseWriteBuffer(txStream, handle, count, meta));
+    }
+
+    //! @brief Returns true if packet carries samples of SendBuffer()
+    static bool HasSamples(const FPGA_DataPacket& pkt)
+    {
+        for (size_t i = 0; i < sizeof(pkt.data); ++i)
+            if (pkt.data[i] != 0)
+                return true;
+        return false;
+    }
+
+    size_t rxStream;
+    size_t txStream;
+};
+
+TEST_F (DirectAccessTxTest, TimedBufferWaitsForTimestamp)
+{
+    const uint64_t timestamp = ReceivedTimestamp() + 1000000000;
+    conn.recordTxPackets = 10000;
+    ASSERT_NO_FATAL_FAILURE(SendBuffer(timestamp));
+    std::vector<FPGA_DataPacket> sent;
+    for (int i = 0; i < 1000 && sent.empty(); ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        for (const auto &pkt : conn.TakeTxPackets())
+            if (HasSamples(pkt))
+                sent.push_back(pkt);
+    }
+    ASSERT_EQ(1u, sent.size());
+    EXPECT_EQ(timestamp, sent[0].counter);
+    EXPECT_FALSE(SyntheticConnection::IgnoresTimestamp(sent[0]));
+}
+
+TEST_F (DirectAccessTxTest, LateBufferDropped)
+{
+    ASSERT_GT(ReceivedTimestamp(), 1u);
+    conn.recordTxPackets = 10000;
+    ASSERT_NO_FATAL_FAILURE(SendBuffer(1));
+    StreamMetrics metrics;
+    for (int i = 0; i < 1000; ++i)
+    {
+        ASSERT_EQ(0, conn.GetStreamMetrics(txStream, metrics));
+        if (metrics.lateSamples != 0)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_NE(0u, metrics.lateSamples);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    for (const auto &pkt : conn.TakeTxPackets())
+        EXPECT_FALSE(HasSamples(pkt));
+}
@@ -0,0 +1,176 @@
+#ifdef __unix__
+#include "gtest/gtest.h"
+#include "FdStreamRing.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <thread>
+#include <chrono>
+#include <ctime>
+#include <cstring>
+using namespace std;
+using namespace lime;
+
+/** @brief Pipe stands in for Xillybus stream device file,
+    the other end is served by a test thread.
+*/
+class FdStreamRingTest : public ::testing::Test
+{
+public:
+    void SetUp()
+    {
+        ASSERT_EQ(0, pipe(fds));
+    }
+
+    void TearDown()
+    {
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    //! @brief Writes bytes counting up from 0 in chunks, pausing between them
+    static void Produce(const int fd, const size_t total, const size_t chunk, const int pause_us)
+    {
+        std::vector<unsigned char> data(chunk);
+        size_t written = 0;
+        while (written < total)
+        {
+            for (size_t i = 0; i < chunk; ++i)
+                data[i] = (written + i) & 0xFF;
+            size_t done = 0;
+            while (done < chunk)
+            {
+                const ssize_t ret = write(fd, data.data() + done, chunk - done);
+                if (ret > 0)
+                    done += ret;
+            }
+            written += chunk;
+            if (pause_us)
+                std::this_thread::sleep_for(std::chrono::microseconds(pause_us));
+        }
+    }
+
+    int fds[2];
+};
+
+TEST_F (FdStreamRingTest, ReceiveWaitsWithoutSpinning)
+{
+    const uint32_t bufferSize = 16*4096;
+    const size_t total = 64*bufferSize;
+    std::vector<char> buffers(4*bufferSize);
+    FdStreamRing ring(false, 4);
+    ASSERT_EQ(0, ring.Start(fds[0]));
+    for (int i = 0; i < 4; ++i)
+        ASSERT_EQ(0, ring.Submit(&buffers[i*bufferSize], bufferSize));
+
+    //about 32 MB/s in 4 KB writes
+    const auto start = std::chrono::steady_clock::now();
+    const std::clock_t cpuStart = std::clock();
+    std::thread producer(Produce, fds[1], total, 4096, 125);
+    size_t received = 0;
+    bool ordered = true;
+    while (received < total)
+    {
+        char* buffer;
+        const int count = ring.Reap(&buffer, 1000);
+        ASSERT_EQ(int(bufferSize), count);
+        for (int i = 0; i < count; ++i)
+            ordered &= (unsigned char)buffer[i] == ((received + i) & 0xFF);
+        received += count;
+        ASSERT_EQ(0, ring.Submit(buffer, bufferSize));
+    }
+    producer.join();
+    const double cpuSeconds = double(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const FdStreamRing::Stats stats = ring.GetStats();
+    ring.Stop();
+
+    EXPECT_TRUE(ordered);
+    EXPECT_EQ(total, stats.bytesTransferred);
+    EXPECT_EQ(total/bufferSize, stats.buffersTransferred);
+    //I/O thread sleeps while pipe is empty
+    EXPECT_LT(stats.ioCpuTime_us, seconds*0.5e6);
+    EXPECT_LT(cpuSeconds, seconds*0.9);
+    printf("Paced Rx %.1f MB/s: process CPU %.1f%%, I/O thread CPU %.1f%%, %llu polls\n",
+        total/seconds/1e6, 100*cpuSeconds/seconds, 100*stats.ioCpuTime_us/1e6/seconds,
+        (unsigned long long)stats.polls);
+}
+
+TEST_F (FdStreamRingTest, TransmitThroughput)
+{
+    const uint32_t bufferSize = 16*4096;
+    const size_t total = 1024*bufferSize;
+    std::vector<char> buffers(4*bufferSize);
+    std::vector<char*> freeBuffers;
+    for (int i = 0; i < 4; ++i)
+        freeBuffers.push_back(&buffers[i*bufferSize]);
+    FdStreamRing ring(true, 4);
+    ASSERT_EQ(0, ring.Start(fds[1]));
+
+    size_t consumed = 0;
+    bool ordered = true;
+    std::thread consumer([&]()
+    {
+        std::vector<unsigned char> data(bufferSize);
+        while (consumed < total)
+        {
+            const ssize_t ret = read(fds[0], data.data(), data.size());
+            if (ret <= 0)
+                continue;
+            for (ssize_t i = 0; i < ret; ++i)
+                ordered &= data[i] == ((consumed + i) & 0xFF);
+            consumed += ret;
+        }
+    });
+
+    const auto start = std::chrono::steady_clock::now();
+    size_t produced = 0;
+    while (produced < total)
+    {
+        char* buffer;
+        if (freeBuffers.empty())
+        {
+            ASSERT_EQ(int(bufferSize), ring.Reap(&buffer, 1000));
+            freeBuffers.push_back(buffer);
+        }
+        buffer = freeBuffers.back();
+        freeBuffers.pop_back();
+        for (uint32_t i = 0; i < bufferSize; ++i)
+            buffer[i] = (produced + i) & 0xFF;
+        ASSERT_EQ(0, ring.Submit(buffer, bufferSize));
+        produced += bufferSize;
+    }
+    consumer.join();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const FdStreamRing::Stats stats = ring.GetStats();
+    ring.Stop();
+
+    EXPECT_TRUE(ordered);
+    EXPECT_EQ(total, stats.bytesTransferred);
+    printf("Tx through pipe %.1f MB/s, I/O thread CPU %.1f%%, %llu polls\n",
+        total/seconds/1e6, 100*stats.ioCpuTime_us/1e6/seconds, (unsigned long long)stats.polls);
+}
+
+TEST_F (FdStreamRingTest, StopWakesIoThread)
+{
+    char data[4096];
+    FdStreamRing ring(false, 2);
+    ASSERT_EQ(0, ring.Start(fds[0]));
+    ASSERT_EQ(0, ring.Submit(data, sizeof(data)));
+    char* buffer = nullptr;
+    EXPECT_EQ(StreamTransport::REAP_TIMEOUT, ring.Reap(&buffer, 10));
+    const auto start = std::chrono::steady_clock::now();
+    ring.Stop();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+    //cancelled buffer is handed back without data
+    EXPECT_EQ(0, ring.Reap(&buffer, 10));
+    EXPECT_EQ(data, buffer);
+    EXPECT_EQ(-1, ring.Submit(data, sizeof(data)));
+
+    //end of file stops the ring with error
+    ASSERT_EQ(0, ring.Start(fds[0]));
+    ASSERT_EQ(0, ring.Submit(data, sizeof(data)));
+    close(fds[1]);
+    fds[1] = open("/dev/null", O_WRONLY);
+    EXPECT_EQ(StreamTransport::REAP_FAILED, ring.Reap(&buffer, 1000));
+}
+#endif // __unix__
@@ -0,0 +1,129 @@
+#include "gtest/gtest.h"
+#include "syntheticConnection.h"
+using namespace std;
+using namespace lime;
+
+static const int bufferSize = spp;
+static const int16_t fillValue = 100;
+
+class GapFillTest : public SyntheticStreamTest<>
+{
+public:
+    GapFillTest() : streamID(0)
+    {
+    }
+
+    void Start(const uint32_t gapFillLimit)
+    {
+        StreamConfig config = ChannelConfig(false);
+        config.gapFillLimit = gapFillLimit;
+        config.gapFillValue = fillValue;
+        StartStream(streamID, config);
+    }
+
+    //! @brief Reads samples until read marked as discontinuous
+    int ReadUntilDiscontinuity(StreamMetadata& meta, uint64_t& expectedTimestamp)
+    {
+        for (int i = 0; i < 1000; ++i)
+        {
+            const int count = conn.ReadStream(streamID, buffer, bufferSize, 1000, meta);
+            if (count <= 0)
+                return count;
+            if (meta.discontinuity)
+                return count;
+            EXPECT_EQ(expectedTimestamp, meta.timestamp);
+            expectedTimestamp = meta.timestamp + count;
+        }
+        return -1;
+    }
+
+    static int CountFilled(const complex16_t* samples, const int count)
+    {
+        int filled = 0;
+        for (int i = 0; i < count; ++i)
+            if (samples[i].i == fillValue && samples[i].q == fillValue)
+                ++filled;
+        return filled;
+    }
+
+    size_t streamID;
+    complex16_t buffer[bufferSize];
+};
+
+TEST_F (GapFillTest, FillsLostPackets)
+{
+    Start(4*spp);
+    StreamMetadata meta;
+    uint64_t expectedTimestamp = 0;
+    ASSERT_EQ(bufferSize, conn.ReadStream(streamID, buffer, bufferSize, 1000, meta));
+    EXPECT_FALSE(meta.discontinuity);
+    expectedTimestamp = meta.timestamp + bufferSize;
+
+    conn.dropPackets = 2;
+    int count = ReadUntilDiscontinuity(meta, expectedTimestamp);
+    ASSERT_GT(count, 0);
+    //inserted samples keep timestamps continuous
+    EXPECT_EQ(expectedTimestamp, meta.timestamp);
+    int filled = CountFilled(buffer, count);
+    for (int i = 0; i < 4; ++i)
+    {
+        count = conn.ReadStream(streamID, buffer, bufferSize, 1000, meta);
+        ASSERT_GT(count, 0);
+        EXPECT_FALSE(meta.discontinuity);
+        filled += CountFilled(buffer, count);
+    }
+    EXPECT_EQ(2*spp, filled);
+}
+
+TEST_F (GapFillTest, LimitedFill)
+{
+    Start(1000);
+    StreamMetadata meta;
+    uint64_t expectedTimestamp = 0;
+    ASSERT_EQ(bufferSize, conn.ReadStream(streamID, buffer, bufferSize, 1000, meta));
+    expectedTimestamp = meta.timestamp + bufferSize;
+
+    conn.dropPackets = 2;
+    int count = ReadUntilDiscontinuity(meta, expectedTimestamp);
+    ASSERT_EQ(1000, count);
+    EXPECT_EQ(expectedTimestamp, meta.timestamp);
+    EXPECT_EQ(1000, CountFilled(buffer, count));
+    expectedTimestamp = meta.timestamp + count;
+
+    //samples after the inserted ones are again marked as discontinuous
+    count = conn.ReadStream(streamID, buffer, bufferSize, 1000, meta);
+    ASSERT_GT(count, 0);
+    EXPECT_TRUE(meta.discontinuity);
+    EXPECT_EQ(expectedTimestamp + 2*spp - 1000, meta.timestamp);
+    EXPECT_EQ(0, CountFilled(buffer, count));
+}
+
+TEST_F (GapFillTest, FlagsWithoutFill)
+{
+    Start(0);
+    StreamMetadata meta;
+    uint64_t expectedTimestamp = 0;
+    ASSERT_EQ(bufferSize, conn.ReadStream(streamID, buffer, bufferSize, 1000, meta));
+    expectedTimestamp = meta.timestamp + bufferSize;
+
+    conn.dropPackets = 2;
+    const int count = ReadUntilDiscontinuity(meta, expectedTimestamp);
+    ASSERT_GT(count, 0);
+    EXPECT_EQ(expectedTimestamp + 2*spp, meta.timestamp);
+    EXPECT_EQ(0, CountFilled(buffer, count));
+}
+
+TEST_F (GapFillTest, NoSplitWithoutFill)
+{
+    Start(0);
+    StreamMetadata meta;
+    //reads not aligned to packets, gap falls inside of read
+    ASSERT_EQ(spp/2, conn.ReadStream(streamID, buffer, spp/2, 1000, meta));
+    uint64_t expectedTimestamp = meta.timestamp + spp/2;
+
+    conn.dropPackets = 2;
+    const int count = ReadUntilDiscontinuity(meta, expectedTimestamp);
+    //read is not shortened at the gap
+    EXPECT_EQ(bufferSize, count);
+    EXPECT_EQ(expectedTimestamp, meta.timestamp);
+}
@@ -0,0 +1,159 @@
+#include "gtest/gtest.h"
+#include "syntheticConnection.h"
+#include <thread>
+#include <chrono>
+using namespace std;
+using namespace lime;
+
+static const int fifoPackets = 64; //smallest FIFO
+static const int burst = 2*fifoPackets;
+
+/** @brief Generator pushes twice the FIFO size without waiting for consumer,
+    then tests read the FIFO content.
+*/
+class OverflowPolicyTest : public SyntheticStreamTest<>
+{
+public:
+    OverflowPolicyTest() : streamID(0)
+    {
+    }
+
+    void Start(const StreamConfig::OverflowPolicy policy)
+    {
+        StreamConfig config = ChannelConfig(false);
+        config.bufferLength = fifoPackets*spp;
+        config.overflowPolicy = policy;
+        config.overflowTimeout_ms = 1000;
+        ASSERT_NO_FATAL_FAILURE(SetupStream(streamID, config));
+        conn.burstPackets = burst;
+        ASSERT_EQ(0, conn.ControlStream(streamID, true));
+    }
+
+    void WaitForBurst()
+    {
+        for (int i = 0; i < 1000 && conn.burstPackets.load() > 0; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        ASSERT_EQ(0, conn.burstPackets.load());
+        //last packet is being processed
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    //! @brief Reads one packet worth of samples
+    int ReadPacket(StreamMetadata& meta)
+    {
+        return conn.ReadStream(streamID, buffer, spp, 1000, meta);
+    }
+
+    size_t streamID;
+    complex16_t buffer[spp];
+};
+
+TEST_F (OverflowPolicyTest, DropOldest)
+{
+    Start(StreamConfig::OVERFLOW_DROP_OLDEST);
+    WaitForBurst();
+    StreamMetrics metrics;
+    ASSERT_EQ(0, conn.GetStreamMetrics(streamID, metrics));
+    EXPECT_EQ(uint64_t(burst - fifoPackets)*spp, metrics.overflowOldestSamples);
+    EXPECT_EQ(0u, metrics.overflowNewestSamples);
+    EXPECT_EQ(metrics.overflowOldestSamples, metrics.overflowSamples);
+
+    StreamMetadata meta;
+    ASSERT_EQ(spp, ReadPacket(meta));
+    EXPECT_EQ(uint64_t(burst - fifoPackets)*spp, meta.timestamp);
+}
+
+TEST_F (OverflowPolicyTest, DropNewest)
+{
+    Start(StreamConfig::OVERFLOW_DROP_NEWEST);
+    WaitForBurst();
+    StreamMetrics metrics;
+    ASSERT_EQ(0, conn.GetStreamMetrics(streamID, metrics));
+    EXPECT_EQ(0u, metrics.overflowOldestSamples);
+    EXPECT_EQ(uint64_t(burst - fifoPackets)*spp, metrics.overflowNewestSamples);
+
+    StreamMetadata meta;
+    for (int i = 0; i < fifoPackets; ++i)
+    {
+        ASSERT_EQ(spp, ReadPacket(meta));
+        ASSERT_EQ(uint64_t(i)*spp, meta.timestamp);
+    }
+    ASSERT_EQ(spp, ReadPacket(meta));
+    EXPECT_TRUE(meta.discontinuity);
+    EXPECT_GE(meta.timestamp, uint64_t(burst)*spp);
+}
+
+TEST_F (OverflowPolicyTest, Block)
+{
+    Start(StreamConfig::OVERFLOW_BLOCK);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    //receive loop waits for consumer, nothing is lost
+    StreamMetadata meta;
+    for (int i = 0; i < burst; ++i)
+    {
+        ASSERT_EQ(spp, ReadPacket(meta));
+        ASSERT_EQ(uint64_t(i)*spp, meta.timestamp);
+        ASSERT_FALSE(meta.discontinuity);
+    }
+
+    StreamMetrics metrics;
+    ASSERT_EQ(0, conn.GetStreamMetrics(streamID, metrics));
+    EXPECT_EQ(0u, metrics.overflowSamples);
+    EXPECT_GE(metrics.overflowBlocks, 1u);
+    EXPECT_GE(metrics.overflowBlockTime_us, 10000u);
+}
+
+TEST_F (OverflowPolicyTest, Decimate)
+{
+    Start(StreamConfig::OVERFLOW_DECIMATE);
+    WaitForBurst();
+    //every other packet is skipped after FIFO is 3/4 full,
+    //packets not skipped by decimation are dropped when FIFO is full
+    const int behind = fifoPackets*3/4;
+    StreamMetrics metrics;
+    ASSERT_EQ(0, conn.GetStreamMetrics(streamID, metrics));
+    const uint64_t decimated = (burst - behind)/2;
+    EXPECT_EQ(decimated*spp, metrics.overflowDecimatedSamples);
+    EXPECT_EQ((burst - fifoPackets - decimated)*spp, metrics.overflowNewestSamples);
+    EXPECT_EQ(uint64_t(burst - fifoPackets)*spp, metrics.overflowSamples);
+
+    StreamMetadata meta;
+    for (int i = 0; i < behind; ++i)
+    {
+        ASSERT_EQ(spp, ReadPacket(meta));
+        ASSERT_EQ(uint64_t(i)*spp, meta.timestamp);
+    }
+    for (int i = behind+1; i < 2*fifoPackets-behind; i += 2)
+    {
+        ASSERT_EQ(spp, ReadPacket(meta));
+        EXPECT_EQ(uint64_t(i)*spp, meta.timestamp);
+        EXPECT_TRUE(meta.discontinuity);
+    }
+}
+
+TEST (OverflowPolicy, TimestampedTxDoesNotOverwrite)
+{
+    SyntheticConnection conn;
+    size_t streamID = 0;
+    StreamConfig config;
+    config.isTx = true;
+    config.channelID = 0;
+    config.format = StreamConfig::STREAM_12_BIT_IN_16;
+    config.bufferLength = fifoPackets*spp;
+    ASSERT_EQ(0, conn.SetupStream(streamID, config));
+
+    //stream is not started, writes fill FIFO until it blocks
+    std::vector<complex16_t> samples(spp);
+    StreamMetadata meta;
+    meta.hasTimestamp = true;
+    meta.timestamp = 0;
+    int written = spp;
+    for (int i = 0; i < 4*burst && written == spp; ++i)
+    {
+        written = conn.WriteStream(streamID, samples.data(), spp, 10, meta);
+        meta.timestamp += spp;
+    }
+    EXPECT_LT(written, spp);
+    EXPECT_EQ(0, conn.WriteStream(streamID, samples.data(), spp, 10, meta));
+    conn.CloseStream(streamID);
+}
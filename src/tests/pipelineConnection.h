@@ -0,0 +1,116 @@
+#ifndef PIPELINE_CONNECTION_H
+#define PIPELINE_CONNECTION_H
+
+#include "LMS64CProtocol.h"
+#include "LMS64CCommands.h"
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <deque>
+#include <map>
+#include <cstring>
+
+static const int pipelinePktLength = 64;
+
+/** @brief LMS64C device without hardware. Replies to written packets become
+    available after fixed latency and are read back in order, LMS7002M and
+    board SPI writes are applied to register maps.
+*/
+class PipelineConnection : public lime::LMS64CProtocol
+{
+public:
+    PipelineConnection(const int window, const int latency_us) :
+        window(window), latency(latency_us), maxInFlight(0), writes(0), corruptReply(-1) {}
+
+    bool IsOpen() {return true;}
+    eConnectionType GetType(void) {return USB_PORT;}
+
+    int Write(const unsigned char* buffer, int length, int) override
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        ++writes;
+        const auto ready = std::chrono::steady_clock::now() + std::chrono::microseconds(latency);
+        for (int i = 0; i + pipelinePktLength <= length; i += pipelinePktLength)
+        {
+            Reply reply;
+            reply.ready = ready;
+            Process(&buffer[i], reply.data);
+            mReplies.push_back(reply);
+        }
+        maxInFlight = std::max<int>(maxInFlight, mReplies.size());
+        return length;
+    }
+
+    int Read(unsigned char* buffer, int length, int) override
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        if (length != pipelinePktLength || mReplies.empty())
+            return 0;
+        Reply reply = mReplies.front();
+        mReplies.pop_front();
+        if (corruptReply-- == 0)
+            reply.data[0] ^= 0xFF;
+        lock.unlock();
+        std::this_thread::sleep_until(reply.ready);
+        memcpy(buffer, reply.data, pipelinePktLength);
+        return pipelinePktLength;
+    }
+
+    std::map<uint16_t, uint16_t> lmsRegs;
+    std::map<uint16_t, uint16_t> fpgaRegs;
+    int window;
+    int latency;
+    int maxInFlight;
+    int writes;
+    int corruptReply; //index of reply returned with wrong command
+
+protected:
+    int ControlPacketsInFlight(void) const override {return window;}
+
+private:
+    struct Reply
+    {
+        std::chrono::steady_clock::time_point ready;
+        unsigned char data[pipelinePktLength];
+    };
+
+    void Process(const unsigned char* in, unsigned char* out)
+    {
+        memcpy(out, in, pipelinePktLength);
+        out[1] = lime::STATUS_COMPLETED_CMD;
+        const unsigned char* data = &in[8];
+        const int blocks = in[2];
+        switch (in[0])
+        {
+        case lime::CMD_LMS7002_WR:
+        case lime::CMD_BRDSPI_WR:
+        {
+            auto &regs = in[0] == lime::CMD_LMS7002_WR ? lmsRegs : fpgaRegs;
+            for (int k = 0; k < blocks; ++k)
+                regs[(data[4*k] << 8) | data[4*k+1]] = (data[4*k+2] << 8) | data[4*k+3];
+            break;
+        }
+        case lime::CMD_LMS7002_RD:
+        case lime::CMD_BRDSPI_RD:
+        {
+            auto &regs = in[0] == lime::CMD_LMS7002_RD ? lmsRegs : fpgaRegs;
+            for (int k = 0; k < blocks; ++k)
+            {
+                const uint16_t addr = (data[2*k] << 8) | data[2*k+1];
+                out[8+4*k] = addr >> 8;
+                out[8+4*k+1] = addr & 0xFF;
+                out[8+4*k+2] = regs[addr] >> 8;
+                out[8+4*k+3] = regs[addr] & 0xFF;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    std::mutex mLock;
+    std::deque<Reply> mReplies;
+};
+
+#endif
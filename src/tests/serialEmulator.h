@@ -0,0 +1,109 @@
+#ifndef SERIAL_EMULATOR_H
+#define SERIAL_EMULATOR_H
+
+#ifdef __unix__
+#include "ConnectionRegistry.h"
+#include "IConnection.h"
+#include "LMS64CCommands.h"
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <termios.h>
+
+static const size_t serialPktLength = 64;
+
+/** @brief Board stand-in on the master side of a pseudo terminal. Every
+    LMS64C packet is answered with completed status after a delay per
+    received chunk, like replies of USB CDC device arrive once per frame.
+*/
+class SerialEmulator
+{
+public:
+    SerialEmulator(const int replyDelay_us) : reply(true), packets(0), chunks(0), mDelay(replyDelay_us), mStop(false)
+    {
+        mFd = posix_openpt(O_RDWR | O_NOCTTY);
+        if (mFd < 0)
+            return;
+        grantpt(mFd);
+        unlockpt(mFd);
+        termios tty;
+        tcgetattr(mFd, &tty);
+        cfmakeraw(&tty);
+        tcsetattr(mFd, TCSANOW, &tty);
+        mThread = std::thread(&SerialEmulator::Run, this);
+    }
+
+    ~SerialEmulator()
+    {
+        mStop = true;
+        if (mThread.joinable())
+            mThread.join();
+        if (mFd >= 0)
+            close(mFd);
+    }
+
+    lime::IConnection* Connect()
+    {
+        if (mFd < 0)
+            return nullptr;
+        lime::ConnectionHandle handle;
+        handle.module = "EVB7COM";
+        handle.addr = ptsname(mFd);
+        return lime::ConnectionRegistry::makeConnection(handle);
+    }
+
+    std::atomic<bool> reply; //answer received packets
+    std::atomic<int> packets; //packets answered
+    std::atomic<int> chunks; //reads that returned data
+
+private:
+    void Run()
+    {
+        std::vector<unsigned char> pending;
+        unsigned char buf[4096];
+        while (!mStop)
+        {
+            pollfd fds = {mFd, POLLIN, 0};
+            if (poll(&fds, 1, 10) <= 0)
+                continue;
+            const int bread = read(mFd, buf, sizeof(buf));
+            if (bread <= 0)
+                continue;
+            ++chunks;
+            pending.insert(pending.end(), buf, buf+bread);
+            if (!reply)
+            {
+                pending.clear();
+                continue;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(mDelay));
+            std::vector<unsigned char> out;
+            while (pending.size() >= serialPktLength)
+            {
+                out.insert(out.end(), pending.begin(), pending.begin()+serialPktLength);
+                out[out.size()-serialPktLength+1] = lime::STATUS_COMPLETED_CMD;
+                pending.erase(pending.begin(), pending.begin()+serialPktLength);
+                ++packets;
+            }
+            for (size_t i = 0; i < out.size();)
+            {
+                const int ret = write(mFd, out.data()+i, out.size()-i);
+                if (ret > 0)
+                    i += ret;
+            }
+        }
+    }
+
+    const int mDelay;
+    std::atomic<bool> mStop;
+    int mFd;
+    std::thread mThread;
+};
+#endif
+
+#endif
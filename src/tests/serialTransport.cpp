@@ -0,0 +1,53 @@
+#include "gtest/gtest.h"
+#include "serialEmulator.h"
+#ifdef __unix__
+using namespace std;
+using namespace lime;
+
+TEST (SerialTransport, BatchedRegisterWrites)
+{
+    SerialEmulator board(1000);
+    IConnection* conn = board.Connect();
+    if (conn == nullptr)
+    {
+        printf("EVB7COM connection not available, skipping\n");
+        return;
+    }
+    ASSERT_TRUE(conn->IsOpen());
+
+    //BRDSPI packet carries 14 registers
+    const int packets = 200;
+    std::vector<uint32_t> addrs(packets*14);
+    std::vector<uint32_t> values(addrs.size());
+    for (size_t i = 0; i < addrs.size(); ++i)
+    {
+        addrs[i] = i & 0xFF;
+        values[i] = i;
+    }
+    EXPECT_EQ(0, conn->WriteRegisters(addrs.data(), values.data(), addrs.size()));
+    EXPECT_EQ(packets, board.packets.load());
+    EXPECT_LT(board.chunks.load(), packets);
+    ConnectionRegistry::freeConnection(conn);
+}
+
+TEST (SerialTransport, MissingReplyTimesOut)
+{
+    SerialEmulator board(0);
+    IConnection* conn = board.Connect();
+    if (conn == nullptr)
+    {
+        printf("EVB7COM connection not available, skipping\n");
+        return;
+    }
+    board.reply = false;
+    uint32_t addr = 0x0009, value = 0;
+    EXPECT_NE(0, conn->WriteRegisters(&addr, &value, 1));
+    EXPECT_EQ(0, board.packets.load());
+
+    //port stays usable after the timeout
+    board.reply = true;
+    EXPECT_EQ(0, conn->WriteRegisters(&addr, &value, 1));
+    EXPECT_EQ(1, board.packets.load());
+    ConnectionRegistry::freeConnection(conn);
+}
+#endif
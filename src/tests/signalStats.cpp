@@ -0,0 +1,70 @@
+#include "gtest/gtest.h"
+#include "syntheticConnection.h"
+using namespace std;
+using namespace lime;
+
+TEST (SignalStats, LoopbackRead)
+{
+    SyntheticConnection conn(true);
+    StreamConfig config;
+    config.channelID = 0;
+    config.isTx = false;
+    config.signalStats = true;
+    size_t rxStream = 0;
+    size_t txStream = 0;
+    ASSERT_EQ(0, conn.SetupStream(rxStream, config));
+    config.isTx = true;
+    ASSERT_EQ(0, conn.SetupStream(txStream, config));
+    conn.ControlStream(rxStream, true);
+    conn.ControlStream(txStream, true);
+
+    //two packets of constant samples, with clipped I in first and clipped Q in last sample
+    const size_t count = 1020*2; //samples per packet of 12 bit in 16 link format
+    std::vector<complex16_t> tx(count);
+    for (auto &s : tx)
+    {
+        s.i = 1000;
+        s.q = -500;
+    }
+    tx.front().i = 2047;
+    tx.back().q = -2048;
+    const uint64_t timestamp = 1000000;
+    StreamMetadata txMeta;
+    txMeta.timestamp = timestamp;
+    txMeta.hasTimestamp = true;
+    txMeta.endOfBurst = true;
+    ASSERT_EQ(int(count), conn.WriteStream(txStream, tx.data(), count, 1000, txMeta));
+
+    std::vector<complex16_t> rx(count);
+    StreamMetadata rxMeta;
+    rxMeta.timestamp = timestamp;
+    rxMeta.hasTimestamp = true;
+    ASSERT_EQ(int(count), conn.ReadStream(rxStream, rx.data(), count, 1000, rxMeta));
+    ASSERT_EQ(timestamp, rxMeta.timestamp);
+
+    const SignalStats &stats = rxMeta.signalStats;
+    int64_t sumI = 0;
+    int64_t sumQ = 0;
+    uint64_t sumPower = 0;
+    for (const auto &s : tx)
+    {
+        sumI += s.i;
+        sumQ += s.q;
+        sumPower += s.i*s.i + s.q*s.q;
+    }
+    EXPECT_EQ(count, stats.samplesCount);
+    EXPECT_EQ(2u, stats.clipCount);
+    EXPECT_EQ(2048u, stats.peak);
+    EXPECT_EQ(sumI, stats.sumI);
+    EXPECT_EQ(sumQ, stats.sumQ);
+    EXPECT_EQ(sumPower, stats.sumPower);
+
+    SignalStats last;
+    ASSERT_EQ(0, conn.GetSignalStats(rxStream, last));
+    EXPECT_EQ(stats.sumPower, last.sumPower);
+
+    conn.ControlStream(txStream, false);
+    conn.ControlStream(rxStream, false);
+    conn.CloseStream(txStream);
+    conn.CloseStream(rxStream);
+}
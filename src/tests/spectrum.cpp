@@ -0,0 +1,108 @@
+#include "gtest/gtest.h"
+#include "syntheticConnection.h"
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+using namespace std;
+using namespace lime;
+
+/** @brief Transmits cyclic tone through synthetic loopback connection,
+    the test reads only spectra, never the received samples.
+*/
+class SpectrumTest : public SyntheticStreamTest<>
+{
+public:
+    SpectrumTest() : SyntheticStreamTest(true), rxStream(0), txStream(0)
+    {
+    }
+
+    void SetUp()
+    {
+        ASSERT_NO_FATAL_FAILURE(SetupStream(rxStream, ChannelConfig(false, StreamConfig::STREAM_12_BIT_IN_16)));
+        ASSERT_NO_FATAL_FAILURE(SetupStream(txStream, ChannelConfig(true, StreamConfig::STREAM_12_BIT_IN_16)));
+
+        //tone at bin 64 of 1024 point FFT, half of full scale
+        std::vector<complex16_t> tone(1024);
+        for (size_t i = 0; i < tone.size(); ++i)
+        {
+            const double phase = 2 * M_PI * 64 * i / 1024;
+            tone[i].i = std::lround(1024 * cos(phase));
+            tone[i].q = std::lround(1024 * sin(phase));
+        }
+        ASSERT_EQ(0, ((IStreamChannel*)txStream)->SetCyclicBuffer(tone.data(), tone.size()));
+        ASSERT_EQ(0, conn.ControlStream(rxStream, true));
+        ASSERT_EQ(0, conn.ControlStream(txStream, true));
+    }
+
+    void TearDown()
+    {
+        conn.StopSpectrumMonitor(rxStream);
+        SyntheticStreamTest::TearDown();
+    }
+
+    size_t rxStream;
+    size_t txStream;
+};
+
+TEST_F (SpectrumTest, Tone)
+{
+    SpectrumConfig config;
+    config.fftSize = 1024;
+    config.overlap = 0.5;
+    config.averageCount = 4;
+    config.frameRate = 0;
+    ASSERT_EQ(0, conn.StartSpectrumMonitor(rxStream, config));
+
+    std::vector<float> bins(2048);
+    StreamMetadata meta;
+    ASSERT_EQ(1024, conn.ReadSpectrum(rxStream, bins.data(), bins.size(), 1000, meta));
+    const int peak = std::max_element(bins.begin(), bins.begin()+1024) - bins.begin();
+    EXPECT_EQ(512 + 64, peak);
+    EXPECT_NEAR(-6.02, bins[peak], 0.1);
+    EXPECT_LT(bins[512], -60);
+    EXPECT_LT(bins[512 - 64], -60);
+
+    //window does not change power of tone centered in bin
+    config.window = SpectrumConfig::WINDOW_RECTANGULAR;
+    config.averaging = SpectrumConfig::AVERAGE_MAX_HOLD;
+    ASSERT_EQ(0, conn.StartSpectrumMonitor(rxStream, config));
+    ASSERT_EQ(1024, conn.ReadSpectrum(rxStream, bins.data(), bins.size(), 1000, meta));
+    EXPECT_NEAR(-6.02, bins[512 + 64], 0.1);
+}
+
+TEST_F (SpectrumTest, FrameRate)
+{
+    SpectrumConfig config;
+    config.fftSize = 256;
+    config.averageCount = 2;
+    config.averaging = SpectrumConfig::AVERAGE_EXPONENTIAL;
+    config.frameRate = 50;
+    ASSERT_EQ(0, conn.StartSpectrumMonitor(rxStream, config));
+
+    std::vector<float> bins(256);
+    StreamMetadata meta;
+    ASSERT_EQ(256, conn.ReadSpectrum(rxStream, bins.data(), bins.size(), 1000, meta));
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t lastTimestamp = meta.timestamp;
+    for (int i = 0; i < 5; ++i)
+    {
+        ASSERT_EQ(256, conn.ReadSpectrum(rxStream, bins.data(), bins.size(), 1000, meta));
+        EXPECT_GT(meta.timestamp, lastTimestamp);
+        lastTimestamp = meta.timestamp;
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_GE(elapsed, std::chrono::milliseconds(80));
+}
+
+TEST_F (SpectrumTest, InvalidConfig)
+{
+    SpectrumConfig config;
+    config.fftSize = 8;
+    EXPECT_NE(0, conn.StartSpectrumMonitor(rxStream, config));
+    config.fftSize = 1024;
+    config.overlap = 1;
+    EXPECT_NE(0, conn.StartSpectrumMonitor(rxStream, config));
+    std::vector<float> bins(16);
+    StreamMetadata meta;
+    EXPECT_LT(conn.ReadSpectrum(rxStream, bins.data(), bins.size(), 10, meta), 0);
+}
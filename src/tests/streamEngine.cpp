@@ -0,0 +1,299 @@
+#include "gtest/gtest.h"
+#include "syntheticConnection.h"
+#include "StreamTransport.h"
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+using namespace std;
+using namespace lime;
+
+/** @brief Data moved by in-memory transports of one connection.
+*/
+struct MemoryLink
+{
+    MemoryLink() : rxPackets(0), rxTimestamp(0), rxLate(false), rxReaped(0), txTransfers(0), failSubmit(false) {}
+    std::mutex lock;
+    int rxPackets; //packets left to receive
+    uint64_t rxTimestamp; //of next received packet
+    bool rxLate; //received packets report late Tx packets
+    int rxReaped; //transfers returned to receive loop
+    std::vector<uint64_t> txTimestamps; //of sent packets carrying samples
+    int txTransfers;
+    bool failSubmit; //transfers can not be started
+};
+
+/** @brief Transport without hardware. Receive buffers are filled with
+    packets of continuous timestamps when submitted, like hardware fills
+    them in order, but transfers finish out of order: of two finished
+    transfers at the head of the queue the later one is reaped first.
+*/
+class MemoryTransport : public StreamTransport
+{
+public:
+    MemoryTransport(MemoryLink* link, const bool isTx) : mLink(link), mIsTx(isTx), mCancelled(false) {}
+
+    int Submit(char* buffer, const uint32_t length) override
+    {
+        Transfer transfer = {buffer, 0, false};
+        {
+            std::lock_guard<std::mutex> lock(mLink->lock);
+            if (mCancelled || mLink->failSubmit)
+                return -1;
+            FPGA_DataPacket* pkt = (FPGA_DataPacket*)buffer;
+            const uint32_t count = length/sizeof(FPGA_DataPacket);
+            if (mIsTx)
+            {
+                for (uint32_t i = 0; i < count; ++i)
+                    if ((pkt[i].reserved[0] & (1 << 4)) == 0)
+                        mLink->txTimestamps.push_back(pkt[i].counter);
+                ++mLink->txTransfers;
+                transfer.bytes = length;
+                transfer.done = true;
+            }
+            else if (mLink->rxPackets >= int(count))
+            {
+                memset(buffer, 0, length);
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    pkt[i].counter = mLink->rxTimestamp;
+                    pkt[i].reserved[0] = mLink->rxLate ? (1 << 3) : 0;
+                    mLink->rxTimestamp += spp;
+                }
+                mLink->rxPackets -= count;
+                transfer.bytes = length;
+                transfer.done = true;
+            }
+        }
+        if (mIsTx) //emulate link rate
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        std::lock_guard<std::mutex> lock(mLock);
+        mTransfers.push_back(transfer);
+        mChanged.notify_all();
+        return 0;
+    }
+
+    int Reap(char** buffer, const unsigned timeout_ms) override
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        auto ready = [this]{
+            for (auto &t : mTransfers)
+                if (t.done)
+                    return true;
+            return false;
+        };
+        if (!mChanged.wait_for(lock, std::chrono::milliseconds(timeout_ms), ready))
+            return REAP_TIMEOUT;
+        size_t i = 0;
+        if (mTransfers.size() >= 2 && mTransfers[0].done && mTransfers[1].done)
+            i = 1;
+        while (!mTransfers[i].done)
+            ++i;
+        const Transfer transfer = mTransfers[i];
+        mTransfers.erase(mTransfers.begin() + i);
+        *buffer = transfer.buffer;
+        if (!mIsTx)
+        {
+            std::lock_guard<std::mutex> lck(mLink->lock);
+            ++mLink->rxReaped;
+        }
+        return transfer.bytes;
+    }
+
+    void Cancel(void) override
+    {
+        {
+            std::lock_guard<std::mutex> lck(mLink->lock);
+            mCancelled = true;
+        }
+        std::lock_guard<std::mutex> lock(mLock);
+        for (auto &t : mTransfers)
+            t.done = true;
+        mChanged.notify_all();
+    }
+
+private:
+    struct Transfer
+    {
+        char* buffer;
+        int bytes;
+        bool done;
+    };
+    MemoryLink* mLink;
+    const bool mIsTx;
+    bool mCancelled;
+    std::mutex mLock;
+    std::condition_variable mChanged;
+    std::deque<Transfer> mTransfers;
+};
+
+/** @brief Runs the shared streaming loops over in-memory transports.
+*/
+class MemoryConnection : public SyntheticConnection
+{
+public:
+    MemoryConnection(bool loopback = false) : SyntheticConnection(loopback), packetsPerTransfer(4), buffersCount(16), lateWrites(0)
+    {
+        RxLoopFunction = [this](Streamer* stream){ILimeSDRStreaming::ReceivePacketsLoop(stream);};
+        TxLoopFunction = [this](Streamer* stream){ILimeSDRStreaming::TransmitPacketsLoop(stream);};
+    }
+
+    StreamTransport* OpenStreamTransport(Streamer*, const bool isTx, TransportConfig& config) override
+    {
+        config.packetsPerTransfer = packetsPerTransfer;
+        config.buffersCount = buffersCount;
+        config.lateFlagsMask = 5 << 1;
+        return new MemoryTransport(&link, isTx);
+    }
+
+    //count pulses clearing late Tx flags
+    int TransferPacket(GenericPacket& pkt) override
+    {
+        if (pkt.cmd == CMD_BRDSPI_WR)
+            for (size_t i = 0; i+3 < pkt.outBuffer.size(); i += 4)
+                if (pkt.outBuffer[i] == 0 && pkt.outBuffer[i+1] == 0x09 && (pkt.outBuffer[i+3] & (5 << 1)) == (5 << 1))
+                    ++lateWrites;
+        return SyntheticConnection::TransferPacket(pkt);
+    }
+
+    MemoryLink link;
+    uint32_t packetsPerTransfer;
+    uint32_t buffersCount;
+    std::atomic<int> lateWrites;
+};
+
+class StreamEngineTest : public SyntheticStreamTest<MemoryConnection>
+{
+public:
+    StreamEngineTest() : streamID(0) {}
+
+    void StartRx(const int packets, const int fifoPackets)
+    {
+        conn.link.rxPackets = packets;
+        StreamConfig config = ChannelConfig(false);
+        config.bufferLength = fifoPackets*spp;
+        config.overflowPolicy = StreamConfig::OVERFLOW_DROP_OLDEST;
+        StartStream(streamID, config);
+    }
+
+    //! @brief Waits until receive loop took all transfers with data
+    void WaitRxReaped(const int transfers)
+    {
+        for (int i = 0; i < 5000; ++i)
+        {
+            {
+                std::lock_guard<std::mutex> lock(conn.link.lock);
+                if (conn.link.rxReaped >= transfers)
+                    return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        FAIL() << "transfers not reaped";
+    }
+
+    size_t streamID;
+};
+
+TEST_F (StreamEngineTest, RxProcessedInSubmissionOrder)
+{
+    const int packets = 64*conn.packetsPerTransfer;
+    StartRx(packets, packets);
+    std::vector<complex16_t> samples(spp);
+    for (int i = 0; i < packets; ++i)
+    {
+        StreamMetadata meta;
+        ASSERT_EQ(spp, conn.ReadStream(streamID, samples.data(), spp, 1000, meta));
+        ASSERT_EQ(uint64_t(i)*spp, meta.timestamp);
+    }
+    StreamMetrics metrics;
+    ASSERT_EQ(0, conn.GetStreamMetrics(streamID, metrics));
+    EXPECT_EQ(uint64_t(packets), metrics.packetsTransferred);
+    EXPECT_EQ(0u, metrics.overflowSamples);
+}
+
+TEST_F (StreamEngineTest, LateTxFlagsCleared)
+{
+    conn.packetsPerTransfer = 1;
+    conn.link.rxLate = true;
+    const int packets = 200;
+    StartRx(packets, packets);
+    WaitRxReaped(packets);
+    //first 128 reports are ignored, then one in every 16 transfers is acted on
+    for (int i = 0; i < 1000 && conn.lateWrites.load() == 0; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    EXPECT_GE(conn.lateWrites.load(), 1);
+    EXPECT_LE(conn.lateWrites.load(), 5);
+}
+
+TEST_F (StreamEngineTest, TxSentInOrder)
+{
+    StartStream(streamID, ChannelConfig(true, StreamConfig::STREAM_12_BIT_IN_16));
+
+    const int packets = 32;
+    const uint64_t start = 1000000;
+    std::vector<complex16_t> samples(packets*spp);
+    StreamMetadata meta;
+    meta.timestamp = start;
+    meta.hasTimestamp = true;
+    meta.endOfBurst = true;
+    ASSERT_EQ(int(samples.size()), conn.WriteStream(streamID, samples.data(), samples.size(), 1000, meta));
+    //packets are sent in order, each continues the previous one
+    std::vector<uint64_t> sent;
+    uint64_t step = 0;
+    for (int i = 0; i < 1000; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::lock_guard<std::mutex> lock(conn.link.lock);
+        sent = conn.link.txTimestamps;
+        step = sent.size() > 1 ? sent[1] - sent[0] : 0;
+        if (step && sent.size()*step >= samples.size())
+            break;
+    }
+    ASSERT_GT(step, 0u);
+    ASSERT_EQ((samples.size() + step - 1)/step, sent.size());
+    for (size_t i = 0; i < sent.size(); ++i)
+        EXPECT_EQ(start + i*step, sent[i]);
+}
+
+TEST_F (StreamEngineTest, StopsAfterTransportFailure)
+{
+    conn.link.failSubmit = true;
+    StartRx(64, 64);
+    //receive loop exits on its own, stopping the stream must not hang
+    std::atomic<bool> stopped(false);
+    std::thread stopper([this, &stopped]{
+        conn.ControlStream(streamID, false);
+        stopped = true;
+    });
+    for (int i = 0; i < 5000 && !stopped.load(); ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    EXPECT_TRUE(stopped.load());
+    if (stopped.load())
+        stopper.join();
+    else
+        stopper.detach();
+}
+
+TEST_F (StreamEngineTest, RxThroughput)
+{
+    conn.packetsPerTransfer = 16;
+    const int transfers = 4096;
+    const auto begin = std::chrono::steady_clock::now();
+    const uint64_t bytes = uint64_t(transfers)*conn.packetsPerTransfer*sizeof(FPGA_DataPacket);
+    StartRx(transfers*conn.packetsPerTransfer, 64);
+    StreamMetrics metrics;
+    for (int i = 0; i < 10000; ++i)
+    {
+        ASSERT_EQ(0, conn.GetStreamMetrics(streamID, metrics));
+        if (metrics.bytesTransferred >= bytes)
+            break;
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    EXPECT_EQ(bytes, metrics.bytesTransferred);
+    printf("Rx engine over memory transport: %.0f MB/s, %.0f transfers/s\n",
+        metrics.bytesTransferred/seconds/1e6, transfers/seconds);
+}
@@ -0,0 +1,143 @@
+#include "gtest/gtest.h"
+#include "syntheticConnection.h"
+#ifdef __linux__
+#include <poll.h>
+#endif
+using namespace std;
+using namespace lime;
+
+class StreamEventsTest : public SyntheticStreamTest<>
+{
+public:
+    StreamEventsTest() : SyntheticStreamTest(true), txStream(0)
+    {
+    }
+
+    void SetUp()
+    {
+        StreamConfig config = ChannelConfig(true, StreamConfig::STREAM_12_BIT_IN_16);
+        config.underflowTimeout_ms = 10;
+        ASSERT_NO_FATAL_FAILURE(StartStream(txStream, config));
+    }
+
+    int WriteBurst(const uint64_t timestamp, const size_t count, bool endOfBurst, const int16_t value = 0)
+    {
+        complex16_t sample;
+        sample.i = sample.q = value;
+        std::vector<complex16_t> samples(count, sample);
+        StreamMetadata meta;
+        meta.timestamp = timestamp;
+        meta.hasTimestamp = true;
+        meta.endOfBurst = endOfBurst;
+        return conn.WriteStream(txStream, samples.data(), count, 1000, meta);
+    }
+
+    size_t txStream;
+};
+
+TEST_F (StreamEventsTest, EndOfBurstAck)
+{
+    StreamEvent event;
+    EXPECT_NE(0, conn.ReadStreamEvent(txStream, 0, event));
+    ASSERT_EQ(1500, WriteBurst(100000, 1500, true));
+    ASSERT_EQ(0, conn.ReadStreamEvent(txStream, 1000, event));
+    EXPECT_EQ(StreamEvent::EVENT_END_OF_BURST, event.type);
+    EXPECT_EQ(101500u, event.timestamp);
+    //no underflows are reported after end of burst
+    EXPECT_NE(0, conn.ReadStreamEvent(txStream, 100, event));
+}
+
+TEST_F (StreamEventsTest, Underflow)
+{
+    ASSERT_EQ(1500, WriteBurst(100000, 1500, false));
+    StreamEvent event;
+    ASSERT_EQ(0, conn.ReadStreamEvent(txStream, 1000, event));
+    EXPECT_EQ(StreamEvent::EVENT_UNDERFLOW, event.type);
+    EXPECT_EQ(101500u, event.timestamp);
+    EXPECT_NE(0u, event.samplesCount);
+
+    StreamMetadata meta;
+    ASSERT_EQ(0, conn.ReadStreamStatus(txStream, 1000, meta));
+    EXPECT_TRUE(meta.underflow);
+}
+
+#ifdef __linux__
+TEST_F (StreamEventsTest, EventFd)
+{
+    const int fd = conn.GetStreamEventFd(txStream);
+    ASSERT_GE(fd, 0);
+    pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    EXPECT_EQ(0, poll(&pfd, 1, 0));
+    ASSERT_EQ(1500, WriteBurst(100000, 1500, true));
+    ASSERT_EQ(1, poll(&pfd, 1, 1000));
+    StreamEvent event;
+    ASSERT_EQ(0, conn.ReadStreamEvent(txStream, 0, event));
+    EXPECT_EQ(StreamEvent::EVENT_END_OF_BURST, event.type);
+    EXPECT_NE(0, conn.ReadStreamEvent(txStream, 0, event));
+    EXPECT_EQ(0, poll(&pfd, 1, 0));
+}
+#endif
+
+TEST_F (StreamEventsTest, Metrics)
+{
+    ASSERT_EQ(1500, WriteBurst(100000, 1500, false));
+    StreamEvent event;
+    ASSERT_EQ(0, conn.ReadStreamEvent(txStream, 1000, event));
+    ASSERT_EQ(StreamEvent::EVENT_UNDERFLOW, event.type);
+
+    //underflow is reported while the packet is encoded, before it is sent
+    StreamMetrics metrics;
+    for (int i = 0; i < 100; ++i)
+    {
+        ASSERT_EQ(0, conn.GetStreamMetrics(txStream, metrics));
+        if (metrics.packetsTransferred >= 2)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_GE(metrics.fifoHighWatermark, 1500u);
+    EXPECT_LE(metrics.fifoHighWatermark, metrics.fifoSize);
+    EXPECT_GE(metrics.packetsTransferred, 2u);
+    //transmit loop may be between encoding and sending a packet
+    EXPECT_LE(metrics.bytesTransferred, metrics.packetsTransferred*sizeof(FPGA_DataPacket));
+    EXPECT_GE(metrics.bytesTransferred, (metrics.packetsTransferred-1)*sizeof(FPGA_DataPacket));
+    uint64_t intervals = 0;
+    for (auto count : metrics.transferIntervals)
+        intervals += count;
+    EXPECT_NE(0u, intervals);
+    EXPECT_NE(0u, metrics.packetTimeMax_ns);
+    EXPECT_LE(metrics.packetTimeAvg_ns, metrics.packetTimeMax_ns);
+    EXPECT_NE(0u, metrics.underflowSamples);
+    EXPECT_EQ(0u, metrics.overflowSamples);
+    EXPECT_EQ(0u, metrics.lateSamples);
+}
+
+TEST_F (StreamEventsTest, LateTimestamp)
+{
+    //looped back packets advance hardware time
+    size_t rxStream;
+    ASSERT_NO_FATAL_FAILURE(StartStream(rxStream, ChannelConfig(false, StreamConfig::STREAM_12_BIT_IN_16)));
+    std::vector<complex16_t> buffer(spp);
+    StreamMetadata meta;
+    meta.timestamp = 0;
+    for (int i = 0; i < 1000 && meta.timestamp < 10000; ++i)
+        ASSERT_GT(conn.ReadStream(rxStream, buffer.data(), buffer.size(), 1000, meta), 0);
+    ASSERT_GE(meta.timestamp, 10000u);
+
+    conn.recordTxPackets = 10000;
+    ASSERT_EQ(1500, WriteBurst(1000, 1500, true, 100));
+    StreamEvent event;
+    ASSERT_EQ(0, conn.ReadStreamEvent(txStream, 1000, event));
+    EXPECT_EQ(StreamEvent::EVENT_LATE_TIMESTAMP, event.type);
+    EXPECT_EQ(1500u, event.samplesCount);
+    StreamMetrics metrics;
+    ASSERT_EQ(0, conn.GetStreamMetrics(txStream, metrics));
+    EXPECT_EQ(1500u, metrics.lateSamples);
+
+    //late samples are not sent
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    for (const auto &pkt : conn.TakeTxPackets())
+        for (size_t i = 0; i < sizeof(pkt.data); ++i)
+            ASSERT_EQ(0, pkt.data[i]);
+}
@@ -0,0 +1,104 @@
+#include "gtest/gtest.h"
+#include "syntheticConnection.h"
+#include <random>
+using namespace std;
+using namespace lime;
+
+/** @brief Transmits samples in one format and receives them in other format
+    through synthetic connection, that loops transmitted packets back.
+    @return number of samples received
+*/
+static int Loopback(StreamConfig::StreamDataFormat txFormat, const void* txSamples,
+                    StreamConfig::StreamDataFormat rxFormat, void* rxSamples, const size_t count)
+{
+    SyntheticConnection conn(true);
+    StreamConfig config;
+    config.channelID = 0;
+    config.isTx = false;
+    config.format = rxFormat;
+    size_t rxStream = 0;
+    size_t txStream = 0;
+    if (conn.SetupStream(rxStream, config) != 0)
+        return -1;
+    config.isTx = true;
+    config.format = txFormat;
+    if (conn.SetupStream(txStream, config) != 0)
+        return -1;
+    conn.ControlStream(rxStream, true);
+    conn.ControlStream(txStream, true);
+
+    const uint64_t timestamp = 1000000;
+    StreamMetadata txMeta;
+    txMeta.timestamp = timestamp;
+    txMeta.hasTimestamp = true;
+    txMeta.endOfBurst = true;
+    int received = 0;
+    if (conn.WriteStream(txStream, txSamples, count, 1000, txMeta) == int(count))
+    {
+        //skip samples of packets sent before the burst
+        StreamMetadata rxMeta;
+        rxMeta.timestamp = timestamp;
+        rxMeta.hasTimestamp = true;
+        received = conn.ReadStream(rxStream, rxSamples, count, 1000, rxMeta);
+        if (rxMeta.timestamp != timestamp)
+            received = -1;
+    }
+
+    conn.ControlStream(txStream, false);
+    conn.ControlStream(rxStream, false);
+    conn.CloseStream(txStream);
+    conn.CloseStream(rxStream);
+    return received;
+}
+
+TEST (StreamFormats, Packed12RoundTrip)
+{
+    const size_t count = 1360*4;
+    std::mt19937 gen(0);
+    std::vector<uint8_t> tx(count*3);
+    for (auto &b : tx)
+        b = gen();
+    std::vector<uint8_t> rx(count*3);
+    ASSERT_EQ(int(count), Loopback(StreamConfig::STREAM_12_BIT_PACKED, tx.data(), StreamConfig::STREAM_12_BIT_PACKED, rx.data(), count));
+    EXPECT_EQ(tx, rx);
+}
+
+TEST (StreamFormats, Packed12Layout)
+{
+    //I=0x123, Q=-2 packed as in SoapySDR CS12 format
+    const size_t count = 1360;
+    std::vector<uint8_t> tx(count*3);
+    for (size_t i = 0; i < count; ++i)
+    {
+        tx[3*i] = 0x23;
+        tx[3*i+1] = 0xE1;
+        tx[3*i+2] = 0xFF;
+    }
+    std::vector<complex16_t> rx(count);
+    ASSERT_EQ(int(count), Loopback(StreamConfig::STREAM_12_BIT_PACKED, tx.data(), StreamConfig::STREAM_12_BIT_IN_16, rx.data(), count));
+    for (size_t i = 0; i < count; ++i)
+    {
+        ASSERT_EQ(0x123, rx[i].i);
+        ASSERT_EQ(-2, rx[i].q);
+    }
+}
+
+TEST (StreamFormats, Int8RoundTrip)
+{
+    const size_t count = 1360*4;
+    std::mt19937 gen(0);
+    std::vector<int8_t> tx(count*2);
+    for (auto &v : tx)
+        v = gen();
+    std::vector<int8_t> rx(count*2);
+    ASSERT_EQ(int(count), Loopback(StreamConfig::STREAM_8_BIT, tx.data(), StreamConfig::STREAM_8_BIT, rx.data(), count));
+    EXPECT_EQ(tx, rx);
+
+    std::vector<complex16_t> rx16(count);
+    ASSERT_EQ(int(count), Loopback(StreamConfig::STREAM_8_BIT, tx.data(), StreamConfig::STREAM_12_BIT_COMPRESSED, rx16.data(), count));
+    for (size_t i = 0; i < count; ++i)
+    {
+        ASSERT_EQ(tx[2*i]*16, rx16[i].i);
+        ASSERT_EQ(tx[2*i+1]*16, rx16[i].q);
+    }
+}
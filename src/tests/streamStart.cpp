@@ -0,0 +1,65 @@
+#include "gtest/gtest.h"
+#include "syntheticConnection.h"
+#include <algorithm>
+using namespace std;
+using namespace lime;
+
+class StreamStartTest : public SyntheticStreamTest<>
+{
+public:
+    StreamStartTest() : streamID(0)
+    {
+    }
+
+    void SetUp()
+    {
+        ASSERT_NO_FATAL_FAILURE(SetupStream(streamID, ChannelConfig(false)));
+    }
+
+    size_t streamID;
+};
+
+TEST_F (StreamStartTest, ConfigurationFailureNotStarted)
+{
+    conn.failControl = true;
+    EXPECT_NE(0, conn.ControlStream(streamID, true));
+    conn.failControl = false;
+    auto channel = (IStreamChannel*)streamID;
+    EXPECT_FALSE(channel->GetInfo().active);
+
+    //receive thread is not started, no samples are generated
+    complex16_t buffer[spp];
+    StreamMetadata meta;
+    EXPECT_EQ(0, conn.ReadStream(streamID, buffer, spp, 100, meta));
+
+    ASSERT_EQ(0, conn.ControlStream(streamID, true));
+    EXPECT_TRUE(channel->GetInfo().active);
+    EXPECT_EQ(spp, conn.ReadStream(streamID, buffer, spp, 1000, meta));
+}
+
+TEST_F (StreamStartTest, WarmRestartWritesStreamControlOnly)
+{
+    std::vector<uint16_t> fpgaWrites, lmsWrites;
+    ASSERT_EQ(0, conn.ControlStream(streamID, true));
+    ASSERT_EQ(0, conn.ControlStream(streamID, false));
+    conn.TakeRegisterWrites(fpgaWrites, lmsWrites);
+
+    //unchanged settings: only timestamp reset and stream enable
+    ASSERT_EQ(0, conn.ControlStream(streamID, true));
+    conn.TakeRegisterWrites(fpgaWrites, lmsWrites);
+    EXPECT_TRUE(lmsWrites.empty());
+    EXPECT_FALSE(fpgaWrites.empty());
+    for (auto addr : fpgaWrites)
+        EXPECT_TRUE(addr == 0x0009 || addr == 0x000A) << "FPGA register 0x" << std::hex << addr;
+    ASSERT_EQ(0, conn.ControlStream(streamID, false));
+
+    //register written between starts forces full interface setup
+    const uint32_t spiWrite = (1u << 31) | (0x0020u << 16) | 0xFFFD;
+    ASSERT_EQ(0, conn.WriteLMS7002MSPI(&spiWrite, 1));
+    conn.TakeRegisterWrites(fpgaWrites, lmsWrites);
+    ASSERT_EQ(0, conn.ControlStream(streamID, true));
+    conn.TakeRegisterWrites(fpgaWrites, lmsWrites);
+    EXPECT_FALSE(lmsWrites.empty());
+    EXPECT_NE(fpgaWrites.end(), std::find(fpgaWrites.begin(), fpgaWrites.end(), 0x0007));
+    EXPECT_NE(fpgaWrites.end(), std::find(fpgaWrites.begin(), fpgaWrites.end(), 0x0008));
+}
@@ -5,6 +5,8 @@
 #include "math.h"
 #include <thread>
 #include <chrono>
+#include <atomic>
+#include <vector>
 #include "dataTypes.h"
 using namespace std;
 using namespace lime;
@@ -663,3 +665,175 @@ TEST_F (StreamingFixture, channelsRxAB_Float)
         delete []buffers[i];
     delete buffers;
 }
+
+TEST_F (StreamingFixture, channelsRxHotAddB)
+{
+    LMS7002M lmsControl;
+    lmsControl.SetConnection(serPort, 0);
+    lmsControl.ResetChip();
+    //load initial settings to get samples
+    lmsControl.UploadAll();
+    lmsControl.SetActiveChannel(LMS7002M::ChA);
+    lmsControl.Modify_SPI_Reg_bits(LMS7param(EN_ADCCLKH_CLKGN), 0);
+    lmsControl.Modify_SPI_Reg_bits(LMS7param(CLKH_OV_CLKL_CGEN), 2);
+    lmsControl.SetFrequencySX(LMS7002M::Tx, 1e6);
+    lmsControl.SetFrequencySX(LMS7002M::Rx, 1e6);
+    lmsControl.Modify_SPI_Reg_bits(LMS7param(LML1_MODE), 0);
+    lmsControl.Modify_SPI_Reg_bits(LMS7param(LML2_MODE), 0);
+    lmsControl.Modify_SPI_Reg_bits(LMS7param(PD_RX_AFE2), 0);
+
+    lmsControl.SetActiveChannel(LMS7002M::ChAB);
+    lmsControl.Modify_SPI_Reg_bits(LMS7param(INSEL_RXTSP), 1);
+    lmsControl.Modify_SPI_Reg_bits(LMS7param(GFIR1_BYP_RXTSP), 1);
+    lmsControl.Modify_SPI_Reg_bits(LMS7param(GFIR2_BYP_RXTSP), 1);
+    lmsControl.Modify_SPI_Reg_bits(LMS7param(GFIR3_BYP_RXTSP), 1);
+    lmsControl.Modify_SPI_Reg_bits(LMS7param(AGC_BYP_RXTSP), 1);
+    lmsControl.Modify_SPI_Reg_bits(LMS7param(CMIX_BYP_RXTSP), 1);
+
+    lmsControl.SetActiveChannel(LMS7002M::ChA);
+    lmsControl.Modify_SPI_Reg_bits(LMS7param(TSGFCW_RXTSP), 1);
+    lmsControl.Modify_SPI_Reg_bits(LMS7param(TSGFC_RXTSP), 1);
+    lmsControl.SetActiveChannel(LMS7002M::ChB);
+    lmsControl.Modify_SPI_Reg_bits(LMS7param(TSGFCW_RXTSP), 1);
+    lmsControl.Modify_SPI_Reg_bits(LMS7param(TSGFC_RXTSP), 0);
+    lmsControl.SetActiveChannel(LMS7002M::ChA);
+    float cgenFreq = 30.72e6 * 4;
+    lmsControl.SetInterfaceFrequency(cgenFreq, 0, 0);
+    auto txRate = lmsControl.GetSampleRate(LMS7002M::Tx, LMS7002M::ChA);
+    auto rxRate = lmsControl.GetSampleRate(LMS7002M::Rx, LMS7002M::ChA);
+    serPort->UpdateExternalDataRate(0, txRate, rxRate);
+
+    StreamConfig config;
+    config.isTx = false;
+    config.format = StreamConfig::STREAM_12_BIT_COMPRESSED;
+    size_t streamA;
+    config.channelID = 0;
+    serPort->SetupStream(streamA, config);
+    ASSERT_NE(streamA, size_t(~0));
+    ASSERT_EQ(0, serPort->ControlStream(streamA, true));
+
+    //read channel A continuously while channel B is added and removed
+    std::atomic<bool> running(true);
+    int gaps = 0;
+    int shortReads = 0;
+    std::thread readerA([&]()
+    {
+        const int chunk = 1360;
+        complex16_t buffer[chunk];
+        lime::IStreamChannel::Metadata metadata;
+        uint64_t expectedTs = 0;
+        while (running.load())
+        {
+            int samplesRead = ((IStreamChannel*)streamA)->Read((void *)buffer, chunk, &metadata, 1000);
+            if (samplesRead != chunk)
+                ++shortReads;
+            if (expectedTs != 0 && metadata.timestamp != expectedTs)
+                ++gaps;
+            expectedTs = metadata.timestamp + samplesRead;
+        }
+    });
+
+    //fatal failures return from lambda, reader thread is joined afterwards
+    auto hotAddB = [&]()
+    {
+        this_thread::sleep_for(chrono::milliseconds(200));
+
+        size_t streamB;
+        config.channelID = 1;
+        serPort->SetupStream(streamB, config);
+        ASSERT_NE(streamB, size_t(~0));
+        ASSERT_EQ(0, serPort->ControlStream(streamB, true));
+
+        const int streamsize = 680*32;
+        std::vector<complex16_t> buffer(streamsize);
+        lime::IStreamChannel::Metadata metadata;
+        int samplesRead = ((IStreamChannel*)streamB)->Read((void *)buffer.data(), streamsize, &metadata, 1000);
+        EXPECT_EQ(streamsize, samplesRead);
+
+        ASSERT_EQ(0, serPort->ControlStream(streamB, false));
+        ASSERT_EQ(0, serPort->CloseStream(streamB));
+        this_thread::sleep_for(chrono::milliseconds(200));
+
+        //closed channel is disabled in FPGA
+        uint32_t channelEnables = 0;
+        ASSERT_EQ(0, serPort->ReadRegister(0x0007, channelEnables));
+        EXPECT_EQ(0x1u, channelEnables & 0x3);
+    };
+    hotAddB();
+
+    running.store(false);
+    readerA.join();
+    IStreamChannel::Info info = ((IStreamChannel*)streamA)->GetInfo();
+    EXPECT_EQ(0, gaps);
+    EXPECT_EQ(0, shortReads);
+    EXPECT_EQ(0, info.droppedPackets);
+    EXPECT_EQ(0, info.overrun);
+
+    ASSERT_EQ(0, serPort->ControlStream(streamA, false));
+    ASSERT_EQ(0, serPort->CloseStream(streamA));
+}
+
+TEST_F (StreamingFixture, channelsRxTimedBurst)
+{
+    LMS7002M lmsControl;
+    lmsControl.SetConnection(serPort, 0);
+    lmsControl.ResetChip();
+    //load initial settings to get samples
+    lmsControl.UploadAll();
+    lmsControl.SetActiveChannel(LMS7002M::ChA);
+    lmsControl.Modify_SPI_Reg_bits(LMS7param(EN_ADCCLKH_CLKGN), 0);
+    lmsControl.Modify_SPI_Reg_bits(LMS7param(CLKH_OV_CLKL_CGEN), 2);
+    lmsControl.SetFrequencySX(LMS7002M::Tx, 1e6);
+    lmsControl.SetFrequencySX(LMS7002M::Rx, 1e6);
+    lmsControl.Modify_SPI_Reg_bits(LMS7param(LML1_MODE), 0);
+    lmsControl.Modify_SPI_Reg_bits(LMS7param(LML2_MODE), 0);
+    lmsControl.Modify_SPI_Reg_bits(LMS7param(INSEL_RXTSP), 1);
+    lmsControl.Modify_SPI_Reg_bits(LMS7param(TSGFCW_RXTSP), 1);
+    lmsControl.Modify_SPI_Reg_bits(LMS7param(TSGFC_RXTSP), 1);
+    float cgenFreq = 30.72e6 * 4;
+    lmsControl.SetInterfaceFrequency(cgenFreq, 0, 0);
+    auto txRate = lmsControl.GetSampleRate(LMS7002M::Tx, LMS7002M::ChA);
+    auto rxRate = lmsControl.GetSampleRate(LMS7002M::Rx, LMS7002M::ChA);
+    serPort->UpdateExternalDataRate(0, txRate, rxRate);
+
+    StreamConfig config;
+    config.isTx = false;
+    config.format = StreamConfig::STREAM_12_BIT_COMPRESSED;
+    config.channelID = 0;
+    size_t streamA;
+    serPort->SetupStream(streamA, config);
+    ASSERT_NE(streamA, size_t(~0));
+
+    //burst queued before stream start
+    const int burstSize = 5000;
+    StreamMetadata metadata;
+    metadata.hasTimestamp = true;
+    metadata.timestamp = uint64_t(rxRate/10) + 3;
+    ASSERT_EQ(0, serPort->ScheduleRxStream(streamA, burstSize, metadata));
+    ASSERT_EQ(0, serPort->ControlStream(streamA, true));
+
+    const int streamsize = 680*32;
+    complex16_t* buffer = new complex16_t[streamsize];
+    StreamMetadata rxMeta;
+    int samplesRead = serPort->ReadStream(streamA, buffer, streamsize, 1000, rxMeta);
+    EXPECT_EQ(burstSize, samplesRead);
+    EXPECT_EQ(metadata.timestamp, rxMeta.timestamp);
+    EXPECT_TRUE(rxMeta.endOfBurst);
+
+    //stream is paused after the burst
+    samplesRead = serPort->ReadStream(streamA, buffer, streamsize, 100, rxMeta);
+    EXPECT_EQ(0, samplesRead);
+
+    //continuous streaming from timestamp
+    lime::IStreamChannel::Metadata meta;
+    meta.flags = lime::IStreamChannel::Metadata::SYNC_TIMESTAMP;
+    meta.timestamp = metadata.timestamp + uint64_t(rxRate/10);
+    const uint64_t startTs = meta.timestamp;
+    samplesRead = ((IStreamChannel*)streamA)->Read((void *)buffer, streamsize, &meta, 1000);
+    EXPECT_EQ(streamsize, samplesRead);
+    EXPECT_EQ(startTs, meta.timestamp);
+    delete []buffer;
+
+    ASSERT_EQ(0, serPort->ControlStream(streamA, false));
+    ASSERT_EQ(0, serPort->CloseStream(streamA));
+}
@@ -0,0 +1,148 @@
+#include "gtest/gtest.h"
+#include "syntheticConnection.h"
+#include "SweepEngine.h"
+#include "LMS7002M.h"
+#include <cmath>
+#include <algorithm>
+using namespace std;
+using namespace lime;
+
+TEST (Sweep, SettlingIsDiscarded)
+{
+    SyntheticConnection conn;
+    StreamConfig config;
+    config.isTx = false;
+    config.channelID = 0;
+    config.format = StreamConfig::STREAM_12_BIT_COMPRESSED;
+    size_t streamID = 0;
+    ASSERT_EQ(0, conn.SetupStream(streamID, config));
+    conn.rxStream = streamID;
+    ASSERT_EQ(0, conn.ControlStream(streamID, true));
+
+    //hardware time of each retune, estimate used by engine is not earlier
+    std::vector<std::pair<size_t, uint64_t> > retunes;
+    auto retune = [&conn, &retunes](const size_t step)
+    {
+        retunes.push_back(std::make_pair(step, conn.GetHardwareTimestamp()));
+        return 0;
+    };
+
+    SweepConfig sweep;
+    sweep.stepCount = 3;
+    sweep.settlingSamples = 5000;
+    sweep.samplesPerStep = 2000;
+    sweep.format = config.format;
+    SweepEngine engine(&conn, (IStreamChannel*)streamID);
+    ASSERT_EQ(0, engine.Start(sweep, retune));
+    ASSERT_EQ(1u, retunes.size());
+
+    std::vector<complex16_t> samples(sweep.samplesPerStep);
+    uint64_t lastTimestamp = 0;
+    for (size_t i = 0; i < 7; ++i)
+    {
+        SweepBlock block;
+        ASSERT_EQ(int(sweep.samplesPerStep), engine.Next(samples.data(), samples.size(), block, 1000));
+        EXPECT_EQ(i % sweep.stepCount, block.step);
+        EXPECT_FALSE(block.discontinuity);
+        //block was requested after retune to its step
+        const auto &tune = retunes[i];
+        EXPECT_EQ(block.step, tune.first);
+        EXPECT_GE(block.timestamp, tune.second + sweep.settlingSamples);
+        EXPECT_GE(block.timestamp, lastTimestamp + sweep.samplesPerStep);
+        lastTimestamp = block.timestamp;
+        //next step is tuned before the block is returned
+        EXPECT_EQ(i + 2, retunes.size());
+    }
+    EXPECT_EQ(7u, engine.GetStepCount());
+    EXPECT_GT(engine.GetStepsPerSecond(), 0);
+
+    conn.ControlStream(streamID, false);
+    conn.CloseStream(streamID);
+}
+
+TEST (Sweep, Spectrum)
+{
+    SyntheticConnection conn(true);
+    StreamConfig config;
+    config.isTx = false;
+    config.channelID = 0;
+    config.format = StreamConfig::STREAM_COMPLEX_FLOAT32;
+    size_t rxStream = 0;
+    size_t txStream = 0;
+    ASSERT_EQ(0, conn.SetupStream(rxStream, config));
+    config.isTx = true;
+    config.format = StreamConfig::STREAM_12_BIT_IN_16;
+    ASSERT_EQ(0, conn.SetupStream(txStream, config));
+
+    //tone at bin 64 of 1024 point FFT, half of full scale
+    std::vector<complex16_t> tone(1024);
+    for (size_t i = 0; i < tone.size(); ++i)
+    {
+        const double phase = 2 * M_PI * 64 * i / 1024;
+        tone[i].i = std::lround(1024 * cos(phase));
+        tone[i].q = std::lround(1024 * sin(phase));
+    }
+    ASSERT_EQ(0, ((IStreamChannel*)txStream)->SetCyclicBuffer(tone.data(), tone.size()));
+    ASSERT_EQ(0, conn.ControlStream(rxStream, true));
+    ASSERT_EQ(0, conn.ControlStream(txStream, true));
+
+    SweepConfig sweep;
+    sweep.stepCount = 2;
+    sweep.settlingSamples = 100;
+    sweep.format = StreamConfig::STREAM_COMPLEX_FLOAT32;
+    sweep.computeSpectrum = true;
+    sweep.spectrum.fftSize = 1024;
+    sweep.spectrum.averageCount = 4;
+    SweepEngine engine(&conn, (IStreamChannel*)rxStream);
+    ASSERT_EQ(0, engine.Start(sweep, [](const size_t){return 0;}));
+
+    std::vector<float> bins(1024);
+    for (int i = 0; i < 2; ++i)
+    {
+        SweepBlock block;
+        ASSERT_EQ(1024, engine.Next(bins.data(), bins.size(), block, 1000));
+        EXPECT_EQ(size_t(i), block.step);
+        const int peak = std::max_element(bins.begin(), bins.end()) - bins.begin();
+        EXPECT_EQ(512 + 64, peak);
+        EXPECT_NEAR(-6.02, bins[peak], 0.1);
+    }
+    SweepBlock block;
+    EXPECT_LT(engine.Next(bins.data(), 16, block, 10), 0);
+
+    conn.ControlStream(txStream, false);
+    conn.ControlStream(rxStream, false);
+    conn.CloseStream(txStream);
+    conn.CloseStream(rxStream);
+}
+
+TEST (Sweep, ApplyFrequencySX)
+{
+    SyntheticConnection conn;
+    //VCO comparators report lock for any setting
+    const uint32_t cmp = (1u << 31) | (0x0123 << 16) | 0x2000;
+    ASSERT_EQ(0, conn.WriteLMS7002MSPI(&cmp, 1));
+    LMS7002M lms;
+    lms.SetConnection(&conn, 0);
+
+    LMS7002M::SX_details low, high;
+    ASSERT_EQ(0, lms.SetFrequencySX(false, 1e9, &low));
+    ASSERT_EQ(0, lms.SetFrequencySX(false, 2.5e9, &high));
+    ASSERT_TRUE(low.success);
+
+    //all settings are written in single transfer without VCO tuning
+    const LMS7002M::Channel channel = lms.GetActiveChannel(false);
+    const int transfers = conn.controlTransfers.load();
+    ASSERT_EQ(0, lms.ApplyFrequencySX(false, low));
+    EXPECT_EQ(transfers + 1, conn.controlTransfers.load());
+    //within fractional divider resolution
+    EXPECT_NEAR(1e9, lms.GetFrequencySX(false), 100);
+    EXPECT_EQ(low.INT, lms.Get_SPI_Reg_bits(LMS7param(INT_SDM), true));
+    EXPECT_EQ(low.csw, lms.Get_SPI_Reg_bits(LMS7param(CSW_VCO), true));
+    EXPECT_EQ(low.div_loch, lms.Get_SPI_Reg_bits(LMS7param(DIV_LOCH), true));
+
+    //active channel is not changed
+    EXPECT_EQ(channel, lms.GetActiveChannel(false));
+
+    ASSERT_EQ(0, lms.ApplyFrequencySX(false, high));
+    EXPECT_NEAR(2.5e9, lms.GetFrequencySX(false), 100);
+}
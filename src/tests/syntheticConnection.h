@@ -0,0 +1,258 @@
+#ifndef SYNTHETIC_CONNECTION_H
+#define SYNTHETIC_CONNECTION_H
+
+#include "gtest/gtest.h"
+#include "ILimeSDRStreaming.h"
+#include "LMS64CCommands.h"
+#include <map>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <cstring>
+
+static const int spp = 1360; //12 bit compressed single channel
+
+/** @brief Connection without hardware for testing streaming pipeline.
+    Receive loop generates packets with continuous timestamps as fast as
+    the stream consumes them, optionally skipping packets to emulate losses
+    on the link or pushing packets regardless of FIFO space to overflow it,
+    or in loopback mode receives packets that
+    were produced by transmit loop. Transmitted packets and register writes
+    can be recorded for inspection.
+*/
+class SyntheticConnection : public lime::ILimeSDRStreaming
+{
+public:
+    SyntheticConnection(bool loopback = false) : rxStream(0), dropPackets(0), burstPackets(0), controlTransfers(0), failControl(false), recordTxPackets(0), loopback(loopback)
+    {
+        RxLoopFunction = std::bind(&SyntheticConnection::ReceivePacketsLoop, this, std::placeholders::_1);
+        TxLoopFunction = std::bind(&SyntheticConnection::TransmitPacketsLoop, this, std::placeholders::_1);
+        mExpectedSampleRate = 1e6;
+    }
+    bool IsOpen() {return true;}
+    eConnectionType GetType(void) {return USB_PORT;}
+    int Write(const unsigned char*, int length, int) {return length;}
+    int Read(unsigned char*, int length, int) {return length;}
+    int UpdateExternalDataRate(const size_t, const double, const double) {return 0;}
+
+    //emulate board SPI registers
+    int TransferPacket(GenericPacket& pkt)
+    {
+        std::lock_guard<std::mutex> lock(regLock);
+        ++controlTransfers;
+        if (failControl.load())
+            return -1;
+        pkt.inBuffer.clear();
+        const auto &out = pkt.outBuffer;
+        auto &regs = (pkt.cmd == lime::CMD_BRDSPI_WR || pkt.cmd == lime::CMD_BRDSPI_RD) ? fpgaRegs : lmsRegs;
+        if (pkt.cmd == lime::CMD_BRDSPI_WR || pkt.cmd == lime::CMD_LMS7002_WR)
+        {
+            auto &writes = pkt.cmd == lime::CMD_BRDSPI_WR ? fpgaWrites : lmsWrites;
+            for(size_t i=0; i+3<out.size(); i+=4)
+            {
+                const uint16_t addr = (out[i]<<8) | out[i+1];
+                regs[addr] = (out[i+2]<<8) | out[i+3];
+                writes.push_back(addr);
+            }
+        }
+        else if (pkt.cmd == lime::CMD_BRDSPI_RD || pkt.cmd == lime::CMD_LMS7002_RD)
+        {
+            for(size_t i=0; i+1<out.size(); i+=2)
+            {
+                const uint16_t value = regs[(out[i]<<8) | out[i+1]];
+                pkt.inBuffer.push_back(out[i]);
+                pkt.inBuffer.push_back(out[i+1]);
+                pkt.inBuffer.push_back(value >> 8);
+                pkt.inBuffer.push_back(value & 0xFF);
+            }
+        }
+        pkt.status = lime::STATUS_COMPLETED_CMD;
+        return 0;
+    }
+
+    void ReceivePacketsLoop(Streamer* stream)
+    {
+        if (loopback)
+        {
+            while (!stream->terminateRx.load())
+            {
+                std::unique_lock<std::mutex> lock(loopbackLock);
+                if (loopbackPackets.empty())
+                {
+                    lock.unlock();
+                    stream->RefreshRxLayout();
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                    continue;
+                }
+                lime::FPGA_DataPacket pkt = loopbackPackets.front();
+                loopbackPackets.pop_front();
+                lock.unlock();
+                stream->ProcessRxPacket(pkt);
+            }
+            return;
+        }
+
+        lime::FPGA_DataPacket pkt;
+        memset(&pkt, 0, sizeof(pkt));
+        uint64_t timestamp = 0;
+        auto channel = (lime::IStreamChannel*)rxStream.load();
+        while (!stream->terminateRx.load())
+        {
+            //do not overflow, benchmarks measure consumer cost only
+            lime::IStreamChannel::Info info = channel->GetInfo();
+            if (burstPackets.load() == 0 && info.fifoSize - info.fifoItemsCount < 4*spp)
+            {
+                stream->RefreshRxLayout();
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                continue;
+            }
+            const uint32_t samplesInPacket = SamplesInPacket();
+            for(int i=0; i<4; ++i)
+            {
+                if (dropPackets.load() > 0)
+                {
+                    --dropPackets;
+                    timestamp += samplesInPacket;
+                    continue;
+                }
+                if (burstPackets.load() > 0)
+                    --burstPackets;
+                pkt.counter = timestamp;
+                stream->ProcessRxPacket(pkt);
+                timestamp += samplesInPacket;
+            }
+            stream->rxMetrics.TransferCompleted(4*sizeof(pkt));
+        }
+    }
+
+    void TransmitPacketsLoop(Streamer* stream)
+    {
+        lime::FPGA_DataPacket pkt;
+        while (!stream->terminateTx.load())
+        {
+            stream->ReadTxPacket(pkt);
+            stream->txMetrics.TransferCompleted(sizeof(pkt));
+            if (recordTxPackets.load() > 0)
+            {
+                --recordTxPackets;
+                std::lock_guard<std::mutex> lock(txRecordLock);
+                txRecord.push_back(pkt);
+            }
+            if (loopback)
+            {
+                std::lock_guard<std::mutex> lock(loopbackLock);
+                loopbackPackets.push_back(pkt);
+            }
+            //packets without timestamp carry no samples from streams
+            if (IgnoresTimestamp(pkt))
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    std::atomic<size_t> rxStream; //stream used for pacing generated packets
+    std::atomic<int> dropPackets; //number of next generated packets to lose
+    std::atomic<int> burstPackets; //number of next generated packets pushed without pacing
+    std::atomic<int> controlTransfers; //number of emulated control packets
+    std::atomic<bool> failControl; //emulated control packets fail
+    std::atomic<int> recordTxPackets; //number of next transmitted packets to record
+
+    //! @brief Returns samples per channel in packets of channels enabled in FPGA
+    uint32_t SamplesInPacket()
+    {
+        std::lock_guard<std::mutex> lock(regLock);
+        const uint16_t mask = fpgaRegs[0x0007];
+        const int chCount = (mask & 1) + ((mask >> 1) & 1);
+        return chCount == 0 ? spp : spp/chCount;
+    }
+
+    //! @brief Takes addresses of recorded FPGA and LMS7002M register writes, in order of writing
+    void TakeRegisterWrites(std::vector<uint16_t> &fpga, std::vector<uint16_t> &lms)
+    {
+        std::lock_guard<std::mutex> lock(regLock);
+        fpga.clear();
+        lms.clear();
+        fpga.swap(fpgaWrites);
+        lms.swap(lmsWrites);
+    }
+
+    //! @brief Returns recorded transmitted packets and clears the record
+    std::vector<lime::FPGA_DataPacket> TakeTxPackets()
+    {
+        std::lock_guard<std::mutex> lock(txRecordLock);
+        std::vector<lime::FPGA_DataPacket> packets;
+        packets.swap(txRecord);
+        return packets;
+    }
+
+    //! @brief Returns true if packet is sent without waiting for its timestamp
+    static bool IgnoresTimestamp(const lime::FPGA_DataPacket& pkt)
+    {
+        return pkt.reserved[0] & (1 << 4);
+    }
+private:
+    const bool loopback;
+    std::mutex loopbackLock;
+    std::deque<lime::FPGA_DataPacket> loopbackPackets;
+    std::mutex txRecordLock;
+    std::vector<lime::FPGA_DataPacket> txRecord;
+    std::mutex regLock;
+    std::map<uint16_t, uint16_t> fpgaRegs;
+    std::map<uint16_t, uint16_t> lmsRegs;
+    std::vector<uint16_t> fpgaWrites;
+    std::vector<uint16_t> lmsWrites;
+};
+
+/** @brief Test fixture streaming through synthetic connection. Streams set up
+    by the test are stopped and closed in reverse order when the test ends.
+*/
+template <class Connection = SyntheticConnection>
+class SyntheticStreamTest : public ::testing::Test
+{
+public:
+    SyntheticStreamTest(const bool loopback = false) : conn(loopback)
+    {
+    }
+
+    //! @brief Returns configuration of single channel stream
+    static lime::StreamConfig ChannelConfig(const bool isTx, const lime::StreamConfig::StreamDataFormat format = lime::StreamConfig::STREAM_12_BIT_COMPRESSED)
+    {
+        lime::StreamConfig config;
+        config.isTx = isTx;
+        config.channelID = 0;
+        config.format = format;
+        return config;
+    }
+
+    //! @brief Sets up stream, the first receive stream paces generated packets
+    void SetupStream(size_t &streamID, const lime::StreamConfig &config)
+    {
+        ASSERT_EQ(0, conn.SetupStream(streamID, config));
+        mStreams.push_back(streamID);
+        if (!config.isTx && conn.rxStream.load() == 0)
+            conn.rxStream = streamID;
+    }
+
+    //! @brief Sets up and starts stream
+    void StartStream(size_t &streamID, const lime::StreamConfig &config)
+    {
+        ASSERT_NO_FATAL_FAILURE(SetupStream(streamID, config));
+        ASSERT_EQ(0, conn.ControlStream(streamID, true));
+    }
+
+    void TearDown() override
+    {
+        for (auto it = mStreams.rbegin(); it != mStreams.rend(); ++it)
+            conn.ControlStream(*it, false);
+        for (auto it = mStreams.rbegin(); it != mStreams.rend(); ++it)
+            conn.CloseStream(*it);
+    }
+
+    Connection conn;
+
+private:
+    std::vector<size_t> mStreams;
+};
+
+#endif // SYNTHETIC_CONNECTION_H
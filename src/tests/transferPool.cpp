@@ -0,0 +1,122 @@
+#include "gtest/gtest.h"
+#include "TransferPool.h"
+#include <thread>
+#include <chrono>
+#include <set>
+#include <atomic>
+#include <mutex>
+using namespace std;
+using namespace lime;
+
+TEST (TransferPool, FreeList)
+{
+    TransferPool pool(4);
+    std::set<int> ids;
+    for (int i = 0; i < 4; ++i)
+        ids.insert(pool.Acquire());
+    EXPECT_EQ(4u, ids.size());
+    EXPECT_EQ(0, *ids.begin());
+    EXPECT_EQ(3, *ids.rbegin());
+    EXPECT_EQ(-1, pool.Acquire());
+
+    pool.Release(2);
+    EXPECT_FALSE(pool.IsUsed(2));
+    EXPECT_EQ(2, pool.Acquire());
+    EXPECT_TRUE(pool.IsPending(2));
+}
+
+TEST (TransferPool, CompletionOrder)
+{
+    TransferPool pool(8);
+    const int first = pool.Acquire();
+    const int second = pool.Acquire();
+    const int third = pool.Acquire();
+    EXPECT_EQ(-1, pool.WaitAny(0));
+
+    //later transfers are not stuck behind the first one
+    pool.Complete(third);
+    pool.Complete(second);
+    EXPECT_EQ(third, pool.WaitAny(0));
+    EXPECT_EQ(second, pool.WaitAny(0));
+    EXPECT_EQ(-1, pool.WaitAny(0));
+    EXPECT_TRUE(pool.IsPending(first));
+
+    std::thread callback([&pool, first]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        pool.Complete(first);
+    });
+    EXPECT_EQ(first, pool.WaitAny(1000));
+    callback.join();
+}
+
+TEST (TransferPool, WaitForParticular)
+{
+    TransferPool pool(2);
+    const int queued = pool.Acquire();
+    const int single = pool.Acquire(false);
+    EXPECT_FALSE(pool.Wait(single, 0));
+    pool.Complete(single);
+    EXPECT_TRUE(pool.Wait(single, 0));
+    //not reported to the thread waiting for any completion
+    EXPECT_EQ(-1, pool.WaitAny(0));
+    pool.Release(single);
+
+    pool.Complete(queued);
+    EXPECT_TRUE(pool.Wait(queued, 0));
+    pool.Release(queued);
+    //released context is skipped, reused one is reported once
+    EXPECT_EQ(-1, pool.WaitAny(0));
+    const int reused = pool.Acquire();
+    pool.Complete(reused);
+    EXPECT_EQ(reused, pool.WaitAny(0));
+    EXPECT_EQ(-1, pool.WaitAny(0));
+}
+
+TEST (TransferPool, ReuseUnderLoad)
+{
+    const int contexts = 16;
+    const int transfers = 100000;
+    TransferPool pool(contexts);
+    //completion thread finishes transfers in reverse order of submission
+    std::vector<int> submitted;
+    std::mutex lock;
+    std::atomic<bool> done(false);
+    std::thread callback([&]()
+    {
+        while (!done.load())
+        {
+            std::vector<int> batch;
+            {
+                std::lock_guard<std::mutex> lck(lock);
+                batch.swap(submitted);
+            }
+            for (auto it = batch.rbegin(); it != batch.rend(); ++it)
+                pool.Complete(*it);
+            std::this_thread::yield();
+        }
+    });
+
+    int inFlight = 0;
+    int completed = 0;
+    const auto start = std::chrono::steady_clock::now();
+    while (completed < transfers)
+    {
+        int id;
+        while (inFlight < contexts && (id = pool.Acquire()) >= 0)
+        {
+            std::lock_guard<std::mutex> lck(lock);
+            submitted.push_back(id);
+            ++inFlight;
+        }
+        id = pool.WaitAny(1000);
+        ASSERT_GE(id, 0);
+        pool.Release(id);
+        --inFlight;
+        ++completed;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    done.store(true);
+    callback.join();
+    printf("%.0f transfer completions/s\n", transfers/seconds);
+}